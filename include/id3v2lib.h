@@ -15,17 +15,36 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
+#include <sys/uio.h>
+
+#include "modules/canonical.h"
+#include "modules/change_log.h"
+#include "modules/codepage.h"
+#include "modules/cover_store.h"
 #include "modules/frame_header.h"
 #include "modules/frame_ids.h"
 #include "modules/frame_list.h"
 #include "modules/frame.h"
 #include "modules/frames/apic_frame.h"
 #include "modules/frames/comment_frame.h"
+#include "modules/frames/pcnt_frame.h"
+#include "modules/frames/popm_frame.h"
 #include "modules/frames/text_frame.h"
+#include "modules/genres.h"
+#include "modules/index_filter.h"
+#include "modules/index_groups.h"
+#include "modules/library_index.h"
 #include "modules/picture_types.h"
+#include "modules/scan.h"
+#include "modules/snapshot.h"
 #include "modules/tag_header.h"
 #include "modules/tag.h"
+#include "modules/tag_cache.h"
+#include "modules/tag_view.h"
+#include "modules/throttle.h"
 #include "modules/utils.h"
+#include "modules/walker.h"
 
 ID3v2_TagHeader* ID3v2_read_tag_header(const char* file_name);
 ID3v2_TagHeader* ID3v2_read_tag_header_from_buffer(const char* buffer);
@@ -37,6 +56,71 @@ void ID3v2_write_tag(const char* file_name, ID3v2_Tag* tag);
 
 void ID3v2_delete_tag(const char* file_name);
 
+#define ID3v2_OPERATION_CANCELLED 1
+
+/**
+ * Called as the audio data is moved. Returning false cancels the operation
+ * and leaves the original file untouched.
+ */
+typedef bool (*ID3v2_ProgressCallback)(
+    const unsigned long long bytes_moved,
+    const unsigned long long total_bytes,
+    void* ctx
+);
+
+/**
+ * Same as ID3v2_write_tag and ID3v2_delete_tag, reporting progress while
+ * the audio data is moved. The callback isn't called at all when nothing
+ * has to be moved. Return 0 on success, -1 on error and
+ * ID3v2_OPERATION_CANCELLED if the callback cancelled the operation.
+ * Partial tags (see ID3v2_TAG_CACHE_DROP_PICTURES) are never written.
+ */
+int ID3v2_write_tag_with_progress(
+    const char* file_name,
+    ID3v2_Tag* tag,
+    ID3v2_ProgressCallback callback,
+    void* callback_ctx
+);
+int ID3v2_delete_tag_with_progress(
+    const char* file_name,
+    ID3v2_ProgressCallback callback,
+    void* callback_ctx
+);
+
+#define ID3v2_PREPEND_IOV_COUNT 3
+
+/**
+ * Lays out a tagged copy of audio without copying it: iov (which must have
+ * room for ID3v2_PREPEND_IOV_COUNT entries) is filled with the serialized
+ * tag, its padding and the audio itself. Only the first entry is allocated,
+ * free its iov_base once the output has been written. Returns 0 on success
+ * and -1 on error.
+ */
+int ID3v2_Tag_prepend(
+    ID3v2_Tag* tag,
+    const char* audio,
+    const size_t audio_size,
+    struct iovec* iov,
+    int* iovcnt
+);
+
+/**
+ * Writes every entry of iov to fd, retrying partial writes. The entries are
+ * consumed as they're written. Returns 0 on success and -1 on error.
+ */
+int ID3v2_writev(const int fd, struct iovec* iov, int iovcnt);
+
+/**
+ * Fast paths for the frames that change on every play. The existing PCNT
+ * frame (or the POPM frame for email, when it isn't NULL) is patched in
+ * place, and a missing one is written into the padding. Only when that isn't
+ * possible is the whole tag rewritten. The file is locked while it's being
+ * updated, so concurrent calls don't lose updates. Both return 0 on success
+ * and -1 on error.
+ */
+int ID3v2_increment_play_count(const char* file_name, const char* email);
+int ID3v2_set_rating(const char* file_name, const char* email, const unsigned char rating);
+
 #ifdef __cplusplus
 } // extern "C"
 // clang-format on
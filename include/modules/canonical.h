@@ -0,0 +1,38 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_canonical_h
+#define id3v2lib_canonical_h
+
+/**
+ * Canonical tags take a multiple of this many bytes, header included.
+ */
+#define ID3v2_CANONICAL_TAG_ALIGNMENT 1024
+
+typedef struct _ID3v2_Tag ID3v2_Tag;
+
+/**
+ * Rewrites the tag so equal metadata always serializes to the same bytes,
+ * whatever its edit history:
+ *
+ * - Frames are sorted by id, and frames sharing an id by their content.
+ * - Text frames use Latin-1 when possible and UTF-16 otherwise in v2.3
+ *   tags, UTF-8 in v2.4 tags. Empty trailing values are dropped.
+ * - Tag flags and frame status flags are cleared.
+ * - Padding fills the tag up to the next ID3v2_CANONICAL_TAG_ALIGNMENT.
+ */
+void ID3v2_Tag_canonicalize(ID3v2_Tag* tag);
+
+/**
+ * Canonicalizes the tag and returns its bytes, padding included. The
+ * result can be hashed to tell whether two tags hold the same metadata.
+ */
+char* ID3v2_Tag_to_canonical(ID3v2_Tag* tag, int* size);
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_change_log_h
+#define id3v2lib_change_log_h
+
+#include <stdio.h>
+
+#define ID3v2_CHANGE_LOG_RECORD_MAGIC "ID3L"
+#define ID3v2_CHANGE_LOG_RECORD_MAGIC_LENGTH 4
+
+typedef struct _ID3v2_Tag ID3v2_Tag;
+
+/**
+ * An append only log of tag edits. Every record holds the identity of the
+ * edited file (its path relative to the library root), a hash of all of its
+ * audio data and the frames that changed, so the same edits can be replayed on
+ * a copy of the library without copying any audio.
+ */
+typedef struct _ID3v2_ChangeLog
+{
+    FILE* file;
+} ID3v2_ChangeLog;
+
+ID3v2_ChangeLog* ID3v2_ChangeLog_open(const char* log_file_name);
+void ID3v2_ChangeLog_close(ID3v2_ChangeLog* log);
+
+/**
+ * Works like ID3v2_write_tag and then appends a record with the frames that
+ * differ from the ones previously found in the file. file_id identifies the
+ * file across replicas: its path relative to the library root, without ".."
+ * components. Returns 0 on success and -1 if file_id isn't such a path or the
+ * tag couldn't be written, in which case nothing is logged, or if the record
+ * couldn't be appended.
+ */
+int ID3v2_ChangeLog_write_tag(
+    ID3v2_ChangeLog* log,
+    const char* file_name,
+    const char* file_id,
+    ID3v2_Tag* tag
+);
+
+/**
+ * Replays every record of the log on the replica found at replica_root.
+ * Records whose file id points outside of replica_root, whose audio
+ * fingerprint doesn't match the replica's file, or whose tag can't be written
+ * are skipped. Returns the number of records applied or -1 if the log can't be
+ * read.
+ */
+int ID3v2_ChangeLog_apply(const char* log_file_name, const char* replica_root);
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_codepage_h
+#define id3v2lib_codepage_h
+
+/**
+ * Codepages the text of Latin-1 frames is often written in instead. CP1252
+ * and CP1251 are the western and cyrillic Windows codepages, Shift-JIS and
+ * GBK are read as Windows does (codepages 932 and 936).
+ */
+#define ID3v2_CODEPAGE_LATIN1 0
+#define ID3v2_CODEPAGE_CP1252 1
+#define ID3v2_CODEPAGE_CP1251 2
+#define ID3v2_CODEPAGE_SHIFT_JIS 3
+#define ID3v2_CODEPAGE_GBK 4
+
+#define ID3v2_CODEPAGE_COUNT 5
+
+/**
+ * Room needed to decode size bytes of text, termination included. No
+ * character takes more than three bytes of UTF-8 or less than one byte.
+ */
+#define ID3v2_CODEPAGE_UTF8_SIZE(size) ((size) * 3 + 1)
+
+typedef struct _ID3v2_Tag ID3v2_Tag;
+
+/**
+ * Guesses the codepage of Latin-1 text from its bytes. Guesses get better
+ * with more text, so everything that should share a codepage (like the
+ * tags of an album) is best added to the same detector.
+ */
+typedef struct _ID3v2_CodepageDetector
+{
+    long scores[ID3v2_CODEPAGE_COUNT];
+    int text_count; // Texts that aren't plain ASCII
+} ID3v2_CodepageDetector;
+
+/**
+ * Decodes size bytes of text in codepage into dest as null terminated
+ * UTF-8. dest needs room for ID3v2_CODEPAGE_UTF8_SIZE(size) bytes. Runs of
+ * ASCII are copied as they are, null characters included, and bytes that
+ * don't make a character become U+FFFD. Returns the size of the decoded
+ * text, without its termination.
+ */
+int ID3v2_codepage_to_utf8(const char* text, const int size, const int codepage, char* dest);
+
+/**
+ * Re-encodes the Latin-1 text frames of the tag reading their bytes in
+ * codepage, as UTF-8 in v2.4 tags and UTF-16 in v2.3 ones. Frames whose
+ * bytes read the same in Latin-1 are left as they are.
+ */
+void ID3v2_Tag_decode_codepage(ID3v2_Tag* tag, const int codepage);
+
+void ID3v2_CodepageDetector_init(ID3v2_CodepageDetector* detector);
+void ID3v2_CodepageDetector_add_text(
+    ID3v2_CodepageDetector* detector,
+    const char* text,
+    const int size
+);
+
+/**
+ * Adds the text of every Latin-1 text frame of the tag.
+ */
+void ID3v2_CodepageDetector_add_tag(ID3v2_CodepageDetector* detector, ID3v2_Tag* tag);
+
+/**
+ * Returns the codepage that reads the texts added so far most like words of
+ * some language, or ID3v2_CODEPAGE_LATIN1 if they're plain ASCII or none
+ * reads any better.
+ */
+int ID3v2_CodepageDetector_guess(const ID3v2_CodepageDetector* detector);
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_cover_store_h
+#define id3v2lib_cover_store_h
+
+#include <stdbool.h>
+
+// Pictures are named after the hex SHA-256 of their bytes
+#define ID3v2_COVER_HASH_LENGTH 64
+
+/**
+ * A picture found in an APIC frame. width and height are 0 when they
+ * can't be read from the picture (only PNG, JPEG and GIF are understood).
+ */
+typedef struct _ID3v2_Cover
+{
+    const char* file_name;
+    int picture_type;
+    char hash[ID3v2_COVER_HASH_LENGTH + 1];
+    const char* mime_type;
+    long size;
+    int width;
+    int height;
+} ID3v2_Cover;
+
+/**
+ * A directory holding the pictures of a library, each stored once under
+ * xx/hash (xx being the first two characters of the hash), and a mapping
+ * file listing the pictures of every file extracted so far along with a
+ * fingerprint of its tag.
+ */
+typedef struct _ID3v2_CoverStore ID3v2_CoverStore;
+
+typedef struct _ID3v2_CoverStats
+{
+    // Skipped because their fingerprint didn't change
+    int unchanged_files;
+    // Files that couldn't be read, and pictures that couldn't be stored
+    int failed;
+    // Found in the files that changed
+    int pictures;
+    // Pictures the store didn't hold yet
+    int stored_pictures;
+} ID3v2_CoverStats;
+
+/**
+ * Called once per picture. Returning false stops the iteration.
+ */
+typedef bool (*ID3v2_CoverCallback)(const ID3v2_Cover* cover, void* ctx);
+
+/**
+ * Creates the directory if needed and loads its mapping. Returns NULL on
+ * error.
+ */
+ID3v2_CoverStore* ID3v2_CoverStore_open(const char* directory);
+void ID3v2_CoverStore_close(ID3v2_CoverStore* store);
+
+/**
+ * Stores the pictures of every file, reading threads files at the same
+ * time (0 uses one per CPU), and saves the mapping. Files whose size,
+ * mtime and frame headers match their fingerprint are skipped without
+ * reading any picture. Pictures are found by walking the frame headers of
+ * the tag and copied to the store straight from the file, only tags that
+ * need decoding (unsynchronised ones) are read whole. stats can be NULL.
+ * Returns 0 on success and -1 if the mapping can't be saved.
+ */
+int ID3v2_CoverStore_extract(
+    ID3v2_CoverStore* store,
+    const char* const* file_names,
+    const int count,
+    const int threads,
+    ID3v2_CoverStats* stats
+);
+
+/**
+ * Visits the pictures of every file of the mapping, sorted by file name.
+ * Returns 0 once every picture has been visited and
+ * ID3v2_OPERATION_CANCELLED if the callback stopped the iteration.
+ */
+int ID3v2_CoverStore_for_each(
+    const ID3v2_CoverStore* store,
+    ID3v2_CoverCallback callback,
+    void* callback_ctx
+);
+
+#endif
@@ -14,6 +14,8 @@
 
 #define ID3v2_ENCODING_ISO 0
 #define ID3v2_ENCODING_UNICODE 1
+#define ID3v2_ENCODING_UTF16BE 2
+#define ID3v2_ENCODING_UTF8 3
 
 typedef struct _ID3v2_FrameHeader ID3v2_FrameHeader;
 
@@ -17,9 +17,15 @@
 #define ID3v2_GENRE_FRAME_ID "TCON"
 #define ID3v2_TRACK_FRAME_ID "TRCK"
 #define ID3v2_YEAR_FRAME_ID "TYER"
+#define ID3v2_DATE_FRAME_ID "TDAT"
+#define ID3v2_RECORDING_TIME_FRAME_ID "TDRC"
+#define ID3v2_BPM_FRAME_ID "TBPM"
+#define ID3v2_LENGTH_FRAME_ID "TLEN"
 #define ID3v2_COMMENT_FRAME_ID "COMM"
 #define ID3v2_DISC_NUMBER_FRAME_ID "TPOS"
 #define ID3v2_COMPOSER_FRAME_ID "TCOM"
 #define ID3v2_ALBUM_COVER_FRAME_ID "APIC"
+#define ID3v2_POPULARIMETER_FRAME_ID "POPM"
+#define ID3v2_PLAY_COUNTER_FRAME_ID "PCNT"
 
 #endif
@@ -10,8 +10,15 @@
 #ifndef id3v2lib_frame_list_h
 #define id3v2lib_frame_list_h
 
+#include <stdbool.h>
+
 typedef struct _ID3v2_Frame ID3v2_Frame;
 
+/**
+ * Used to select frames, ctx is passed as is to every call.
+ */
+typedef bool (*ID3v2_FramePredicate)(ID3v2_Frame* frame, void* ctx);
+
 typedef struct _ID3v2_FrameList
 {
     ID3v2_Frame* frame;
@@ -0,0 +1,26 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_pcnt_frame_h
+#define id3v2lib_pcnt_frame_h
+
+typedef struct _ID3v2_FrameHeader ID3v2_FrameHeader;
+
+typedef struct _ID3v2_PcntFrameData
+{
+    unsigned long long counter;
+} ID3v2_PcntFrameData;
+
+typedef struct _ID3v2_PcntFrame
+{
+    ID3v2_FrameHeader* header;
+    ID3v2_PcntFrameData* data;
+} ID3v2_PcntFrame;
+
+#endif
@@ -0,0 +1,30 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_popm_frame_h
+#define id3v2lib_popm_frame_h
+
+#define ID3v2_POPM_FRAME_RATING_LENGTH 1
+
+typedef struct _ID3v2_FrameHeader ID3v2_FrameHeader;
+
+typedef struct _ID3v2_PopmFrameData
+{
+    char* email;
+    unsigned char rating;
+    unsigned long long counter;
+} ID3v2_PopmFrameData;
+
+typedef struct _ID3v2_PopmFrame
+{
+    ID3v2_FrameHeader* header;
+    ID3v2_PopmFrameData* data;
+} ID3v2_PopmFrame;
+
+#endif
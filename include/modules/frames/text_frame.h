@@ -10,6 +10,8 @@
 #ifndef id3v2lib_text_frame_h
 #define id3v2lib_text_frame_h
 
+#define ID3v2_TEXT_FRAME_MAX_NUMBERS 3
+
 typedef struct _ID3v2_FrameHeader ID3v2_FrameHeader;
 
 typedef struct _ID3v2_TextFrameData
@@ -17,8 +19,22 @@ typedef struct _ID3v2_TextFrameData
     int size;
     char encoding;
     char* text;
+    // Numbers found in the text, parsed by the numeric getters the first
+    // time they're needed. number_count is -1 until then.
+    int number_count;
+    long numbers[ID3v2_TEXT_FRAME_MAX_NUMBERS];
 } ID3v2_TextFrameData;
 
+/**
+ * A string that doesn't have to be NUL terminated. The encoding of text is
+ * provided along with it, see the ID3v2_ENCODING_* constants.
+ */
+typedef struct _ID3v2_TextValue
+{
+    const char* text;
+    int size;
+} ID3v2_TextValue;
+
 typedef struct _ID3v2_TextFrame
 {
     ID3v2_FrameHeader* header;
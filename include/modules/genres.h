@@ -0,0 +1,46 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_genres_h
+#define id3v2lib_genres_h
+
+// Genres of the ID3v1 spec and its Winamp extensions
+#define ID3v2_GENRE_COUNT 192
+
+#define ID3v2_GENRE_UNKNOWN -1
+#define ID3v2_GENRE_REMIX -2
+#define ID3v2_GENRE_COVER -3
+
+typedef struct _ID3v2_Genre
+{
+    // One of the ID3v1 genres or ID3v2_GENRE_REMIX, ID3v2_GENRE_COVER and
+    // ID3v2_GENRE_UNKNOWN for free text genres that aren't in the table
+    int id;
+    // Points to the static genre table, NULL for unknown genres
+    const char* name;
+    // Unknown genres only, points to the text of the frame so it isn't null
+    // terminated. Its encoding is one of the ID3v2_ENCODING_* constants.
+    const char* text;
+    int text_size;
+    char encoding;
+} ID3v2_Genre;
+
+/**
+ * Returns the name of an ID3v1 genre, "Remix" or "Cover", or NULL if the
+ * id isn't known.
+ */
+const char* ID3v2_genre_name(const int id);
+
+/**
+ * Returns the id of the genre with the provided name, compared ignoring
+ * case, or ID3v2_GENRE_UNKNOWN if there isn't any.
+ */
+int ID3v2_genre_id(const char* name);
+
+#endif
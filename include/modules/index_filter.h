@@ -0,0 +1,67 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_index_filter_h
+#define id3v2lib_index_filter_h
+
+#include "library_index.h"
+
+/**
+ * A compiled filter over the columns of the library index, written as
+ *
+ *   artist contains "beatles" and year between 1965 and 1970 and has_cover
+ *
+ * Columns are named path, title, artist, album, album_artist, genre, year,
+ * track and has_cover. Every column can be compared with =, !=, <, <=, >
+ * and >=, string columns against quoted strings (compared by their bytes)
+ * and numeric ones against integers. Numeric columns also take
+ * "between low and high", both included, and can be used alone to test
+ * that they aren't 0. "contains" looks for a substring, ignoring the case
+ * of ASCII letters. Predicates are combined with and, or, not and
+ * parentheses, and keywords are case insensitive. An empty expression
+ * selects every row.
+ */
+typedef struct _ID3v2_IndexFilter ID3v2_IndexFilter;
+
+/**
+ * The rows of a snapshot selected by a filter. It keeps the snapshot
+ * pinned until it's freed.
+ */
+typedef struct _ID3v2_IndexSelection ID3v2_IndexSelection;
+
+/**
+ * Returns NULL if the expression isn't valid, storing the offset at which
+ * it stops making sense in error_offset (when it isn't NULL).
+ */
+ID3v2_IndexFilter* ID3v2_IndexFilter_compile(const char* expression, int* error_offset);
+void ID3v2_IndexFilter_free(ID3v2_IndexFilter* filter);
+
+/**
+ * Runs the filter over every row of the snapshot. A filter can be run by
+ * several threads at the same time.
+ */
+ID3v2_IndexSelection* ID3v2_IndexFilter_select(
+    const ID3v2_IndexFilter* filter,
+    ID3v2_IndexSnapshot* snapshot
+);
+
+int ID3v2_IndexSelection_get_count(const ID3v2_IndexSelection* selection);
+
+/**
+ * Same as ID3v2_IndexSnapshot_for_each, only visiting the selected rows.
+ */
+int ID3v2_IndexSelection_for_each(
+    const ID3v2_IndexSelection* selection,
+    ID3v2_IndexRowCallback callback,
+    void* callback_ctx
+);
+
+void ID3v2_IndexSelection_free(ID3v2_IndexSelection* selection);
+
+#endif
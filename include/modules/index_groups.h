@@ -0,0 +1,69 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_index_groups_h
+#define id3v2lib_index_groups_h
+
+#include "index_filter.h"
+
+/**
+ * The rows of a snapshot (or of a selection) sharing the same value of a
+ * column. Groups of string columns set text, groups of numeric ones set
+ * number instead.
+ */
+typedef struct _ID3v2_IndexGroup
+{
+    const char* text;
+    int number;
+    int count;
+} ID3v2_IndexGroup;
+
+/**
+ * The groups of a column, sorted by value. It keeps the snapshot pinned
+ * until it's freed, and the text of its groups is valid until then.
+ */
+typedef struct _ID3v2_IndexGroups ID3v2_IndexGroups;
+
+/**
+ * Counts the rows of every value of a column. Numeric columns are grouped
+ * by ranges of width values, named after their first one: a width of 10
+ * groups years by decade. The width of string columns is ignored.
+ */
+ID3v2_IndexGroups* ID3v2_IndexSnapshot_group_by(
+    ID3v2_IndexSnapshot* snapshot,
+    const int column,
+    const int width
+);
+
+/**
+ * Same as ID3v2_IndexSnapshot_group_by, only counting the selected rows.
+ */
+ID3v2_IndexGroups* ID3v2_IndexSelection_group_by(
+    const ID3v2_IndexSelection* selection,
+    const int column,
+    const int width
+);
+
+int ID3v2_IndexGroups_get_count(const ID3v2_IndexGroups* groups);
+
+/**
+ * Returns NULL if there's no group at index.
+ */
+const ID3v2_IndexGroup* ID3v2_IndexGroups_get(const ID3v2_IndexGroups* groups, const int index);
+
+/**
+ * Copies the k groups with the most rows to dest, most rows first, and
+ * returns how many were copied. Groups with as many rows are copied in the
+ * order of their values.
+ */
+int ID3v2_IndexGroups_top(const ID3v2_IndexGroups* groups, const int k, ID3v2_IndexGroup* dest);
+
+void ID3v2_IndexGroups_free(ID3v2_IndexGroups* groups);
+
+#endif
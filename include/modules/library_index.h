@@ -0,0 +1,150 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_library_index_h
+#define id3v2lib_library_index_h
+
+#include <stdbool.h>
+
+/**
+ * Columns of the library index, one row per file. String columns hold
+ * UTF-8 text and numeric ones hold 0 when the tag doesn't have the frame.
+ */
+#define ID3v2_INDEX_PATH 0
+#define ID3v2_INDEX_TITLE 1
+#define ID3v2_INDEX_ARTIST 2
+#define ID3v2_INDEX_ALBUM 3
+#define ID3v2_INDEX_ALBUM_ARTIST 4
+#define ID3v2_INDEX_GENRE 5
+#define ID3v2_INDEX_YEAR 6
+#define ID3v2_INDEX_TRACK 7
+#define ID3v2_INDEX_HAS_COVER 8
+
+#define ID3v2_INDEX_STRING_COLUMN_COUNT 6
+#define ID3v2_INDEX_COLUMN_COUNT 9
+
+typedef struct _ID3v2_Tag ID3v2_Tag;
+
+/**
+ * The index lives in a directory of immutable segment files, listed by a
+ * manifest. Every commit writes a new segment with the rows it changes and
+ * replaces the manifest, so the files on disk are never seen half written.
+ * In memory, every manifest is a generation: readers pin the current one
+ * and keep reading it for as long as they need while newer ones are
+ * published. Only one process may write to an index, any number of them
+ * can read it.
+ */
+typedef struct _ID3v2_LibraryIndex ID3v2_LibraryIndex;
+
+/**
+ * A pinned generation of the index. It doesn't change while it's held,
+ * whatever is committed or compacted meanwhile.
+ */
+typedef struct _ID3v2_IndexSnapshot ID3v2_IndexSnapshot;
+
+/**
+ * Rows to put or delete in a single commit.
+ */
+typedef struct _ID3v2_IndexBatch ID3v2_IndexBatch;
+
+/**
+ * strings is only used for string columns and numbers for numeric ones,
+ * both are indexed by column. Strings read from a snapshot point into it.
+ */
+typedef struct _ID3v2_IndexRow
+{
+    const char* strings[ID3v2_INDEX_COLUMN_COUNT];
+    int numbers[ID3v2_INDEX_COLUMN_COUNT];
+} ID3v2_IndexRow;
+
+/**
+ * Opens the index stored in directory, creating it if it doesn't exist.
+ * Returns NULL on error.
+ */
+ID3v2_LibraryIndex* ID3v2_LibraryIndex_open(const char* directory);
+
+/**
+ * Snapshots acquired from the index stay valid after it's closed.
+ */
+void ID3v2_LibraryIndex_close(ID3v2_LibraryIndex* index);
+
+ID3v2_IndexBatch* ID3v2_IndexBatch_new();
+void ID3v2_IndexBatch_free(ID3v2_IndexBatch* batch);
+
+/**
+ * Rows are copied into the batch. When a batch puts or deletes the same
+ * path more than once, the last one wins.
+ */
+void ID3v2_IndexBatch_put(ID3v2_IndexBatch* batch, const ID3v2_IndexRow* row);
+void ID3v2_IndexBatch_put_tag(ID3v2_IndexBatch* batch, const char* path, ID3v2_Tag* tag);
+void ID3v2_IndexBatch_delete(ID3v2_IndexBatch* batch, const char* path);
+
+/**
+ * Writes the batch as a new segment and publishes the generation holding
+ * it. Its cost only depends on the size of the batch. Returns 0 on success
+ * and -1 on error, in which case the index is left as it was.
+ */
+int ID3v2_LibraryIndex_commit(ID3v2_LibraryIndex* index, ID3v2_IndexBatch* batch);
+
+/**
+ * Picks up what another process committed or compacted since the index
+ * was opened, loading only the segments that aren't loaded yet. Returns 0
+ * on success and -1 on error.
+ */
+int ID3v2_LibraryIndex_refresh(ID3v2_LibraryIndex* index);
+
+/**
+ * Merges every segment into a single one without the rows that were
+ * replaced or deleted. Meant to be called from a background thread: the
+ * merge doesn't hold any lock, readers keep using the generation they
+ * pinned and commits made meanwhile are kept. Returns 0 on success and -1
+ * on error.
+ */
+int ID3v2_LibraryIndex_compact(ID3v2_LibraryIndex* index);
+
+/**
+ * Pins the current generation. Never blocks, not even while a commit is
+ * being published. Every acquired snapshot has to be released.
+ */
+ID3v2_IndexSnapshot* ID3v2_LibraryIndex_acquire(ID3v2_LibraryIndex* index);
+void ID3v2_IndexSnapshot_release(ID3v2_IndexSnapshot* snapshot);
+
+/**
+ * Number of the generation, it grows by one with every commit and
+ * compaction.
+ */
+unsigned long long ID3v2_IndexSnapshot_get_generation(const ID3v2_IndexSnapshot* snapshot);
+int ID3v2_IndexSnapshot_get_segment_count(const ID3v2_IndexSnapshot* snapshot);
+int ID3v2_IndexSnapshot_get_row_count(const ID3v2_IndexSnapshot* snapshot);
+
+/**
+ * Fills row with the one stored for path. Returns false if there isn't any.
+ */
+bool ID3v2_IndexSnapshot_find(
+    const ID3v2_IndexSnapshot* snapshot,
+    const char* path,
+    ID3v2_IndexRow* row
+);
+
+/**
+ * Called once per row, in no particular order. Returning false stops.
+ */
+typedef bool (*ID3v2_IndexRowCallback)(const ID3v2_IndexRow* row, void* ctx);
+
+/**
+ * Returns 0 once every row has been visited and ID3v2_OPERATION_CANCELLED
+ * if the callback stopped.
+ */
+int ID3v2_IndexSnapshot_for_each(
+    const ID3v2_IndexSnapshot* snapshot,
+    ID3v2_IndexRowCallback callback,
+    void* callback_ctx
+);
+
+#endif
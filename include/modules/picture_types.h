@@ -32,4 +32,6 @@
 #define ID3v2_PIC_TYPE_ARTIST_LOGOTYPE 0x13
 #define ID3v2_PIC_TYPE_PUBLISHER_LOGOTYPE 0x14
 
+#define ID3v2_PIC_TYPE_COUNT 0x15
+
 #endif
@@ -0,0 +1,87 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_scan_h
+#define id3v2lib_scan_h
+
+#include <stdbool.h>
+
+/**
+ * Orders in which the files of a scan are visited. PHYSICAL visits them
+ * by the disk offset of their first extent (as reported by FIEMAP, or by
+ * inode number when it isn't available), which saves seeks on rotational
+ * disks.
+ */
+#define ID3v2_SCAN_ORDER_GIVEN 0
+#define ID3v2_SCAN_ORDER_PHYSICAL 1
+
+#define ID3v2_SCAN_DEFAULT_WINDOW 256
+
+typedef struct _ID3v2_Tag ID3v2_Tag;
+
+/**
+ * In physical order, only the next window files of the list are looked
+ * at, and among them the one that follows the last file visited on disk
+ * goes first. Bigger windows save more seeks but stat more files ahead.
+ * Scans hand out tags with their Latin-1 text frames read in codepage (one
+ * of the ID3v2_CODEPAGE_* constants, see ID3v2_Tag_decode_codepage), 0
+ * leaves them as they are. Updates ignore it.
+ */
+typedef struct _ID3v2_ScanOptions
+{
+    int order;
+    int window;
+    int codepage;
+} ID3v2_ScanOptions;
+
+/**
+ * Called once per file. tag is NULL when the file has no tag or can't be
+ * read, and it's freed once the callback returns. Returning false stops
+ * the scan.
+ */
+typedef bool (*ID3v2_ScanCallback)(const char* file_name, ID3v2_Tag* tag, void* ctx);
+
+/**
+ * Called once per file, with an empty tag when the file has none. Returning
+ * true writes the tag back to the file.
+ */
+typedef bool (*ID3v2_UpdateCallback)(const char* file_name, ID3v2_Tag* tag, void* ctx);
+
+/**
+ * Reads the tag of every file and hands it to the callback. options can be
+ * NULL to visit the files in the given order. The scan runs with the I/O
+ * class of the installed throttle, if any. Returns 0 once every file has
+ * been visited and ID3v2_OPERATION_CANCELLED if the callback stopped the
+ * scan.
+ */
+int ID3v2_scan_files(
+    const char* const* file_names,
+    const int count,
+    const ID3v2_ScanOptions* options,
+    ID3v2_ScanCallback callback,
+    void* callback_ctx
+);
+
+/**
+ * Same as ID3v2_scan_files, writing back the tags the callback asks for.
+ * Tags are handed out as they're stored, whatever the codepage of options,
+ * so only the callback can convert what gets written, by calling
+ * ID3v2_Tag_decode_codepage itself. Every file is visited even if some
+ * writes fail. Returns 0 on success and
+ * -1 if any write failed.
+ */
+int ID3v2_update_files(
+    const char* const* file_names,
+    const int count,
+    const ID3v2_ScanOptions* options,
+    ID3v2_UpdateCallback callback,
+    void* callback_ctx
+);
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_snapshot_h
+#define id3v2lib_snapshot_h
+
+#include <stdbool.h>
+
+#define ID3v2_SNAPSHOT_MAGIC "ID3S"
+#define ID3v2_SNAPSHOT_MAGIC_LENGTH 4
+#define ID3v2_SNAPSHOT_VERSION 1
+#define ID3v2_SNAPSHOT_HEADER_LENGTH 24
+#define ID3v2_SNAPSHOT_FRAME_ENTRY_LENGTH 16
+
+typedef struct _ID3v2_Frame ID3v2_Frame;
+typedef struct _ID3v2_Tag ID3v2_Tag;
+
+/**
+ * A snapshot is a parsed tag laid out in a single buffer without any
+ * pointers, so it can be mmapped, cached or sent over a socket and read as
+ * is by any process. Integers are stored big endian and offsets are
+ * relative to the start of the snapshot:
+ *
+ *   header       magic[4] version[1] major_version[1] minor_version[1] flags[1]
+ *                size[4] frame_count[4] payload_offset[4] padding_size[4]
+ *   frame table  frame_count entries of id[4] flags[2] reserved[2] offset[4] size[4]
+ *   payload      the data of every frame, serialized for major_version
+ *
+ * Frame data is laid out the way a tag of that version stores it, so the
+ * text of v2.4 snapshots may be UTF-8. ID3v2_FrameRef_get_text and the
+ * other ID3v2_FrameRef_get_* decoders (see tag_view.h) read it in place.
+ */
+
+/**
+ * A frame read from a snapshot. Every pointer points into the snapshot,
+ * id and flags aren't null terminated.
+ */
+typedef struct _ID3v2_FrameRef
+{
+    const char* id;
+    const char* flags;
+    const char* data;
+    int size;
+    bool unsynchronised; // Only set for frames of v2.4 tags unsynchronised as a whole
+} ID3v2_FrameRef;
+
+/**
+ * Lays out the tag in a new snapshot and returns it, its size is stored
+ * in size. The snapshot has to be released with free().
+ */
+char* ID3v2_Snapshot_new(ID3v2_Tag* tag, int* size);
+
+/**
+ * Checks that every offset found in the snapshot is within its bounds.
+ * Snapshots that come from untrusted sources have to be checked before
+ * reading them.
+ */
+bool ID3v2_Snapshot_is_valid(const char* snapshot, const int size);
+
+int ID3v2_Snapshot_get_frame_count(const char* snapshot);
+char ID3v2_Snapshot_get_major_version(const char* snapshot);
+
+bool ID3v2_Snapshot_get_frame(const char* snapshot, const int index, ID3v2_FrameRef* frame);
+
+/**
+ * Looks for the first frame matching frame_id, starting at the start-th
+ * frame. Returns its index, or -1 if there isn't any.
+ */
+int ID3v2_Snapshot_find_frame(
+    const char* snapshot,
+    const char* frame_id,
+    const int start,
+    ID3v2_FrameRef* frame
+);
+
+/**
+ * Decodes the index-th frame into a frame like the ones of a parsed tag, so
+ * its text, comment, picture or counter can be read through the usual
+ * structs. Returns NULL if there's no such frame. The frame is a copy and
+ * has to be released with ID3v2_Frame_free().
+ */
+ID3v2_Frame* ID3v2_Snapshot_decode_frame(const char* snapshot, const int index);
+
+#endif
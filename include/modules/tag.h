@@ -10,19 +10,40 @@
 #ifndef id3v2lib_tag_h
 #define id3v2lib_tag_h
 
+#include <stdbool.h>
+
+#include "modules/frame_list.h"
+
 #define ID3v2_TAG_DEFAULT_PADDING_LENGTH 2048
 
+/**
+ * Dates are packed as YYYYMMDD so they can be compared and sorted as plain
+ * integers. Unknown months and days are 0.
+ */
+#define ID3v2_DATE(year, month, day) ((year) * 10000 + (month) * 100 + (day))
+#define ID3v2_DATE_YEAR(date) ((date) / 10000)
+#define ID3v2_DATE_MONTH(date) (((date) / 100) % 100)
+#define ID3v2_DATE_DAY(date) ((date) % 100)
+
 typedef struct _ID3v2_TagHeader ID3v2_TagHeader;
 typedef struct _ID3v2_FrameList ID3v2_FrameList;
 typedef struct _ID3v2_TextFrame ID3v2_TextFrame;
 typedef struct _ID3v2_CommentFrame ID3v2_CommentFrame;
 typedef struct _ID3v2_ApicFrame ID3v2_ApicFrame;
+typedef struct _ID3v2_PopmFrame ID3v2_PopmFrame;
+typedef struct _ID3v2_PcntFrame ID3v2_PcntFrame;
+typedef struct _ID3v2_TagIndex ID3v2_TagIndex;
+typedef struct _ID3v2_Genre ID3v2_Genre;
+typedef struct _ID3v2_TextValue ID3v2_TextValue;
 
 typedef struct _ID3v2_Tag
 {
     ID3v2_TagHeader* header;
     ID3v2_FrameList* frames;
     int padding_size;
+    ID3v2_TagIndex* index;
+    // Some frames were left out when it was read, so it can't be written
+    bool partial;
 } ID3v2_Tag;
 
 ID3v2_Tag* ID3v2_Tag_new(ID3v2_TagHeader* header, const int padding_size);
@@ -56,9 +77,59 @@ ID3v2_TextFrame* ID3v2_Tag_get_disc_number_frame(ID3v2_Tag* tag);
 ID3v2_TextFrame* ID3v2_Tag_get_composer_frame(ID3v2_Tag* tag);
 ID3v2_CommentFrame* ID3v2_Tag_get_comment_frame(ID3v2_Tag* tag);
 ID3v2_FrameList* ID3v2_Tag_get_comment_frames(ID3v2_Tag* tag);
+
+/**
+ * Returns the COMM frame identified by language and short description, the
+ * pair that makes a COMM frame unique according to the spec. The description
+ * can be either an ISO or an unicode string, NULL is the same as "".
+ */
+ID3v2_CommentFrame* ID3v2_Tag_get_comment(
+    ID3v2_Tag* tag,
+    const char* language,
+    const char* short_description
+);
 ID3v2_ApicFrame* ID3v2_Tag_get_album_cover_frame(ID3v2_Tag* tag);
 ID3v2_FrameList* ID3v2_Tag_get_apic_frames(ID3v2_Tag* tag);
 
+/**
+ * Returns the first APIC frame with the provided picture type (one of the
+ * ID3v2_PIC_TYPE_* constants) or NULL if the tag doesn't have any.
+ */
+ID3v2_ApicFrame* ID3v2_Tag_get_picture(ID3v2_Tag* tag, const char picture_type);
+
+ID3v2_PcntFrame* ID3v2_Tag_get_play_counter_frame(ID3v2_Tag* tag);
+
+/**
+ * POPM frames are unique by email. If email is NULL, the first POPM
+ * frame found is returned.
+ */
+ID3v2_PopmFrame* ID3v2_Tag_get_popm_frame(ID3v2_Tag* tag, const char* email);
+
+/**
+ * Numeric getters. The text of the frame is parsed the first time one of
+ * them is called and the result is cached in the frame, so later calls
+ * don't parse it again. They return false if the tag doesn't have the
+ * frame or its text doesn't hold a number. Missing totals are set to 0.
+ */
+bool ID3v2_Tag_get_track(ID3v2_Tag* tag, int* number, int* total);
+bool ID3v2_Tag_get_disc(ID3v2_Tag* tag, int* number, int* total);
+bool ID3v2_Tag_get_year(ID3v2_Tag* tag, int* year);
+
+/**
+ * Reads TDRC if the tag has it, TYER and TDAT otherwise. See ID3v2_DATE
+ * for the format of date.
+ */
+bool ID3v2_Tag_get_date(ID3v2_Tag* tag, int* date);
+bool ID3v2_Tag_get_bpm(ID3v2_Tag* tag, int* bpm);
+bool ID3v2_Tag_get_length(ID3v2_Tag* tag, long* milliseconds);
+
+/**
+ * Resolves the genres found in the TCON frame against the ID3v1 genre
+ * table. Fills up to max_genres genres and returns how many were found.
+ * Nothing is allocated, see ID3v2_Genre.
+ */
+int ID3v2_Tag_get_genres(ID3v2_Tag* tag, ID3v2_Genre* genres, const int max_genres);
+
 /**
  * Setter functions
  */
@@ -71,6 +142,33 @@ typedef struct _ID3v2_TextFrameInput
 
 void ID3v2_Tag_set_text_frame(ID3v2_Tag* tag, ID3v2_TextFrameInput* input);
 
+/**
+ * Sets a text frame from size bytes of text in the provided encoding (one of
+ * the ID3v2_ENCODING_* constants, the tag is left alone for any other), so
+ * the text doesn't have to be NUL terminated. UTF-8 text is stored as is in
+ * v2.4 tags and converted to UTF-16 in older ones.
+ */
+void ID3v2_Tag_set_text(
+    ID3v2_Tag* tag,
+    const char* frame_id,
+    const char* text,
+    const int size,
+    const char encoding
+);
+
+/**
+ * Same as ID3v2_Tag_set_text, for frames holding several values. They're
+ * stored NUL separated, as v2.4 specifies, and joined with a "/" in older
+ * tags.
+ */
+void ID3v2_Tag_set_text_values(
+    ID3v2_Tag* tag,
+    const char* frame_id,
+    const ID3v2_TextValue* values,
+    const int count,
+    const char encoding
+);
+
 void ID3v2_Tag_set_artist(ID3v2_Tag* tag, const char* artist);
 void ID3v2_Tag_set_album(ID3v2_Tag* tag, const char* album);
 void ID3v2_Tag_set_title(ID3v2_Tag* tag, const char* title);
@@ -81,6 +179,22 @@ void ID3v2_Tag_set_year(ID3v2_Tag* tag, const char* year);
 void ID3v2_Tag_set_disc_number(ID3v2_Tag* tag, const char* disc_number);
 void ID3v2_Tag_set_composer(ID3v2_Tag* tag, const char* composer);
 
+/**
+ * Numeric setters, the counterparts of the numeric getters. A total of 0
+ * is left out of the frame.
+ */
+void ID3v2_Tag_set_track_value(ID3v2_Tag* tag, const int number, const int total);
+void ID3v2_Tag_set_disc_value(ID3v2_Tag* tag, const int number, const int total);
+void ID3v2_Tag_set_year_value(ID3v2_Tag* tag, const int year);
+
+/**
+ * v2.4 tags store the date, and the year, in TDRC, older ones in TYER and
+ * TDAT.
+ */
+void ID3v2_Tag_set_date_value(ID3v2_Tag* tag, const int date);
+void ID3v2_Tag_set_bpm(ID3v2_Tag* tag, const int bpm);
+void ID3v2_Tag_set_length(ID3v2_Tag* tag, const long milliseconds);
+
 typedef struct _ID3v2_CommentFrameInput
 {
     const char* flags;
@@ -107,6 +221,14 @@ typedef struct _ID3v2_ApicFrameInput
 void ID3v2_Tag_add_apic_frame(ID3v2_Tag* tag, ID3v2_ApicFrameInput* input);
 void ID3v2_Tag_set_apic_frame(ID3v2_Tag* tag, ID3v2_ApicFrameInput* input);
 
+void ID3v2_Tag_set_picture(
+    ID3v2_Tag* tag,
+    const char picture_type,
+    const char* mime_type,
+    const int size,
+    const char* data
+);
+
 void ID3v2_Tag_set_album_cover(
     ID3v2_Tag* tag,
     const char* mime_type,
@@ -114,11 +236,35 @@ void ID3v2_Tag_set_album_cover(
     const char* data
 );
 
+typedef struct _ID3v2_PopmFrameInput
+{
+    const char* flags;
+    const char* email;
+    const unsigned char rating;
+    const unsigned long long counter;
+} ID3v2_PopmFrameInput;
+
+void ID3v2_Tag_set_popm_frame(ID3v2_Tag* tag, ID3v2_PopmFrameInput* input);
+void ID3v2_Tag_set_play_count(ID3v2_Tag* tag, const unsigned long long count);
+
 /**
  * Delete functions
  */
 void ID3v2_Tag_delete_frame(ID3v2_Tag* tag, const char* frame_id);
 
+/**
+ * Deletes every frame for which predicate returns true in a single pass
+ * over the tag. Returns how many frames were deleted.
+ */
+int ID3v2_Tag_delete_frames_if(ID3v2_Tag* tag, ID3v2_FramePredicate predicate, void* ctx);
+
+/**
+ * Deletes every frame whose id is (or isn't, for the not_in variant) one
+ * of the count ids provided.
+ */
+int ID3v2_Tag_delete_frames_in(ID3v2_Tag* tag, const char* const* frame_ids, const int count);
+int ID3v2_Tag_delete_frames_not_in(ID3v2_Tag* tag, const char* const* frame_ids, const int count);
+
 void ID3v2_Tag_delete_artist(ID3v2_Tag* tag);
 void ID3v2_Tag_delete_album(ID3v2_Tag* tag);
 void ID3v2_Tag_delete_title(ID3v2_Tag* tag);
@@ -135,4 +281,7 @@ void ID3v2_Tag_delete_comment(ID3v2_Tag* tag);
 void ID3v2_Tag_delete_apic_frame(ID3v2_Tag* tag, const int index);
 void ID3v2_Tag_delete_album_cover(ID3v2_Tag* tag);
 
+void ID3v2_Tag_delete_popm_frame(ID3v2_Tag* tag, const char* email);
+void ID3v2_Tag_delete_play_counter(ID3v2_Tag* tag);
+
 #endif
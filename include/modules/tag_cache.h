@@ -0,0 +1,71 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_tag_cache_h
+#define id3v2lib_tag_cache_h
+
+#include <stddef.h>
+
+#define ID3v2_TAG_CACHE_SHARDS 16
+
+/**
+ * What to do with tags holding APIC frames larger than max_picture_size.
+ * KEEP caches them as any other tag, SKIP never caches them and DROP
+ * caches them without those frames. Tags rebuilt from such an entry are
+ * flagged as partial, and can't be written back; the library's own
+ * read-modify-write calls read the file instead.
+ */
+#define ID3v2_TAG_CACHE_KEEP_PICTURES 0
+#define ID3v2_TAG_CACHE_SKIP_PICTURES 1
+#define ID3v2_TAG_CACHE_DROP_PICTURES 2
+
+typedef struct _ID3v2_TagCacheShard ID3v2_TagCacheShard;
+
+/**
+ * Keeps recently read tags in memory, so reading the same file again
+ * doesn't touch the disk. Files are identified by device and inode, and
+ * cached tags are only used while the file keeps its mtime and size. The
+ * cache is split in shards with a lock each, and every shard evicts its
+ * least recently used tags once it holds more than its share of max_bytes.
+ */
+typedef struct _ID3v2_TagCache
+{
+    size_t max_bytes;
+    int picture_policy;
+    int max_picture_size;
+    ID3v2_TagCacheShard* shards;
+} ID3v2_TagCache;
+
+typedef struct _ID3v2_TagCacheStats
+{
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+    unsigned long long entries;
+    unsigned long long bytes;
+} ID3v2_TagCacheStats;
+
+ID3v2_TagCache* ID3v2_TagCache_new(
+    const size_t max_bytes,
+    const int picture_policy,
+    const int max_picture_size
+);
+void ID3v2_TagCache_free(ID3v2_TagCache* cache);
+
+/**
+ * Makes ID3v2_read_tag go through the cache, NULL stops using it. Files
+ * written by the library are dropped from the installed cache. The cache
+ * has to be uninstalled before it's freed.
+ */
+void ID3v2_TagCache_install(ID3v2_TagCache* cache);
+
+void ID3v2_TagCache_clear(ID3v2_TagCache* cache);
+void ID3v2_TagCache_get_stats(ID3v2_TagCache* cache, ID3v2_TagCacheStats* stats);
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_tag_view_h
+#define id3v2lib_tag_view_h
+
+#include <stdbool.h>
+
+#include "snapshot.h"
+
+/**
+ * Reads a tag straight from the bytes it's stored in, without allocating
+ * anything: frames are handed out as ID3v2_FrameRef pointing into buffer,
+ * which has to outlive the view. Views don't change the buffer, so any
+ * number of them can read it from different threads.
+ */
+typedef struct _ID3v2_TagView
+{
+    const char* buffer;
+    int end; // First byte after the tag or the buffer, whatever comes first
+    int major_version;
+    int flags;
+    bool unsynchronised; // v2.4 tags can be unsynchronised as a whole too
+    int frames_offset;
+    int cursor;
+} ID3v2_TagView;
+
+/**
+ * Checks the tag header found at the start of buffer. Returns false if
+ * there's no v2.3 or v2.4 tag, or it's a v2.3 tag unsynchronised as a whole,
+ * whose frames can't be found without decoding it first. The frames of a
+ * v2.4 tag unsynchronised as a whole can be walked, but not read in place.
+ */
+bool ID3v2_TagView_init(ID3v2_TagView* view, const char* buffer, const int size);
+
+/**
+ * Hands out the next frame. The data of v2.4 frames with a data length
+ * indicator starts after it. Returns false once the padding or the end of
+ * the tag is reached, or the next frame doesn't fit in the buffer.
+ */
+bool ID3v2_TagView_next(ID3v2_TagView* view, ID3v2_FrameRef* frame);
+
+/**
+ * Goes back to the first frame.
+ */
+void ID3v2_TagView_rewind(ID3v2_TagView* view);
+
+/**
+ * Looks for the first frame matching frame_id, without moving the view.
+ */
+bool ID3v2_TagView_find_frame(
+    const ID3v2_TagView* view,
+    const char* frame_id,
+    ID3v2_FrameRef* frame
+);
+
+/**
+ * Text as stored in a frame, in its encoding (one of the ID3v2_ENCODING_*
+ * constants) and without its terminator. UTF-16 keeps its BOM.
+ */
+typedef struct _ID3v2_TextRef
+{
+    char encoding;
+    const char* text;
+    int size;
+} ID3v2_TextRef;
+
+typedef struct _ID3v2_CommentRef
+{
+    const char* language; // 3 characters, not null terminated
+    ID3v2_TextRef short_description;
+    ID3v2_TextRef comment;
+} ID3v2_CommentRef;
+
+typedef struct _ID3v2_PictureRef
+{
+    const char* mime_type; // Null terminated
+    char picture_type;
+    ID3v2_TextRef description;
+    const char* data;
+    int size;
+} ID3v2_PictureRef;
+
+typedef struct _ID3v2_UserTextRef
+{
+    ID3v2_TextRef description;
+    ID3v2_TextRef value;
+} ID3v2_UserTextRef;
+
+/**
+ * Decode the body of text (T*** other than TXXX), COMM, APIC and TXXX
+ * frames. Every pointer points into the frame. They return false if the
+ * frame is malformed, or is unsynchronised, compressed or encrypted and
+ * can't be read without decoding it into a new buffer.
+ */
+bool ID3v2_FrameRef_get_text(const ID3v2_FrameRef* frame, ID3v2_TextRef* text);
+bool ID3v2_FrameRef_get_comment(const ID3v2_FrameRef* frame, ID3v2_CommentRef* comment);
+bool ID3v2_FrameRef_get_picture(const ID3v2_FrameRef* frame, ID3v2_PictureRef* picture);
+bool ID3v2_FrameRef_get_user_text(const ID3v2_FrameRef* frame, ID3v2_UserTextRef* user_text);
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_throttle_h
+#define id3v2lib_throttle_h
+
+#include <pthread.h>
+
+/**
+ * I/O scheduling classes, as understood by ioprio_set. NONE leaves the
+ * priority of the thread alone.
+ */
+#define ID3v2_IO_CLASS_NONE 0
+#define ID3v2_IO_CLASS_BEST_EFFORT 2
+#define ID3v2_IO_CLASS_IDLE 3
+
+typedef struct _ID3v2_ThrottleStats
+{
+    // Time spent waiting for bandwidth and for a rewrite slot
+    unsigned long long throttled_ns;
+    unsigned long long rewrite_wait_ns;
+    unsigned long long bytes_moved;
+    unsigned long long rewrites;
+} ID3v2_ThrottleStats;
+
+/**
+ * Limits the impact of tag writes that have to move the audio data. While
+ * the data is moved the thread runs with the provided I/O class and level
+ * (0 is the highest, 7 the lowest), no more than bytes_per_second are
+ * copied (0 means no limit) and no more than max_rewrites files are
+ * rewritten at the same time (0 means no limit).
+ */
+typedef struct _ID3v2_Throttle
+{
+    int io_class;
+    int io_level;
+    unsigned long long bytes_per_second;
+    int max_rewrites;
+
+    pthread_mutex_t lock;
+    pthread_cond_t rewrite_done;
+    int rewrites;
+    double tokens;
+    unsigned long long last_refill_ns;
+    ID3v2_ThrottleStats stats;
+} ID3v2_Throttle;
+
+ID3v2_Throttle* ID3v2_Throttle_new(
+    const int io_class,
+    const int io_level,
+    const unsigned long long bytes_per_second,
+    const int max_rewrites
+);
+void ID3v2_Throttle_free(ID3v2_Throttle* throttle);
+
+/**
+ * Applies the throttle to every write made by the library, NULL removes
+ * it. It has to be removed before it's freed.
+ */
+void ID3v2_Throttle_install(ID3v2_Throttle* throttle);
+
+void ID3v2_Throttle_get_stats(ID3v2_Throttle* throttle, ID3v2_ThrottleStats* stats);
+
+#endif
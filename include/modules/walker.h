@@ -0,0 +1,65 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_walker_h
+#define id3v2lib_walker_h
+
+#include <stdbool.h>
+
+#include "scan.h"
+
+/**
+ * Extensions of the files the library can read, used when no others are
+ * provided.
+ */
+#define ID3v2_WALK_DEFAULT_EXTENSIONS {"mp3", "mp2", "aif", "aiff", "aifc", "wav", "dsf"}
+#define ID3v2_WALK_DEFAULT_EXTENSION_COUNT 7
+
+/**
+ * threads walks that many subtrees at the same time (0 uses one per CPU).
+ * Only files whose extension is one of extensions (compared without case,
+ * NULL for the default ones) are reported. Symbolic links aren't followed.
+ */
+typedef struct _ID3v2_WalkOptions
+{
+    int threads;
+    const char* const* extensions;
+    int extension_count;
+} ID3v2_WalkOptions;
+
+/**
+ * Called once per file found, from any of the walking threads at the same
+ * time. Returning false stops the walk.
+ */
+typedef bool (*ID3v2_WalkCallback)(const char* path, void* ctx);
+
+/**
+ * Reports every matching file under root. options can be NULL. Returns 0
+ * once the whole tree has been walked, ID3v2_OPERATION_CANCELLED if the
+ * callback stopped the walk and -1 if root can't be opened.
+ */
+int ID3v2_walk(
+    const char* root,
+    const ID3v2_WalkOptions* options,
+    ID3v2_WalkCallback callback,
+    void* callback_ctx
+);
+
+/**
+ * Same as ID3v2_walk, reading the tag of every file on the walking threads
+ * and handing it to the callback as ID3v2_scan_files does.
+ */
+int ID3v2_scan_tree(
+    const char* root,
+    const ID3v2_WalkOptions* options,
+    ID3v2_ScanCallback callback,
+    void* callback_ctx
+);
+
+#endif
@@ -7,27 +7,63 @@
  * file that was distributed with this source code.
  */
 
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <unistd.h>
 
 #include "modules/char_stream.private.h"
+#include "modules/container.private.h"
 #include "modules/frame.private.h"
 #include "modules/frame_list.private.h"
+#include "modules/frame_walker.private.h"
+#include "modules/frames/pcnt_frame.private.h"
+#include "modules/frames/popm_frame.private.h"
 #include "modules/tag.private.h"
+#include "modules/tag_cache.private.h"
 #include "modules/tag_header.private.h"
+#include "modules/throttle.private.h"
 #include "modules/utils.private.h"
 
 #include "id3v2lib.h"
 
+/**
+ * Opens the file and finds where its tag is stored, see TagLocation.
+ */
+static int open_tag_location(const char* file_name, const int flags, TagLocation* location)
+{
+    const int fd = open(file_name, flags);
+    if (fd < 0) return -1;
+
+    if (!Container_locate_tag(fd, location))
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
 ID3v2_TagHeader* ID3v2_read_tag_header(const char* file_name)
 {
-    FILE* fp = fopen(file_name, "rb");
+    TagLocation location;
     char tag_header_buffer[ID3v2_TAG_HEADER_LENGTH];
 
-    if (fp == NULL) return NULL;
+    const int fd = open_tag_location(file_name, O_RDONLY, &location);
+    if (fd < 0) return NULL;
 
-    const int bytes_read = fread(tag_header_buffer, sizeof(char), ID3v2_TAG_HEADER_LENGTH, fp);
-    fclose(fp);
+    const int bytes_read =
+        location.tag_offset >= 0
+            ? pread(fd, tag_header_buffer, ID3v2_TAG_HEADER_LENGTH, location.tag_offset)
+            : 0;
+    close(fd);
 
     if (bytes_read < ID3v2_TAG_HEADER_LENGTH) return NULL;
 
@@ -42,28 +78,127 @@ ID3v2_TagHeader* ID3v2_read_tag_header_from_buffer(const char* buffer)
     return header;
 }
 
-ID3v2_Tag* ID3v2_read_tag(const char* file_name)
+#define TAG_READ_CHUNK_LENGTH (16 * 1024)
+
+/**
+ * Makes sure the first needed bytes of the tag are in buffer, reading them
+ * along with a chunk of what follows. Returns false if the file is shorter.
+ */
+static bool fetch_tag_bytes(
+    const int fd,
+    const long tag_offset,
+    const int tag_length,
+    const int needed,
+    char** buffer,
+    int* fetched
+)
 {
-    ID3v2_TagHeader* tag_header = ID3v2_read_tag_header(file_name);
+    if (*fetched >= needed) return true;
+
+    const int target = needed + TAG_READ_CHUNK_LENGTH < tag_length
+                           ? needed + TAG_READ_CHUNK_LENGTH
+                           : tag_length;
+    *buffer = (char*) realloc(*buffer, target);
+
+    const ssize_t bytes_read =
+        pread(fd, *buffer + *fetched, target - *fetched, tag_offset + *fetched);
+    if (bytes_read > 0) *fetched += bytes_read;
+
+    return *fetched >= needed;
+}
+
+/**
+ * Reads the tag frame by frame and stops at the padding, so it's never
+ * read. Returns the bytes read (at most a chunk of padding past the frames)
+ * and stores how many there are in size.
+ */
+static char* read_tag_frames(
+    const int fd,
+    const long tag_offset,
+    ID3v2_TagHeader* header,
+    int* size
+)
+{
+    const int tag_length = header->tag_size + ID3v2_TAG_HEADER_LENGTH;
+    char* buffer = NULL;
+    int fetched = 0;
+
+    // Frame sizes of unsynchronised v2.3 tags only hold once the whole tag
+    // is synchronised, and extended headers aren't walked
+    if (header->extended_header_size > 0 ||
+        (header->major_version == 3 && (header->flags & TAG_HEADER_UNSYNCHRONISATION_FLAG)))
+    {
+        fetch_tag_bytes(fd, tag_offset, tag_length, tag_length, &buffer, &fetched);
+        *size = fetched;
+        return buffer;
+    }
+
+    int cursor = ID3v2_TAG_HEADER_LENGTH;
 
-    if (tag_header == NULL) return NULL;
+    while (cursor < (int) header->tag_size &&
+           fetch_tag_bytes(
+               fd, tag_offset, tag_length, cursor + ID3v2_FRAME_HEADER_LENGTH, &buffer, &fetched
+           ))
+    {
+        const char* frame_header = buffer + cursor;
+        if (memcmp(frame_header, "\0\0\0\0", ID3v2_FRAME_HEADER_ID_LENGTH) == 0) break;
+
+        int frame_size =
+            btoi(frame_header + ID3v2_FRAME_HEADER_ID_LENGTH, ID3v2_FRAME_HEADER_SIZE_LENGTH);
+        if (header->major_version == 4) frame_size = syncint_decode(frame_size);
+        if (frame_size < 0 || frame_size > tag_length - cursor - ID3v2_FRAME_HEADER_LENGTH)
+        {
+            cursor = tag_length;
+        }
+        else
+        {
+            cursor += ID3v2_FRAME_HEADER_LENGTH + frame_size;
+        }
 
-    FILE* file = fopen(file_name, "rb");
-    int buffer_length = tag_header->tag_size + ID3v2_TAG_HEADER_LENGTH;
-    char* tag_buffer = (char*) malloc((buffer_length) * sizeof(char));
+        fetch_tag_bytes(fd, tag_offset, tag_length, cursor, &buffer, &fetched);
+    }
+
+    *size = fetched;
+    return buffer;
+}
+
+ID3v2_Tag* Tag_read_from_file(const char* file_name)
+{
+    TagLocation location;
+    char tag_header_buffer[ID3v2_TAG_HEADER_LENGTH];
 
-    if (tag_buffer == NULL)
+    const int fd = open_tag_location(file_name, O_RDONLY, &location);
+    if (fd < 0) return NULL;
+
+    if (location.tag_offset < 0 ||
+        pread(fd, tag_header_buffer, ID3v2_TAG_HEADER_LENGTH, location.tag_offset) <
+            ID3v2_TAG_HEADER_LENGTH)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    ID3v2_TagHeader* tag_header = ID3v2_read_tag_header_from_buffer(tag_header_buffer);
+
+    if (tag_header == NULL)
     {
-        perror("Could not allocate buffer.");
-        fclose(file);
-        ID3v2_TagHeader_free(tag_header);
+        close(fd);
         return NULL;
     }
 
-    fread(tag_buffer, buffer_length, 1, file);
-    fclose(file);
+    int buffer_length = 0;
+    char* tag_buffer = read_tag_frames(fd, location.tag_offset, tag_header, &buffer_length);
+    close(fd);
 
-    ID3v2_Tag* tag = ID3v2_read_tag_from_buffer(tag_buffer, buffer_length);
+    // The parse reads from the buffer without copying it
+    CharStream tag_cs = {0, buffer_length, tag_buffer};
+    ID3v2_Tag* tag = Tag_parse(&tag_cs);
+
+    // Whatever wasn't read is padding
+    if (tag != NULL)
+    {
+        tag->padding_size += tag_header->tag_size + ID3v2_TAG_HEADER_LENGTH - buffer_length;
+    }
 
     free(tag_buffer);
     ID3v2_TagHeader_free(tag_header);
@@ -71,95 +206,884 @@ ID3v2_Tag* ID3v2_read_tag(const char* file_name)
     return tag;
 }
 
-ID3v2_Tag* ID3v2_read_tag_from_buffer(const char* tag_buffer, const int buffer_length)
+ID3v2_Tag* ID3v2_read_tag(const char* file_name)
 {
-    CharStream* tag_cs = CharStream_from_buffer(tag_buffer, buffer_length);
-    ID3v2_Tag* tag = Tag_parse(tag_cs);
-    CharStream_free(tag_cs);
+    ID3v2_TagCache* cache = TagCache_get_installed();
+    TagCacheKey key;
+
+    if (cache == NULL || !TagCache_stat(file_name, &key)) return Tag_read_from_file(file_name);
+
+    ID3v2_Tag* tag = TagCache_get(cache, &key);
+    if (tag != NULL) return tag;
+
+    tag = Tag_read_from_file(file_name);
+    TagCache_put(cache, &key, tag);
+
     return tag;
 }
 
-void ID3v2_write_tag(const char* file_name, ID3v2_Tag* tag)
+ID3v2_Tag* ID3v2_read_tag_from_buffer(const char* tag_buffer, const int buffer_length)
 {
-    if (tag == NULL) return;
+    CharStream tag_cs = {0, buffer_length, (char*) tag_buffer};
+    return Tag_parse(&tag_cs);
+}
 
+/**
+ * Overwrites the tag at tag_offset with one that takes the same space. Only
+ * the new frames are written, the padding after them is zeroed up to where
+ * the old frames ended: the rest of it is already made of zeros.
+ */
+static bool overwrite_tag(const int fd, const long tag_offset, ID3v2_Tag* tag)
+{
+    const long tag_end = tag_offset + ID3v2_TAG_HEADER_LENGTH + tag->header->tag_size;
+    long old_frames_end = tag_end;
+    FrameWalker walker;
+
+    // Unsynchronised frame sizes can't be trusted to find the old padding
+    if (FrameWalker_open(&walker, fd, tag_offset) &&
+        !(walker.flags & TAG_HEADER_UNSYNCHRONISATION_FLAG))
+    {
+        old_frames_end = FrameWalker_padding_offset(&walker);
+
+        // Make sure the walk stopped at the padding and not at a broken frame
+        char first_byte = '\0';
+        if (old_frames_end < tag_end && pread(fd, &first_byte, 1, old_frames_end) == 1 &&
+            first_byte != '\0')
+        {
+            old_frames_end = tag_end;
+        }
+    }
+
+    CharStream* tag_cs = Tag_to_char_stream_without_padding(tag);
+    const long frames_end = tag_offset + tag_cs->size;
+
+    const bool written =
+        pwrite(fd, tag_cs->stream, tag_cs->size, tag_offset) == tag_cs->size &&
+        (old_frames_end <= frames_end || pwrite_zeros(fd, frames_end, old_frames_end - frames_end));
+
+    CharStream_free(tag_cs);
+
+    return written;
+}
+
+/**
+ * When the frames fit in the space taken by the existing tag, the tag is
+ * overwritten in place and whatever is left becomes padding. The audio
+ * data doesn't have to be moved at all.
+ */
+static bool write_tag_in_place(const char* file_name, ID3v2_Tag* tag, const int frames_size)
+{
     ID3v2_TagHeader* existing_tag_header = ID3v2_read_tag_header(file_name);
-    const int original_size =
-        existing_tag_header != NULL ? existing_tag_header->tag_size + ID3v2_TAG_HEADER_LENGTH : 0;
-    free(existing_tag_header);
 
+    if (existing_tag_header == NULL) return false;
+
+    const int available_size = existing_tag_header->tag_size;
+    ID3v2_TagHeader_free(existing_tag_header);
+
+    if (frames_size > available_size) return false;
+
+    const int fd = open(file_name, O_RDWR);
+    if (fd < 0) return false;
+
+    tag->header->tag_size = available_size;
+    tag->padding_size = available_size - frames_size;
+    const bool written = overwrite_tag(fd, 0, tag);
+
+    close(fd);
+
+    return written;
+}
+
+/**
+ * Tags that have to be moved get some padding, so later edits can be
+ * written in place.
+ */
+static void add_default_padding(ID3v2_Tag* tag, const int frames_size)
+{
     const int extra_padding_length = clamp_int(
         ID3v2_TAG_DEFAULT_PADDING_LENGTH - tag->padding_size,
         0,
         ID3v2_TAG_DEFAULT_PADDING_LENGTH
     );
     tag->padding_size += extra_padding_length;
-    CharStream* tag_cs = Tag_to_char_stream(tag);
+    tag->header->tag_size = frames_size + tag->padding_size;
+}
 
-    // Perform operations on a temp file in case things go wrong
+/**
+ * Tags stored in AIFF, WAV and DSF files fill the space of the existing
+ * tag when they fit in it, otherwise they're moved to the end of the file.
+ */
+static bool write_container_tag(
+    const int fd,
+    TagLocation* location,
+    ID3v2_Tag* tag,
+    const int frames_size
+)
+{
+    if (location->tag_offset >= 0 &&
+        frames_size + ID3v2_TAG_HEADER_LENGTH <= location->tag_space)
+    {
+        tag->header->tag_size = location->tag_space - ID3v2_TAG_HEADER_LENGTH;
+        tag->padding_size = tag->header->tag_size - frames_size;
+        return overwrite_tag(fd, location->tag_offset, tag);
+    }
+
+    add_default_padding(tag, frames_size);
+
+    CharStream* tag_cs = Tag_to_char_stream_without_padding(tag);
+    const bool written =
+        Container_write_tag(fd, location, tag_cs->stream, tag_cs->size, tag->padding_size);
+    CharStream_free(tag_cs);
+
+    return written;
+}
+
+#define PAYLOAD_CHUNK_LENGTH (64 * 1024)
+#define TEMP_FILE_SUFFIX ".id3v2-XXXXXX"
+
+typedef struct _PayloadMove
+{
+    ID3v2_Throttle* throttle;
+    ID3v2_ProgressCallback callback;
+    void* callback_ctx;
+    unsigned long long moved;
+    unsigned long long total;
+} PayloadMove;
+
+/**
+ * Copies whatever is left in src to dest, in chunks so the installed
+ * throttle can pace the copy and the callback can follow it. Returns 0
+ * once everything is copied, -1 if reading or writing fails and
+ * ID3v2_OPERATION_CANCELLED if the callback asked to stop, when
+ * cancellable.
+ */
+static int copy_payload(FILE* src, FILE* dest, PayloadMove* move, const bool cancellable)
+{
+    char* chunk = (char*) malloc(PAYLOAD_CHUNK_LENGTH * sizeof(char));
+    size_t size = 0;
+    int result = 0;
+
+    while (result == 0 && (size = fread(chunk, sizeof(char), PAYLOAD_CHUNK_LENGTH, src)) > 0)
+    {
+        Throttle_consume(move->throttle, size);
+
+        if (fwrite(chunk, sizeof(char), size, dest) != size)
+        {
+            result = -1;
+            break;
+        }
+
+        if (!cancellable) continue;
+
+        move->moved += size;
+
+        if (move->callback != NULL && !move->callback(move->moved, move->total, move->callback_ctx))
+        {
+            result = ID3v2_OPERATION_CANCELLED;
+        }
+    }
+
+    free(chunk);
+
+    if (result == 0 && ferror(src)) result = -1;
+
+    return result;
+}
+
+/**
+ * Used when no file can be created next to the original one. The original
+ * is overwritten from a temp file, so it can only be cancelled until it
+ * starts being overwritten, and nothing is overwritten until the whole new
+ * file made it to the temp file.
+ */
+static int rewrite_file_through_tmpfile(
+    const char* file_name,
+    FILE* src_fp,
+    const char* head,
+    const int head_size,
+    const int padding_size,
+    PayloadMove* move
+)
+{
     FILE* temp_fp = tmpfile();
+    if (temp_fp == NULL) return -1;
 
-    // First write the tag to the temp file
-    fwrite(tag_cs->stream, sizeof(char), tag_cs->size, temp_fp);
+    int result = -1;
 
-    // And then, read the original audio data and copy it to
-    // the temp file so it's located after the tag
-    FILE* dest_fp = fopen(file_name, "r+b");
-    fseek(dest_fp, original_size, SEEK_SET); // move to the end of the original tag
+    if (fwrite(head, sizeof(char), head_size, temp_fp) == (size_t) head_size &&
+        fwrite_zeros(temp_fp, padding_size))
+    {
+        result = copy_payload(src_fp, temp_fp, move, true);
+    }
+
+    if (result == 0 && (fflush(temp_fp) != 0 || ferror(temp_fp))) result = -1;
 
-    int c = 0;
+    const long new_size = ftell(temp_fp);
+    FILE* dest_fp = result == 0 ? fopen(file_name, "r+b") : NULL;
 
-    while ((c = getc(dest_fp)) != EOF)
+    if (dest_fp == NULL)
     {
-        putc(c, temp_fp);
+        fclose(temp_fp);
+        return result == 0 ? -1 : result;
     }
 
-    // Finally copy the temp file back into the destination file
-    fclose(dest_fp);
-    dest_fp = fopen(file_name, "w+b");
+    // Written over the original, which is cut to size once it's all there
     fseek(temp_fp, 0L, SEEK_SET);
+    result = copy_payload(temp_fp, dest_fp, move, false);
 
-    while ((c = getc(temp_fp)) != EOF)
+    if (result == 0 && (fflush(dest_fp) != 0 || ftruncate(fileno(dest_fp), new_size) != 0 ||
+                        fsync(fileno(dest_fp)) != 0))
     {
-        putc(c, dest_fp);
+        result = -1;
     }
 
     fclose(temp_fp);
-    fclose(dest_fp);
+    if (fclose(dest_fp) != 0) result = -1;
+
+    return result;
+}
+
+/**
+ * Gives the temp file the owner, group, mode and extended attributes (ACLs
+ * included) of the original. Returns false if any of them can't be copied.
+ */
+static bool copy_file_attributes(const int src_fd, const int dest_fd, const struct stat* st)
+{
+    // The mode goes last, changing the owner clears the set-user-ID bit
+    if (fchown(dest_fd, st->st_uid, st->st_gid) != 0 ||
+        fchmod(dest_fd, st->st_mode & 07777) != 0)
+    {
+        return false;
+    }
+
+    ssize_t names_size = flistxattr(src_fd, NULL, 0);
+    if (names_size < 0) return errno == ENOTSUP;
+    if (names_size == 0) return true;
+
+    char* names = (char*) malloc(names_size * sizeof(char));
+    names_size = flistxattr(src_fd, names, names_size);
+    bool copied = names_size >= 0;
+
+    for (ssize_t i = 0; copied && i < names_size; i += strlen(names + i) + 1)
+    {
+        const ssize_t value_size = fgetxattr(src_fd, names + i, NULL, 0);
+        char* value = (char*) malloc(value_size > 0 ? value_size : 1);
+
+        copied = value_size >= 0 &&
+                 fgetxattr(src_fd, names + i, value, value_size) == value_size &&
+                 fsetxattr(dest_fd, names + i, value, value_size, 0) == 0;
+
+        free(value);
+    }
+
+    free(names);
+
+    return copied;
+}
+
+/**
+ * Replaces everything before payload_offset with head, followed by
+ * padding_size zeros. The new file is written next to the original one and
+ * renamed over it, so the original is left intact if anything goes wrong or
+ * the move is cancelled. Links are followed, and files with several hard
+ * links or whose attributes can't be carried over are rewritten in place
+ * instead, so they stay the same file.
+ */
+static int rewrite_file(
+    const char* file_name,
+    const char* head,
+    const int head_size,
+    const int padding_size,
+    const long payload_offset,
+    PayloadMove* move
+)
+{
+    char* real_name = realpath(file_name, NULL);
+    if (real_name == NULL) return -1;
+
+    FILE* src_fp = fopen(real_name, "rb");
+
+    if (src_fp == NULL)
+    {
+        free(real_name);
+        return -1;
+    }
+
+    struct stat st;
+    fstat(fileno(src_fp), &st);
+    move->total = st.st_size > payload_offset ? st.st_size - payload_offset : 0;
+    fseek(src_fp, payload_offset, SEEK_SET);
+
+    const int previous_priority = Throttle_begin_rewrite(move->throttle);
+
+    char* temp_name = (char*) malloc(strlen(real_name) + sizeof(TEMP_FILE_SUFFIX));
+    sprintf(temp_name, "%s" TEMP_FILE_SUFFIX, real_name);
+
+    int temp_fd = st.st_nlink > 1 ? -1 : mkstemp(temp_name);
+    FILE* temp_fp = NULL;
+    int result = 0;
+
+    if (temp_fd >= 0 && (!copy_file_attributes(fileno(src_fp), temp_fd, &st) ||
+                         (temp_fp = fdopen(temp_fd, "wb")) == NULL))
+    {
+        close(temp_fd);
+        unlink(temp_name);
+        temp_fd = -1;
+    }
+
+    if (temp_fd < 0)
+    {
+        result = rewrite_file_through_tmpfile(
+            real_name, src_fp, head, head_size, padding_size, move
+        );
+    }
+    else
+    {
+        result = -1;
+
+        if (fwrite(head, sizeof(char), head_size, temp_fp) == (size_t) head_size &&
+            fwrite_zeros(temp_fp, padding_size))
+        {
+            result = copy_payload(src_fp, temp_fp, move, true);
+        }
+
+        if (result == 0 && (fflush(temp_fp) != 0 || ferror(temp_fp) || fsync(temp_fd) != 0))
+        {
+            result = -1;
+        }
+
+        if (fclose(temp_fp) != 0 && result == 0) result = -1;
+
+        if (result != 0 || rename(temp_name, real_name) != 0)
+        {
+            unlink(temp_name);
+            if (result == 0) result = -1;
+        }
+    }
+
+    Throttle_end_rewrite(move->throttle, previous_priority);
+
+    free(temp_name);
+    free(real_name);
+    fclose(src_fp);
+
+    return result;
+}
+
+static int write_tag(
+    const char* file_name,
+    ID3v2_Tag* tag,
+    ID3v2_ProgressCallback callback,
+    void* callback_ctx
+)
+{
+    if (tag == NULL || tag->partial) return -1;
+
+    const int frames_size = Tag_get_frames_size(tag);
+
+    TagLocation location;
+    const int fd = open_tag_location(file_name, O_RDWR, &location);
+
+    if (fd >= 0 && location.container != CONTAINER_NONE)
+    {
+        const bool written = write_container_tag(fd, &location, tag, frames_size);
+        close(fd);
+        return written ? 0 : -1;
+    }
+
+    if (fd >= 0) close(fd);
+
+    if (write_tag_in_place(file_name, tag, frames_size)) return 0;
+
+    ID3v2_TagHeader* existing_tag_header = ID3v2_read_tag_header(file_name);
+    const int original_size =
+        existing_tag_header != NULL ? existing_tag_header->tag_size + ID3v2_TAG_HEADER_LENGTH : 0;
+    free(existing_tag_header);
+
+    add_default_padding(tag, frames_size);
+    CharStream* tag_cs = Tag_to_char_stream_without_padding(tag);
+
+    // The new tag goes first and the original audio data right after it
+    PayloadMove move = {Throttle_get_installed(), callback, callback_ctx, 0, 0};
+    const int result = rewrite_file(
+        file_name, tag_cs->stream, tag_cs->size, tag->padding_size, original_size, &move
+    );
 
     CharStream_free(tag_cs);
+
+    return result;
 }
 
-void ID3v2_delete_tag(const char* file_name)
+static int delete_tag(const char* file_name, ID3v2_ProgressCallback callback, void* callback_ctx)
 {
+    TagLocation location;
+    const int fd = open_tag_location(file_name, O_RDWR, &location);
+
+    if (fd >= 0 && location.container != CONTAINER_NONE)
+    {
+        const bool deleted = Container_delete_tag(fd, &location);
+        close(fd);
+        return deleted ? 0 : -1;
+    }
+
+    if (fd >= 0) close(fd);
+
     ID3v2_TagHeader* tag_header = ID3v2_read_tag_header(file_name);
 
-    if (tag_header == NULL) return;
+    if (tag_header == NULL) return 0;
 
-    FILE* file_fp = fopen(file_name, "rb");
-    FILE* temp_fp = tmpfile();
+    PayloadMove move = {Throttle_get_installed(), callback, callback_ctx, 0, 0};
+    const int result =
+        rewrite_file(file_name, NULL, 0, 0, tag_header->tag_size + ID3v2_TAG_HEADER_LENGTH, &move);
+
+    ID3v2_TagHeader_free(tag_header);
+
+    return result;
+}
+
+/**
+ * Prepended tags point their padding here, so it's never allocated.
+ */
+static const char zero_padding[ID3v2_TAG_DEFAULT_PADDING_LENGTH];
+
+int ID3v2_Tag_prepend(
+    ID3v2_Tag* tag,
+    const char* audio,
+    const size_t audio_size,
+    struct iovec* iov,
+    int* iovcnt
+)
+{
+    if (tag == NULL || iov == NULL || iovcnt == NULL) return -1;
+
+    const int frames_size = Tag_get_frames_size(tag);
+
+    tag->padding_size = ID3v2_TAG_DEFAULT_PADDING_LENGTH;
+    tag->header->tag_size = frames_size + tag->padding_size;
+
+    CharStream* tag_cs = Tag_to_char_stream_without_padding(tag);
 
-    fseek(file_fp, tag_header->tag_size + ID3v2_TAG_HEADER_LENGTH, SEEK_SET);
+    iov[0].iov_base = tag_cs->stream;
+    iov[0].iov_len = tag_cs->size;
+    iov[1].iov_base = (void*) zero_padding;
+    iov[1].iov_len = tag->padding_size;
+    iov[2].iov_base = (void*) audio;
+    iov[2].iov_len = audio_size;
+    *iovcnt = ID3v2_PREPEND_IOV_COUNT;
 
-    int c = 0;
+    // The stream is handed over to the caller
+    free(tag_cs);
 
-    while ((c = getc(file_fp)) != EOF)
+    return 0;
+}
+
+int ID3v2_writev(const int fd, struct iovec* iov, int iovcnt)
+{
+    while (iovcnt > 0)
     {
-        putc(c, temp_fp);
+        const ssize_t written = writev(fd, iov, iovcnt);
+
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+
+        // Skip whatever was written and resume a partial write where it stopped
+        size_t remaining = written;
+
+        while (iovcnt > 0 && remaining >= iov->iov_len)
+        {
+            remaining -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+
+        if (iovcnt > 0)
+        {
+            iov->iov_base = (char*) iov->iov_base + remaining;
+            iov->iov_len -= remaining;
+        }
     }
 
-    // Finally copy the temp file back into the destination file
-    fclose(file_fp);
-    file_fp = fopen(file_name, "w+b");
-    fseek(temp_fp, 0L, SEEK_SET);
+    return 0;
+}
+
+/**
+ * Rewritten files are renamed over the original ones, so they're dropped
+ * from the cache before they get a new inode.
+ */
+void ID3v2_write_tag(const char* file_name, ID3v2_Tag* tag)
+{
+    ID3v2_write_tag_with_progress(file_name, tag, NULL, NULL);
+}
 
-    while ((c = getc(temp_fp)) != EOF)
+int ID3v2_write_tag_with_progress(
+    const char* file_name,
+    ID3v2_Tag* tag,
+    ID3v2_ProgressCallback callback,
+    void* callback_ctx
+)
+{
+    TagCache_invalidate(TagCache_get_installed(), file_name);
+    const int result = write_tag(file_name, tag, callback, callback_ctx);
+    TagCache_invalidate(TagCache_get_installed(), file_name);
+
+    return result;
+}
+
+void ID3v2_delete_tag(const char* file_name)
+{
+    ID3v2_delete_tag_with_progress(file_name, NULL, NULL);
+}
+
+int ID3v2_delete_tag_with_progress(
+    const char* file_name,
+    ID3v2_ProgressCallback callback,
+    void* callback_ctx
+)
+{
+    TagCache_invalidate(TagCache_get_installed(), file_name);
+    const int result = delete_tag(file_name, callback, callback_ctx);
+    TagCache_invalidate(TagCache_get_installed(), file_name);
+
+    return result;
+}
+
+#ifndef F_OFD_SETLKW
+    // Classic record locks are dropped when any descriptor of the file is
+    // closed, so they only protect against other processes.
+    #define F_OFD_SETLKW F_SETLKW
+#endif
+
+#define IN_PLACE_DONE 0
+#define IN_PLACE_ERROR -1
+#define IN_PLACE_UNSUPPORTED 1
+
+/**
+ * Frames whose body is compressed, encrypted or otherwise transformed can't
+ * be patched byte by byte.
+ */
+static bool frame_is_plain(FrameWalker* walker, FrameLocation* location)
+{
+    const unsigned char format_flags = location->flags[1];
+    return walker->major_version == 4 ? (format_flags & 0x4F) == 0 : (format_flags & 0xE0) == 0;
+}
+
+static bool is_popularity_frame(FrameWalker* walker, FrameLocation* location, const char* email)
+{
+    if (email == NULL)
     {
-        putc(c, file_fp);
+        return memcmp(location->id, ID3v2_PLAY_COUNTER_FRAME_ID, ID3v2_FRAME_HEADER_ID_LENGTH) == 0;
     }
 
-    ID3v2_TagHeader_free(tag_header);
+    if (memcmp(location->id, ID3v2_POPULARIMETER_FRAME_ID, ID3v2_FRAME_HEADER_ID_LENGTH) != 0)
+    {
+        return false;
+    }
 
-    fclose(temp_fp);
-    fclose(file_fp);
+    // Only the email is needed to tell POPM frames apart
+    const int email_size = strlen(email) + 1;
+    if (location->size < email_size) return false;
+
+    char* frame_email = (char*) malloc(email_size * sizeof(char));
+    const long body_offset = location->offset + ID3v2_FRAME_HEADER_LENGTH;
+    const bool matches = pread(walker->fd, frame_email, email_size, body_offset) == email_size &&
+                         memcmp(frame_email, email, email_size) == 0;
+    free(frame_email);
+
+    return matches;
+}
+
+/**
+ * Patches the counter (and the rating) of an existing PCNT or POPM frame.
+ * Usually that's a single write of a few bytes. If the counter needs an
+ * extra byte, the frames after it are shifted into the padding instead.
+ */
+static int update_popularity_frame(
+    FrameWalker* walker,
+    FrameLocation* location,
+    const char* email,
+    const bool increment,
+    const int rating
+)
+{
+    if (!frame_is_plain(walker, location)) return IN_PLACE_UNSUPPORTED;
+
+    const long body_offset = location->offset + ID3v2_FRAME_HEADER_LENGTH;
+    const int rating_offset = email != NULL ? strlen(email) + 1 : 0;
+    const int counter_offset =
+        email != NULL ? rating_offset + ID3v2_POPM_FRAME_RATING_LENGTH : rating_offset;
+    const int counter_length = location->size - counter_offset;
+
+    if (counter_length < 0 || counter_length > 8) return IN_PLACE_UNSUPPORTED;
+
+    char body[ID3v2_POPM_FRAME_RATING_LENGTH + 8];
+    char* counter_bytes = body + ID3v2_POPM_FRAME_RATING_LENGTH;
+    const long patch_offset = body_offset + counter_offset - (email != NULL ? 1 : 0);
+    const int patch_length = location->size - (patch_offset - body_offset);
+
+    if (pread(walker->fd, email != NULL ? body : counter_bytes, patch_length, patch_offset) !=
+        patch_length)
+    {
+        return IN_PLACE_ERROR;
+    }
+
+    unsigned long long counter = btoull(counter_bytes, counter_length);
+    if (increment) counter++;
+    if (rating >= 0) body[0] = rating;
+
+    int new_counter_length = counter_length;
+
+    if (increment && counter_size(counter) > counter_length)
+    {
+        new_counter_length = counter_size(counter);
+    }
+
+    ulltob(counter, counter_bytes, new_counter_length);
+
+    if (new_counter_length == counter_length)
+    {
+        const char* patch = email != NULL ? body : counter_bytes;
+        return pwrite(walker->fd, patch, patch_length, patch_offset) == patch_length
+                   ? IN_PLACE_DONE
+                   : IN_PLACE_ERROR;
+    }
+
+    // The counter grows, shift whatever follows the frame into the padding
+    const int growth = new_counter_length - counter_length;
+    const long frame_end = body_offset + location->size;
+    const long padding_offset = FrameWalker_padding_offset(walker);
+
+    if (walker->end - padding_offset < growth) return IN_PLACE_UNSUPPORTED;
+
+    const int new_size = location->size + growth;
+    const int tail_length = padding_offset - frame_end;
+    const int patch_size = ID3v2_FRAME_HEADER_LENGTH + new_size + tail_length;
+    char* patch = (char*) malloc(patch_size * sizeof(char));
+    char* cursor = patch;
+
+    memcpy(cursor, location->id, ID3v2_FRAME_HEADER_ID_LENGTH);
+    FrameWalker_encode_size(walker, new_size, cursor + ID3v2_FRAME_HEADER_ID_LENGTH);
+    memcpy(
+        cursor + ID3v2_FRAME_HEADER_ID_LENGTH + ID3v2_FRAME_HEADER_SIZE_LENGTH,
+        location->flags,
+        ID3v2_FRAME_HEADER_FLAGS_LENGTH
+    );
+    cursor += ID3v2_FRAME_HEADER_LENGTH;
+
+    int result = IN_PLACE_DONE;
+
+    if (pread(walker->fd, cursor, rating_offset, body_offset) != rating_offset ||
+        pread(walker->fd, cursor + new_size, tail_length, frame_end) != tail_length)
+    {
+        result = IN_PLACE_ERROR;
+    }
+
+    cursor += rating_offset;
+
+    if (email != NULL)
+    {
+        *cursor = body[0];
+        cursor += ID3v2_POPM_FRAME_RATING_LENGTH;
+    }
+
+    memcpy(cursor, counter_bytes, new_counter_length);
+
+    if (result == IN_PLACE_DONE && pwrite(walker->fd, patch, patch_size, location->offset) != patch_size)
+    {
+        result = IN_PLACE_ERROR;
+    }
+
+    free(patch);
+    return result;
+}
+
+/**
+ * Writes a brand new PCNT or POPM frame at the start of the padding.
+ */
+static int add_popularity_frame(
+    FrameWalker* walker,
+    const char* email,
+    const bool increment,
+    const int rating
+)
+{
+    const unsigned long long counter = increment ? 1 : 0;
+    ID3v2_Frame* frame =
+        email == NULL
+            ? (ID3v2_Frame*) PcntFrame_new("\0\0", counter)
+            : (ID3v2_Frame*) PopmFrame_new("\0\0", email, rating < 0 ? 0 : rating, counter);
+    CharStream* frame_cs = Frame_to_char_stream(frame);
+    FrameWalker_encode_size(walker, frame->header->size, frame_cs->stream + ID3v2_FRAME_HEADER_ID_LENGTH);
+
+    const long padding_offset = walker->cursor;
+    int result = IN_PLACE_UNSUPPORTED;
+
+    if (walker->end - padding_offset >= frame_cs->size)
+    {
+        // Make sure the walk stopped because of the padding and not because of a broken frame
+        char* existing = (char*) malloc(frame_cs->size * sizeof(char));
+        bool is_padding = pread(walker->fd, existing, frame_cs->size, padding_offset) == frame_cs->size;
+
+        for (int i = 0; is_padding && i < frame_cs->size; i++)
+        {
+            is_padding = existing[i] == '\0';
+        }
+
+        free(existing);
+
+        if (is_padding)
+        {
+            result = pwrite(walker->fd, frame_cs->stream, frame_cs->size, padding_offset) ==
+                             frame_cs->size
+                         ? IN_PLACE_DONE
+                         : IN_PLACE_ERROR;
+        }
+    }
+
+    CharStream_free(frame_cs);
+    ID3v2_Frame_free(frame);
+
+    return result;
+}
+
+static int update_popularity_in_place(
+    const int fd,
+    const char* email,
+    const bool increment,
+    const int rating
+)
+{
+    FrameWalker walker;
+    FrameLocation location;
+    TagLocation tag_location;
+
+    if (!Container_locate_tag(fd, &tag_location) || tag_location.tag_offset < 0 ||
+        !FrameWalker_open(&walker, fd, tag_location.tag_offset))
+    {
+        return IN_PLACE_UNSUPPORTED;
+    }
+
+    // Patched bytes might need escaping, leave unsynchronised tags to a full rewrite
+    if (walker.flags & TAG_HEADER_UNSYNCHRONISATION_FLAG) return IN_PLACE_UNSUPPORTED;
+
+    while (FrameWalker_next(&walker, &location))
+    {
+        if (is_popularity_frame(&walker, &location, email))
+        {
+            return update_popularity_frame(&walker, &location, email, increment, rating);
+        }
+    }
+
+    return add_popularity_frame(&walker, email, increment, rating);
+}
+
+static int update_popularity_rewriting(
+    const char* file_name,
+    const char* email,
+    const bool increment,
+    const int rating
+)
+{
+    ID3v2_Tag* tag = Tag_read_from_file(file_name);
+    if (tag == NULL) tag = ID3v2_Tag_new_empty();
+
+    if (email == NULL)
+    {
+        ID3v2_PcntFrame* existing = ID3v2_Tag_get_play_counter_frame(tag);
+        const unsigned long long counter = existing != NULL ? existing->data->counter : 0;
+        ID3v2_Tag_set_play_count(tag, counter + 1);
+    }
+    else
+    {
+        ID3v2_PopmFrame* existing = ID3v2_Tag_get_popm_frame(tag, email);
+        const unsigned long long counter = existing != NULL ? existing->data->counter : 0;
+        const unsigned char existing_rating = existing != NULL ? existing->data->rating : 0;
+
+        ID3v2_Tag_set_popm_frame(
+            tag,
+            &(ID3v2_PopmFrameInput){
+                .flags = "\0\0",
+                .email = email,
+                .rating = rating >= 0 ? rating : existing_rating,
+                .counter = increment ? counter + 1 : counter,
+            }
+        );
+    }
+
+    const int written = ID3v2_write_tag_with_progress(file_name, tag, NULL, NULL);
+    ID3v2_Tag_free(tag);
+
+    return written == 0 ? IN_PLACE_DONE : IN_PLACE_ERROR;
+}
+
+/**
+ * Opens the file and locks it whole. Rewrites rename a new file over the
+ * old one, so a lock that was waited for may have been taken on a file
+ * that's gone: the file is then opened and locked again.
+ */
+static int open_locked(const char* file_name)
+{
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+
+    while (true)
+    {
+        const int fd = open(file_name, O_RDWR);
+        if (fd < 0) return -1;
+
+        struct stat locked, current;
+
+        if (fcntl(fd, F_OFD_SETLKW, &lock) != 0 || fstat(fd, &locked) != 0 ||
+            stat(file_name, &current) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+
+        if (locked.st_dev == current.st_dev && locked.st_ino == current.st_ino) return fd;
+
+        close(fd);
+    }
+}
+
+/**
+ * Holds an exclusive lock on the whole file while updating it, so concurrent
+ * updates (from other threads or processes) are serialized.
+ */
+static int update_popularity(
+    const char* file_name,
+    const char* email,
+    const bool increment,
+    const int rating
+)
+{
+    const int fd = open_locked(file_name);
+    if (fd < 0) return -1;
+
+    int result = update_popularity_in_place(fd, email, increment, rating);
+
+    if (result == IN_PLACE_UNSUPPORTED)
+    {
+        result = update_popularity_rewriting(file_name, email, increment, rating);
+    }
+
+    TagCache_invalidate(TagCache_get_installed(), file_name);
+    close(fd); // This also releases the lock
+
+    return result == IN_PLACE_DONE ? 0 : -1;
+}
+
+int ID3v2_increment_play_count(const char* file_name, const char* email)
+{
+    return update_popularity(file_name, email, true, -1);
+}
+
+int ID3v2_set_rating(const char* file_name, const char* email, const unsigned char rating)
+{
+    if (email == NULL) return -1;
+    return update_popularity(file_name, email, false, rating);
 }
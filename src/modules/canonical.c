@@ -0,0 +1,211 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "frames/text_frame.private.h"
+#include "modules/char_stream.private.h"
+#include "modules/frame.private.h"
+#include "modules/frame_header.private.h"
+#include "modules/tag.private.h"
+#include "modules/tag_header.h"
+#include "modules/tag_index.private.h"
+#include "modules/utils.private.h"
+
+#include "modules/canonical.h"
+
+/**
+ * Strings are either UTF-16 with a BOM or single byte, which is UTF-8 if the
+ * frame says so and Latin-1 otherwise.
+ */
+static char string_encoding(const char* string, const char frame_encoding)
+{
+    if (string_has_bom(string)) return ID3v2_ENCODING_UNICODE;
+    return frame_encoding == ID3v2_ENCODING_UTF8 ? ID3v2_ENCODING_UTF8 : ID3v2_ENCODING_ISO;
+}
+
+/**
+ * Re-encodes the strings of a comment or picture frame, which share the
+ * encoding of the frame, following the rule TextFrame_canonicalize applies
+ * to text frames. Returns that encoding.
+ */
+static char canonicalize_strings(
+    char** strings,
+    const int count,
+    const char frame_encoding,
+    const int id3_major_version
+)
+{
+    char encoding = id3_major_version < 4 ? ID3v2_ENCODING_ISO : ID3v2_ENCODING_UTF8;
+
+    for (int i = 0; i < count && encoding == ID3v2_ENCODING_ISO; i++)
+    {
+        const char from = string_encoding(strings[i], frame_encoding);
+        if (!TextFrame_string_is_latin1(strings[i], from)) encoding = ID3v2_ENCODING_UNICODE;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        const char from = string_encoding(strings[i], frame_encoding);
+        char* encoded = TextFrame_reencode_string(strings[i], from, encoding);
+
+        free(strings[i]);
+        strings[i] = encoded;
+    }
+
+    return encoding;
+}
+
+static void CommentFrame_canonicalize(ID3v2_CommentFrame* frame, const int id3_major_version)
+{
+    ID3v2_CommentFrameData* data = frame->data;
+    char* strings[] = {data->short_description, data->comment};
+
+    data->encoding = canonicalize_strings(strings, 2, data->encoding, id3_major_version);
+    data->short_description = strings[0];
+    data->comment = strings[1];
+    data->size = ID3v2_strlent(data->comment);
+
+    frame->header->size = ID3v2_FRAME_ENCODING_LENGTH + ID3v2_COMMENT_FRAME_LANGUAGE_LENGTH +
+                          ID3v2_strlent(data->short_description) + data->size;
+}
+
+static void ApicFrame_canonicalize(ID3v2_ApicFrame* frame, const int id3_major_version)
+{
+    ID3v2_ApicFrameData* data = frame->data;
+
+    data->encoding =
+        canonicalize_strings(&data->description, 1, data->encoding, id3_major_version);
+
+    frame->header->size = ID3v2_FRAME_ENCODING_LENGTH + ID3v2_strlent(data->mime_type) +
+                          ID3v2_APIC_FRAME_PICTURE_TYPE_LENGTH +
+                          ID3v2_strlent(data->description) + data->picture_size;
+}
+
+typedef struct _SortableFrame
+{
+    ID3v2_Frame* frame;
+    CharStream* frame_cs;
+} SortableFrame;
+
+static int SortableFrame_compare(const void* a, const void* b)
+{
+    const SortableFrame* first = (const SortableFrame*) a;
+    const SortableFrame* second = (const SortableFrame*) b;
+
+    // The header starts with the id, the content follows it
+    const int first_size = first->frame_cs->size;
+    const int second_size = second->frame_cs->size;
+    const int id_order = memcmp(
+        first->frame_cs->stream,
+        second->frame_cs->stream,
+        ID3v2_FRAME_HEADER_ID_LENGTH
+    );
+
+    if (id_order != 0) return id_order;
+
+    const int content_order = memcmp(
+        first->frame_cs->stream + ID3v2_FRAME_HEADER_LENGTH,
+        second->frame_cs->stream + ID3v2_FRAME_HEADER_LENGTH,
+        (first_size < second_size ? first_size : second_size) - ID3v2_FRAME_HEADER_LENGTH
+    );
+
+    if (content_order != 0) return content_order;
+
+    return first_size - second_size;
+}
+
+static void Tag_sort_frames(ID3v2_Tag* tag)
+{
+    int count = 0;
+    ID3v2_FrameList* head = tag->frames;
+
+    for (; head != NULL && head->frame != NULL; head = head->next) count++;
+    if (count < 2) return;
+
+    SortableFrame* frames = (SortableFrame*) malloc(count * sizeof(SortableFrame));
+    head = tag->frames;
+
+    for (int i = 0; i < count; i++, head = head->next)
+    {
+        frames[i].frame = head->frame;
+        frames[i].frame_cs = Frame_to_char_stream(head->frame);
+    }
+
+    qsort(frames, count, sizeof(SortableFrame), SortableFrame_compare);
+
+    // The nodes stay where they are, only the frames move
+    head = tag->frames;
+
+    for (int i = 0; i < count; i++, head = head->next)
+    {
+        head->frame = frames[i].frame;
+        CharStream_free(frames[i].frame_cs);
+    }
+
+    free(frames);
+}
+
+void ID3v2_Tag_canonicalize(ID3v2_Tag* tag)
+{
+    ID3v2_FrameList* head = tag->frames;
+
+    for (; head != NULL && head->frame != NULL; head = head->next)
+    {
+        ID3v2_Frame* frame = head->frame;
+
+        // Status flags only tell what to do with the frame on later edits
+        frame->header->flags[0] = 0;
+
+        if (FrameHeader_isTextFrame(frame->header))
+        {
+            TextFrame_canonicalize((ID3v2_TextFrame*) frame, tag->header->major_version);
+        }
+        else if (FrameHeader_isCommentFrame(frame->header))
+        {
+            CommentFrame_canonicalize((ID3v2_CommentFrame*) frame, tag->header->major_version);
+        }
+        else if (FrameHeader_isApicFrame(frame->header))
+        {
+            ApicFrame_canonicalize((ID3v2_ApicFrame*) frame, tag->header->major_version);
+        }
+    }
+
+    Tag_sort_frames(tag);
+
+    // The order of the frames in the index may not hold anymore
+    TagIndex_free(tag->index);
+    tag->index = NULL;
+
+    tag->header->minor_version = 0;
+    tag->header->flags = 0;
+    tag->header->extended_header_size = 0;
+
+    const int frames_size = Tag_get_frames_size(tag);
+    const int used_size = ID3v2_TAG_HEADER_LENGTH + frames_size;
+
+    tag->padding_size =
+        (ID3v2_CANONICAL_TAG_ALIGNMENT - used_size % ID3v2_CANONICAL_TAG_ALIGNMENT) %
+        ID3v2_CANONICAL_TAG_ALIGNMENT;
+    tag->header->tag_size = frames_size + tag->padding_size;
+}
+
+char* ID3v2_Tag_to_canonical(ID3v2_Tag* tag, int* size)
+{
+    ID3v2_Tag_canonicalize(tag);
+
+    CharStream* tag_cs = Tag_to_char_stream(tag);
+    char* bytes = tag_cs->stream;
+    *size = tag_cs->size;
+
+    free(tag_cs);
+
+    return bytes;
+}
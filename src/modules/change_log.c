@@ -0,0 +1,455 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "modules/char_stream.private.h"
+#include "modules/container.private.h"
+#include "modules/frame.private.h"
+#include "modules/frame_header.private.h"
+#include "modules/frame_list.private.h"
+#include "modules/tag.private.h"
+#include "modules/tag_header.private.h"
+#include "modules/utils.private.h"
+
+#include "id3v2lib.h"
+
+// The whole audio payload is hashed, read this many bytes at a time
+#define AUDIO_FINGERPRINT_CHUNK_LENGTH 65536
+
+#define RECORD_SIZE_LENGTH 4
+#define RECORD_FILE_ID_SIZE_LENGTH 2
+#define RECORD_AUDIO_SIZE_LENGTH 8
+#define RECORD_AUDIO_FINGERPRINT_LENGTH 8
+#define RECORD_OP_COUNT_LENGTH 2
+#define RECORD_FRAME_COUNT_LENGTH 2
+#define RECORD_FRAME_SIZE_LENGTH 4
+
+typedef struct _RecordBuffer
+{
+    char* data;
+    int size;
+    int capacity;
+} RecordBuffer;
+
+static void RecordBuffer_write(RecordBuffer* record, const char* data, const int size)
+{
+    if (record->size + size > record->capacity)
+    {
+        record->capacity = (record->size + size) * 2;
+        record->data = (char*) realloc(record->data, record->capacity * sizeof(char));
+    }
+
+    memcpy(record->data + record->size, data, size);
+    record->size += size;
+}
+
+static void RecordBuffer_write_int(RecordBuffer* record, const unsigned long long value, int size)
+{
+    char bytes[8];
+    ulltob(value, bytes, size);
+    RecordBuffer_write(record, bytes, size);
+}
+
+static bool audio_fingerprint(
+    const char* file_name,
+    unsigned long long* audio_size,
+    unsigned long long* fingerprint
+)
+{
+    const int fd = open(file_name, O_RDONLY);
+    if (fd < 0) return false;
+
+    // The tag, and the container sizes that follow it, are left out
+    TagLocation location;
+    long audio_offset, audio_end;
+
+    if (!Container_locate_tag(fd, &location))
+    {
+        close(fd);
+        return false;
+    }
+
+    Container_locate_payload(&location, &audio_offset, &audio_end);
+    *audio_size = audio_end - audio_offset;
+
+    char size_bytes[RECORD_AUDIO_SIZE_LENGTH];
+    ulltob(*audio_size, size_bytes, RECORD_AUDIO_SIZE_LENGTH);
+    *fingerprint = fnv1a_64(size_bytes, RECORD_AUDIO_SIZE_LENGTH, FNV1A_64_OFFSET_BASIS);
+
+    char* chunk = (char*) malloc(AUDIO_FINGERPRINT_CHUNK_LENGTH * sizeof(char));
+    bool complete = true;
+
+    for (long offset = audio_offset; offset < audio_end;)
+    {
+        const long remaining = audio_end - offset;
+        const int chunk_length = remaining < AUDIO_FINGERPRINT_CHUNK_LENGTH
+                                     ? (int) remaining
+                                     : AUDIO_FINGERPRINT_CHUNK_LENGTH;
+
+        const ssize_t bytes_read = pread(fd, chunk, chunk_length, offset);
+
+        if (bytes_read <= 0)
+        {
+            complete = false;
+            break;
+        }
+
+        *fingerprint = fnv1a_64(chunk, bytes_read, *fingerprint);
+        offset += bytes_read;
+    }
+
+    free(chunk);
+    close(fd);
+
+    return complete;
+}
+
+/**
+ * Compares the frames matching frame_id in both tags as they would be
+ * written to the file.
+ */
+static bool frames_equal(ID3v2_Tag* a, ID3v2_Tag* b, const char* frame_id)
+{
+    ID3v2_FrameList* a_frames = ID3v2_Tag_get_frames(a, frame_id);
+    ID3v2_FrameList* b_frames = ID3v2_Tag_get_frames(b, frame_id);
+    ID3v2_FrameList* a_head = a_frames;
+    ID3v2_FrameList* b_head = b_frames;
+    bool equal = true;
+
+    while (equal && a_head != NULL && a_head->frame != NULL && b_head != NULL &&
+           b_head->frame != NULL)
+    {
+        CharStream* a_cs = Frame_to_char_stream(a_head->frame);
+        CharStream* b_cs = Frame_to_char_stream(b_head->frame);
+        equal = a_cs->size == b_cs->size && memcmp(a_cs->stream, b_cs->stream, a_cs->size) == 0;
+        CharStream_free(a_cs);
+        CharStream_free(b_cs);
+
+        a_head = a_head->next;
+        b_head = b_head->next;
+    }
+
+    // Both lists have to be exhausted at the same time
+    equal = equal && (a_head == NULL || a_head->frame == NULL) &&
+            (b_head == NULL || b_head->frame == NULL);
+
+    ID3v2_FrameList_unlink(a_frames);
+    ID3v2_FrameList_unlink(b_frames);
+
+    return equal;
+}
+
+/**
+ * An op replaces every frame with its id by the frames it holds. An op
+ * without frames deletes the id from the tag.
+ */
+static void write_op(RecordBuffer* record, ID3v2_Tag* tag, const char* frame_id)
+{
+    ID3v2_FrameList* frames = ID3v2_Tag_get_frames(tag, frame_id);
+    ID3v2_FrameList* head = frames;
+    int count = 0;
+
+    for (; head != NULL && head->frame != NULL; head = head->next)
+    {
+        count++;
+    }
+
+    RecordBuffer_write(record, frame_id, ID3v2_FRAME_HEADER_ID_LENGTH);
+    RecordBuffer_write_int(record, count, RECORD_FRAME_COUNT_LENGTH);
+
+    for (head = frames; head != NULL && head->frame != NULL; head = head->next)
+    {
+        CharStream* frame_cs = Frame_to_char_stream(head->frame);
+        RecordBuffer_write_int(record, frame_cs->size, RECORD_FRAME_SIZE_LENGTH);
+        RecordBuffer_write(record, frame_cs->stream, frame_cs->size);
+        CharStream_free(frame_cs);
+    }
+
+    ID3v2_FrameList_unlink(frames);
+}
+
+static bool id_seen_before(ID3v2_FrameList* list, ID3v2_FrameList* until, const char* frame_id)
+{
+    for (; list != until && list != NULL; list = list->next)
+    {
+        if (memcmp(list->frame->header->id, frame_id, ID3v2_FRAME_HEADER_ID_LENGTH) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Writes one op per frame id that differs between both tags, and returns
+ * how many were written.
+ */
+static int write_ops(RecordBuffer* record, ID3v2_Tag* old_tag, ID3v2_Tag* new_tag)
+{
+    int op_count = 0;
+    char frame_id[ID3v2_FRAME_HEADER_ID_LENGTH + 1] = {0};
+
+    for (ID3v2_FrameList* head = new_tag->frames; head != NULL && head->frame != NULL;
+         head = head->next)
+    {
+        memcpy(frame_id, head->frame->header->id, ID3v2_FRAME_HEADER_ID_LENGTH);
+
+        if (id_seen_before(new_tag->frames, head, frame_id)) continue;
+        if (frames_equal(old_tag, new_tag, frame_id)) continue;
+
+        write_op(record, new_tag, frame_id);
+        op_count++;
+    }
+
+    for (ID3v2_FrameList* head = old_tag->frames; head != NULL && head->frame != NULL;
+         head = head->next)
+    {
+        memcpy(frame_id, head->frame->header->id, ID3v2_FRAME_HEADER_ID_LENGTH);
+
+        if (id_seen_before(old_tag->frames, head, frame_id)) continue;
+        if (ID3v2_Tag_get_frame(new_tag, frame_id) != NULL) continue;
+
+        write_op(record, new_tag, frame_id); // No frames left, this deletes the id
+        op_count++;
+    }
+
+    return op_count;
+}
+
+ID3v2_ChangeLog* ID3v2_ChangeLog_open(const char* log_file_name)
+{
+    FILE* file = fopen(log_file_name, "ab");
+    if (file == NULL) return NULL;
+
+    ID3v2_ChangeLog* log = (ID3v2_ChangeLog*) malloc(sizeof(ID3v2_ChangeLog));
+    log->file = file;
+
+    return log;
+}
+
+void ID3v2_ChangeLog_close(ID3v2_ChangeLog* log)
+{
+    if (log == NULL) return;
+
+    fclose(log->file);
+    free(log);
+}
+
+// Ids are joined to the replica root, so they can't point outside of it
+static bool is_valid_file_id(const char* file_id, const int size)
+{
+    if (size == 0 || file_id[0] == '/' || memchr(file_id, '\0', size) != NULL) return false;
+
+    for (int start = 0; start < size;)
+    {
+        int end = start;
+        while (end < size && file_id[end] != '/') end++;
+
+        if (end - start == 2 && file_id[start] == '.' && file_id[start + 1] == '.') return false;
+
+        start = end + 1;
+    }
+
+    return true;
+}
+
+int ID3v2_ChangeLog_write_tag(
+    ID3v2_ChangeLog* log,
+    const char* file_name,
+    const char* file_id,
+    ID3v2_Tag* tag
+)
+{
+    if (tag == NULL || file_id == NULL || !is_valid_file_id(file_id, strlen(file_id))) return -1;
+
+    ID3v2_Tag* old_tag = Tag_read_from_file(file_name);
+    if (old_tag == NULL) old_tag = ID3v2_Tag_new_empty();
+
+    // Only edits that reached the file are logged
+    if (ID3v2_write_tag_with_progress(file_name, tag, NULL, NULL) != 0)
+    {
+        ID3v2_Tag_free(old_tag);
+        return -1;
+    }
+
+    int result = 0;
+    unsigned long long audio_size = 0;
+    unsigned long long fingerprint = 0;
+
+    if (log != NULL && audio_fingerprint(file_name, &audio_size, &fingerprint))
+    {
+        RecordBuffer ops = {NULL, 0, 0};
+        const int op_count = write_ops(&ops, old_tag, tag);
+
+        if (op_count > 0)
+        {
+            RecordBuffer record = {NULL, 0, 0};
+            const int file_id_size = strlen(file_id);
+
+            RecordBuffer_write(&record, ID3v2_CHANGE_LOG_RECORD_MAGIC, 4);
+            RecordBuffer_write_int(
+                &record,
+                RECORD_FILE_ID_SIZE_LENGTH + file_id_size + RECORD_AUDIO_SIZE_LENGTH +
+                    RECORD_AUDIO_FINGERPRINT_LENGTH + RECORD_OP_COUNT_LENGTH + ops.size,
+                RECORD_SIZE_LENGTH
+            );
+            RecordBuffer_write_int(&record, file_id_size, RECORD_FILE_ID_SIZE_LENGTH);
+            RecordBuffer_write(&record, file_id, file_id_size);
+            RecordBuffer_write_int(&record, audio_size, RECORD_AUDIO_SIZE_LENGTH);
+            RecordBuffer_write_int(&record, fingerprint, RECORD_AUDIO_FINGERPRINT_LENGTH);
+            RecordBuffer_write_int(&record, op_count, RECORD_OP_COUNT_LENGTH);
+            RecordBuffer_write(&record, ops.data, ops.size);
+
+            // A single write per record, so records from a crashed writer are at worst truncated
+            if (fwrite(record.data, sizeof(char), record.size, log->file) != record.size ||
+                fflush(log->file) != 0)
+            {
+                result = -1;
+            }
+
+            free(record.data);
+        }
+
+        free(ops.data);
+    }
+
+    ID3v2_Tag_free(old_tag);
+
+    return result;
+}
+
+static int read_int(CharStream* record_cs, const int size)
+{
+    char bytes[8];
+    if (CharStream_read(record_cs, bytes, size) != size) return -1;
+    return btoull(bytes, size);
+}
+
+static bool apply_record(CharStream* record_cs, const char* replica_root)
+{
+    const int file_id_size = read_int(record_cs, RECORD_FILE_ID_SIZE_LENGTH);
+    if (file_id_size < 0 || file_id_size > record_cs->size - record_cs->cursor) return false;
+
+    const int root_size = strlen(replica_root);
+    char* file_name = (char*) malloc((root_size + 1 + file_id_size + 1) * sizeof(char));
+    memcpy(file_name, replica_root, root_size);
+    file_name[root_size] = '/';
+    CharStream_read(record_cs, file_name + root_size + 1, file_id_size);
+    file_name[root_size + 1 + file_id_size] = '\0';
+
+    if (!is_valid_file_id(file_name + root_size + 1, file_id_size))
+    {
+        free(file_name);
+        return false;
+    }
+
+    char expected[RECORD_AUDIO_SIZE_LENGTH + RECORD_AUDIO_FINGERPRINT_LENGTH];
+    CharStream_read(record_cs, expected, sizeof(expected));
+
+    unsigned long long audio_size = 0;
+    unsigned long long fingerprint = 0;
+
+    if (!audio_fingerprint(file_name, &audio_size, &fingerprint) ||
+        audio_size != btoull(expected, RECORD_AUDIO_SIZE_LENGTH) ||
+        fingerprint != btoull(expected + RECORD_AUDIO_SIZE_LENGTH, RECORD_AUDIO_FINGERPRINT_LENGTH))
+    {
+        // Not the same audio, the replica has diverged from the source
+        free(file_name);
+        return false;
+    }
+
+    ID3v2_Tag* tag = Tag_read_from_file(file_name);
+    if (tag == NULL) tag = ID3v2_Tag_new_empty();
+
+    const int op_count = read_int(record_cs, RECORD_OP_COUNT_LENGTH);
+
+    for (int op = 0; op < op_count; op++)
+    {
+        char frame_id[ID3v2_FRAME_HEADER_ID_LENGTH];
+        CharStream_read(record_cs, frame_id, ID3v2_FRAME_HEADER_ID_LENGTH);
+        const int frame_count = read_int(record_cs, RECORD_FRAME_COUNT_LENGTH);
+        if (frame_count < 0) break;
+
+        ID3v2_Frame** frames = (ID3v2_Frame**) malloc((frame_count + 1) * sizeof(ID3v2_Frame*));
+        int parsed = 0;
+
+        for (int i = 0; i < frame_count; i++)
+        {
+            const int frame_size = read_int(record_cs, RECORD_FRAME_SIZE_LENGTH);
+            if (frame_size < 0 || frame_size > record_cs->size - record_cs->cursor) break;
+
+            // Frames are stored the way v2.3 tags store them
+            CharStream* frame_cs = CharStream_from_buffer(CharStream_get_cur(record_cs), frame_size);
+            ID3v2_Frame* frame = Frame_parse(frame_cs, 3);
+            CharStream_free(frame_cs);
+            CharStream_seek(record_cs, frame_size, SEEK_CUR);
+
+            if (frame != NULL) frames[parsed++] = frame;
+        }
+
+        Tag_set_frames(tag, frame_id, frames, parsed);
+        free(frames);
+    }
+
+    // Written in place whenever the new frames fit, the audio isn't touched
+    const bool written = ID3v2_write_tag_with_progress(file_name, tag, NULL, NULL) == 0;
+
+    ID3v2_Tag_free(tag);
+    free(file_name);
+
+    return written;
+}
+
+int ID3v2_ChangeLog_apply(const char* log_file_name, const char* replica_root)
+{
+    FILE* fp = fopen(log_file_name, "rb");
+    if (fp == NULL) return -1;
+
+    int applied = 0;
+    char prefix[ID3v2_CHANGE_LOG_RECORD_MAGIC_LENGTH + RECORD_SIZE_LENGTH];
+
+    while (fread(prefix, sizeof(char), sizeof(prefix), fp) == sizeof(prefix))
+    {
+        if (memcmp(prefix, ID3v2_CHANGE_LOG_RECORD_MAGIC, ID3v2_CHANGE_LOG_RECORD_MAGIC_LENGTH) != 0)
+        {
+            applied = -1;
+            break;
+        }
+
+        const int record_size =
+            btoull(prefix + ID3v2_CHANGE_LOG_RECORD_MAGIC_LENGTH, RECORD_SIZE_LENGTH);
+        char* record = (char*) malloc(record_size * sizeof(char));
+
+        // A truncated record can only be the last one, left by a writer that crashed
+        if (fread(record, sizeof(char), record_size, fp) != record_size)
+        {
+            free(record);
+            break;
+        }
+
+        CharStream* record_cs = CharStream_from_buffer(record, record_size);
+        if (apply_record(record_cs, replica_root)) applied++;
+        CharStream_free(record_cs);
+
+        free(record);
+    }
+
+    fclose(fp);
+
+    return applied;
+}
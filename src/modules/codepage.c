@@ -0,0 +1,351 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "frames/text_frame.private.h"
+#include "modules/frame.private.h"
+#include "modules/frame_header.private.h"
+#include "modules/tag.private.h"
+#include "modules/tag_header.h"
+#include "modules/utils.private.h"
+
+#include "codepage.private.h"
+#include "modules/codepage.h"
+
+// What characters look like to the detector
+#define CLASS_OTHER 0
+#define CLASS_ASCII_LETTER 1
+#define CLASS_LATIN_LETTER 2
+#define CLASS_CYRILLIC_UPPER 3
+#define CLASS_CYRILLIC_LOWER 4
+#define CLASS_KANA 5
+#define CLASS_HAN 6
+#define CLASS_RARE_HAN 7
+#define CLASS_CJK_SYMBOL 8
+#define CLASS_PUNCTUATION 9
+#define CLASS_INVALID 10
+
+/**
+ * Counts the bytes before the first one that isn't ASCII.
+ */
+static int ascii_length(const unsigned char* text, const int size)
+{
+    int i = 0;
+
+#ifdef __SSE2__
+    // The top bit of every byte, 16 at a time
+    for (; i + 16 <= size; i += 16)
+    {
+        const int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) (text + i)));
+        if (mask != 0) return i + __builtin_ctz(mask);
+    }
+#else
+    for (; i + 8 <= size; i += 8)
+    {
+        unsigned long long word;
+        memcpy(&word, text + i, sizeof(word));
+        if ((word & 0x8080808080808080ULL) != 0) break;
+    }
+#endif
+
+    while (i < size && text[i] < 0x80) i++;
+
+    return i;
+}
+
+static int shift_jis_lead_index(const unsigned char lead)
+{
+    if (lead >= 0x81 && lead <= 0x9F) return lead - 0x81;
+    if (lead >= 0xE0 && lead <= 0xFC) return lead - 0xE0 + 0x9F - 0x81 + 1;
+
+    return -1;
+}
+
+/**
+ * Decodes the character at *cursor, whose first byte isn't ASCII, and
+ * moves past it. Returns 0 and only skips the first byte if it doesn't
+ * start a character.
+ */
+static unsigned int decode_character(
+    const int codepage,
+    const unsigned char* text,
+    const int size,
+    int* cursor
+)
+{
+    const unsigned char c = text[(*cursor)++];
+    const unsigned char trail = *cursor < size ? text[*cursor] : 0;
+    int index = -1;
+
+    switch (codepage)
+    {
+        case ID3v2_CODEPAGE_CP1252:
+            return cp1252_table[c - 0x80];
+
+        case ID3v2_CODEPAGE_CP1251:
+            return cp1251_table[c - 0x80];
+
+        case ID3v2_CODEPAGE_SHIFT_JIS:
+            if (shift_jis_table[c - 0x80] != 0) return shift_jis_table[c - 0x80];
+
+            if (shift_jis_lead_index(c) >= 0 && trail >= 0x40 && trail <= 0xFC)
+            {
+                index = shift_jis_lead_index(c) * SHIFT_JIS_TRAIL_COUNT + trail - 0x40;
+                if (shift_jis_double_table[index] == 0) return 0;
+
+                (*cursor)++;
+                return shift_jis_double_table[index];
+            }
+
+            return 0;
+
+        case ID3v2_CODEPAGE_GBK:
+            if (gbk_table[c - 0x80] != 0) return gbk_table[c - 0x80];
+
+            if (c >= 0x81 && c <= 0xFE && trail >= 0x40 && trail <= 0xFE)
+            {
+                index = (c - 0x81) * GBK_TRAIL_COUNT + trail - 0x40;
+                if (gbk_double_table[index] == 0) return 0;
+
+                (*cursor)++;
+                return gbk_double_table[index];
+            }
+
+            return 0;
+
+        default:
+            return c;
+    }
+}
+
+int ID3v2_codepage_to_utf8(const char* text, const int size, const int codepage, char* dest)
+{
+    const unsigned char* bytes = (const unsigned char*) text;
+    char* end = dest;
+    int cursor = 0;
+
+    while (cursor < size)
+    {
+        const int ascii = ascii_length(bytes + cursor, size - cursor);
+        memcpy(end, text + cursor, ascii);
+        end += ascii;
+        cursor += ascii;
+
+        // Double byte characters may end with an ASCII byte, so only the
+        // first byte of the next character is looked at
+        while (cursor < size && bytes[cursor] >= 0x80)
+        {
+            const unsigned int code_point = decode_character(codepage, bytes, size, &cursor);
+            end = utf8_encode(end, code_point != 0 ? code_point : 0xFFFD);
+        }
+    }
+
+    *end = '\0';
+    return end - dest;
+}
+
+void ID3v2_Tag_decode_codepage(ID3v2_Tag* tag, const int codepage)
+{
+    ID3v2_FrameList* head = tag->frames;
+
+    for (; head != NULL && head->frame != NULL; head = head->next)
+    {
+        ID3v2_Frame* frame = head->frame;
+        if (!FrameHeader_isTextFrame(frame->header)) continue;
+
+        const int size = frame->header->size;
+        TextFrame_decode_codepage(
+            (ID3v2_TextFrame*) frame,
+            codepage,
+            tag->header->major_version
+        );
+        tag->header->tag_size += frame->header->size - size;
+    }
+}
+
+static int character_class(const unsigned int code_point)
+{
+    if (code_point == 0) return CLASS_INVALID;
+
+    if ((code_point | 0x20) >= 'a' && (code_point | 0x20) <= 'z') return CLASS_ASCII_LETTER;
+
+    if (code_point >= 0xC0 && code_point <= 0x24F && code_point != 0xD7 && code_point != 0xF7)
+    {
+        return CLASS_LATIN_LETTER;
+    }
+
+    // Russian, Ukrainian and Belarusian letters, the ones only used further
+    // south are as rare in tags as they are common in misread CJK text
+    if (code_point >= 0x410 && code_point <= 0x42F) return CLASS_CYRILLIC_UPPER;
+    if (code_point >= 0x430 && code_point <= 0x44F) return CLASS_CYRILLIC_LOWER;
+
+    switch (code_point)
+    {
+        case 0x401: case 0x404: case 0x406: case 0x407: case 0x40E: case 0x490:
+            return CLASS_CYRILLIC_UPPER;
+        case 0x451: case 0x454: case 0x456: case 0x457: case 0x45E: case 0x491:
+            return CLASS_CYRILLIC_LOWER;
+    }
+
+    // Dashes, quotes and ellipsis, which only Windows codepages have
+    if (code_point >= 0x2013 && code_point <= 0x2026) return CLASS_PUNCTUATION;
+
+    if (code_point >= 0x3041 && code_point <= 0x30FF) return CLASS_KANA;
+    if (code_point >= 0x4E00 && code_point <= 0x9FFF) return CLASS_HAN;
+
+    if ((code_point >= 0x3000 && code_point <= 0x303F) ||
+        (code_point >= 0xFF01 && code_point <= 0xFF5E))
+    {
+        return CLASS_CJK_SYMBOL;
+    }
+
+    return CLASS_OTHER;
+}
+
+/**
+ * How much a character looks like part of a word, given the one before it.
+ * Letters are expected to come along with letters of their own script,
+ * cyrillic words to go on in lowercase, and CJK text to use kana and
+ * common ideographs.
+ */
+static int character_score(const int previous, const int current)
+{
+    const bool previous_cyrillic =
+        previous == CLASS_CYRILLIC_UPPER || previous == CLASS_CYRILLIC_LOWER;
+    const bool current_cyrillic =
+        current == CLASS_CYRILLIC_UPPER || current == CLASS_CYRILLIC_LOWER;
+
+    switch (current)
+    {
+        case CLASS_INVALID: return -20;
+        case CLASS_KANA: return 3;
+        case CLASS_HAN: return 2;
+        case CLASS_RARE_HAN: return -1;
+        case CLASS_CJK_SYMBOL: return 1;
+        case CLASS_PUNCTUATION: return 1;
+    }
+
+    if ((previous == CLASS_ASCII_LETTER && current == CLASS_LATIN_LETTER) ||
+        (previous == CLASS_LATIN_LETTER && current == CLASS_ASCII_LETTER))
+    {
+        return 2;
+    }
+
+    if (previous == CLASS_LATIN_LETTER && current == CLASS_LATIN_LETTER) return -1;
+
+    if ((previous == CLASS_ASCII_LETTER && current_cyrillic) ||
+        (previous_cyrillic && current == CLASS_ASCII_LETTER))
+    {
+        return -2;
+    }
+
+    if (previous_cyrillic && current == CLASS_CYRILLIC_LOWER) return 2;
+    if (previous == CLASS_CYRILLIC_UPPER && current == CLASS_CYRILLIC_UPPER) return 1;
+    if (previous == CLASS_CYRILLIC_LOWER && current == CLASS_CYRILLIC_UPPER) return -3;
+
+    return 0;
+}
+
+static long text_score(const int codepage, const unsigned char* text, const int size)
+{
+    long score = 0;
+    int previous = CLASS_OTHER;
+    int cursor = 0;
+
+    while (cursor < size)
+    {
+        const int start = cursor;
+        int current = CLASS_OTHER;
+
+        if (text[cursor] < 0x80)
+        {
+            current = character_class(text[cursor++]);
+            if (current == CLASS_INVALID) current = CLASS_OTHER;
+        }
+        else
+        {
+            current = character_class(decode_character(codepage, text, size, &cursor));
+        }
+
+        // The first level of GB2312 holds the ideographs in common use
+        if (codepage == ID3v2_CODEPAGE_GBK && current == CLASS_HAN &&
+            (text[start] < 0xB0 || text[start] > 0xD7 || text[start + 1] < 0xA1))
+        {
+            current = CLASS_RARE_HAN;
+        }
+
+        score += character_score(previous, current);
+        previous = current;
+    }
+
+    return score;
+}
+
+void ID3v2_CodepageDetector_init(ID3v2_CodepageDetector* detector)
+{
+    memset(detector, 0, sizeof(ID3v2_CodepageDetector));
+}
+
+void ID3v2_CodepageDetector_add_text(
+    ID3v2_CodepageDetector* detector,
+    const char* text,
+    const int size
+)
+{
+    const unsigned char* bytes = (const unsigned char*) text;
+    if (ascii_length(bytes, size) == size) return;
+
+    // Latin-1 reads as CP1252 does, minus its punctuation
+    for (int codepage = ID3v2_CODEPAGE_CP1252; codepage < ID3v2_CODEPAGE_COUNT; codepage++)
+    {
+        detector->scores[codepage] += text_score(codepage, bytes, size);
+    }
+
+    detector->text_count++;
+}
+
+void ID3v2_CodepageDetector_add_tag(ID3v2_CodepageDetector* detector, ID3v2_Tag* tag)
+{
+    ID3v2_FrameList* head = tag->frames;
+
+    for (; head != NULL && head->frame != NULL; head = head->next)
+    {
+        if (!FrameHeader_isTextFrame(head->frame->header)) continue;
+
+        const ID3v2_TextFrameData* data = ((ID3v2_TextFrame*) head->frame)->data;
+
+        if (data->encoding == ID3v2_ENCODING_ISO)
+        {
+            ID3v2_CodepageDetector_add_text(detector, data->text, data->size);
+        }
+    }
+}
+
+int ID3v2_CodepageDetector_guess(const ID3v2_CodepageDetector* detector)
+{
+    int guess = ID3v2_CODEPAGE_LATIN1;
+    long best_score = 0;
+
+    for (int codepage = ID3v2_CODEPAGE_CP1252; codepage < ID3v2_CODEPAGE_COUNT; codepage++)
+    {
+        if (detector->scores[codepage] > best_score)
+        {
+            guess = codepage;
+            best_score = detector->scores[codepage];
+        }
+    }
+
+    return guess;
+}
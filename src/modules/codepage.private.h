@@ -0,0 +1,37 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_codepage_private_h
+#define id3v2lib_codepage_private_h
+
+// Shift-JIS lead bytes are 0x81 to 0x9F and 0xE0 to 0xFC, trail bytes 0x40 to 0xFC
+#define SHIFT_JIS_LEAD_COUNT 60
+#define SHIFT_JIS_TRAIL_COUNT 189
+
+// GBK lead bytes are 0x81 to 0xFE, trail bytes 0x40 to 0xFE
+#define GBK_LEAD_COUNT 126
+#define GBK_TRAIL_COUNT 191
+
+/**
+ * Code points of the bytes 0x80 to 0xFF, 0 for the ones that don't make a
+ * character on their own, lead bytes included.
+ */
+extern const unsigned short cp1251_table[128];
+extern const unsigned short cp1252_table[128];
+extern const unsigned short shift_jis_table[128];
+extern const unsigned short gbk_table[128];
+
+/**
+ * Code points of double byte characters by lead and trail byte, 0 for the
+ * pairs that don't make one.
+ */
+extern const unsigned short shift_jis_double_table[SHIFT_JIS_LEAD_COUNT * SHIFT_JIS_TRAIL_COUNT];
+extern const unsigned short gbk_double_table[GBK_LEAD_COUNT * GBK_TRAIL_COUNT];
+
+#endif
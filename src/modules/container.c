@@ -0,0 +1,364 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "modules/tag_header.h"
+#include "modules/utils.private.h"
+
+#include "container.private.h"
+
+#define FORM_HEADER_LENGTH 12
+#define FORM_SIZE_OFFSET 4
+
+#define DSF_HEADER_LENGTH 28
+#define DSF_FILE_SIZE_OFFSET 12
+#define DSF_METADATA_POINTER_OFFSET 20
+#define DSF_INT_LENGTH 8
+
+#define JUNK_CHUNK_ID "JUNK"
+
+static unsigned long long read_le(const char* bytes, const int size)
+{
+    unsigned long long value = 0;
+
+    for (int i = size - 1; i >= 0; i--)
+    {
+        value = (value << 8) | (unsigned char) bytes[i];
+    }
+
+    return value;
+}
+
+static void write_le(unsigned long long value, char* dest, const int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        dest[i] = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+/**
+ * AIFF stores its sizes big endian, WAV little endian.
+ */
+static unsigned long long read_chunk_int(const int container, const char* bytes)
+{
+    return container == CONTAINER_AIFF ? btoull(bytes, 4) : read_le(bytes, 4);
+}
+
+static void write_chunk_int(const int container, const unsigned long long value, char* dest)
+{
+    if (container == CONTAINER_AIFF) ulltob(value, dest, 4);
+    else write_le(value, dest, 4);
+}
+
+static bool is_id3_chunk(const char* id)
+{
+    return memcmp(id, "ID3 ", 4) == 0 || memcmp(id, "id3 ", 4) == 0;
+}
+
+/**
+ * Checks that the bytes at offset are the header of an ID3 tag and returns
+ * the size it takes, header included.
+ */
+static long tag_size_at(const int fd, const long offset)
+{
+    char header[ID3v2_TAG_HEADER_LENGTH];
+
+    if (pread(fd, header, ID3v2_TAG_HEADER_LENGTH, offset) != ID3v2_TAG_HEADER_LENGTH) return -1;
+    if (memcmp(header, "ID3", ID3v2_TAG_HEADER_IDENTIFIER_LENGTH) != 0) return -1;
+
+    return syncint_decode(btoi(header + 6, ID3v2_TAG_HEADER_TAG_SIZE_LENGTH)) +
+           ID3v2_TAG_HEADER_LENGTH;
+}
+
+static void locate_chunk(const int fd, TagLocation* location)
+{
+    long offset = FORM_HEADER_LENGTH;
+    char header[CONTAINER_CHUNK_HEADER_LENGTH];
+
+    while (offset + CONTAINER_CHUNK_HEADER_LENGTH <= location->file_size)
+    {
+        if (pread(fd, header, CONTAINER_CHUNK_HEADER_LENGTH, offset) != CONTAINER_CHUNK_HEADER_LENGTH)
+        {
+            return;
+        }
+
+        const long size = read_chunk_int(location->container, header + 4);
+
+        if (is_id3_chunk(header))
+        {
+            location->chunk_offset = offset;
+            location->tag_offset = offset + CONTAINER_CHUNK_HEADER_LENGTH;
+            location->tag_space = size;
+            return;
+        }
+
+        // Chunks are aligned to even offsets
+        offset += CONTAINER_CHUNK_HEADER_LENGTH + size + (size & 1);
+    }
+}
+
+static void locate_dsf(const int fd, TagLocation* location)
+{
+    char header[DSF_HEADER_LENGTH];
+
+    if (pread(fd, header, DSF_HEADER_LENGTH, 0) != DSF_HEADER_LENGTH) return;
+
+    const long pointer = read_le(header + DSF_METADATA_POINTER_OFFSET, DSF_INT_LENGTH);
+    if (pointer == 0) return;
+
+    const long size = tag_size_at(fd, pointer);
+    if (size < 0) return;
+
+    location->tag_offset = pointer;
+    location->tag_space = size;
+}
+
+bool Container_locate_tag(const int fd, TagLocation* location)
+{
+    struct stat st;
+    char magic[FORM_HEADER_LENGTH] = {0};
+
+    if (fstat(fd, &st) != 0) return false;
+
+    location->container = CONTAINER_NONE;
+    location->tag_offset = -1;
+    location->tag_space = 0;
+    location->chunk_offset = -1;
+    location->file_size = st.st_size;
+
+    pread(fd, magic, FORM_HEADER_LENGTH, 0);
+
+    if (memcmp(magic, "FORM", 4) == 0 &&
+        (memcmp(magic + 8, "AIFF", 4) == 0 || memcmp(magic + 8, "AIFC", 4) == 0))
+    {
+        location->container = CONTAINER_AIFF;
+        locate_chunk(fd, location);
+    }
+    else if (memcmp(magic, "RIFF", 4) == 0 && memcmp(magic + 8, "WAVE", 4) == 0)
+    {
+        location->container = CONTAINER_WAV;
+        locate_chunk(fd, location);
+    }
+    else if (memcmp(magic, "DSD ", 4) == 0)
+    {
+        location->container = CONTAINER_DSF;
+        locate_dsf(fd, location);
+    }
+    else
+    {
+        const long size = tag_size_at(fd, 0);
+
+        if (size >= 0)
+        {
+            location->tag_offset = 0;
+            location->tag_space = size;
+        }
+    }
+
+    return true;
+}
+
+static bool write_all(const int fd, const char* data, const long size, const long offset)
+{
+    return pwrite(fd, data, size, offset) == size;
+}
+
+static bool fix_form_size(const int fd, TagLocation* location, const long file_size)
+{
+    char size_bytes[4];
+    write_chunk_int(location->container, file_size - CONTAINER_CHUNK_HEADER_LENGTH, size_bytes);
+
+    return write_all(fd, size_bytes, 4, FORM_SIZE_OFFSET);
+}
+
+static bool fix_dsf(const int fd, const long file_size, const long pointer)
+{
+    char bytes[DSF_INT_LENGTH];
+
+    write_le(file_size, bytes, DSF_INT_LENGTH);
+    if (!write_all(fd, bytes, DSF_INT_LENGTH, DSF_FILE_SIZE_OFFSET)) return false;
+
+    write_le(pointer, bytes, DSF_INT_LENGTH);
+    return write_all(fd, bytes, DSF_INT_LENGTH, DSF_METADATA_POINTER_OFFSET);
+}
+
+static bool chunk_is_last(TagLocation* location)
+{
+    const long end = location->tag_offset + location->tag_space + (location->tag_space & 1);
+    return end >= location->file_size;
+}
+
+static bool write_chunk(
+    const int fd,
+    TagLocation* location,
+    const char* tag,
+    const int size,
+    const int padding_size
+)
+{
+    long offset = location->file_size + (location->file_size & 1);
+
+    if (location->chunk_offset >= 0)
+    {
+        if (chunk_is_last(location))
+        {
+            // Nothing follows the chunk, it can grow or shrink where it is
+            offset = location->chunk_offset;
+        }
+        else
+        {
+            // Whatever follows can't be moved, the old chunk is left as filler
+            if (!write_all(fd, JUNK_CHUNK_ID, 4, location->chunk_offset)) return false;
+        }
+    }
+
+    const int chunk_size = size + padding_size;
+    char header[CONTAINER_CHUNK_HEADER_LENGTH];
+    memcpy(header, location->container == CONTAINER_AIFF ? "ID3 " : "id3 ", 4);
+    write_chunk_int(location->container, chunk_size, header + 4);
+
+    const long tag_offset = offset + CONTAINER_CHUNK_HEADER_LENGTH;
+    const long end = tag_offset + chunk_size + (chunk_size & 1);
+
+    // The padding (and pad byte) is written as zeros, never allocated
+    if (!write_all(fd, header, CONTAINER_CHUNK_HEADER_LENGTH, offset) ||
+        !write_all(fd, tag, size, tag_offset) ||
+        !pwrite_zeros(fd, tag_offset + size, end - tag_offset - size) || ftruncate(fd, end) != 0)
+    {
+        return false;
+    }
+
+    return fix_form_size(fd, location, end);
+}
+
+static bool write_dsf(
+    const int fd,
+    TagLocation* location,
+    const char* tag,
+    const int size,
+    const int padding_size
+)
+{
+    long offset = location->file_size;
+
+    // The tag is expected at the end of the file, after the audio
+    if (location->tag_offset >= 0 &&
+        location->tag_offset + location->tag_space >= location->file_size)
+    {
+        offset = location->tag_offset;
+    }
+
+    const long end = offset + size + padding_size;
+
+    if (!write_all(fd, tag, size, offset) || !pwrite_zeros(fd, offset + size, padding_size) ||
+        ftruncate(fd, end) != 0)
+    {
+        return false;
+    }
+
+    return fix_dsf(fd, end, offset);
+}
+
+bool Container_write_tag(
+    const int fd,
+    TagLocation* location,
+    const char* tag,
+    const int size,
+    const int padding_size
+)
+{
+    if (location->tag_offset >= 0 && size + padding_size == location->tag_space)
+    {
+        return write_all(fd, tag, size, location->tag_offset) &&
+               pwrite_zeros(fd, location->tag_offset + size, padding_size);
+    }
+
+    switch (location->container)
+    {
+        case CONTAINER_AIFF:
+        case CONTAINER_WAV:
+            return write_chunk(fd, location, tag, size, padding_size);
+        case CONTAINER_DSF:
+            return write_dsf(fd, location, tag, size, padding_size);
+        default:
+            return false;
+    }
+}
+
+static bool delete_chunk(const int fd, TagLocation* location)
+{
+    if (!chunk_is_last(location))
+    {
+        return write_all(fd, JUNK_CHUNK_ID, 4, location->chunk_offset);
+    }
+
+    return ftruncate(fd, location->chunk_offset) == 0 &&
+           fix_form_size(fd, location, location->chunk_offset);
+}
+
+static bool delete_dsf(const int fd, TagLocation* location)
+{
+    long file_size = location->file_size;
+
+    if (location->tag_offset + location->tag_space >= file_size)
+    {
+        file_size = location->tag_offset;
+        if (ftruncate(fd, file_size) != 0) return false;
+    }
+
+    return fix_dsf(fd, file_size, 0);
+}
+
+bool Container_delete_tag(const int fd, TagLocation* location)
+{
+    if (location->tag_offset < 0) return true;
+
+    switch (location->container)
+    {
+        case CONTAINER_AIFF:
+        case CONTAINER_WAV:
+            return delete_chunk(fd, location);
+        case CONTAINER_DSF:
+            return delete_dsf(fd, location);
+        default:
+            return false;
+    }
+}
+
+void Container_locate_payload(TagLocation* location, long* start, long* end)
+{
+    *start = 0;
+    *end = location->file_size;
+
+    switch (location->container)
+    {
+        case CONTAINER_AIFF:
+        case CONTAINER_WAV:
+            *start = FORM_HEADER_LENGTH;
+            if (location->chunk_offset >= 0) *end = location->chunk_offset;
+            break;
+        case CONTAINER_DSF:
+            *start = DSF_HEADER_LENGTH;
+            if (location->tag_offset >= 0) *end = location->tag_offset;
+            break;
+        default:
+            if (location->tag_offset >= 0) *start = location->tag_offset + location->tag_space;
+            break;
+    }
+
+    if (*end < *start) *end = *start;
+}
@@ -0,0 +1,62 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_container_private_h
+#define id3v2lib_container_private_h
+
+#include <stdbool.h>
+
+// Plain streams (mp3) store the tag at the start of the file
+#define CONTAINER_NONE 0
+#define CONTAINER_AIFF 1
+#define CONTAINER_WAV 2
+#define CONTAINER_DSF 3
+
+#define CONTAINER_CHUNK_HEADER_LENGTH 8
+
+typedef struct _TagLocation
+{
+    int container;
+    long tag_offset;   // Where the tag starts, -1 if the file doesn't have one
+    long tag_space;    // Bytes available for the tag at tag_offset
+    long chunk_offset; // Where the header of the ID3 chunk starts, AIFF and WAV only
+    long file_size;
+} TagLocation;
+
+/**
+ * Finds where the tag of the file is stored. Chunk based containers are
+ * walked reading chunk headers only, so the audio data is never read.
+ */
+bool Container_locate_tag(const int fd, TagLocation* location);
+
+/**
+ * Stores the tag in a container (not CONTAINER_NONE). Tags that fit in
+ * the space of the existing one are written in place, otherwise the tag
+ * is moved to the end of the file and the container sizes are fixed up,
+ * the audio data is never moved. tag holds the header and frames, the
+ * padding_size zeros that follow them are written without being allocated.
+ */
+bool Container_write_tag(
+    const int fd,
+    TagLocation* location,
+    const char* tag,
+    const int size,
+    const int padding_size
+);
+
+bool Container_delete_tag(const int fd, TagLocation* location);
+
+/**
+ * Finds the bytes writing the tag leaves alone, from after the container
+ * header (whose sizes follow the tag) up to the tag, or after the tag of
+ * plain streams.
+ */
+void Container_locate_payload(TagLocation* location, long* start, long* end);
+
+#endif
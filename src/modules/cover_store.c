@@ -0,0 +1,1028 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "id3v2lib.h"
+#include "modules/container.private.h"
+#include "modules/frame_walker.private.h"
+#include "modules/sha256.private.h"
+#include "modules/tag.private.h"
+#include "modules/utils.private.h"
+
+#define MAPPING_FILE_NAME "mapping"
+#define MAPPING_HEADER "id3v2lib covers 1\n"
+
+#define COPY_CHUNK_SIZE (256 * 1024)
+
+// The mime type, picture type and description have to fit in it
+#define APIC_HEADER_READ_SIZE 4096
+
+#define TAG_HEADER_UNSYNCHRONISATION_FLAG (1 << 7)
+
+// Second byte of the frame flags
+#define V23_FRAME_COMPRESSION_FLAG (1 << 7)
+#define V23_FRAME_ENCRYPTION_FLAG (1 << 6)
+#define V23_FRAME_GROUPING_FLAG (1 << 5)
+#define V24_FRAME_GROUPING_FLAG (1 << 6)
+#define V24_FRAME_COMPRESSION_FLAG (1 << 3)
+#define V24_FRAME_ENCRYPTION_FLAG (1 << 2)
+#define V24_FRAME_UNSYNCHRONISATION_FLAG (1 << 1)
+#define V24_FRAME_DATA_LENGTH_FLAG (1 << 0)
+
+#define FRAME_DATA_LENGTH_SIZE 4
+
+// Files don't hash to it in practice, so files holding it are always
+// extracted again
+#define RETRY_FINGERPRINT 0ULL
+
+typedef struct _CoverFile
+{
+    char* file_name;
+    unsigned long long fingerprint;
+    // Files that can't be read any more are dropped from the mapping
+    bool removed;
+    int picture_count;
+    ID3v2_Cover* pictures;
+} CoverFile;
+
+struct _ID3v2_CoverStore
+{
+    char* directory;
+    int file_count;
+    int file_capacity;
+    // Sorted by file name
+    CoverFile* files;
+};
+
+static void CoverFile_free(CoverFile* file)
+{
+    for (int i = 0; i < file->picture_count; i++)
+    {
+        free((char*) file->pictures[i].mime_type);
+    }
+
+    free(file->pictures);
+    free(file->file_name);
+}
+
+static ID3v2_Cover* CoverFile_add_picture(CoverFile* file)
+{
+    file->pictures = (ID3v2_Cover*) realloc(
+        file->pictures,
+        (file->picture_count + 1) * sizeof(ID3v2_Cover)
+    );
+
+    ID3v2_Cover* cover = &file->pictures[file->picture_count++];
+    memset(cover, 0, sizeof(ID3v2_Cover));
+    cover->file_name = file->file_name;
+
+    return cover;
+}
+
+static int compare_files(const void* a, const void* b)
+{
+    return strcmp(((const CoverFile*) a)->file_name, ((const CoverFile*) b)->file_name);
+}
+
+static CoverFile* CoverStore_find(const ID3v2_CoverStore* store, const char* file_name, int count)
+{
+    const CoverFile key = {(char*) file_name};
+    if (count == 0) return NULL;
+
+    return (CoverFile*) bsearch(&key, store->files, count, sizeof(CoverFile), compare_files);
+}
+
+static CoverFile* CoverStore_append(ID3v2_CoverStore* store)
+{
+    if (store->file_count == store->file_capacity)
+    {
+        store->file_capacity = store->file_capacity == 0 ? 64 : store->file_capacity * 2;
+        store->files =
+            (CoverFile*) realloc(store->files, store->file_capacity * sizeof(CoverFile));
+    }
+
+    CoverFile* file = &store->files[store->file_count++];
+    memset(file, 0, sizeof(CoverFile));
+
+    return file;
+}
+
+/**
+ * Mapping
+ *
+ * A text file listing every file followed by its pictures:
+ *
+ *   file <fingerprint> <file name>
+ *   picture <picture type> <hash> <size> <width> <height> <mime type>
+ *
+ * Files whose name holds a line break aren't listed, so they're extracted
+ * again on every run.
+ */
+
+static char* mapping_file_name(const ID3v2_CoverStore* store, const char* suffix)
+{
+    char* file_name = NULL;
+
+    if (asprintf(&file_name, "%s/" MAPPING_FILE_NAME "%s", store->directory, suffix) < 0)
+    {
+        return NULL;
+    }
+
+    return file_name;
+}
+
+/**
+ * Mappings that can't be read are dropped, every file is extracted again
+ * and the pictures already stored are found in the store.
+ */
+static void CoverStore_load(ID3v2_CoverStore* store)
+{
+    char* file_name = mapping_file_name(store, "");
+    FILE* fp = file_name != NULL ? fopen(file_name, "r") : NULL;
+    free(file_name);
+
+    if (fp == NULL) return;
+
+    char* line = NULL;
+    size_t capacity = 0;
+    ssize_t length = getline(&line, &capacity, fp);
+    bool valid = length > 0 && strcmp(line, MAPPING_HEADER) == 0;
+    CoverFile* file = NULL;
+
+    while (valid && (length = getline(&line, &capacity, fp)) > 0)
+    {
+        if (line[length - 1] == '\n') line[--length] = '\0';
+
+        unsigned long long fingerprint;
+        ID3v2_Cover cover;
+        int offset = 0;
+
+        if (sscanf(line, "file %16llx%n", &fingerprint, &offset) == 1 && line[offset] == ' ')
+        {
+            file = CoverStore_append(store);
+            file->file_name = strdup(line + offset + 1);
+            file->fingerprint = fingerprint;
+        }
+        else if (
+            file != NULL &&
+            sscanf(
+                line,
+                "picture %d %64s %ld %d %d%n",
+                &cover.picture_type,
+                cover.hash,
+                &cover.size,
+                &cover.width,
+                &cover.height,
+                &offset
+            ) == 5 &&
+            line[offset] == ' '
+        )
+        {
+            ID3v2_Cover* added = CoverFile_add_picture(file);
+            cover.file_name = file->file_name;
+            cover.mime_type = strdup(line + offset + 1);
+            *added = cover;
+        }
+        else
+        {
+            valid = false;
+        }
+    }
+
+    free(line);
+    fclose(fp);
+
+    if (!valid)
+    {
+        for (int i = 0; i < store->file_count; i++) CoverFile_free(&store->files[i]);
+        store->file_count = 0;
+    }
+
+    qsort(store->files, store->file_count, sizeof(CoverFile), compare_files);
+}
+
+static int sync_directory(const char* directory)
+{
+    const int fd = open(directory, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return -1;
+
+    const int result = fsync(fd);
+    close(fd);
+
+    return result;
+}
+
+/**
+ * Writes the mapping to a temporary file and renames it over the previous
+ * one, so readers see either of them whole. Returns 0 on success and -1
+ * on error.
+ */
+static int CoverStore_save(const ID3v2_CoverStore* store)
+{
+    char* temp_file_name = mapping_file_name(store, ".tmp");
+    char* file_name = mapping_file_name(store, "");
+    FILE* fp = temp_file_name != NULL && file_name != NULL ? fopen(temp_file_name, "w") : NULL;
+    bool written = fp != NULL && fputs(MAPPING_HEADER, fp) >= 0;
+
+    for (int i = 0; written && i < store->file_count; i++)
+    {
+        const CoverFile* file = &store->files[i];
+        if (strchr(file->file_name, '\n') != NULL) continue;
+
+        written = fprintf(fp, "file %016llx %s\n", file->fingerprint, file->file_name) >= 0;
+
+        for (int p = 0; written && p < file->picture_count; p++)
+        {
+            const ID3v2_Cover* cover = &file->pictures[p];
+
+            written = fprintf(
+                          fp,
+                          "picture %d %s %ld %d %d %s\n",
+                          cover->picture_type,
+                          cover->hash,
+                          cover->size,
+                          cover->width,
+                          cover->height,
+                          cover->mime_type
+                      ) >= 0;
+        }
+    }
+
+    if (fp != NULL)
+    {
+        written = written && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+        written = fclose(fp) == 0 && written;
+    }
+
+    written = written && rename(temp_file_name, file_name) == 0;
+    if (fp != NULL && !written) unlink(temp_file_name);
+
+    written = written && sync_directory(store->directory) == 0;
+
+    free(temp_file_name);
+    free(file_name);
+
+    return written ? 0 : -1;
+}
+
+/**
+ * Pictures
+ */
+
+typedef struct _PictureSource
+{
+    // Pictures stored as is are read from fd at offset, decoded ones from
+    // data
+    int fd;
+    long offset;
+    const char* data;
+    long size;
+} PictureSource;
+
+static bool PictureSource_read(
+    const PictureSource* source,
+    const long at,
+    char* dest,
+    const long size
+)
+{
+    if (at < 0 || at + size > source->size) return false;
+
+    if (source->data != NULL)
+    {
+        memcpy(dest, source->data + at, size);
+        return true;
+    }
+
+    return pread(source->fd, dest, size, source->offset + at) == size;
+}
+
+static void read_jpeg_dimensions(const PictureSource* source, ID3v2_Cover* cover)
+{
+    unsigned char marker[5];
+    long at = 2;
+
+    while (PictureSource_read(source, at, (char*) marker, 4))
+    {
+        if (marker[0] != 0xFF) return;
+
+        // Markers can be preceded by any number of fill bytes
+        if (marker[1] == 0xFF)
+        {
+            at++;
+            continue;
+        }
+
+        const int type = marker[1];
+
+        // End of the image, or start of the scan without a frame header
+        if (type == 0xD9 || type == 0xDA) return;
+
+        // Start of frame markers, leaving out DHT, JPG and DAC
+        if (type >= 0xC0 && type <= 0xCF && type != 0xC4 && type != 0xC8 && type != 0xCC)
+        {
+            // precision[1] height[2] width[2]
+            if (PictureSource_read(source, at + 4, (char*) marker, 5))
+            {
+                cover->height = marker[1] << 8 | marker[2];
+                cover->width = marker[3] << 8 | marker[4];
+            }
+
+            return;
+        }
+
+        // Restart markers have no length
+        if (type >= 0xD0 && type <= 0xD7)
+        {
+            at += 2;
+            continue;
+        }
+
+        at += 2 + (marker[2] << 8 | marker[3]);
+    }
+}
+
+static void read_dimensions(const PictureSource* source, ID3v2_Cover* cover)
+{
+    unsigned char header[24];
+    const long size = source->size < (long) sizeof(header) ? source->size : (long) sizeof(header);
+
+    if (!PictureSource_read(source, 0, (char*) header, size)) return;
+
+    if (size >= 24 && memcmp(header, "\x89PNG\r\n\x1a\n", 8) == 0 &&
+        memcmp(header + 12, "IHDR", 4) == 0)
+    {
+        cover->width = btoi((const char*) header + 16, 4);
+        cover->height = btoi((const char*) header + 20, 4);
+    }
+    else if (size >= 10 &&
+             (memcmp(header, "GIF87a", 6) == 0 || memcmp(header, "GIF89a", 6) == 0))
+    {
+        cover->width = header[6] | header[7] << 8;
+        cover->height = header[8] | header[9] << 8;
+    }
+    else if (size >= 4 && header[0] == 0xFF && header[1] == 0xD8)
+    {
+        read_jpeg_dimensions(source, cover);
+    }
+}
+
+static bool hash_picture(const PictureSource* source, char* buffer, char* hash)
+{
+    Sha256 sha;
+    Sha256_init(&sha);
+
+    if (source->data != NULL)
+    {
+        Sha256_update(&sha, source->data, source->size);
+    }
+    else
+    {
+        for (long at = 0; at < source->size; at += COPY_CHUNK_SIZE)
+        {
+            const long size =
+                source->size - at < COPY_CHUNK_SIZE ? source->size - at : COPY_CHUNK_SIZE;
+            if (!PictureSource_read(source, at, buffer, size)) return false;
+
+            Sha256_update(&sha, buffer, size);
+        }
+    }
+
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    Sha256_final(&sha, digest);
+
+    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++)
+    {
+        sprintf(hash + i * 2, "%02x", digest[i]);
+    }
+
+    return true;
+}
+
+static bool write_all(const int fd, const char* data, long size)
+{
+    while (size > 0)
+    {
+        const ssize_t written = write(fd, data, size);
+        if (written <= 0) return false;
+
+        data += written;
+        size -= written;
+    }
+
+    return true;
+}
+
+static bool copy_picture(const PictureSource* source, const int fd, char* buffer)
+{
+    if (source->data != NULL) return write_all(fd, source->data, source->size);
+
+    loff_t offset = source->offset;
+    long remaining = source->size;
+
+    // The kernel moves the bytes without copying them to user space, or
+    // shares them on filesystems that support reflinks
+    while (remaining > 0)
+    {
+        const ssize_t copied = copy_file_range(source->fd, &offset, fd, NULL, remaining, 0);
+        if (copied <= 0) break;
+
+        remaining -= copied;
+    }
+
+    // Across filesystems (or kernels) copy_file_range can't handle
+    while (remaining > 0)
+    {
+        const long size = remaining < COPY_CHUNK_SIZE ? remaining : COPY_CHUNK_SIZE;
+
+        if (pread(source->fd, buffer, size, offset) != size || !write_all(fd, buffer, size))
+        {
+            return false;
+        }
+
+        offset += size;
+        remaining -= size;
+    }
+
+    return true;
+}
+
+/**
+ * Stores the picture as xx/hash, going through a temporary file so the
+ * store never holds partial pictures. Returns 1 if it was stored, 0 if the
+ * store already held it and -1 on error.
+ */
+static int store_picture(
+    const char* directory,
+    const PictureSource* source,
+    const char* hash,
+    char* buffer
+)
+{
+    char* subdirectory = NULL;
+    char* file_name = NULL;
+    char* temp_file_name = NULL;
+    int result = -1;
+
+    if (asprintf(&subdirectory, "%s/%.2s", directory, hash) < 0) return -1;
+
+    if (asprintf(&file_name, "%s/%s", subdirectory, hash) < 0 ||
+        asprintf(&temp_file_name, "%s/.%s.XXXXXX", subdirectory, hash) < 0)
+    {
+        free(subdirectory);
+        free(file_name);
+        return -1;
+    }
+
+    if (access(file_name, F_OK) == 0)
+    {
+        result = 0;
+    }
+    else if (mkdir(subdirectory, 0755) == 0 || errno == EEXIST)
+    {
+        const int fd = mkstemp(temp_file_name);
+
+        if (fd >= 0)
+        {
+            const bool written = fchmod(fd, 0644) == 0 && copy_picture(source, fd, buffer) &&
+                                 fsync(fd) == 0;
+
+            // Other threads or processes may have stored it in the meantime
+            if (close(fd) == 0 && written)
+            {
+                if (link(temp_file_name, file_name) == 0) result = 1;
+                else if (errno == EEXIST) result = 0;
+            }
+
+            unlink(temp_file_name);
+        }
+    }
+
+    free(subdirectory);
+    free(file_name);
+    free(temp_file_name);
+
+    return result;
+}
+
+/**
+ * Extraction
+ */
+
+#define COVER_FILE_UNREADABLE 0
+#define COVER_FILE_UNCHANGED 1
+#define COVER_FILE_EXTRACTED 2
+
+typedef struct _CoverJob
+{
+    const ID3v2_CoverStore* store;
+    const char* const* file_names;
+    int count;
+    int next_file;
+    // By file
+    CoverFile* results;
+    int* states;
+    ID3v2_CoverStats stats;
+} CoverJob;
+
+static char* copy_mime_type(const char* mime_type, const int length)
+{
+    char* copy = strndup(mime_type, length);
+
+    // The mapping has a line per picture
+    for (int i = 0; copy[i] != '\0'; i++)
+    {
+        if ((unsigned char) copy[i] < ' ') copy[i] = '_';
+    }
+
+    return copy;
+}
+
+/**
+ * Pictures that couldn't be stored leave their file to be extracted again
+ * by the next run, even if it doesn't change.
+ */
+static void CoverJob_fail_picture(CoverJob* job, CoverFile* file)
+{
+    __atomic_add_fetch(&job->stats.failed, 1, __ATOMIC_RELAXED);
+    file->fingerprint = RETRY_FINGERPRINT;
+}
+
+static void CoverJob_add_picture(
+    CoverJob* job,
+    CoverFile* file,
+    const PictureSource* source,
+    const int picture_type,
+    char* mime_type,
+    char* buffer
+)
+{
+    char hash[ID3v2_COVER_HASH_LENGTH + 1];
+    __atomic_add_fetch(&job->stats.pictures, 1, __ATOMIC_RELAXED);
+
+    const int stored = hash_picture(source, buffer, hash)
+                           ? store_picture(job->store->directory, source, hash, buffer)
+                           : -1;
+
+    if (stored < 0)
+    {
+        CoverJob_fail_picture(job, file);
+        free(mime_type);
+        return;
+    }
+
+    if (stored > 0) __atomic_add_fetch(&job->stats.stored_pictures, 1, __ATOMIC_RELAXED);
+
+    ID3v2_Cover* cover = CoverFile_add_picture(file);
+    cover->picture_type = picture_type;
+    memcpy(cover->hash, hash, sizeof(hash));
+    cover->mime_type = mime_type;
+    cover->size = source->size;
+    read_dimensions(source, cover);
+}
+
+/**
+ * Reads the mime type and the picture type of an APIC frame. Returns where
+ * the picture starts, or -1 if it doesn't start within size bytes.
+ */
+static int parse_apic_header(
+    const char* data,
+    const int size,
+    int* picture_type,
+    char** mime_type
+)
+{
+    const char* mime_end = size > 1 ? (const char*) memchr(data + 1, '\0', size - 1) : NULL;
+    if (mime_end == NULL || mime_end + 1 >= data + size) return -1;
+
+    int cursor = mime_end - data + 2;
+    int picture_start = -1;
+
+    // The description ends with a null character as wide as its encoding
+    if (data[0] == ID3v2_ENCODING_UNICODE || data[0] == ID3v2_ENCODING_UTF16BE)
+    {
+        for (; picture_start < 0 && cursor + 1 < size; cursor += 2)
+        {
+            if (data[cursor] == '\0' && data[cursor + 1] == '\0') picture_start = cursor + 2;
+        }
+    }
+    else
+    {
+        for (; picture_start < 0 && cursor < size; cursor++)
+        {
+            if (data[cursor] == '\0') picture_start = cursor + 1;
+        }
+    }
+
+    if (picture_start >= 0)
+    {
+        *picture_type = (unsigned char) mime_end[1];
+        *mime_type = copy_mime_type(data + 1, mime_end - data - 1);
+    }
+
+    return picture_start;
+}
+
+static void extract_picture(
+    CoverJob* job,
+    CoverFile* file,
+    const FrameWalker* walker,
+    const FrameLocation* frame,
+    char* buffer
+)
+{
+    const unsigned char flags = frame->flags[1];
+    long offset = frame->offset + ID3v2_FRAME_HEADER_LENGTH;
+    int size = frame->size;
+    bool unsynchronised = false;
+
+    // Compressed and encrypted frames are kept as found by the library too
+    if (walker->major_version == 4)
+    {
+        if (flags & (V24_FRAME_COMPRESSION_FLAG | V24_FRAME_ENCRYPTION_FLAG)) return;
+
+        if (flags & V24_FRAME_GROUPING_FLAG)
+        {
+            offset++;
+            size--;
+        }
+
+        if (flags & V24_FRAME_DATA_LENGTH_FLAG)
+        {
+            offset += FRAME_DATA_LENGTH_SIZE;
+            size -= FRAME_DATA_LENGTH_SIZE;
+        }
+
+        unsynchronised = flags & V24_FRAME_UNSYNCHRONISATION_FLAG;
+    }
+    else
+    {
+        if (flags & (V23_FRAME_COMPRESSION_FLAG | V23_FRAME_ENCRYPTION_FLAG)) return;
+
+        if (flags & V23_FRAME_GROUPING_FLAG)
+        {
+            offset++;
+            size--;
+        }
+    }
+
+    if (size <= 0) return;
+
+    char* decoded = NULL;
+
+    if (unsynchronised)
+    {
+        char* raw = (char*) malloc(size);
+        decoded = (char*) malloc(size);
+
+        if (pread(walker->fd, raw, size, offset) == size)
+        {
+            size = unsync_decode(raw, size, decoded);
+        }
+        else
+        {
+            free(decoded);
+            decoded = NULL;
+        }
+
+        free(raw);
+
+        if (decoded == NULL)
+        {
+            CoverJob_fail_picture(job, file);
+            return;
+        }
+    }
+
+    char header[APIC_HEADER_READ_SIZE];
+    const int header_size = size < APIC_HEADER_READ_SIZE ? size : APIC_HEADER_READ_SIZE;
+    const PictureSource frame_source = {walker->fd, offset, decoded, size};
+    int picture_type = 0;
+    char* mime_type = NULL;
+    const int picture_start =
+        PictureSource_read(&frame_source, 0, header, header_size)
+            ? parse_apic_header(header, header_size, &picture_type, &mime_type)
+            : -1;
+
+    if (picture_start < 0)
+    {
+        CoverJob_fail_picture(job, file);
+    }
+    else
+    {
+        const PictureSource source = {
+            walker->fd,
+            offset + picture_start,
+            decoded != NULL ? decoded + picture_start : NULL,
+            size - picture_start,
+        };
+
+        CoverJob_add_picture(job, file, &source, picture_type, mime_type, buffer);
+    }
+
+    free(decoded);
+}
+
+/**
+ * Tags whose frame headers can't be walked in the file are read whole.
+ */
+static void extract_decoded_pictures(CoverJob* job, CoverFile* file, char* buffer)
+{
+    // Pictures may be left out of cached tags
+    ID3v2_Tag* tag = Tag_read_from_file(file->file_name);
+    if (tag == NULL) return;
+
+    ID3v2_FrameList* frames = ID3v2_Tag_get_apic_frames(tag);
+
+    for (ID3v2_FrameList* node = frames; node != NULL && node->frame != NULL; node = node->next)
+    {
+        const ID3v2_ApicFrameData* data = ((ID3v2_ApicFrame*) node->frame)->data;
+        const PictureSource source = {-1, 0, data->data, data->picture_size};
+
+        CoverJob_add_picture(
+            job,
+            file,
+            &source,
+            (unsigned char) data->picture_type,
+            copy_mime_type(data->mime_type, strlen(data->mime_type)),
+            buffer
+        );
+    }
+
+    ID3v2_FrameList_unlink(frames);
+    ID3v2_Tag_free(tag);
+}
+
+static unsigned long long fingerprint_add(
+    const unsigned long long fingerprint,
+    const unsigned long long value
+)
+{
+    char bytes[8];
+    ulltob(value, bytes, 8);
+
+    return fnv1a_64(bytes, 8, fingerprint);
+}
+
+static void extract_file(CoverJob* job, const int index, char* buffer)
+{
+    const char* file_name = job->file_names[index];
+    const int fd = open(file_name, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    TagLocation location;
+
+    if (fd < 0 || fstat(fd, &st) != 0 || !Container_locate_tag(fd, &location))
+    {
+        if (fd >= 0) close(fd);
+
+        job->states[index] = COVER_FILE_UNREADABLE;
+        __atomic_add_fetch(&job->stats.failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    // Any write changes the mtime, the frame headers tell rewrites apart
+    // from other changes made within the same tick
+    unsigned long long fingerprint = FNV1A_64_OFFSET_BASIS;
+    fingerprint = fingerprint_add(fingerprint, st.st_size);
+    fingerprint = fingerprint_add(fingerprint, st.st_mtim.tv_sec);
+    fingerprint = fingerprint_add(fingerprint, st.st_mtim.tv_nsec);
+    fingerprint = fingerprint_add(fingerprint, st.st_ino);
+    fingerprint = fingerprint_add(fingerprint, location.tag_offset);
+
+    FrameWalker walker;
+    FrameLocation* pictures = NULL;
+    int picture_count = 0;
+    bool decode = false;
+
+    if (location.tag_offset >= 0 && FrameWalker_open(&walker, fd, location.tag_offset))
+    {
+        FrameLocation frame;
+
+        // Unsynchronisation can hide the frame headers of the whole tag
+        decode = walker.flags & TAG_HEADER_UNSYNCHRONISATION_FLAG;
+
+        while (FrameWalker_next(&walker, &frame))
+        {
+            fingerprint = fnv1a_64(frame.id, ID3v2_FRAME_HEADER_ID_LENGTH, fingerprint);
+            fingerprint = fnv1a_64(frame.flags, ID3v2_FRAME_HEADER_FLAGS_LENGTH, fingerprint);
+            fingerprint = fingerprint_add(fingerprint, frame.size);
+            fingerprint = fingerprint_add(fingerprint, frame.offset);
+
+            if (memcmp(frame.id, ID3v2_ALBUM_COVER_FRAME_ID, ID3v2_FRAME_HEADER_ID_LENGTH) == 0)
+            {
+                pictures = (FrameLocation*) realloc(
+                    pictures,
+                    (picture_count + 1) * sizeof(FrameLocation)
+                );
+                pictures[picture_count++] = frame;
+            }
+        }
+    }
+    else if (location.tag_offset >= 0)
+    {
+        // Versions the walker doesn't read
+        decode = true;
+    }
+
+    const CoverFile* previous =
+        CoverStore_find(job->store, file_name, job->store->file_count);
+
+    if (previous != NULL && previous->fingerprint == fingerprint)
+    {
+        job->states[index] = COVER_FILE_UNCHANGED;
+        __atomic_add_fetch(&job->stats.unchanged_files, 1, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        CoverFile* file = &job->results[index];
+        file->file_name = strdup(file_name);
+        file->fingerprint = fingerprint;
+        job->states[index] = COVER_FILE_EXTRACTED;
+
+        if (decode)
+        {
+            extract_decoded_pictures(job, file, buffer);
+        }
+        else
+        {
+            for (int i = 0; i < picture_count; i++)
+            {
+                extract_picture(job, file, &walker, &pictures[i], buffer);
+            }
+        }
+    }
+
+    free(pictures);
+    close(fd);
+}
+
+static void* extract_files(void* arg)
+{
+    CoverJob* job = (CoverJob*) arg;
+    char* buffer = (char*) malloc(COPY_CHUNK_SIZE);
+    int index;
+
+    while ((index = __atomic_fetch_add(&job->next_file, 1, __ATOMIC_RELAXED)) < job->count)
+    {
+        extract_file(job, index, buffer);
+    }
+
+    free(buffer);
+
+    return NULL;
+}
+
+/**
+ * Files are only added to the store once every thread is done, threads
+ * only ever read it.
+ */
+static void CoverStore_merge(ID3v2_CoverStore* store, CoverJob* job)
+{
+    const int previous_count = store->file_count;
+
+    for (int i = 0; i < job->count; i++)
+    {
+        if (job->states[i] == COVER_FILE_UNCHANGED) continue;
+
+        CoverFile* previous = CoverStore_find(store, job->file_names[i], previous_count);
+        const bool extracted = job->states[i] == COVER_FILE_EXTRACTED;
+
+        if (previous != NULL)
+        {
+            // Keeps its name until the end, it's still looked up
+            CoverFile_free(previous);
+            *previous = extracted ? job->results[i]
+                                  : (CoverFile){strdup(job->file_names[i]), 0, true, 0, NULL};
+        }
+        else if (extracted)
+        {
+            *CoverStore_append(store) = job->results[i];
+        }
+    }
+
+    qsort(store->files, store->file_count, sizeof(CoverFile), compare_files);
+
+    // Drops removed files, and files listed twice in the same run
+    int kept = 0;
+
+    for (int i = 0; i < store->file_count; i++)
+    {
+        CoverFile* file = &store->files[i];
+
+        if (file->removed || (kept > 0 && compare_files(&store->files[kept - 1], file) == 0))
+        {
+            CoverFile_free(file);
+        }
+        else
+        {
+            store->files[kept++] = *file;
+        }
+    }
+
+    store->file_count = kept;
+}
+
+ID3v2_CoverStore* ID3v2_CoverStore_open(const char* directory)
+{
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) return NULL;
+
+    ID3v2_CoverStore* store = (ID3v2_CoverStore*) calloc(1, sizeof(ID3v2_CoverStore));
+    store->directory = strdup(directory);
+    CoverStore_load(store);
+
+    return store;
+}
+
+void ID3v2_CoverStore_close(ID3v2_CoverStore* store)
+{
+    if (store == NULL) return;
+
+    for (int i = 0; i < store->file_count; i++)
+    {
+        CoverFile_free(&store->files[i]);
+    }
+
+    free(store->files);
+    free(store->directory);
+    free(store);
+}
+
+int ID3v2_CoverStore_extract(
+    ID3v2_CoverStore* store,
+    const char* const* file_names,
+    const int count,
+    const int threads,
+    ID3v2_CoverStats* stats
+)
+{
+    CoverJob job = {store, file_names, count, 0};
+    job.results = (CoverFile*) calloc(count + 1, sizeof(CoverFile));
+    job.states = (int*) calloc(count + 1, sizeof(int));
+
+    int workers = threads > 0 ? threads : sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers > count) workers = count;
+    if (workers < 1) workers = 1;
+
+    pthread_t* started_workers = (pthread_t*) malloc(workers * sizeof(pthread_t));
+    int started = 0;
+
+    // The calling thread extracts too, so files are extracted even if no
+    // thread can be started
+    for (int i = 1; i < workers; i++)
+    {
+        if (pthread_create(&started_workers[started], NULL, extract_files, &job) == 0) started++;
+    }
+
+    extract_files(&job);
+
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(started_workers[i], NULL);
+    }
+
+    CoverStore_merge(store, &job);
+
+    if (stats != NULL) *stats = job.stats;
+
+    free(started_workers);
+    free(job.results);
+    free(job.states);
+
+    return CoverStore_save(store);
+}
+
+int ID3v2_CoverStore_for_each(
+    const ID3v2_CoverStore* store,
+    ID3v2_CoverCallback callback,
+    void* callback_ctx
+)
+{
+    for (int i = 0; i < store->file_count; i++)
+    {
+        for (int p = 0; p < store->files[i].picture_count; p++)
+        {
+            if (!callback(&store->files[i].pictures[p], callback_ctx))
+            {
+                return ID3v2_OPERATION_CANCELLED;
+            }
+        }
+    }
+
+    return 0;
+}
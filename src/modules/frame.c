@@ -16,6 +16,8 @@
 #include "modules/frame_ids.h"
 #include "modules/frames/apic_frame.private.h"
 #include "modules/frames/comment_frame.private.h"
+#include "modules/frames/pcnt_frame.private.h"
+#include "modules/frames/popm_frame.private.h"
 #include "modules/frames/text_frame.private.h"
 #include "modules/utils.private.h"
 
@@ -46,6 +48,18 @@ ID3v2_Frame* Frame_parse(CharStream* frame_cs, int id3_major_version)
         FrameHeader_free(header);
         return (ID3v2_Frame*) ApicFrame_parse(frame_cs, id3_major_version);
     }
+    else if (FrameHeader_isPopmFrame(header))
+    {
+        CharStream_seek(frame_cs, -ID3v2_FRAME_HEADER_LENGTH, SEEK_CUR);
+        FrameHeader_free(header);
+        return (ID3v2_Frame*) PopmFrame_parse(frame_cs, id3_major_version);
+    }
+    else if (FrameHeader_isPcntFrame(header))
+    {
+        CharStream_seek(frame_cs, -ID3v2_FRAME_HEADER_LENGTH, SEEK_CUR);
+        FrameHeader_free(header);
+        return (ID3v2_Frame*) PcntFrame_parse(frame_cs, id3_major_version);
+    }
 
     // Unknown frame type, simply copy the raw data into the data property
     ID3v2_Frame* frame = (ID3v2_Frame*) malloc(sizeof(ID3v2_Frame));
@@ -72,6 +86,14 @@ CharStream* Frame_to_char_stream(ID3v2_Frame* frame)
     {
         return ApicFrame_to_char_stream((ID3v2_ApicFrame*) frame);
     }
+    else if (FrameHeader_isPopmFrame(frame->header))
+    {
+        return PopmFrame_to_char_stream((ID3v2_PopmFrame*) frame);
+    }
+    else if (FrameHeader_isPcntFrame(frame->header))
+    {
+        return PcntFrame_to_char_stream((ID3v2_PcntFrame*) frame);
+    }
     else
     {
         // Unknown frame type, dump whatever we have in memory for that frame
@@ -99,6 +121,14 @@ void ID3v2_Frame_free(ID3v2_Frame* frame)
     {
         ApicFrame_free((ID3v2_ApicFrame*) frame);
     }
+    else if (FrameHeader_isPopmFrame(frame->header))
+    {
+        PopmFrame_free((ID3v2_PopmFrame*) frame);
+    }
+    else if (FrameHeader_isPcntFrame(frame->header))
+    {
+        PcntFrame_free((ID3v2_PcntFrame*) frame);
+    }
     else
     {
         // Unknown frame id, naively try our best to free it
@@ -0,0 +1,270 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef ID3V2_WITH_ZLIB
+    #include <zlib.h>
+#endif
+
+#include "modules/char_stream.private.h"
+#include "modules/frame.private.h"
+#include "modules/frame_header.h"
+#include "modules/utils.private.h"
+
+#include "frame_decoder.private.h"
+
+// Smaller tags are decoded faster than threads are started
+#define PARALLEL_DECODE_MIN_BYTES (1024 * 1024)
+#define MAX_DECODE_THREADS 8
+
+// Second byte of the v2.4 frame flags
+#define FRAME_GROUPING_FLAG (1 << 6)
+#define FRAME_COMPRESSION_FLAG (1 << 3)
+#define FRAME_ENCRYPTION_FLAG (1 << 2)
+#define FRAME_UNSYNCHRONISATION_FLAG (1 << 1)
+#define FRAME_DATA_LENGTH_FLAG (1 << 0)
+
+#define FRAME_DATA_LENGTH_SIZE 4
+
+// Compressed frames can only be inflated when built with zlib
+#ifdef ID3V2_WITH_ZLIB
+    #define FRAME_INFLATE_SUPPORTED true
+#else
+    #define FRAME_INFLATE_SUPPORTED false
+#endif
+
+// zlib never inflates a byte into more than this many
+#define ZLIB_MAX_RATIO 1032
+
+typedef struct _DecodeJob
+{
+    const char* tag;
+    const FrameSpan* spans;
+    int count;
+    int id3_major_version;
+    bool unsynchronised;
+    ID3v2_Frame** frames;
+    int next_frame;
+} DecodeJob;
+
+int FrameDecoder_locate(
+    CharStream* tag_cs,
+    const int tag_end,
+    const int id3_major_version,
+    FrameSpan** spans
+)
+{
+    int count = 0;
+    int capacity = 64;
+    *spans = (FrameSpan*) malloc(capacity * sizeof(FrameSpan));
+
+    while (tag_cs->cursor < tag_end &&
+           tag_cs->size - tag_cs->cursor >= ID3v2_FRAME_HEADER_LENGTH)
+    {
+        const char* header = CharStream_get_cur(tag_cs);
+
+        // Padding reached
+        if (memcmp(header, "\0\0\0\0", ID3v2_FRAME_HEADER_ID_LENGTH) == 0) break;
+
+        int size = btoi(header + ID3v2_FRAME_HEADER_ID_LENGTH, ID3v2_FRAME_HEADER_SIZE_LENGTH);
+        if (id3_major_version == 4) size = syncint_decode(size);
+        if (size < 0) break;
+
+        if (count == capacity)
+        {
+            capacity *= 2;
+            *spans = (FrameSpan*) realloc(*spans, capacity * sizeof(FrameSpan));
+        }
+
+        // Frames running past the tag keep whatever is left of them
+        const int remaining = tag_cs->size - tag_cs->cursor;
+        int frame_size = ID3v2_FRAME_HEADER_LENGTH + size;
+        if (size > remaining - ID3v2_FRAME_HEADER_LENGTH) frame_size = remaining;
+
+        (*spans)[count].offset = tag_cs->cursor;
+        (*spans)[count].size = frame_size;
+        count++;
+
+        CharStream_seek(tag_cs, frame_size, SEEK_CUR);
+    }
+
+    return count;
+}
+
+/**
+ * Replaces the compressed body that follows the header of frame with the
+ * data_length bytes it inflates to. Returns data_length, or -1 if the body
+ * doesn't inflate to exactly that many bytes.
+ */
+static int inflate_frame(char** frame, const int body_size, const int data_length)
+{
+#ifdef ID3V2_WITH_ZLIB
+    if (data_length < 0 || data_length / ZLIB_MAX_RATIO > body_size) return -1;
+
+    char* inflated = (char*) malloc(ID3v2_FRAME_HEADER_LENGTH + data_length);
+    memcpy(inflated, *frame, ID3v2_FRAME_HEADER_LENGTH);
+
+    uLongf inflated_size = data_length;
+    const int result = uncompress(
+        (Bytef*) inflated + ID3v2_FRAME_HEADER_LENGTH,
+        &inflated_size,
+        (const Bytef*) *frame + ID3v2_FRAME_HEADER_LENGTH,
+        body_size
+    );
+
+    if (result != Z_OK || inflated_size != (uLongf) data_length)
+    {
+        free(inflated);
+        return -1;
+    }
+
+    free(*frame);
+    *frame = inflated;
+
+    return data_length;
+#else
+    return -1;
+#endif
+}
+
+static void decode_frame(DecodeJob* job, const int index)
+{
+    const char* frame = job->tag + job->spans[index].offset;
+    int size = job->spans[index].size;
+    char* decoded = NULL;
+
+    if (job->id3_major_version == 4)
+    {
+        const char flags = frame[ID3v2_FRAME_HEADER_LENGTH - 1];
+        const bool unsynchronised = job->unsynchronised || (flags & FRAME_UNSYNCHRONISATION_FLAG);
+        const bool has_data_length = flags & FRAME_DATA_LENGTH_FLAG;
+        const bool compressed = flags & FRAME_COMPRESSION_FLAG;
+        const int skipped = has_data_length ? FRAME_DATA_LENGTH_SIZE : 0;
+
+        // Encrypted bodies, and compressed ones that can't be inflated, are kept as they are.
+        // Compressed bodies are always preceded by their inflated size.
+        if ((unsynchronised || has_data_length) &&
+            !(flags & (FRAME_GROUPING_FLAG | FRAME_ENCRYPTION_FLAG)) &&
+            (!compressed || (FRAME_INFLATE_SUPPORTED && has_data_length)) &&
+            size >= ID3v2_FRAME_HEADER_LENGTH + skipped)
+        {
+            const char* body = frame + ID3v2_FRAME_HEADER_LENGTH + skipped;
+            const int body_size = size - ID3v2_FRAME_HEADER_LENGTH - skipped;
+
+            decoded = (char*) malloc(ID3v2_FRAME_HEADER_LENGTH + body_size);
+            memcpy(decoded, frame, ID3v2_FRAME_HEADER_LENGTH);
+
+            int decoded_size = body_size;
+            if (unsynchronised)
+            {
+                decoded_size = unsync_decode(body, body_size, decoded + ID3v2_FRAME_HEADER_LENGTH);
+            }
+            else
+            {
+                memcpy(decoded + ID3v2_FRAME_HEADER_LENGTH, body, body_size);
+            }
+
+            // Unsynchronisation is applied after compression, so it's undone first
+            if (compressed)
+            {
+                const int data_length = syncint_decode(
+                    btoi(frame + ID3v2_FRAME_HEADER_LENGTH, FRAME_DATA_LENGTH_SIZE)
+                );
+                decoded_size = inflate_frame(&decoded, decoded_size, data_length);
+            }
+
+            if (decoded_size < 0)
+            {
+                free(decoded);
+                decoded = NULL;
+            }
+            else
+            {
+                char* size_bytes = itob(syncint_encode(decoded_size));
+                memcpy(
+                    decoded + ID3v2_FRAME_HEADER_ID_LENGTH,
+                    size_bytes,
+                    ID3v2_FRAME_HEADER_SIZE_LENGTH
+                );
+                free(size_bytes);
+                decoded[ID3v2_FRAME_HEADER_LENGTH - 1] &=
+                    ~(FRAME_COMPRESSION_FLAG | FRAME_UNSYNCHRONISATION_FLAG |
+                      FRAME_DATA_LENGTH_FLAG);
+
+                frame = decoded;
+                size = ID3v2_FRAME_HEADER_LENGTH + decoded_size;
+            }
+        }
+    }
+
+    // Frames only read from the stream, so a view over the tag is enough
+    CharStream frame_cs = {0, size, (char*) frame};
+    job->frames[index] = Frame_parse(&frame_cs, job->id3_major_version);
+
+    free(decoded);
+}
+
+static void* decode_frames(void* arg)
+{
+    DecodeJob* job = (DecodeJob*) arg;
+    int index;
+
+    while ((index = __atomic_fetch_add(&job->next_frame, 1, __ATOMIC_RELAXED)) < job->count)
+    {
+        decode_frame(job, index);
+    }
+
+    return NULL;
+}
+
+void FrameDecoder_decode(
+    CharStream* tag_cs,
+    const FrameSpan* spans,
+    const int count,
+    const int id3_major_version,
+    const bool unsynchronised,
+    ID3v2_Frame** frames
+)
+{
+    DecodeJob job = {tag_cs->stream, spans, count, id3_major_version, unsynchronised, frames, 0};
+
+    long bytes = 0;
+    for (int i = 0; i < count; i++) bytes += spans[i].size;
+
+    int threads = 1;
+    if (bytes >= PARALLEL_DECODE_MIN_BYTES)
+    {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+        if (threads > MAX_DECODE_THREADS) threads = MAX_DECODE_THREADS;
+        if (threads > count) threads = count;
+    }
+
+    pthread_t workers[MAX_DECODE_THREADS];
+    int started = 0;
+
+    // The calling thread decodes too, so frames are decoded even if no
+    // thread can be started
+    for (int i = 1; i < threads; i++)
+    {
+        if (pthread_create(&workers[started], NULL, decode_frames, &job) == 0) started++;
+    }
+
+    decode_frames(&job);
+
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+}
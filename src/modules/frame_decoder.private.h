@@ -0,0 +1,53 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_frame_decoder_private_h
+#define id3v2lib_frame_decoder_private_h
+
+#include <stdbool.h>
+
+#include "modules/frame.h"
+
+typedef struct _CharStream CharStream;
+
+typedef struct _FrameSpan
+{
+    int offset; // Where the frame header starts in the tag
+    int size;   // Header included
+} FrameSpan;
+
+/**
+ * First phase of the parse: walks the frame headers from the cursor of
+ * tag_cs up to tag_end without decoding anything. Returns how many frames
+ * were found and leaves the cursor where the frames end.
+ */
+int FrameDecoder_locate(
+    CharStream* tag_cs,
+    const int tag_end,
+    const int id3_major_version,
+    FrameSpan** spans
+);
+
+/**
+ * Second phase: decodes the located frames into frames, in the same order.
+ * Big tags are decoded by several threads. Unsynchronisation and data
+ * length indicators of v2.4 frames are removed on the way, and compressed
+ * frames are inflated when built with zlib. unsynchronised tells that the
+ * tag header marks every frame as unsynchronised.
+ */
+void FrameDecoder_decode(
+    CharStream* tag_cs,
+    const FrameSpan* spans,
+    const int count,
+    const int id3_major_version,
+    const bool unsynchronised,
+    ID3v2_Frame** frames
+);
+
+#endif
@@ -13,6 +13,7 @@
 #include <string.h>
 
 #include "modules/char_stream.private.h"
+#include "modules/frame_ids.h"
 #include "modules/utils.private.h"
 
 #include "frame_header.private.h"
@@ -85,6 +86,16 @@ bool FrameHeader_isApicFrame(ID3v2_FrameHeader* header)
     return header->id[0] == 'A';
 }
 
+bool FrameHeader_isPopmFrame(ID3v2_FrameHeader* header)
+{
+    return memcmp(header->id, ID3v2_POPULARIMETER_FRAME_ID, ID3v2_FRAME_HEADER_ID_LENGTH) == 0;
+}
+
+bool FrameHeader_isPcntFrame(ID3v2_FrameHeader* header)
+{
+    return memcmp(header->id, ID3v2_PLAY_COUNTER_FRAME_ID, ID3v2_FRAME_HEADER_ID_LENGTH) == 0;
+}
+
 void FrameHeader_free(ID3v2_FrameHeader* header)
 {
     free(header);
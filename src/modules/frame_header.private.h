@@ -24,6 +24,8 @@ CharStream* FrameHeader_to_char_stream(ID3v2_FrameHeader* header);
 bool FrameHeader_isTextFrame(ID3v2_FrameHeader* header);
 bool FrameHeader_isCommentFrame(ID3v2_FrameHeader* header);
 bool FrameHeader_isApicFrame(ID3v2_FrameHeader* header);
+bool FrameHeader_isPopmFrame(ID3v2_FrameHeader* header);
+bool FrameHeader_isPcntFrame(ID3v2_FrameHeader* header);
 
 void FrameHeader_free(ID3v2_FrameHeader* header);
 
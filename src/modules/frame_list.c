@@ -113,21 +113,38 @@ void ID3v2_FrameList_unlink(ID3v2_FrameList* list)
     }
 }
 
+/**
+ * The head node is the list itself, so instead of unlinking it, the next
+ * node is moved into it.
+ */
+static void FrameList_remove_node(ID3v2_FrameList* previous, ID3v2_FrameList* node)
+{
+    if (previous != NULL)
+    {
+        previous->next = node->next;
+        free(node);
+        return;
+    }
+
+    ID3v2_FrameList* next = node->next != NULL ? node->next : FrameList_new();
+    *node = *next;
+    free(next);
+}
+
 ID3v2_Frame* FrameList_remove_frame_by_id(ID3v2_FrameList* list, const char* frame_id)
 {
-    if (list == NULL) return NULL;
+    ID3v2_FrameList* previous = NULL;
 
-    while (list != NULL)
+    while (list != NULL && list->frame != NULL)
     {
         if (strncmp(list->frame->header->id, frame_id, 4) == 0)
         {
             ID3v2_Frame* removed = list->frame;
-            ID3v2_FrameList* new_head_old_ptr = list->next != NULL ? list->next : FrameList_new();
-            *list = *new_head_old_ptr;
-            free(new_head_old_ptr);
+            FrameList_remove_node(previous, list);
             return removed;
         }
 
+        previous = list;
         list = list->next;
     }
 
@@ -136,24 +153,76 @@ ID3v2_Frame* FrameList_remove_frame_by_id(ID3v2_FrameList* list, const char* fra
 
 ID3v2_Frame* FrameList_remove_frame(ID3v2_FrameList* list, ID3v2_Frame* to_remove)
 {
-    if (list == NULL) return NULL;
+    ID3v2_FrameList* previous = NULL;
 
-    while (list != NULL)
+    while (list != NULL && list->frame != NULL)
     {
         if (list->frame == to_remove)
         {
-            ID3v2_FrameList* new_head_old_ptr = list->next != NULL ? list->next : FrameList_new();
-            *list = *new_head_old_ptr;
-            free(new_head_old_ptr);
+            FrameList_remove_node(previous, list);
             return to_remove;
         }
 
+        previous = list;
         list = list->next;
     }
 
     return NULL;
 }
 
+int FrameList_remove_frames_if(
+    ID3v2_FrameList* list,
+    ID3v2_FramePredicate predicate,
+    void* ctx,
+    void (*on_remove)(ID3v2_Frame* frame, void* on_remove_ctx),
+    void* on_remove_ctx
+)
+{
+    ID3v2_FrameList* read = list;
+    ID3v2_FrameList* write = list;
+    ID3v2_FrameList* last_kept = NULL;
+    int removed = 0;
+
+    // Kept frames are moved towards the head so the list is compacted in place
+    while (read != NULL && read->frame != NULL)
+    {
+        ID3v2_Frame* frame = read->frame;
+        read = read->next;
+
+        if (predicate(frame, ctx))
+        {
+            on_remove(frame, on_remove_ctx);
+            removed++;
+            continue;
+        }
+
+        write->frame = frame;
+        last_kept = write;
+        write = write->next;
+    }
+
+    if (removed == 0) return 0;
+
+    ID3v2_FrameList* unused = NULL;
+
+    if (last_kept == NULL)
+    {
+        unused = list->next;
+        list->frame = NULL;
+        list->start = NULL;
+        list->next = NULL;
+    }
+    else
+    {
+        unused = last_kept->next;
+        last_kept->next = NULL;
+    }
+
+    ID3v2_FrameList_unlink(unused);
+
+    return removed;
+}
+
 /**
  * This does not free the replaced frame. That's responsibility
  * of the calling routine.
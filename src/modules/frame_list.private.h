@@ -21,6 +21,19 @@ ID3v2_FrameList* FrameList_get_frames_by_id(ID3v2_FrameList* list, const char* f
 
 ID3v2_Frame* FrameList_remove_frame_by_id(ID3v2_FrameList* list, const char* frame_id);
 ID3v2_Frame* FrameList_remove_frame(ID3v2_FrameList* list, ID3v2_Frame* to_remove);
+
+/**
+ * Removes every frame matching predicate in a single pass, keeping the
+ * order of the remaining ones. on_remove is called with every removed
+ * frame, which isn't freed. Returns how many frames were removed.
+ */
+int FrameList_remove_frames_if(
+    ID3v2_FrameList* list,
+    ID3v2_FramePredicate predicate,
+    void* ctx,
+    void (*on_remove)(ID3v2_Frame* frame, void* on_remove_ctx),
+    void* on_remove_ctx
+);
 void FrameList_replace_frame(ID3v2_FrameList* list, ID3v2_Frame* old_frame, ID3v2_Frame* new_frame);
 
 #endif
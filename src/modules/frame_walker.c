@@ -0,0 +1,114 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "modules/tag_header.h"
+#include "modules/utils.private.h"
+
+#include "frame_walker.private.h"
+
+#define TAG_HEADER_EXTENDED_HEADER_FLAG (1 << 6)
+
+bool FrameWalker_open(FrameWalker* walker, const int fd, const long tag_offset)
+{
+    char header[ID3v2_TAG_HEADER_LENGTH];
+
+    if (pread(fd, header, ID3v2_TAG_HEADER_LENGTH, tag_offset) != ID3v2_TAG_HEADER_LENGTH)
+    {
+        return false;
+    }
+
+    if (memcmp(header, "ID3", ID3v2_TAG_HEADER_IDENTIFIER_LENGTH) != 0) return false;
+    if (header[3] != 3 && header[3] != 4) return false;
+
+    walker->fd = fd;
+    walker->tag_offset = tag_offset;
+    walker->major_version = header[3];
+    walker->flags = (unsigned char) header[5];
+    walker->cursor = tag_offset + ID3v2_TAG_HEADER_LENGTH;
+    walker->end = walker->cursor + syncint_decode(btoi(header + 6, ID3v2_TAG_HEADER_TAG_SIZE_LENGTH));
+
+    if (walker->flags & TAG_HEADER_EXTENDED_HEADER_FLAG)
+    {
+        char raw_size[ID3v2_EXTENDED_HEADER_SIZE_LENGTH];
+
+        if (pread(fd, raw_size, ID3v2_EXTENDED_HEADER_SIZE_LENGTH, walker->cursor) !=
+            ID3v2_EXTENDED_HEADER_SIZE_LENGTH)
+        {
+            return false;
+        }
+
+        // v2.4 sizes are syncsafe and include the size field, v2.3 ones do neither
+        const unsigned int size = btoi(raw_size, ID3v2_EXTENDED_HEADER_SIZE_LENGTH);
+        walker->cursor += walker->major_version == 4 ? syncint_decode(size)
+                                                     : size + ID3v2_EXTENDED_HEADER_SIZE_LENGTH;
+    }
+
+    return walker->cursor <= walker->end;
+}
+
+bool FrameWalker_next(FrameWalker* walker, FrameLocation* location)
+{
+    if (walker->cursor + ID3v2_FRAME_HEADER_LENGTH > walker->end) return false;
+
+    char header[ID3v2_FRAME_HEADER_LENGTH];
+
+    if (pread(walker->fd, header, ID3v2_FRAME_HEADER_LENGTH, walker->cursor) !=
+        ID3v2_FRAME_HEADER_LENGTH)
+    {
+        return false;
+    }
+
+    // A zeroed id means we're inside the padding
+    if (header[0] == '\0') return false;
+
+    unsigned int size = btoi(header + ID3v2_FRAME_HEADER_ID_LENGTH, ID3v2_FRAME_HEADER_SIZE_LENGTH);
+    if (walker->major_version == 4) size = syncint_decode(size);
+
+    if (walker->cursor + ID3v2_FRAME_HEADER_LENGTH + size > walker->end) return false;
+
+    memcpy(location->id, header, ID3v2_FRAME_HEADER_ID_LENGTH);
+    memcpy(
+        location->flags,
+        header + ID3v2_FRAME_HEADER_ID_LENGTH + ID3v2_FRAME_HEADER_SIZE_LENGTH,
+        ID3v2_FRAME_HEADER_FLAGS_LENGTH
+    );
+    location->size = size;
+    location->offset = walker->cursor;
+
+    walker->cursor += ID3v2_FRAME_HEADER_LENGTH + size;
+
+    return true;
+}
+
+long FrameWalker_padding_offset(FrameWalker* walker)
+{
+    FrameLocation location;
+
+    while (FrameWalker_next(walker, &location))
+        ;
+
+    return walker->cursor;
+}
+
+void FrameWalker_encode_size(FrameWalker* walker, const int size, char* dest)
+{
+    const int encoded = walker->major_version == 4 ? syncint_encode(size) : size;
+
+    for (int i = 0; i < ID3v2_FRAME_HEADER_SIZE_LENGTH; i++)
+    {
+        dest[i] = (encoded >> ((ID3v2_FRAME_HEADER_SIZE_LENGTH - 1 - i) * 8)) & 0xFF;
+    }
+}
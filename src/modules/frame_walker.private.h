@@ -0,0 +1,58 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_frame_walker_private_h
+#define id3v2lib_frame_walker_private_h
+
+#include <stdbool.h>
+
+#include "modules/frame_header.h"
+
+typedef struct _FrameLocation
+{
+    char id[ID3v2_FRAME_HEADER_ID_LENGTH];
+    char flags[ID3v2_FRAME_HEADER_FLAGS_LENGTH];
+    int size;
+    long offset; // Where the frame header starts in the file
+} FrameLocation;
+
+/**
+ * Walks the frame headers of a tag stored in a file, reading only the
+ * headers. This lets callers find a frame and read or patch just the bytes
+ * they need, without reading the rest of the tag.
+ */
+typedef struct _FrameWalker
+{
+    int fd;
+    long tag_offset;
+    int major_version;
+    int flags;
+    long cursor; // Where the next frame header is expected
+    long end;    // First byte after the tag, padding included
+} FrameWalker;
+
+bool FrameWalker_open(FrameWalker* walker, const int fd, const long tag_offset);
+
+/**
+ * Reads the next frame header. Returns false once the padding or the end
+ * of the tag is reached, leaving the cursor where the frames end.
+ */
+bool FrameWalker_next(FrameWalker* walker, FrameLocation* location);
+
+/**
+ * Skips the remaining frames and returns where the padding starts.
+ */
+long FrameWalker_padding_offset(FrameWalker* walker);
+
+/**
+ * Encodes a frame size the way the walked tag expects it (syncsafe for v2.4).
+ */
+void FrameWalker_encode_size(FrameWalker* walker, const int size, char* dest);
+
+#endif
@@ -48,7 +48,8 @@ ID3v2_ApicFrame* ApicFrame_parse(CharStream* frame_cs, const int id3_major_versi
 {
     ID3v2_FrameHeader* header = FrameHeader_parse(frame_cs, id3_major_version);
 
-    CharStream_seek(frame_cs, ID3v2_FRAME_ENCODING_LENGTH, SEEK_CUR); // skip encoding
+    // Only UTF-8 is kept, the other encodings are told by their BOM
+    const char encoding = CharStream_getc(frame_cs);
 
     const int mime_type_size = ID3v2_strlent(CharStream_get_cur(frame_cs));
     char* mime_type = malloc(mime_type_size * sizeof(char));
@@ -68,6 +69,8 @@ ID3v2_ApicFrame* ApicFrame_parse(CharStream* frame_cs, const int id3_major_versi
     ID3v2_ApicFrame* frame =
         ApicFrame_new(header->flags, description, picture_type, mime_type, pic_size, pic_data);
 
+    if (encoding == ID3v2_ENCODING_UTF8) frame->data->encoding = encoding;
+
     FrameHeader_free(header); // we only needed the header to parse the data
 
     free(mime_type);
@@ -43,7 +43,8 @@ ID3v2_CommentFrame* CommentFrame_parse(CharStream* frame_cs, const int id3_major
 {
     ID3v2_FrameHeader* header = FrameHeader_parse(frame_cs, id3_major_version);
 
-    CharStream_seek(frame_cs, ID3v2_FRAME_ENCODING_LENGTH, SEEK_CUR); // skip encoding
+    // Only UTF-8 is kept, the other encodings are told by their BOM
+    const char encoding = CharStream_getc(frame_cs);
 
     char lang[ID3v2_COMMENT_FRAME_LANGUAGE_LENGTH];
     CharStream_read(frame_cs, lang, ID3v2_COMMENT_FRAME_LANGUAGE_LENGTH);
@@ -58,6 +59,8 @@ ID3v2_CommentFrame* CommentFrame_parse(CharStream* frame_cs, const int id3_major
 
     ID3v2_CommentFrame* frame = CommentFrame_new(header->flags, lang, short_desc, comment);
 
+    if (encoding == ID3v2_ENCODING_UTF8) frame->data->encoding = encoding;
+
     FrameHeader_free(header); // we only needed the header to parse the data
 
     free(comment);
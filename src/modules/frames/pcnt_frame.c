@@ -0,0 +1,73 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "modules/char_stream.private.h"
+#include "modules/frame.private.h"
+#include "modules/frame_header.private.h"
+#include "modules/frame_ids.h"
+#include "modules/utils.private.h"
+
+#include "pcnt_frame.private.h"
+
+ID3v2_PcntFrame* PcntFrame_new(const char* flags, const unsigned long long counter)
+{
+    ID3v2_PcntFrame* frame = (ID3v2_PcntFrame*) malloc(sizeof(ID3v2_PcntFrame));
+
+    frame->data = (ID3v2_PcntFrameData*) malloc(sizeof(ID3v2_PcntFrameData));
+    frame->data->counter = counter;
+
+    frame->header = FrameHeader_new(ID3v2_PLAY_COUNTER_FRAME_ID, flags, counter_size(counter));
+
+    return frame;
+}
+
+ID3v2_PcntFrame* PcntFrame_parse(CharStream* frame_cs, const int id3_major_version)
+{
+    ID3v2_FrameHeader* header = FrameHeader_parse(frame_cs, id3_major_version);
+
+    char* counter = (char*) malloc(header->size * sizeof(char));
+    const int counter_length = CharStream_read(frame_cs, counter, header->size);
+
+    ID3v2_PcntFrame* frame = PcntFrame_new(header->flags, btoull(counter, counter_length));
+
+    FrameHeader_free(header); // we only needed the header to parse the data
+
+    free(counter);
+    return frame;
+}
+
+CharStream* PcntFrame_to_char_stream(ID3v2_PcntFrame* frame)
+{
+    if (frame == NULL) return NULL;
+
+    CharStream* frame_header_cs = FrameHeader_to_char_stream(frame->header);
+    CharStream* frame_cs = CharStream_new(frame->header->size + ID3v2_FRAME_HEADER_LENGTH);
+
+    // Header
+    CharStream_write(frame_cs, frame_header_cs->stream, frame_header_cs->size);
+    CharStream_free(frame_header_cs);
+
+    // Data
+    char counter[8];
+    ulltob(frame->data->counter, counter, frame->header->size);
+    CharStream_write(frame_cs, counter, frame->header->size);
+
+    return frame_cs;
+}
+
+void PcntFrame_free(ID3v2_PcntFrame* frame)
+{
+    FrameHeader_free(frame->header);
+    free(frame->data);
+    free(frame);
+}
@@ -0,0 +1,23 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_pcnt_frame_private_h
+#define id3v2lib_pcnt_frame_private_h
+
+#include "modules/frames/pcnt_frame.h"
+
+typedef struct _CharStream CharStream;
+
+ID3v2_PcntFrame* PcntFrame_new(const char* flags, const unsigned long long counter);
+ID3v2_PcntFrame* PcntFrame_parse(CharStream* frame_cs, const int id3_major_version);
+CharStream* PcntFrame_to_char_stream(ID3v2_PcntFrame* frame);
+
+void PcntFrame_free(ID3v2_PcntFrame* frame);
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "modules/char_stream.private.h"
+#include "modules/frame.private.h"
+#include "modules/frame_header.private.h"
+#include "modules/frame_ids.h"
+#include "modules/utils.private.h"
+
+#include "popm_frame.private.h"
+
+ID3v2_PopmFrame* PopmFrame_new(
+    const char* flags,
+    const char* email,
+    const unsigned char rating,
+    const unsigned long long counter
+)
+{
+    ID3v2_PopmFrame* frame = (ID3v2_PopmFrame*) malloc(sizeof(ID3v2_PopmFrame));
+
+    frame->data = PopmFrameData_new(email, rating, counter);
+
+    const int frame_size =
+        strlen(frame->data->email) + 1 + ID3v2_POPM_FRAME_RATING_LENGTH + counter_size(counter);
+    frame->header = FrameHeader_new(ID3v2_POPULARIMETER_FRAME_ID, flags, frame_size);
+
+    return frame;
+}
+
+ID3v2_PopmFrame* PopmFrame_parse(CharStream* frame_cs, const int id3_major_version)
+{
+    ID3v2_FrameHeader* header = FrameHeader_parse(frame_cs, id3_major_version);
+
+    char* body = (char*) malloc(header->size * sizeof(char));
+    const int body_size = CharStream_read(frame_cs, body, header->size);
+
+    // The email is a null terminated string, but don't trust it to be
+    char* email_end = (char*) memchr(body, '\0', body_size);
+    const int email_size = email_end != NULL ? email_end - body + 1 : body_size;
+
+    char* email = (char*) malloc((email_size + 1) * sizeof(char));
+    memcpy(email, body, email_size);
+    email[email_size] = '\0';
+
+    const int rating_offset = email_size;
+    const unsigned char rating = rating_offset < body_size ? body[rating_offset] : 0;
+
+    // The counter is optional and can be omitted altogether
+    const int counter_offset = rating_offset + ID3v2_POPM_FRAME_RATING_LENGTH;
+    const unsigned long long counter =
+        counter_offset < body_size ? btoull(body + counter_offset, body_size - counter_offset) : 0;
+
+    ID3v2_PopmFrame* frame = PopmFrame_new(header->flags, email, rating, counter);
+
+    FrameHeader_free(header); // we only needed the header to parse the data
+
+    free(email);
+    free(body);
+    return frame;
+}
+
+CharStream* PopmFrame_to_char_stream(ID3v2_PopmFrame* frame)
+{
+    if (frame == NULL) return NULL;
+
+    CharStream* frame_header_cs = FrameHeader_to_char_stream(frame->header);
+    CharStream* frame_cs = CharStream_new(frame->header->size + ID3v2_FRAME_HEADER_LENGTH);
+
+    // Header
+    CharStream_write(frame_cs, frame_header_cs->stream, frame_header_cs->size);
+    CharStream_free(frame_header_cs);
+
+    // Data
+    const int email_size = strlen(frame->data->email) + 1;
+    const int counter_length =
+        frame->header->size - email_size - ID3v2_POPM_FRAME_RATING_LENGTH;
+    char counter[8];
+    ulltob(frame->data->counter, counter, counter_length);
+
+    CharStream_write(frame_cs, frame->data->email, email_size);
+    CharStream_write(frame_cs, (const char*) &frame->data->rating, ID3v2_POPM_FRAME_RATING_LENGTH);
+    CharStream_write(frame_cs, counter, counter_length);
+
+    return frame_cs;
+}
+
+void PopmFrame_free(ID3v2_PopmFrame* frame)
+{
+    FrameHeader_free(frame->header);
+    free(frame->data->email);
+    free(frame->data);
+    free(frame);
+}
+
+ID3v2_PopmFrameData* PopmFrameData_new(
+    const char* email,
+    const unsigned char rating,
+    const unsigned long long counter
+)
+{
+    ID3v2_PopmFrameData* data = (ID3v2_PopmFrameData*) malloc(sizeof(ID3v2_PopmFrameData));
+
+    const int email_size = strlen(email) + 1;
+    data->email = (char*) malloc(email_size * sizeof(char));
+    memcpy(data->email, email, email_size);
+
+    data->rating = rating;
+    data->counter = counter;
+
+    return data;
+}
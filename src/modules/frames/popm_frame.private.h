@@ -0,0 +1,34 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_popm_frame_private_h
+#define id3v2lib_popm_frame_private_h
+
+#include "modules/frames/popm_frame.h"
+
+typedef struct _CharStream CharStream;
+
+ID3v2_PopmFrame* PopmFrame_new(
+    const char* flags,
+    const char* email,
+    const unsigned char rating,
+    const unsigned long long counter
+);
+ID3v2_PopmFrame* PopmFrame_parse(CharStream* frame_cs, const int id3_major_version);
+CharStream* PopmFrame_to_char_stream(ID3v2_PopmFrame* frame);
+
+void PopmFrame_free(ID3v2_PopmFrame* frame);
+
+ID3v2_PopmFrameData* PopmFrameData_new(
+    const char* email,
+    const unsigned char rating,
+    const unsigned long long counter
+);
+
+#endif
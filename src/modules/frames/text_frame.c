@@ -7,11 +7,13 @@
  * file that was distributed with this source code.
  */
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "modules/char_stream.private.h"
+#include "modules/codepage.h"
 #include "modules/frame.private.h"
 #include "modules/frame_header.private.h"
 #include "modules/utils.private.h"
@@ -30,11 +32,522 @@ ID3v2_TextFrame* TextFrame_new(const char* id, const char* flags, const char* te
     return frame;
 }
 
+/**
+ * Decodes the code point at *cursor and moves past it. Malformed sequences
+ * become U+FFFD, one byte at a time.
+ */
+static unsigned int utf8_decode(const unsigned char* text, const int size, int* cursor)
+{
+    const unsigned char lead = text[(*cursor)++];
+
+    if (lead < 0x80) return lead;
+
+    const int length = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : -1;
+    if (length < 0 || lead > 0xF4 || *cursor + length > size) return 0xFFFD;
+
+    unsigned int code_point = lead & (0x3F >> length);
+
+    for (int i = 0; i < length; i++)
+    {
+        const unsigned char c = text[*cursor + i];
+        if ((c & 0xC0) != 0x80) return 0xFFFD;
+        code_point = (code_point << 6) | (c & 0x3F);
+    }
+
+    *cursor += length;
+    return code_point;
+}
+
+static char TextFrame_output_encoding(const char encoding, const int id3_major_version)
+{
+    if (id3_major_version >= 4 || encoding == ID3v2_ENCODING_ISO) return encoding;
+
+    return ID3v2_ENCODING_UNICODE;
+}
+
+static bool TextValue_has_bom(const ID3v2_TextValue* value)
+{
+    return value->size >= 2 && string_has_bom(value->text);
+}
+
+/**
+ * Size of the value once encoded, without its termination.
+ */
+static int TextValue_encoded_size(const ID3v2_TextValue* value, const char from, const char to)
+{
+    if (from == to)
+    {
+        // Unicode values need a BOM, add one if it's missing
+        const bool needs_bom = to == ID3v2_ENCODING_UNICODE && !TextValue_has_bom(value);
+        return value->size + (needs_bom ? 2 : 0);
+    }
+
+    if (from == ID3v2_ENCODING_UTF16BE) return value->size + 2;
+
+    // UTF-8 into UTF-16, surrogate pairs take two units
+    const unsigned char* text = (const unsigned char*) value->text;
+    int size = 2;
+
+    for (int cursor = 0; cursor < value->size;)
+    {
+        size += utf8_decode(text, value->size, &cursor) >= 0x10000 ? 4 : 2;
+    }
+
+    return size;
+}
+
+static char* TextValue_encode(
+    char* dest,
+    const ID3v2_TextValue* value,
+    const char from,
+    const char to
+)
+{
+    if (from == to && (to != ID3v2_ENCODING_UNICODE || TextValue_has_bom(value)))
+    {
+        memcpy(dest, value->text, value->size);
+        return dest + value->size;
+    }
+
+    if (from == ID3v2_ENCODING_UTF16BE)
+    {
+        *dest++ = 0xFE;
+        *dest++ = 0xFF;
+        memcpy(dest, value->text, value->size);
+        return dest + value->size;
+    }
+
+    *dest++ = 0xFF;
+    *dest++ = 0xFE;
+
+    if (from == ID3v2_ENCODING_UNICODE)
+    {
+        // Little endian without a BOM
+        memcpy(dest, value->text, value->size);
+        return dest + value->size;
+    }
+
+    const unsigned char* text = (const unsigned char*) value->text;
+
+    for (int cursor = 0; cursor < value->size;)
+    {
+        unsigned int code_point = utf8_decode(text, value->size, &cursor);
+
+        if (code_point >= 0x10000)
+        {
+            code_point -= 0x10000;
+            const unsigned int high = 0xD800 | (code_point >> 10);
+            *dest++ = high & 0xFF;
+            *dest++ = high >> 8;
+            code_point = 0xDC00 | (code_point & 0x3FF);
+        }
+
+        *dest++ = code_point & 0xFF;
+        *dest++ = code_point >> 8;
+    }
+
+    return dest;
+}
+
+ID3v2_TextFrame* TextFrame_new_values(
+    const char* id,
+    const char* flags,
+    const ID3v2_TextValue* values,
+    const int count,
+    const char encoding,
+    const int id3_major_version
+)
+{
+    const char output_encoding = TextFrame_output_encoding(encoding, id3_major_version);
+    const int termination_size =
+        output_encoding == ID3v2_ENCODING_ISO || output_encoding == ID3v2_ENCODING_UTF8 ? 1 : 2;
+
+    // NUL separated values came with v2.4, older tags join them with a slash
+    // in a single string, which only starts with a BOM
+    const bool joined = id3_major_version < 4;
+    const int joined_bom_size = joined && output_encoding == ID3v2_ENCODING_UNICODE ? 2 : 0;
+
+    // Every value is terminated (or followed by a slash), the last one included
+    int size = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        size += TextValue_encoded_size(&values[i], encoding, output_encoding) + termination_size;
+        if (i > 0) size -= joined_bom_size;
+    }
+
+    ID3v2_TextFrameData* data = (ID3v2_TextFrameData*) malloc(sizeof(ID3v2_TextFrameData));
+    data->text = (char*) malloc((size > 0 ? size : termination_size) * sizeof(char));
+    data->encoding = output_encoding;
+    data->size = size;
+    data->number_count = -1;
+
+    char* cursor = data->text;
+
+    for (int i = 0; i < count; i++)
+    {
+        char* value = cursor;
+        cursor = TextValue_encode(cursor, &values[i], encoding, output_encoding);
+
+        if (i > 0 && joined_bom_size > 0)
+        {
+            memmove(value, value + joined_bom_size, cursor - value - joined_bom_size);
+            cursor -= joined_bom_size;
+        }
+
+        memset(cursor, 0, termination_size);
+
+        if (joined && i < count - 1)
+        {
+            // The slash follows the byte order of the BOM
+            const bool big_endian = termination_size == 2 && (unsigned char) data->text[0] == 0xFE;
+            cursor[big_endian ? 1 : 0] = '/';
+        }
+
+        cursor += termination_size;
+    }
+
+    if (count == 0)
+    {
+        // An empty frame still holds an empty string
+        memset(data->text, 0, termination_size);
+        data->size = termination_size;
+    }
+
+    ID3v2_TextFrame* frame = (ID3v2_TextFrame*) malloc(sizeof(ID3v2_TextFrame));
+    frame->data = data;
+    frame->header = FrameHeader_new(id, flags, ID3v2_FRAME_ENCODING_LENGTH + data->size);
+
+    return frame;
+}
+
+/**
+ * Walks the code points of every value in the text of a frame.
+ */
+typedef struct _TextReader
+{
+    const unsigned char* text;
+    int size;
+    int cursor;
+    char encoding;
+    bool big_endian;
+    bool value_start;
+} TextReader;
+
+static unsigned int TextReader_read_unit(TextReader* reader)
+{
+    const unsigned char* unit = reader->text + reader->cursor;
+    reader->cursor += 2;
+
+    return reader->big_endian ? (unit[0] << 8) | unit[1] : (unit[1] << 8) | unit[0];
+}
+
+/**
+ * Returns the next code point, 0 between values, or -1 at the end.
+ */
+static long TextReader_next(TextReader* reader)
+{
+    const bool unicode = reader->encoding == ID3v2_ENCODING_UNICODE ||
+                         reader->encoding == ID3v2_ENCODING_UTF16BE;
+
+    // Every unicode value starts with its own BOM
+    if (reader->value_start && reader->encoding == ID3v2_ENCODING_UNICODE &&
+        reader->cursor + 2 <= reader->size &&
+        string_has_bom((const char*) reader->text + reader->cursor))
+    {
+        reader->big_endian = reader->text[reader->cursor] == 0xFE;
+        reader->cursor += 2;
+    }
+
+    reader->value_start = false;
+
+    if (reader->cursor + (unicode ? 2 : 1) > reader->size) return -1;
+
+    unsigned int code_point = 0;
+
+    if (reader->encoding == ID3v2_ENCODING_UTF8)
+    {
+        code_point = utf8_decode(reader->text, reader->size, &reader->cursor);
+    }
+    else if (!unicode)
+    {
+        code_point = reader->text[reader->cursor++];
+    }
+    else
+    {
+        code_point = TextReader_read_unit(reader);
+
+        if (code_point >= 0xD800 && code_point < 0xDC00 && reader->cursor + 2 <= reader->size)
+        {
+            const int cursor = reader->cursor;
+            const unsigned int low = TextReader_read_unit(reader);
+
+            if (low >= 0xDC00 && low < 0xE000)
+            {
+                code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+            }
+            else
+            {
+                reader->cursor = cursor;
+            }
+        }
+    }
+
+    if (code_point == 0) reader->value_start = true;
+
+    return code_point;
+}
+
+char* TextFrame_get_utf8(ID3v2_TextFrame* frame)
+{
+    ID3v2_TextFrameData* data = frame->data;
+    TextReader reader = {
+        (const unsigned char*) data->text,
+        data->size,
+        0,
+        data->encoding,
+        data->encoding == ID3v2_ENCODING_UTF16BE,
+        true,
+    };
+
+    char* text = (char*) malloc(data->size * 4 + 1);
+    char* end = text;
+    long code_point = 0;
+
+    while ((code_point = TextReader_next(&reader)) > 0)
+    {
+        end = utf8_encode(end, code_point);
+    }
+
+    *end = '\0';
+    return text;
+}
+
+/**
+ * Replaces the text of the frame with new values, encoded as
+ * TextFrame_new_values does.
+ */
+static void TextFrame_set_values(
+    ID3v2_TextFrame* frame,
+    const ID3v2_TextValue* values,
+    const int count,
+    const char encoding,
+    const int id3_major_version
+)
+{
+    ID3v2_TextFrame* updated = TextFrame_new_values(
+        frame->header->id,
+        frame->header->flags,
+        values,
+        count,
+        encoding,
+        id3_major_version
+    );
+
+    free(frame->data->text);
+    free(frame->data);
+    frame->data = updated->data;
+    frame->header->size = updated->header->size;
+
+    FrameHeader_free(updated->header);
+    free(updated);
+}
+
+void TextFrame_canonicalize(ID3v2_TextFrame* frame, const int id3_major_version)
+{
+    ID3v2_TextFrameData* data = frame->data;
+    TextReader reader = {
+        (const unsigned char*) data->text,
+        data->size,
+        0,
+        data->encoding,
+        data->encoding == ID3v2_ENCODING_UTF16BE,
+        true,
+    };
+
+    // A code point never takes more than 4 bytes of UTF-8
+    char* text = (char*) malloc(data->size * 4 + 1);
+    int size = 0;
+    int kept_size = 0;
+    int value_count = 1;
+    int kept_value_count = 1;
+    bool latin1 = true;
+    long code_point = 0;
+
+    // Latin-1 is written as is and fixed below if something doesn't fit
+    while ((code_point = TextReader_next(&reader)) >= 0)
+    {
+        if (code_point > 0xFF) latin1 = false;
+
+        if (code_point == 0) value_count++;
+        else kept_value_count = value_count;
+
+        size = utf8_encode(text + size, code_point) - text;
+
+        // Empty values at the end are just terminations
+        if (code_point != 0) kept_size = size;
+    }
+
+    // v2.3 tags use Latin-1 when they can, everything else is UTF-8
+    const char encoding =
+        id3_major_version < 4 && latin1 ? ID3v2_ENCODING_ISO : ID3v2_ENCODING_UTF8;
+
+    if (encoding == ID3v2_ENCODING_ISO)
+    {
+        int latin1_size = 0;
+
+        for (int cursor = 0; cursor < kept_size;)
+        {
+            text[latin1_size++] = utf8_decode((unsigned char*) text, kept_size, &cursor);
+        }
+
+        kept_size = latin1_size;
+    }
+
+    ID3v2_TextValue* values = (ID3v2_TextValue*) malloc(kept_value_count * sizeof(ID3v2_TextValue));
+    int value_start = 0;
+    int count = 0;
+
+    for (int i = 0; i <= kept_size && count < kept_value_count; i++)
+    {
+        if (i == kept_size || text[i] == 0)
+        {
+            values[count++] = (ID3v2_TextValue){text + value_start, i - value_start};
+            value_start = i + 1;
+        }
+    }
+
+    TextFrame_set_values(frame, values, count, encoding, id3_major_version);
+
+    free(values);
+    free(text);
+}
+
+/**
+ * Walks a single terminated string, as found in comment and picture frames.
+ */
+static TextReader TextReader_for_string(const char* string, const char encoding)
+{
+    return (TextReader){
+        (const unsigned char*) string,
+        ID3v2_strlent(string),
+        0,
+        encoding,
+        encoding == ID3v2_ENCODING_UTF16BE,
+        true,
+    };
+}
+
+bool TextFrame_string_is_latin1(const char* string, const char encoding)
+{
+    TextReader reader = TextReader_for_string(string, encoding);
+    long code_point = 0;
+
+    while ((code_point = TextReader_next(&reader)) > 0)
+    {
+        if (code_point > 0xFF) return false;
+    }
+
+    return true;
+}
+
+char* TextFrame_reencode_string(const char* string, const char from, const char to)
+{
+    TextReader reader = TextReader_for_string(string, from);
+
+    // A code point never takes more than 4 bytes of UTF-8
+    char* text = (char*) malloc(reader.size * 4 + 1);
+    char* end = text;
+    long code_point = 0;
+
+    while ((code_point = TextReader_next(&reader)) > 0)
+    {
+        // Latin-1 is only asked for when every code point fits in it
+        if (to == ID3v2_ENCODING_ISO) *end++ = (char) code_point;
+        else end = utf8_encode(end, code_point);
+    }
+
+    const ID3v2_TextValue value = {text, end - text};
+    char* encoded = NULL;
+
+    if (to == ID3v2_ENCODING_UNICODE)
+    {
+        const int size = TextValue_encoded_size(&value, ID3v2_ENCODING_UTF8, to);
+        encoded = (char*) malloc(size + 2);
+        end = TextValue_encode(encoded, &value, ID3v2_ENCODING_UTF8, to);
+        end[0] = end[1] = '\0';
+    }
+    else
+    {
+        encoded = (char*) malloc(value.size + 1);
+        memcpy(encoded, text, value.size);
+        encoded[value.size] = '\0';
+    }
+
+    free(text);
+
+    return encoded;
+}
+
+void TextFrame_decode_codepage(
+    ID3v2_TextFrame* frame,
+    const int codepage,
+    const int id3_major_version
+)
+{
+    ID3v2_TextFrameData* data = frame->data;
+    if (data->encoding != ID3v2_ENCODING_ISO || codepage == ID3v2_CODEPAGE_LATIN1) return;
+
+    // CP1252 only differs from Latin-1 between 0x80 and 0x9F
+    const unsigned char last_different = codepage == ID3v2_CODEPAGE_CP1252 ? 0x9F : 0xFF;
+    bool different = false;
+
+    for (int i = 0; i < data->size && !different; i++)
+    {
+        const unsigned char c = data->text[i];
+        different = c >= 0x80 && c <= last_different;
+    }
+
+    if (!different) return;
+
+    char* text = (char*) malloc(ID3v2_CODEPAGE_UTF8_SIZE(data->size));
+    int size = ID3v2_codepage_to_utf8(data->text, data->size, codepage, text);
+
+    // The last value may be terminated, that's no value of its own
+    if (size > 0 && text[size - 1] == '\0') size--;
+
+    int count = 1;
+
+    for (int i = 0; i < size; i++)
+    {
+        if (text[i] == '\0') count++;
+    }
+
+    ID3v2_TextValue* values = (ID3v2_TextValue*) malloc(count * sizeof(ID3v2_TextValue));
+    int value_start = 0;
+    count = 0;
+
+    for (int i = 0; i <= size; i++)
+    {
+        if (i == size || text[i] == '\0')
+        {
+            values[count++] = (ID3v2_TextValue){text + value_start, i - value_start};
+            value_start = i + 1;
+        }
+    }
+
+    TextFrame_set_values(frame, values, count, ID3v2_ENCODING_UTF8, id3_major_version);
+
+    free(values);
+    free(text);
+}
+
 ID3v2_TextFrame* TextFrame_parse(CharStream* frame_cs, const int id3_major_version)
 {
     ID3v2_FrameHeader* header = FrameHeader_parse(frame_cs, id3_major_version);
 
-    CharStream_seek(frame_cs, ID3v2_FRAME_ENCODING_LENGTH, SEEK_CUR); // skip encoding
+    char encoding = ID3v2_ENCODING_ISO;
+    CharStream_read(frame_cs, &encoding, ID3v2_FRAME_ENCODING_LENGTH);
 
     const int text_size = header->size - ID3v2_FRAME_ENCODING_LENGTH;
     const size_t string_termination_bytes = 2;
@@ -49,6 +562,21 @@ ID3v2_TextFrame* TextFrame_parse(CharStream* frame_cs, const int id3_major_versi
 
     FrameHeader_free(header); // we only needed the header to parse the data
 
+    // UTF-8 and UTF-16BE can't be told apart from ISO by looking for a BOM
+    if (encoding == ID3v2_ENCODING_UTF8 || encoding == ID3v2_ENCODING_UTF16BE)
+    {
+        frame->data->encoding = encoding;
+    }
+
+    if (text_size > frame->data->size)
+    {
+        // v2.4 frames can hold multiple null separated values, keep all of them
+        free(frame->data->text);
+        frame->data->text = text;
+        frame->data->size = text_size;
+        return frame;
+    }
+
     free(text);
     return frame;
 }
@@ -79,6 +607,59 @@ void TextFrame_free(ID3v2_TextFrame* frame)
     free(frame);
 }
 
+/**
+ * Digits are read straight from the frame bytes, one byte per character
+ * for ISO strings and two for unicode ones, so nothing is converted or
+ * allocated.
+ */
+static void TextFrameData_parse_numbers(ID3v2_TextFrameData* data)
+{
+    const unsigned char* text = (const unsigned char*) data->text;
+    const bool has_bom = data->size >= 2 && string_has_bom(data->text);
+    const bool unicode = has_bom || data->encoding == ID3v2_ENCODING_UTF16BE;
+    const bool big_endian = has_bom ? text[0] == 0xFE : unicode;
+    const int width = unicode ? 2 : 1;
+    bool in_number = false;
+
+    data->number_count = 0;
+
+    for (int i = has_bom ? 2 : 0; i + width <= data->size; i += width)
+    {
+        const unsigned int c = !unicode    ? text[i]
+                               : big_endian ? (text[i] << 8) | text[i + 1]
+                                            : (text[i + 1] << 8) | text[i];
+
+        if (c == 0) break;
+
+        if (c < '0' || c > '9')
+        {
+            in_number = false;
+            continue;
+        }
+
+        if (!in_number)
+        {
+            if (data->number_count == ID3v2_TEXT_FRAME_MAX_NUMBERS) break;
+
+            data->numbers[data->number_count++] = 0;
+            in_number = true;
+        }
+
+        long* number = &data->numbers[data->number_count - 1];
+
+        // Saturate instead of overflowing on nonsense values
+        if (*number < 100000000L) *number = (*number * 10) + (c - '0');
+    }
+}
+
+int TextFrame_get_numbers(ID3v2_TextFrame* frame, const long** numbers)
+{
+    if (frame->data->number_count < 0) TextFrameData_parse_numbers(frame->data);
+
+    *numbers = frame->data->numbers;
+    return frame->data->number_count;
+}
+
 ID3v2_TextFrameData* TextFrameData_new(const char* text)
 {
     const char encoding = string_has_bom(text) ? ID3v2_ENCODING_UNICODE : ID3v2_ENCODING_ISO;
@@ -90,6 +671,7 @@ ID3v2_TextFrameData* TextFrameData_new(const char* text)
 
     data->encoding = encoding;
     data->size = size;
+    data->number_count = -1;
     memcpy(data->text, text, size);
 
     return data;
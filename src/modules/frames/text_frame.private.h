@@ -10,16 +10,74 @@
 #ifndef id3v2lib_text_frame_private_h
 #define id3v2lib_text_frame_private_h
 
+#include <stdbool.h>
+
 #include "modules/frames/text_frame.h"
 
 typedef struct _CharStream CharStream;
 
 ID3v2_TextFrame* TextFrame_new(const char* id, const char* flags, const char* text);
+
+/**
+ * Builds the frame out of count values in the provided encoding, in a single
+ * allocation. UTF-8 and UTF-16BE are only stored as such in v2.4 tags, older
+ * ones get UTF-16 with a BOM.
+ */
+ID3v2_TextFrame* TextFrame_new_values(
+    const char* id,
+    const char* flags,
+    const ID3v2_TextValue* values,
+    const int count,
+    const char encoding,
+    const int id3_major_version
+);
 ID3v2_TextFrame* TextFrame_parse(CharStream* frame_cs, const int id3_major_version);
 CharStream* TextFrame_to_char_stream(ID3v2_TextFrame* frame);
 
 void TextFrame_free(ID3v2_TextFrame* frame);
 
+/**
+ * Returns how many numbers (runs of decimal digits) are found in the text
+ * of the frame, up to ID3v2_TEXT_FRAME_MAX_NUMBERS, and points numbers to
+ * them. "3/12" holds 3 and 12, "2023-05-17T10:00" holds 2023, 5 and 17.
+ */
+int TextFrame_get_numbers(ID3v2_TextFrame* frame, const long** numbers);
+
+/**
+ * Re-encodes the text in the canonical encoding for the version (Latin-1
+ * when possible and UTF-16 otherwise for v2.3, UTF-8 for v2.4) and drops
+ * empty trailing values.
+ */
+void TextFrame_canonicalize(ID3v2_TextFrame* frame, const int id3_major_version);
+
+/**
+ * Tells whether every code point of a single terminated string, as found in
+ * comment and picture frames, fits in Latin-1.
+ */
+bool TextFrame_string_is_latin1(const char* string, const char encoding);
+
+/**
+ * Returns a new copy of a single terminated string in another encoding
+ * (Latin-1, UTF-8 or UTF-16 with a BOM), terminated as that encoding is.
+ */
+char* TextFrame_reencode_string(const char* string, const char from, const char to);
+
+/**
+ * Re-encodes the text of a Latin-1 frame reading its bytes in codepage, see
+ * ID3v2_Tag_decode_codepage.
+ */
+void TextFrame_decode_codepage(
+    ID3v2_TextFrame* frame,
+    const int codepage,
+    const int id3_major_version
+);
+
+/**
+ * Returns the first value of the frame as a new null terminated UTF-8
+ * string, whatever its encoding.
+ */
+char* TextFrame_get_utf8(ID3v2_TextFrame* frame);
+
 ID3v2_TextFrameData* TextFrameData_new(const char* text);
 
 #endif
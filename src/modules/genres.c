@@ -0,0 +1,326 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "modules/frame.h"
+#include "modules/utils.private.h"
+
+#include "genres.private.h"
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+#define GENRE_HASH_BUCKET_COUNT 64
+#define GENRE_HASH_SLOT_COUNT 256
+#define GENRE_HASH_EMPTY_SLOT 255
+
+static const char* const genre_names[ID3v2_GENRE_COUNT] = {
+    "Blues", "Classic Rock", "Country", "Dance", "Disco", "Funk", "Grunge", "Hip-Hop", "Jazz",
+    "Metal", "New Age", "Oldies", "Other", "Pop", "R&B", "Rap", "Reggae", "Rock", "Techno",
+    "Industrial", "Alternative", "Ska", "Death Metal", "Pranks", "Soundtrack", "Euro-Techno",
+    "Ambient", "Trip-Hop", "Vocal", "Jazz+Funk", "Fusion", "Trance", "Classical", "Instrumental",
+    "Acid", "House", "Game", "Sound Clip", "Gospel", "Noise", "Alternative Rock", "Bass", "Soul",
+    "Punk", "Space", "Meditative", "Instrumental Pop", "Instrumental Rock", "Ethnic", "Gothic",
+    "Darkwave", "Techno-Industrial", "Electronic", "Pop-Folk", "Eurodance", "Dream",
+    "Southern Rock", "Comedy", "Cult", "Gangsta", "Top 40", "Christian Rap", "Pop/Funk", "Jungle",
+    "Native American", "Cabaret", "New Wave", "Psychedelic", "Rave", "Showtunes", "Trailer",
+    "Lo-Fi", "Tribal", "Acid Punk", "Acid Jazz", "Polka", "Retro", "Musical", "Rock & Roll",
+    "Hard Rock", "Folk", "Folk-Rock", "National Folk", "Swing", "Fast Fusion", "Bebop", "Latin",
+    "Revival", "Celtic", "Bluegrass", "Avantgarde", "Gothic Rock", "Progressive Rock",
+    "Psychedelic Rock", "Symphonic Rock", "Slow Rock", "Big Band", "Chorus", "Easy Listening",
+    "Acoustic", "Humour", "Speech", "Chanson", "Opera", "Chamber Music", "Sonata", "Symphony",
+    "Booty Bass", "Primus", "Porn Groove", "Satire", "Slow Jam", "Club", "Tango", "Samba",
+    "Folklore", "Ballad", "Power Ballad", "Rhythmic Soul", "Freestyle", "Duet", "Punk Rock",
+    "Drum Solo", "A Cappella", "Euro-House", "Dance Hall", "Goa", "Drum & Bass", "Club-House",
+    "Hardcore", "Terror", "Indie", "BritPop", "Negerpunk", "Polsk Punk", "Beat",
+    "Christian Gangsta Rap", "Heavy Metal", "Black Metal", "Crossover", "Contemporary Christian",
+    "Christian Rock", "Merengue", "Salsa", "Thrash Metal", "Anime", "JPop", "Synthpop", "Christmas",
+    "Art Rock", "Baroque", "Bhangra", "Big Beat", "Breakbeat", "Chillout", "Downtempo", "Dub",
+    "EBM", "Eclectic", "Electro", "Electroclash", "Emo", "Experimental", "Garage", "Global", "IDM",
+    "Illbient", "Industro-Goth", "Jam Band", "Krautrock", "Leftfield", "Lounge", "Math Rock",
+    "New Romantic", "Nu-Breakz", "Post-Punk", "Post-Rock", "Psytrance", "Shoegaze", "Space Rock",
+    "Trop Rock", "World Music", "Neoclassical", "Audiobook", "Audio Theatre", "Neue Deutsche Welle",
+    "Podcast", "Indie Rock", "G-Funk", "Dubstep", "Garage Rock", "Psybient",
+};
+
+/**
+ * Minimal perfect hash of the lowercase genre names. A name is hashed once
+ * to find its bucket and once more with the displacement of that bucket to
+ * find its slot, no two genres share a slot. The tables were generated
+ * offline, changing genre_names or genre_hash requires generating them again.
+ */
+static const unsigned char genre_hash_displacements[64] = {
+    4, 2, 2, 1, 1, 1, 1, 2, 5, 3, 10, 10, 9, 4, 22, 1,
+    2, 1, 1, 5, 1, 2, 5, 5, 7, 1, 1, 2, 4, 1, 4, 1,
+    4, 1, 23, 14, 2, 2, 1, 4, 1, 6, 2, 3, 3, 7, 19, 1,
+    1, 2, 12, 11, 18, 3, 1, 7, 0, 2, 17, 1, 3, 5, 10, 3,
+};
+static const unsigned char genre_hash_slots[256] = {
+    9, 167, 185, 11, 94, 149, 165, 255, 97, 144, 106, 255, 70, 113, 255, 163,
+    29, 8, 69, 255, 61, 175, 255, 156, 159, 7, 85, 150, 48, 255, 255, 111,
+    52, 0, 255, 103, 181, 255, 101, 32, 148, 169, 255, 14, 131, 36, 133, 136,
+    255, 255, 42, 45, 104, 99, 173, 255, 28, 90, 4, 57, 162, 168, 65, 255,
+    121, 59, 137, 23, 91, 24, 255, 255, 68, 50, 178, 67, 105, 255, 255, 40,
+    22, 164, 255, 84, 122, 129, 6, 20, 38, 146, 13, 255, 30, 171, 88, 118,
+    141, 35, 63, 255, 76, 189, 255, 75, 143, 16, 120, 174, 190, 255, 152, 87,
+    170, 255, 21, 43, 12, 255, 2, 96, 3, 186, 107, 255, 1, 153, 125, 140,
+    56, 255, 123, 110, 98, 130, 255, 255, 166, 179, 255, 15, 255, 255, 71, 25,
+    255, 255, 126, 255, 54, 255, 39, 41, 255, 27, 255, 255, 10, 255, 255, 117,
+    100, 177, 255, 74, 255, 255, 17, 19, 55, 112, 255, 155, 64, 255, 128, 79,
+    119, 160, 255, 139, 33, 255, 255, 77, 135, 255, 26, 95, 182, 255, 81, 37,
+    83, 109, 73, 18, 145, 82, 151, 255, 187, 115, 5, 92, 138, 255, 191, 46,
+    255, 58, 255, 255, 124, 255, 86, 31, 49, 34, 44, 180, 127, 51, 255, 255,
+    184, 102, 142, 53, 62, 183, 188, 158, 255, 60, 157, 108, 89, 47, 80, 66,
+    255, 147, 255, 134, 116, 172, 114, 78, 72, 132, 255, 161, 93, 176, 154, 255,
+};
+
+/**
+ * Genre text is read straight from the frame, one byte per character for
+ * ISO strings and two for unicode ones.
+ */
+typedef struct _GenreText
+{
+    const unsigned char* bytes;
+    int size;
+    int width;
+    bool big_endian;
+} GenreText;
+
+static unsigned int GenreText_unit_at(GenreText* text, const int offset)
+{
+    if (offset + text->width > text->size) return 0;
+
+    const unsigned char* unit = text->bytes + offset;
+
+    if (text->width == 1) return unit[0];
+    return text->big_endian ? (unit[0] << 8) | unit[1] : (unit[1] << 8) | unit[0];
+}
+
+static unsigned int to_lower(const unsigned int c)
+{
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+static unsigned int genre_hash(GenreText* text, const int start, const int end, const int seed)
+{
+    unsigned int hash = FNV_OFFSET_BASIS ^ seed;
+
+    for (int i = start; i < end; i += text->width)
+    {
+        hash = (hash ^ to_lower(GenreText_unit_at(text, i))) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+static bool genre_name_equals(GenreText* text, const int start, const int end, const char* name)
+{
+    int i = start;
+
+    for (; i < end && *name != '\0'; i += text->width, name++)
+    {
+        if (to_lower(GenreText_unit_at(text, i)) != to_lower((unsigned char) *name)) return false;
+    }
+
+    return i >= end && *name == '\0';
+}
+
+static int genre_lookup(GenreText* text, const int start, const int end)
+{
+    for (int i = start; i < end; i += text->width)
+    {
+        // Every genre name is ASCII
+        if (GenreText_unit_at(text, i) >= 0x80) return ID3v2_GENRE_UNKNOWN;
+    }
+
+    const int bucket = genre_hash(text, start, end, 0) % GENRE_HASH_BUCKET_COUNT;
+    const int displacement = genre_hash_displacements[bucket];
+    const int slot = genre_hash(text, start, end, displacement) % GENRE_HASH_SLOT_COUNT;
+    const int id = genre_hash_slots[slot];
+
+    if (id != GENRE_HASH_EMPTY_SLOT && genre_name_equals(text, start, end, genre_names[id]))
+    {
+        return id;
+    }
+
+    if (genre_name_equals(text, start, end, "Remix")) return ID3v2_GENRE_REMIX;
+    if (genre_name_equals(text, start, end, "Cover")) return ID3v2_GENRE_COVER;
+
+    return ID3v2_GENRE_UNKNOWN;
+}
+
+/**
+ * Resolves a genre reference, either an ID3v1 genre number or one of the
+ * RX and CR keywords. Returns ID3v2_GENRE_UNKNOWN for anything else.
+ */
+static int genre_reference(GenreText* text, const int start, const int end)
+{
+    if (start >= end) return ID3v2_GENRE_UNKNOWN;
+
+    if (end - start == 2 * text->width)
+    {
+        const unsigned int a = GenreText_unit_at(text, start);
+        const unsigned int b = GenreText_unit_at(text, start + text->width);
+
+        if (a == 'R' && b == 'X') return ID3v2_GENRE_REMIX;
+        if (a == 'C' && b == 'R') return ID3v2_GENRE_COVER;
+    }
+
+    int id = 0;
+
+    for (int i = start; i < end; i += text->width)
+    {
+        const unsigned int c = GenreText_unit_at(text, i);
+        if (c < '0' || c > '9') return ID3v2_GENRE_UNKNOWN;
+
+        id = (id * 10) + (c - '0');
+        if (id >= ID3v2_GENRE_COUNT) return ID3v2_GENRE_UNKNOWN;
+    }
+
+    return id;
+}
+
+static int find_unit(GenreText* text, const int start, const int end, const unsigned int unit)
+{
+    for (int i = start; i < end; i += text->width)
+    {
+        if (GenreText_unit_at(text, i) == unit) return i;
+    }
+
+    return -1;
+}
+
+static void Genre_set(ID3v2_Genre* genre, const int id)
+{
+    genre->id = id;
+    genre->name = ID3v2_genre_name(id);
+    genre->text = NULL;
+    genre->text_size = 0;
+    genre->encoding = ID3v2_ENCODING_ISO;
+}
+
+/**
+ * Parses a single value, the whole text of v2.3 frames or one of the null
+ * separated values of v2.4 ones.
+ */
+static int parse_value(
+    GenreText* text,
+    const int start,
+    const int end,
+    ID3v2_Genre* genres,
+    const int max_genres
+)
+{
+    const int width = text->width;
+    int count = 0;
+    int cursor = start;
+
+    // v2.3 references, "(17)(RX)"
+    while (count < max_genres && cursor < end && GenreText_unit_at(text, cursor) == '(')
+    {
+        if (GenreText_unit_at(text, cursor + width) == '(')
+        {
+            // "((" escapes a free text genre that starts with a parenthesis
+            cursor += width;
+            break;
+        }
+
+        const int close = find_unit(text, cursor + width, end, ')');
+        if (close < 0) break;
+
+        const int id = genre_reference(text, cursor + width, close);
+        if (id == ID3v2_GENRE_UNKNOWN) break;
+
+        Genre_set(&genres[count++], id);
+        cursor = close + width;
+    }
+
+    if (count == max_genres || cursor >= end) return count;
+
+    // What's left is either a v2.4 reference or free text
+    int id = genre_reference(text, cursor, end);
+    if (id == ID3v2_GENRE_UNKNOWN) id = genre_lookup(text, cursor, end);
+
+    // "(17)Rock" only refines the reference that comes before it
+    if (count > 0 && id != ID3v2_GENRE_UNKNOWN && genres[count - 1].id == id) return count;
+
+    ID3v2_Genre* genre = &genres[count++];
+    Genre_set(genre, id);
+
+    if (id == ID3v2_GENRE_UNKNOWN)
+    {
+        genre->text = (const char*) text->bytes + cursor;
+        genre->text_size = end - cursor;
+        genre->encoding = width == 1         ? ID3v2_ENCODING_ISO
+                          : text->big_endian ? ID3v2_ENCODING_UTF16BE
+                                             : ID3v2_ENCODING_UNICODE;
+    }
+
+    return count;
+}
+
+int Genres_parse(ID3v2_TextFrame* frame, ID3v2_Genre* genres, const int max_genres)
+{
+    const bool unicode = frame->data->encoding == ID3v2_ENCODING_UNICODE ||
+                         frame->data->encoding == ID3v2_ENCODING_UTF16BE;
+    GenreText text = {
+        (const unsigned char*) frame->data->text,
+        frame->data->size,
+        unicode ? 2 : 1,
+        frame->data->encoding == ID3v2_ENCODING_UTF16BE,
+    };
+    int count = 0;
+    int cursor = 0;
+
+    while (count < max_genres && cursor < text.size)
+    {
+        // Every unicode value starts with its own BOM
+        if (unicode && cursor + 2 <= text.size &&
+            string_has_bom((const char*) text.bytes + cursor))
+        {
+            text.big_endian = text.bytes[cursor] == 0xFE;
+            cursor += 2;
+        }
+
+        int end = find_unit(&text, cursor, text.size, 0);
+        if (end < 0) end = text.size - ((text.size - cursor) % text.width);
+
+        count += parse_value(&text, cursor, end, genres + count, max_genres - count);
+        cursor = end + text.width;
+    }
+
+    return count;
+}
+
+const char* ID3v2_genre_name(const int id)
+{
+    if (id == ID3v2_GENRE_REMIX) return "Remix";
+    if (id == ID3v2_GENRE_COVER) return "Cover";
+    if (id < 0 || id >= ID3v2_GENRE_COUNT) return NULL;
+
+    return genre_names[id];
+}
+
+int ID3v2_genre_id(const char* name)
+{
+    if (name == NULL) return ID3v2_GENRE_UNKNOWN;
+
+    const bool unicode = string_has_bom(name);
+    GenreText text = {
+        (const unsigned char*) name + (unicode ? 2 : 0),
+        unicode ? ID3v2_strlen(name) - 2 : (int) strlen(name),
+        unicode ? 2 : 1,
+        unicode && (unsigned char) name[0] == 0xFE,
+    };
+
+    return genre_lookup(&text, 0, text.size);
+}
@@ -0,0 +1,23 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_genres_private_h
+#define id3v2lib_genres_private_h
+
+#include "modules/frames/text_frame.h"
+#include "modules/genres.h"
+
+/**
+ * Resolves every genre found in the text of a TCON frame, "(17)Rock",
+ * "(4)(RX)" or v2.4 null separated values like "17\0Eurodisco". Fills up
+ * to max_genres genres and returns how many were found.
+ */
+int Genres_parse(ID3v2_TextFrame* frame, ID3v2_Genre* genres, const int max_genres);
+
+#endif
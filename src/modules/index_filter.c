@@ -0,0 +1,1052 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "id3v2lib.h"
+#include "modules/utils.private.h"
+
+#include "index_filter.private.h"
+
+#define FILTER_ALL 0
+#define FILTER_AND 1
+#define FILTER_OR 2
+#define FILTER_NOT 3
+#define FILTER_NUMBER_RANGE 4
+#define FILTER_TEXT_RANGE 5
+#define FILTER_CONTAINS 6
+
+#define TOKEN_END 0
+#define TOKEN_LEFT 1
+#define TOKEN_RIGHT 2
+#define TOKEN_COMPARE 3
+#define TOKEN_NUMBER 4
+#define TOKEN_STRING 5
+#define TOKEN_WORD 6
+#define TOKEN_INVALID 7
+
+#define COMPARE_EQUAL 0
+#define COMPARE_NOT_EQUAL 1
+#define COMPARE_LESS 2
+#define COMPARE_LESS_EQUAL 3
+#define COMPARE_GREATER 4
+#define COMPARE_GREATER_EQUAL 5
+
+// How a predicate turned out for the rows of a segment
+#define BINDING_NONE 0
+#define BINDING_ALL 1
+#define BINDING_RANGE 2
+#define BINDING_SET 3
+
+#define TRIGRAM_LENGTH 3
+#define TRIGRAM_PROBES 4
+#define TRIGRAM_BITS_PER_VALUE 10
+
+static const char* const column_names[ID3v2_INDEX_COLUMN_COUNT] = {
+    "path",
+    "title",
+    "artist",
+    "album",
+    "album_artist",
+    "genre",
+    "year",
+    "track",
+    "has_cover",
+};
+
+/**
+ * Predicates are normalised as they're parsed: numbers are kept as an
+ * inclusive range, text as a range with optional bounds (NULL ones are
+ * unbounded) and != becomes the negation of =.
+ */
+typedef struct _FilterNode
+{
+    int type;
+    int column;
+    // Position among the predicates of the filter
+    int index;
+    long long low;
+    long long high;
+    char* low_text;
+    char* high_text;
+    bool low_inclusive;
+    bool high_inclusive;
+    // Lowercased
+    char* needle;
+    int needle_length;
+    struct _FilterNode* left;
+    struct _FilterNode* right;
+} FilterNode;
+
+struct _ID3v2_IndexFilter
+{
+    FilterNode* root;
+    int predicate_count;
+    int depth;
+};
+
+typedef struct _FilterBinding
+{
+    int type;
+    const int* values;
+    // Of the blocks of the column
+    const IndexRange* ranges;
+    int low;
+    int high;
+    // BINDING_SET only, by code
+    unsigned char* matches;
+} FilterBinding;
+
+static unsigned char lowercase(const unsigned char c)
+{
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+static bool is_string_column(const int column)
+{
+    return column < ID3v2_INDEX_STRING_COLUMN_COUNT;
+}
+
+/**
+ * Stats
+ */
+
+const int* IndexSegment_get_column(const IndexSegment* segment, const int column)
+{
+    return is_string_column(column) ? segment->strings[column].codes : segment->numbers[column];
+}
+
+static unsigned long long trigram_hash(const char* text)
+{
+    const char trigram[TRIGRAM_LENGTH] = {
+        lowercase(text[0]),
+        lowercase(text[1]),
+        lowercase(text[2]),
+    };
+    return fnv1a_64(trigram, TRIGRAM_LENGTH, 14695981039346656037ULL);
+}
+
+static void trigrams_add(unsigned long long* bits, const unsigned int mask, unsigned long long hash)
+{
+    const unsigned int step = (unsigned int) (hash >> 32) | 1;
+
+    for (unsigned int i = 0, bit = (unsigned int) hash; i < TRIGRAM_PROBES; i++, bit += step)
+    {
+        bits[(bit & mask) >> 6] |= 1ULL << (bit & 63);
+    }
+}
+
+static bool trigrams_test(
+    const unsigned long long* bits,
+    const unsigned int mask,
+    unsigned long long hash
+)
+{
+    const unsigned int step = (unsigned int) (hash >> 32) | 1;
+
+    for (unsigned int i = 0, bit = (unsigned int) hash; i < TRIGRAM_PROBES; i++, bit += step)
+    {
+        if ((bits[(bit & mask) >> 6] & (1ULL << (bit & 63))) == 0) return false;
+    }
+
+    return true;
+}
+
+static IndexStats* IndexStats_new(const IndexSegment* segment)
+{
+    IndexStats* stats = (IndexStats*) calloc(1, sizeof(IndexStats));
+    stats->block_count = (segment->row_count + INDEX_BLOCK_ROWS - 1) / INDEX_BLOCK_ROWS;
+
+    for (int column = 0; column < ID3v2_INDEX_COLUMN_COUNT; column++)
+    {
+        const int* values = IndexSegment_get_column(segment, column);
+        IndexRange* ranges = (IndexRange*) malloc((stats->block_count + 1) * sizeof(IndexRange));
+        IndexRange* whole = &ranges[stats->block_count];
+        *whole = (IndexRange){INT_MAX, INT_MIN};
+
+        for (int block = 0; block < stats->block_count; block++)
+        {
+            const int end = block == stats->block_count - 1 ? segment->row_count
+                                                            : (block + 1) * INDEX_BLOCK_ROWS;
+            IndexRange range = {INT_MAX, INT_MIN};
+
+            for (int row = block * INDEX_BLOCK_ROWS; row < end; row++)
+            {
+                if (values[row] < range.min) range.min = values[row];
+                if (values[row] > range.max) range.max = values[row];
+            }
+
+            ranges[block] = range;
+            if (range.min < whole->min) whole->min = range.min;
+            if (range.max > whole->max) whole->max = range.max;
+        }
+
+        stats->ranges[column] = ranges;
+    }
+
+    for (int column = 0; column < ID3v2_INDEX_STRING_COLUMN_COUNT; column++)
+    {
+        const IndexDictionary* dictionary = &segment->strings[column];
+        unsigned int bit_count = 64;
+
+        while (bit_count < (unsigned int) dictionary->count * TRIGRAM_BITS_PER_VALUE &&
+               bit_count < (1U << 31))
+        {
+            bit_count <<= 1;
+        }
+
+        stats->trigram_mask[column] = bit_count - 1;
+        stats->trigrams[column] = (unsigned long long*) calloc(bit_count / 64, sizeof(long long));
+
+        for (int code = 0; code < dictionary->count; code++)
+        {
+            const char* value = dictionary->values[code];
+            const int length = strlen(value);
+
+            for (int i = 0; i + TRIGRAM_LENGTH <= length; i++)
+            {
+                trigrams_add(stats->trigrams[column], bit_count - 1, trigram_hash(value + i));
+            }
+        }
+    }
+
+    return stats;
+}
+
+void IndexStats_free(IndexStats* stats)
+{
+    if (stats == NULL) return;
+
+    for (int column = 0; column < ID3v2_INDEX_COLUMN_COUNT; column++)
+    {
+        free(stats->ranges[column]);
+    }
+
+    for (int column = 0; column < ID3v2_INDEX_STRING_COLUMN_COUNT; column++)
+    {
+        free(stats->trigrams[column]);
+    }
+
+    free(stats);
+}
+
+const IndexStats* IndexSegment_get_stats(IndexSegment* segment)
+{
+    IndexStats* stats = __atomic_load_n(&segment->stats, __ATOMIC_ACQUIRE);
+    if (stats != NULL) return stats;
+
+    // Threads filtering the same segment may build them at the same time
+    IndexStats* expected = NULL;
+    stats = IndexStats_new(segment);
+
+    if (!__atomic_compare_exchange_n(
+            &segment->stats,
+            &expected,
+            stats,
+            false,
+            __ATOMIC_ACQ_REL,
+            __ATOMIC_ACQUIRE
+        ))
+    {
+        IndexStats_free(stats);
+        return expected;
+    }
+
+    return stats;
+}
+
+/**
+ * Parsing
+ */
+
+typedef struct _FilterParser
+{
+    const char* expression;
+    int cursor;
+    // Current token
+    int token;
+    int token_start;
+    int token_length;
+    int compare;
+    long long number;
+    int predicate_count;
+    int error_offset;
+} FilterParser;
+
+static void FilterNode_free(FilterNode* node)
+{
+    if (node == NULL) return;
+
+    FilterNode_free(node->left);
+    FilterNode_free(node->right);
+    free(node->low_text);
+    free(node->high_text);
+    free(node->needle);
+    free(node);
+}
+
+static FilterNode* FilterNode_new(const int type, FilterNode* left, FilterNode* right)
+{
+    FilterNode* node = (FilterNode*) calloc(1, sizeof(FilterNode));
+    node->type = type;
+    node->left = left;
+    node->right = right;
+
+    return node;
+}
+
+static void FilterParser_next(FilterParser* parser)
+{
+    const char* expression = parser->expression;
+
+    while (expression[parser->cursor] == ' ' || expression[parser->cursor] == '\t' ||
+           expression[parser->cursor] == '\n' || expression[parser->cursor] == '\r')
+    {
+        parser->cursor++;
+    }
+
+    const int start = parser->cursor;
+    const char c = expression[start];
+    int length = 1;
+
+    parser->token_start = start;
+
+    if (c == '\0')
+    {
+        parser->token = TOKEN_END;
+        length = 0;
+    }
+    else if (c == '(' || c == ')')
+    {
+        parser->token = c == '(' ? TOKEN_LEFT : TOKEN_RIGHT;
+    }
+    else if (c == '=' || c == '<' || c == '>' || (c == '!' && expression[start + 1] == '='))
+    {
+        const bool equal = expression[start + 1] == '=';
+        parser->token = TOKEN_COMPARE;
+        length = equal || c == '!' ? 2 : 1;
+
+        if (c == '=') parser->compare = COMPARE_EQUAL;
+        else if (c == '!') parser->compare = COMPARE_NOT_EQUAL;
+        else if (c == '<') parser->compare = equal ? COMPARE_LESS_EQUAL : COMPARE_LESS;
+        else parser->compare = equal ? COMPARE_GREATER_EQUAL : COMPARE_GREATER;
+
+    }
+    else if (c == '"' || c == '\'')
+    {
+        // Quotes are escaped with a backslash
+        while (expression[start + length] != '\0' && expression[start + length] != c)
+        {
+            const bool escape = expression[start + length] == '\\';
+            length += escape && expression[start + length + 1] != '\0' ? 2 : 1;
+        }
+
+        parser->token = expression[start + length] == c ? TOKEN_STRING : TOKEN_INVALID;
+        length++;
+    }
+    else if ((c >= '0' && c <= '9') || (c == '-' && expression[start + 1] >= '0' &&
+                                        expression[start + 1] <= '9'))
+    {
+        char* end = NULL;
+        parser->number = strtoll(expression + start, &end, 10);
+
+        // Out of range numbers still compare as such
+        if (parser->number > INT_MAX) parser->number = (long long) INT_MAX + 1;
+        if (parser->number < INT_MIN) parser->number = (long long) INT_MIN - 1;
+
+        parser->token = TOKEN_NUMBER;
+        length = end - (expression + start);
+    }
+    else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_')
+    {
+        while ((expression[start + length] >= 'a' && expression[start + length] <= 'z') ||
+               (expression[start + length] >= 'A' && expression[start + length] <= 'Z') ||
+               (expression[start + length] >= '0' && expression[start + length] <= '9') ||
+               expression[start + length] == '_')
+        {
+            length++;
+        }
+
+        parser->token = TOKEN_WORD;
+    }
+    else
+    {
+        parser->token = TOKEN_INVALID;
+    }
+
+    parser->token_length = length;
+    parser->cursor = start + length;
+}
+
+static bool FilterParser_is_word(const FilterParser* parser, const char* word)
+{
+    if (parser->token != TOKEN_WORD || parser->token_length != (int) strlen(word)) return false;
+
+    for (int i = 0; i < parser->token_length; i++)
+    {
+        if (lowercase(parser->expression[parser->token_start + i]) != word[i]) return false;
+    }
+
+    return true;
+}
+
+static FilterNode* FilterParser_fail(FilterParser* parser, FilterNode* node)
+{
+    if (parser->error_offset < 0) parser->error_offset = parser->token_start;
+
+    FilterNode_free(node);
+    return NULL;
+}
+
+/**
+ * Copies the string token without its quotes and escapes.
+ */
+static char* FilterParser_get_string(const FilterParser* parser)
+{
+    const char* text = parser->expression + parser->token_start + 1;
+    const int size = parser->token_length - 2;
+    char* string = (char*) malloc(size + 1);
+    int length = 0;
+
+    for (int i = 0; i < size; i++)
+    {
+        if (text[i] == '\\' && i + 1 < size) i++;
+        string[length++] = text[i];
+    }
+
+    string[length] = '\0';
+    return string;
+}
+
+static FilterNode* FilterParser_predicate(FilterParser* parser, const int column)
+{
+    FilterNode* node = FilterNode_new(FILTER_NUMBER_RANGE, NULL, NULL);
+    node->column = column;
+    node->index = parser->predicate_count++;
+    node->low = INT_MIN;
+    node->high = INT_MAX;
+
+    if (!is_string_column(column) && FilterParser_is_word(parser, "between"))
+    {
+        FilterParser_next(parser);
+        if (parser->token != TOKEN_NUMBER) return FilterParser_fail(parser, node);
+        node->low = parser->number;
+
+        FilterParser_next(parser);
+        if (!FilterParser_is_word(parser, "and")) return FilterParser_fail(parser, node);
+
+        FilterParser_next(parser);
+        if (parser->token != TOKEN_NUMBER) return FilterParser_fail(parser, node);
+        node->high = parser->number;
+
+        FilterParser_next(parser);
+        return node;
+    }
+
+    if (is_string_column(column) && FilterParser_is_word(parser, "contains"))
+    {
+        FilterParser_next(parser);
+        if (parser->token != TOKEN_STRING) return FilterParser_fail(parser, node);
+
+        node->type = FILTER_CONTAINS;
+        node->needle = FilterParser_get_string(parser);
+        node->needle_length = strlen(node->needle);
+
+        for (int i = 0; i < node->needle_length; i++)
+        {
+            node->needle[i] = lowercase(node->needle[i]);
+        }
+
+        FilterParser_next(parser);
+        return node;
+    }
+
+    if (parser->token != TOKEN_COMPARE)
+    {
+        if (is_string_column(column)) return FilterParser_fail(parser, node);
+
+        // A numeric column alone isn't 0
+        node->low = node->high = 0;
+        return FilterNode_new(FILTER_NOT, node, NULL);
+    }
+
+    const int compare = parser->compare;
+    FilterParser_next(parser);
+
+    if (is_string_column(column))
+    {
+        if (parser->token != TOKEN_STRING) return FilterParser_fail(parser, node);
+
+        char* text = FilterParser_get_string(parser);
+        node->type = FILTER_TEXT_RANGE;
+
+        if (compare == COMPARE_EQUAL || compare == COMPARE_NOT_EQUAL)
+        {
+            node->low_text = text;
+            node->high_text = strdup(text);
+            node->low_inclusive = node->high_inclusive = true;
+        }
+        else if (compare == COMPARE_LESS || compare == COMPARE_LESS_EQUAL)
+        {
+            node->high_text = text;
+            node->high_inclusive = compare == COMPARE_LESS_EQUAL;
+        }
+        else
+        {
+            node->low_text = text;
+            node->low_inclusive = compare == COMPARE_GREATER_EQUAL;
+        }
+    }
+    else
+    {
+        if (parser->token != TOKEN_NUMBER) return FilterParser_fail(parser, node);
+
+        const long long value = parser->number;
+
+        const bool equal = compare == COMPARE_EQUAL || compare == COMPARE_NOT_EQUAL;
+
+        if (equal || compare == COMPARE_GREATER_EQUAL) node->low = value;
+        if (equal || compare == COMPARE_LESS_EQUAL) node->high = value;
+        if (compare == COMPARE_LESS) node->high = value - 1;
+        if (compare == COMPARE_GREATER) node->low = value + 1;
+    }
+
+    FilterParser_next(parser);
+    return compare == COMPARE_NOT_EQUAL ? FilterNode_new(FILTER_NOT, node, NULL) : node;
+}
+
+static FilterNode* FilterParser_or(FilterParser* parser);
+
+static FilterNode* FilterParser_primary(FilterParser* parser)
+{
+    if (FilterParser_is_word(parser, "not"))
+    {
+        FilterParser_next(parser);
+        FilterNode* child = FilterParser_primary(parser);
+        return child != NULL ? FilterNode_new(FILTER_NOT, child, NULL) : NULL;
+    }
+
+    if (parser->token == TOKEN_LEFT)
+    {
+        FilterParser_next(parser);
+        FilterNode* node = FilterParser_or(parser);
+        if (node == NULL) return NULL;
+
+        if (parser->token != TOKEN_RIGHT) return FilterParser_fail(parser, node);
+
+        FilterParser_next(parser);
+        return node;
+    }
+
+    for (int column = 0; column < ID3v2_INDEX_COLUMN_COUNT; column++)
+    {
+        if (FilterParser_is_word(parser, column_names[column]))
+        {
+            FilterParser_next(parser);
+            return FilterParser_predicate(parser, column);
+        }
+    }
+
+    return FilterParser_fail(parser, NULL);
+}
+
+static FilterNode* FilterParser_and(FilterParser* parser)
+{
+    FilterNode* node = FilterParser_primary(parser);
+
+    while (node != NULL && FilterParser_is_word(parser, "and"))
+    {
+        FilterParser_next(parser);
+        FilterNode* right = FilterParser_primary(parser);
+        node = right != NULL ? FilterNode_new(FILTER_AND, node, right)
+                             : FilterParser_fail(parser, node);
+    }
+
+    return node;
+}
+
+static FilterNode* FilterParser_or(FilterParser* parser)
+{
+    FilterNode* node = FilterParser_and(parser);
+
+    while (node != NULL && FilterParser_is_word(parser, "or"))
+    {
+        FilterParser_next(parser);
+        FilterNode* right = FilterParser_and(parser);
+        node = right != NULL ? FilterNode_new(FILTER_OR, node, right)
+                             : FilterParser_fail(parser, node);
+    }
+
+    return node;
+}
+
+static int FilterNode_get_depth(const FilterNode* node)
+{
+    if (node == NULL) return 0;
+
+    const int left = FilterNode_get_depth(node->left);
+    const int right = FilterNode_get_depth(node->right);
+
+    return 1 + (left > right ? left : right);
+}
+
+ID3v2_IndexFilter* ID3v2_IndexFilter_compile(const char* expression, int* error_offset)
+{
+    FilterParser parser = {expression, 0};
+    parser.error_offset = -1;
+    FilterParser_next(&parser);
+
+    FilterNode* root = parser.token == TOKEN_END ? FilterNode_new(FILTER_ALL, NULL, NULL)
+                                                 : FilterParser_or(&parser);
+
+    if (root != NULL && parser.token != TOKEN_END) root = FilterParser_fail(&parser, root);
+
+    if (root == NULL)
+    {
+        if (error_offset != NULL) *error_offset = parser.error_offset;
+        return NULL;
+    }
+
+    ID3v2_IndexFilter* filter = (ID3v2_IndexFilter*) malloc(sizeof(ID3v2_IndexFilter));
+    filter->root = root;
+    filter->predicate_count = parser.predicate_count;
+    filter->depth = FilterNode_get_depth(root);
+
+    return filter;
+}
+
+void ID3v2_IndexFilter_free(ID3v2_IndexFilter* filter)
+{
+    if (filter == NULL) return;
+
+    FilterNode_free(filter->root);
+    free(filter);
+}
+
+/**
+ * Binding
+ */
+
+/**
+ * Returns the first code whose value is greater than text, or greater or
+ * equal when inclusive.
+ */
+static int IndexDictionary_search(
+    const IndexDictionary* dictionary,
+    const char* text,
+    const bool inclusive
+)
+{
+    int low = 0;
+    int high = dictionary->count;
+
+    while (low < high)
+    {
+        const int middle = low + (high - low) / 2;
+        const int result = strcmp(dictionary->values[middle], text);
+
+        if (result < 0 || (result == 0 && !inclusive)) low = middle + 1;
+        else high = middle;
+    }
+
+    return low;
+}
+
+static bool contains_ignoring_case(const char* text, const char* needle, const int needle_length)
+{
+    for (const char* start = text; *start != '\0'; start++)
+    {
+        int i = 0;
+        while (i < needle_length && lowercase(start[i]) == (unsigned char) needle[i]) i++;
+
+        if (i == needle_length) return true;
+    }
+
+    return needle_length == 0;
+}
+
+static void FilterBinding_set_range(
+    FilterBinding* binding,
+    const IndexRange* whole,
+    long long low,
+    long long high
+)
+{
+    if (low < INT_MIN) low = INT_MIN;
+    if (high > INT_MAX) high = INT_MAX;
+
+    if (low > high || low > whole->max || high < whole->min) binding->type = BINDING_NONE;
+    else if (low <= whole->min && high >= whole->max) binding->type = BINDING_ALL;
+    else binding->type = BINDING_RANGE;
+
+    binding->low = low;
+    binding->high = high;
+}
+
+/**
+ * Works out what every predicate means for the segment: which codes of the
+ * dictionary match, and whether it's all of them or none.
+ */
+static void FilterNode_bind(
+    const FilterNode* node,
+    const IndexSegment* segment,
+    const IndexStats* stats,
+    FilterBinding* bindings
+)
+{
+    if (node->type == FILTER_AND || node->type == FILTER_OR || node->type == FILTER_NOT)
+    {
+        FilterNode_bind(node->left, segment, stats, bindings);
+        if (node->right != NULL) FilterNode_bind(node->right, segment, stats, bindings);
+        return;
+    }
+
+    if (node->type == FILTER_ALL) return;
+
+    FilterBinding* binding = &bindings[node->index];
+    const IndexRange* whole = &stats->ranges[node->column][stats->block_count];
+    binding->values = IndexSegment_get_column(segment, node->column);
+    binding->ranges = stats->ranges[node->column];
+    binding->matches = NULL;
+
+    if (node->type == FILTER_NUMBER_RANGE)
+    {
+        FilterBinding_set_range(binding, whole, node->low, node->high);
+        return;
+    }
+
+    const IndexDictionary* dictionary = &segment->strings[node->column];
+
+    if (node->type == FILTER_TEXT_RANGE)
+    {
+        // Sorted dictionaries turn text ranges into code ranges
+        int low = 0;
+        int high = dictionary->count - 1;
+
+        if (node->low_text != NULL)
+        {
+            low = IndexDictionary_search(dictionary, node->low_text, node->low_inclusive);
+        }
+
+        if (node->high_text != NULL)
+        {
+            high = IndexDictionary_search(dictionary, node->high_text, !node->high_inclusive) - 1;
+        }
+
+        FilterBinding_set_range(binding, whole, low, high);
+        return;
+    }
+
+    // A needle with a trigram that isn't found anywhere can't match
+    for (int i = 0; i + TRIGRAM_LENGTH <= node->needle_length; i++)
+    {
+        if (!trigrams_test(
+                stats->trigrams[node->column],
+                stats->trigram_mask[node->column],
+                trigram_hash(node->needle + i)
+            ))
+        {
+            binding->type = BINDING_NONE;
+            return;
+        }
+    }
+
+    binding->matches = (unsigned char*) malloc(dictionary->count + 1);
+    int match_count = 0;
+
+    for (int code = 0; code < dictionary->count; code++)
+    {
+        binding->matches[code] =
+            contains_ignoring_case(dictionary->values[code], node->needle, node->needle_length);
+        match_count += binding->matches[code];
+    }
+
+    binding->type = match_count == 0                   ? BINDING_NONE
+                    : match_count == dictionary->count ? BINDING_ALL
+                                                       : BINDING_SET;
+}
+
+/**
+ * Evaluation
+ */
+
+/**
+ * Sets the bits of the values found in [low, high]. values has to start at
+ * a multiple of 64 rows.
+ */
+static void select_range(
+    const int* values,
+    const int count,
+    const int low,
+    const int high,
+    unsigned long long* bits
+)
+{
+    // low <= value <= high is value - low <= high - low, unsigned
+    const unsigned int width = (unsigned int) high - (unsigned int) low;
+    int i = 0;
+
+#ifdef __SSE2__
+    // SSE2 only compares signed integers, flipping the sign bit makes them unsigned
+    const __m128i sign = _mm_set1_epi32(INT_MIN);
+    const __m128i low_values = _mm_set1_epi32(low);
+    const __m128i limit = _mm_set1_epi32((int) (width ^ 0x80000000U));
+
+    for (; i + 16 <= count; i += 16)
+    {
+        unsigned long long mask = 0;
+
+        for (int j = 0; j < 16; j += 4)
+        {
+            __m128i value = _mm_loadu_si128((const __m128i*) (values + i + j));
+            value = _mm_xor_si128(_mm_sub_epi32(value, low_values), sign);
+
+            const __m128i outside = _mm_cmpgt_epi32(value, limit);
+            mask |= (unsigned long long) (~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xF) << j;
+        }
+
+        bits[i >> 6] |= mask << (i & 63);
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        if ((unsigned int) values[i] - (unsigned int) low <= width)
+        {
+            bits[i >> 6] |= 1ULL << (i & 63);
+        }
+    }
+}
+
+static void fill_block(unsigned long long* bits, const int rows, const bool value)
+{
+    const int words = (rows + 63) / 64;
+    memset(bits, value ? 0xFF : 0, words * sizeof(long long));
+
+    if (value && rows % 64 != 0) bits[words - 1] = (1ULL << (rows % 64)) - 1;
+}
+
+static bool is_block_empty(const unsigned long long* bits, const int words)
+{
+    for (int i = 0; i < words; i++)
+    {
+        if (bits[i] != 0) return false;
+    }
+
+    return true;
+}
+
+/**
+ * Evaluates node over the rows of a block into bits. Every level of the
+ * tree gets its own words of scratch.
+ */
+static void FilterNode_eval(
+    const FilterNode* node,
+    const FilterBinding* bindings,
+    const int block,
+    const int rows,
+    unsigned long long* bits,
+    unsigned long long* scratch
+)
+{
+    const int words = (rows + 63) / 64;
+
+    if (node->type == FILTER_ALL)
+    {
+        fill_block(bits, rows, true);
+        return;
+    }
+
+    if (node->type == FILTER_AND || node->type == FILTER_OR)
+    {
+        FilterNode_eval(node->left, bindings, block, rows, bits, scratch + INDEX_BLOCK_WORDS);
+
+        // Nothing left to select, or to add
+        if (node->type == FILTER_AND && is_block_empty(bits, words)) return;
+
+        FilterNode_eval(node->right, bindings, block, rows, scratch, scratch + INDEX_BLOCK_WORDS);
+
+        for (int i = 0; i < words; i++)
+        {
+            bits[i] = node->type == FILTER_AND ? bits[i] & scratch[i] : bits[i] | scratch[i];
+        }
+
+        return;
+    }
+
+    if (node->type == FILTER_NOT)
+    {
+        FilterNode_eval(node->left, bindings, block, rows, bits, scratch);
+
+        for (int i = 0; i < words; i++) bits[i] = ~bits[i];
+        if (rows % 64 != 0) bits[words - 1] &= (1ULL << (rows % 64)) - 1;
+
+        return;
+    }
+
+    const FilterBinding* binding = &bindings[node->index];
+    const IndexRange* range = &binding->ranges[block];
+    const int* values = binding->values + block * INDEX_BLOCK_ROWS;
+
+    const bool is_range = binding->type == BINDING_RANGE;
+
+    if (binding->type == BINDING_NONE ||
+        (is_range && (binding->low > range->max || binding->high < range->min)))
+    {
+        fill_block(bits, rows, false);
+    }
+    else if (binding->type == BINDING_ALL ||
+             (is_range && binding->low <= range->min && binding->high >= range->max))
+    {
+        fill_block(bits, rows, true);
+    }
+    else if (is_range)
+    {
+        fill_block(bits, rows, false);
+        select_range(values, rows, binding->low, binding->high, bits);
+    }
+    else
+    {
+        fill_block(bits, rows, false);
+
+        for (int i = 0; i < rows; i++)
+        {
+            if (binding->matches[values[i]]) bits[i >> 6] |= 1ULL << (i & 63);
+        }
+    }
+}
+
+ID3v2_IndexSelection* ID3v2_IndexFilter_select(
+    const ID3v2_IndexFilter* filter,
+    ID3v2_IndexSnapshot* snapshot
+)
+{
+    ID3v2_IndexSelection* selection = (ID3v2_IndexSelection*) malloc(sizeof(ID3v2_IndexSelection));
+    selection->snapshot = snapshot;
+    selection->count = 0;
+    selection->rows =
+        (unsigned long long**) calloc(snapshot->segment_count + 1, sizeof(unsigned long long*));
+    __atomic_add_fetch(&snapshot->refs, 1, __ATOMIC_RELAXED);
+
+    FilterBinding* bindings =
+        (FilterBinding*) calloc(filter->predicate_count + 1, sizeof(FilterBinding));
+    unsigned long long* scratch = (unsigned long long*) malloc(
+        (filter->depth + 1) * INDEX_BLOCK_WORDS * sizeof(unsigned long long)
+    );
+
+    for (int s = 0; s < snapshot->segment_count; s++)
+    {
+        IndexSegment* segment = snapshot->segments[s];
+        const IndexDeadMap* dead = snapshot->dead[s];
+        const int words = (segment->row_count + 63) / 64;
+        unsigned long long* bits = (unsigned long long*) calloc(words + 1, sizeof(long long));
+        selection->rows[s] = bits;
+
+        if (segment->row_count == 0) continue;
+
+        const IndexStats* stats = IndexSegment_get_stats(segment);
+        FilterNode_bind(filter->root, segment, stats, bindings);
+
+        for (int block = 0; block < stats->block_count; block++)
+        {
+            const int first_row = block * INDEX_BLOCK_ROWS;
+            const int rows = segment->row_count - first_row < INDEX_BLOCK_ROWS
+                                 ? segment->row_count - first_row
+                                 : INDEX_BLOCK_ROWS;
+            unsigned long long* block_bits = bits + first_row / 64;
+
+            FilterNode_eval(filter->root, bindings, block, rows, block_bits, scratch);
+
+            for (int i = 0; i < (rows + 63) / 64; i++)
+            {
+                // Rows replaced or deleted by newer segments
+                if (dead != NULL)
+                {
+                    unsigned long long hidden = 0;
+                    const unsigned char* dead_bytes = dead->bits + (first_row / 64 + i) * 8;
+                    const int word_rows = rows - i * 64 < 64 ? rows - i * 64 : 64;
+
+                    for (int b = 0; b < (word_rows + 7) / 8; b++)
+                    {
+                        hidden |= (unsigned long long) dead_bytes[b] << (b * 8);
+                    }
+
+                    block_bits[i] &= ~hidden;
+                }
+
+                selection->count += __builtin_popcountll(block_bits[i]);
+            }
+        }
+
+        for (int i = 0; i < filter->predicate_count; i++)
+        {
+            free(bindings[i].matches);
+            bindings[i].matches = NULL;
+        }
+    }
+
+    free(bindings);
+    free(scratch);
+
+    return selection;
+}
+
+int ID3v2_IndexSelection_get_count(const ID3v2_IndexSelection* selection)
+{
+    return selection->count;
+}
+
+int ID3v2_IndexSelection_for_each(
+    const ID3v2_IndexSelection* selection,
+    ID3v2_IndexRowCallback callback,
+    void* callback_ctx
+)
+{
+    const ID3v2_IndexSnapshot* snapshot = selection->snapshot;
+    ID3v2_IndexRow row;
+
+    for (int s = 0; s < snapshot->segment_count; s++)
+    {
+        const unsigned long long* bits = selection->rows[s];
+
+        for (int i = 0; i < (snapshot->segments[s]->row_count + 63) / 64; i++)
+        {
+            for (unsigned long long word = bits[i]; word != 0; word &= word - 1)
+            {
+                IndexSegment_get_row(snapshot->segments[s], i * 64 + __builtin_ctzll(word), &row);
+                if (!callback(&row, callback_ctx)) return ID3v2_OPERATION_CANCELLED;
+            }
+        }
+    }
+
+    return 0;
+}
+
+void ID3v2_IndexSelection_free(ID3v2_IndexSelection* selection)
+{
+    if (selection == NULL) return;
+
+    for (int s = 0; s < selection->snapshot->segment_count; s++)
+    {
+        free(selection->rows[s]);
+    }
+
+    free(selection->rows);
+    ID3v2_IndexSnapshot_release(selection->snapshot);
+    free(selection);
+}
@@ -0,0 +1,58 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_index_filter_private_h
+#define id3v2lib_index_filter_private_h
+
+#include "modules/index_filter.h"
+#include "modules/library_index.private.h"
+
+// Rows are filtered a block at a time, and every block has its own ranges
+#define INDEX_BLOCK_ROWS 1024
+#define INDEX_BLOCK_WORDS (INDEX_BLOCK_ROWS / 64)
+
+typedef struct _IndexRange
+{
+    int min;
+    int max;
+} IndexRange;
+
+/**
+ * What's known about the rows of a segment without reading them, built the
+ * first time the segment is filtered. ranges holds the smallest and largest
+ * value (the code, for string columns) of every block of every column,
+ * followed by the ones of the whole segment. trigrams is a Bloom filter of
+ * every three bytes found in the values of every string column, lowercased.
+ */
+typedef struct _IndexStats
+{
+    int block_count;
+    IndexRange* ranges[ID3v2_INDEX_COLUMN_COUNT];
+    unsigned long long* trigrams[ID3v2_INDEX_STRING_COLUMN_COUNT];
+    unsigned int trigram_mask[ID3v2_INDEX_STRING_COLUMN_COUNT];
+} IndexStats;
+
+const IndexStats* IndexSegment_get_stats(IndexSegment* segment);
+void IndexStats_free(IndexStats* stats);
+
+/**
+ * Returns the codes of a string column, or the values of a numeric one.
+ */
+const int* IndexSegment_get_column(const IndexSegment* segment, const int column);
+
+struct _ID3v2_IndexSelection
+{
+    ID3v2_IndexSnapshot* snapshot;
+    int count;
+    // One bitmap per segment, row r is selected when bit r % 64 of the
+    // word r / 64 is set
+    unsigned long long** rows;
+};
+
+#endif
@@ -0,0 +1,450 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "id3v2lib.h"
+
+#include "index_groups.private.h"
+
+// Fewer rows are counted faster than threads are started
+#define PARALLEL_GROUP_MIN_ROWS (64 * 1024)
+#define MAX_GROUP_THREADS 8
+
+// Words of rows handed to a thread at a time
+#define GROUP_UNIT_WORDS 256
+
+#define GROUP_TABLE_MIN_CAPACITY 256
+
+/**
+ * Rows counted by a thread, by key: the segment and the code of string
+ * values, or the first value of the range of numeric ones. Slots without
+ * rows are empty.
+ */
+typedef struct _GroupTable
+{
+    // Always a power of 2
+    int capacity;
+    int size;
+    unsigned long long* keys;
+    int* counts;
+} GroupTable;
+
+static void GroupTable_init(GroupTable* table, const int capacity)
+{
+    table->capacity = capacity;
+    table->size = 0;
+    table->keys = (unsigned long long*) malloc(capacity * sizeof(unsigned long long));
+    table->counts = (int*) calloc(capacity, sizeof(int));
+}
+
+static void GroupTable_free(GroupTable* table)
+{
+    free(table->keys);
+    free(table->counts);
+}
+
+static int GroupTable_find(const GroupTable* table, const unsigned long long key)
+{
+    const int mask = table->capacity - 1;
+    int slot = (int) ((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+
+    while (table->counts[slot] != 0 && table->keys[slot] != key)
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static void GroupTable_add(GroupTable* table, const unsigned long long key, const int count)
+{
+    int slot = GroupTable_find(table, key);
+
+    if (table->counts[slot] == 0)
+    {
+        if ((table->size + 1) * 2 > table->capacity)
+        {
+            GroupTable grown;
+            GroupTable_init(&grown, table->capacity * 2);
+
+            for (int i = 0; i < table->capacity; i++)
+            {
+                if (table->counts[i] != 0) GroupTable_add(&grown, table->keys[i], table->counts[i]);
+            }
+
+            GroupTable_free(table);
+            *table = grown;
+            slot = GroupTable_find(table, key);
+        }
+
+        table->keys[slot] = key;
+        table->size++;
+    }
+
+    table->counts[slot] += count;
+}
+
+/**
+ * Counting
+ */
+
+typedef struct _GroupJob
+{
+    const ID3v2_IndexSnapshot* snapshot;
+    // Selected rows of every segment, NULL to count the visible ones
+    unsigned long long** rows;
+    int column;
+    int width;
+    // Segment and first word of every unit
+    int* units;
+    int unit_count;
+    int next_unit;
+} GroupJob;
+
+typedef struct _GroupWorker
+{
+    GroupJob* job;
+    GroupTable table;
+} GroupWorker;
+
+static unsigned long long GroupJob_get_word(const GroupJob* job, const int segment, const int word)
+{
+    if (job->rows != NULL) return job->rows[segment][word];
+
+    const int rows = job->snapshot->segments[segment]->row_count - word * 64;
+    unsigned long long bits = rows >= 64 ? ~0ULL : (1ULL << rows) - 1;
+    const IndexDeadMap* dead = job->snapshot->dead[segment];
+
+    if (dead != NULL)
+    {
+        for (int b = 0; b < 8 && b * 8 < rows; b++)
+        {
+            bits &= ~((unsigned long long) dead->bits[word * 8 + b] << (b * 8));
+        }
+    }
+
+    return bits;
+}
+
+static int get_range_start(const int value, const int width)
+{
+    const int start = value / width * width;
+
+    // Division rounds negative values up
+    return start > value ? start - width : start;
+}
+
+static void* count_groups(void* arg)
+{
+    GroupWorker* worker = (GroupWorker*) arg;
+    GroupJob* job = worker->job;
+    const bool strings = job->column < ID3v2_INDEX_STRING_COLUMN_COUNT;
+    int unit;
+
+    while ((unit = __atomic_fetch_add(&job->next_unit, 1, __ATOMIC_RELAXED)) < job->unit_count)
+    {
+        const int segment = job->units[unit * 2];
+        const int first_word = job->units[unit * 2 + 1];
+        const IndexSegment* indexed = job->snapshot->segments[segment];
+        const int* values = IndexSegment_get_column(indexed, job->column);
+        const int words = (indexed->row_count + 63) / 64;
+        const int last_word =
+            first_word + GROUP_UNIT_WORDS < words ? first_word + GROUP_UNIT_WORDS : words;
+
+        // Codes only mean something within their segment
+        const unsigned long long prefix = strings ? (unsigned long long) segment << 32 : 0;
+
+        for (int w = first_word; w < last_word; w++)
+        {
+            for (unsigned long long bits = GroupJob_get_word(job, segment, w); bits != 0;
+                 bits &= bits - 1)
+            {
+                const int value = values[w * 64 + __builtin_ctzll(bits)];
+                const int key = strings ? value : get_range_start(value, job->width);
+
+                GroupTable_add(&worker->table, prefix | (unsigned int) key, 1);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static int compare_texts(const void* a, const void* b)
+{
+    return strcmp(((const ID3v2_IndexGroup*) a)->text, ((const ID3v2_IndexGroup*) b)->text);
+}
+
+static int compare_numbers(const void* a, const void* b)
+{
+    const int x = ((const ID3v2_IndexGroup*) a)->number;
+    const int y = ((const ID3v2_IndexGroup*) b)->number;
+
+    return (x > y) - (x < y);
+}
+
+static ID3v2_IndexGroups* group_by(
+    ID3v2_IndexSnapshot* snapshot,
+    unsigned long long** rows,
+    const int column,
+    const int width
+)
+{
+    const bool strings = column < ID3v2_INDEX_STRING_COLUMN_COUNT;
+    GroupJob job = {snapshot, rows, column, strings || width < 1 ? 1 : width, NULL, 0, 0};
+    int row_count = 0;
+
+    for (int s = 0; s < snapshot->segment_count; s++)
+    {
+        const int words = (snapshot->segments[s]->row_count + 63) / 64;
+        job.unit_count += (words + GROUP_UNIT_WORDS - 1) / GROUP_UNIT_WORDS;
+        row_count += snapshot->segments[s]->row_count;
+    }
+
+    job.units = (int*) malloc((job.unit_count + 1) * 2 * sizeof(int));
+
+    for (int s = 0, unit = 0; s < snapshot->segment_count; s++)
+    {
+        const int words = (snapshot->segments[s]->row_count + 63) / 64;
+
+        for (int word = 0; word < words; word += GROUP_UNIT_WORDS, unit++)
+        {
+            job.units[unit * 2] = s;
+            job.units[unit * 2 + 1] = word;
+        }
+    }
+
+    int threads = 1;
+    if (row_count >= PARALLEL_GROUP_MIN_ROWS)
+    {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+        if (threads > MAX_GROUP_THREADS) threads = MAX_GROUP_THREADS;
+        if (threads > job.unit_count) threads = job.unit_count;
+        if (threads < 1) threads = 1;
+    }
+
+    GroupWorker workers[MAX_GROUP_THREADS];
+    pthread_t threads_started[MAX_GROUP_THREADS];
+    int started = 0;
+
+    for (int i = 0; i < threads; i++)
+    {
+        workers[i].job = &job;
+        GroupTable_init(&workers[i].table, GROUP_TABLE_MIN_CAPACITY);
+    }
+
+    // The calling thread counts too, so rows are counted even if no thread
+    // can be started
+    for (int i = 1; i < threads; i++)
+    {
+        if (pthread_create(&threads_started[started], NULL, count_groups, &workers[started + 1]) ==
+            0)
+        {
+            started++;
+        }
+    }
+
+    count_groups(&workers[0]);
+
+    GroupTable* table = &workers[0].table;
+
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(threads_started[i], NULL);
+    }
+
+    for (int i = 1; i < threads; i++)
+    {
+        const GroupTable* counted = &workers[i].table;
+
+        for (int slot = 0; slot < counted->capacity; slot++)
+        {
+            if (counted->counts[slot] != 0)
+            {
+                GroupTable_add(table, counted->keys[slot], counted->counts[slot]);
+            }
+        }
+
+        GroupTable_free(&workers[i].table);
+    }
+
+    ID3v2_IndexGroups* groups = (ID3v2_IndexGroups*) malloc(sizeof(ID3v2_IndexGroups));
+    groups->snapshot = snapshot;
+    groups->groups = (ID3v2_IndexGroup*) malloc((table->size + 1) * sizeof(ID3v2_IndexGroup));
+    __atomic_add_fetch(&snapshot->refs, 1, __ATOMIC_RELAXED);
+
+    int count = 0;
+
+    for (int slot = 0; slot < table->capacity; slot++)
+    {
+        if (table->counts[slot] == 0) continue;
+
+        ID3v2_IndexGroup* group = &groups->groups[count++];
+        const unsigned long long key = table->keys[slot];
+        group->count = table->counts[slot];
+
+        if (strings)
+        {
+            const IndexSegment* segment = snapshot->segments[key >> 32];
+            group->text = segment->strings[column].values[(unsigned int) key];
+            group->number = 0;
+        }
+        else
+        {
+            group->text = NULL;
+            group->number = (int) (unsigned int) key;
+        }
+    }
+
+    qsort(
+        groups->groups,
+        count,
+        sizeof(ID3v2_IndexGroup),
+        strings ? compare_texts : compare_numbers
+    );
+
+    // Segments have their own dictionaries, so the same value can be found
+    // in several of them
+    if (strings && count > 0)
+    {
+        int merged = 1;
+
+        for (int i = 1; i < count; i++)
+        {
+            if (strcmp(groups->groups[merged - 1].text, groups->groups[i].text) == 0)
+            {
+                groups->groups[merged - 1].count += groups->groups[i].count;
+            }
+            else
+            {
+                groups->groups[merged++] = groups->groups[i];
+            }
+        }
+
+        count = merged;
+    }
+
+    groups->count = count;
+
+    GroupTable_free(table);
+    free(job.units);
+
+    return groups;
+}
+
+ID3v2_IndexGroups* ID3v2_IndexSnapshot_group_by(
+    ID3v2_IndexSnapshot* snapshot,
+    const int column,
+    const int width
+)
+{
+    if (column < 0 || column >= ID3v2_INDEX_COLUMN_COUNT) return NULL;
+
+    return group_by(snapshot, NULL, column, width);
+}
+
+ID3v2_IndexGroups* ID3v2_IndexSelection_group_by(
+    const ID3v2_IndexSelection* selection,
+    const int column,
+    const int width
+)
+{
+    if (column < 0 || column >= ID3v2_INDEX_COLUMN_COUNT) return NULL;
+
+    return group_by(selection->snapshot, selection->rows, column, width);
+}
+
+int ID3v2_IndexGroups_get_count(const ID3v2_IndexGroups* groups)
+{
+    return groups->count;
+}
+
+const ID3v2_IndexGroup* ID3v2_IndexGroups_get(const ID3v2_IndexGroups* groups, const int index)
+{
+    if (index < 0 || index >= groups->count) return NULL;
+
+    return &groups->groups[index];
+}
+
+/**
+ * Top
+ */
+
+// Whether group a comes after group b in a top list
+static bool ranks_below(const ID3v2_IndexGroup* groups, const int a, const int b)
+{
+    return groups[a].count < groups[b].count || (groups[a].count == groups[b].count && a > b);
+}
+
+static void sift_down(int* heap, const int size, int parent, const ID3v2_IndexGroup* groups)
+{
+    while (true)
+    {
+        const int left = parent * 2 + 1;
+        const int right = left + 1;
+        int lowest = parent;
+
+        if (left < size && ranks_below(groups, heap[left], heap[lowest])) lowest = left;
+        if (right < size && ranks_below(groups, heap[right], heap[lowest])) lowest = right;
+        if (lowest == parent) return;
+
+        const int swapped = heap[parent];
+        heap[parent] = heap[lowest];
+        heap[lowest] = swapped;
+        parent = lowest;
+    }
+}
+
+int ID3v2_IndexGroups_top(const ID3v2_IndexGroups* groups, const int k, ID3v2_IndexGroup* dest)
+{
+    const int size = k < groups->count ? k : groups->count;
+    if (size <= 0) return 0;
+
+    // The best groups found so far, with the lowest ranked one on top
+    int* heap = (int*) malloc(size * sizeof(int));
+
+    for (int i = 0; i < size; i++) heap[i] = i;
+    for (int i = size / 2 - 1; i >= 0; i--) sift_down(heap, size, i, groups->groups);
+
+    for (int i = size; i < groups->count; i++)
+    {
+        if (ranks_below(groups->groups, heap[0], i))
+        {
+            heap[0] = i;
+            sift_down(heap, size, 0, groups->groups);
+        }
+    }
+
+    // Lowest ranked first, so dest is filled from its end
+    for (int remaining = size; remaining > 0; remaining--)
+    {
+        dest[remaining - 1] = groups->groups[heap[0]];
+        heap[0] = heap[remaining - 1];
+        sift_down(heap, remaining - 1, 0, groups->groups);
+    }
+
+    free(heap);
+
+    return size;
+}
+
+void ID3v2_IndexGroups_free(ID3v2_IndexGroups* groups)
+{
+    if (groups == NULL) return;
+
+    ID3v2_IndexSnapshot_release(groups->snapshot);
+    free(groups->groups);
+    free(groups);
+}
@@ -0,0 +1,23 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_index_groups_private_h
+#define id3v2lib_index_groups_private_h
+
+#include "modules/index_filter.private.h"
+#include "modules/index_groups.h"
+
+struct _ID3v2_IndexGroups
+{
+    ID3v2_IndexSnapshot* snapshot;
+    int count;
+    ID3v2_IndexGroup* groups;
+};
+
+#endif
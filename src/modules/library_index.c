@@ -0,0 +1,1234 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "id3v2lib.h"
+#include "modules/frames/text_frame.private.h"
+#include "modules/index_filter.private.h"
+#include "modules/utils.private.h"
+
+#include "library_index.private.h"
+
+#define SEGMENT_HEADER_LENGTH 16
+#define MANIFEST_HEADER_LENGTH 28
+#define MANIFEST_FILE_NAME "MANIFEST"
+#define MANIFEST_TMP_FILE_NAME "MANIFEST.tmp"
+#define SEGMENT_FILE_NAME_FORMAT "%s/%016llx.seg"
+// A listed segment may be compacted away by the writer while it's loaded
+#define MAX_REFRESH_ATTEMPTS 8
+
+typedef struct _IndexEntry
+{
+    ID3v2_IndexRow row;
+    bool deleted;
+    int sequence;
+} IndexEntry;
+
+struct _ID3v2_IndexBatch
+{
+    IndexEntry* entries;
+    int count;
+    int capacity;
+};
+
+/**
+ * Readers pin the current generation without taking any lock: they
+ * announce themselves in acquiring[epoch & 1] while they load current and
+ * take a reference, and start over if the epoch moved while they did.
+ * Publishing swaps current, flips the epoch and waits for the readers that
+ * came before the flip, after which nobody can be about to take a
+ * reference on the old generation.
+ */
+struct _ID3v2_LibraryIndex
+{
+    char* directory;
+    pthread_mutex_t write_lock;
+    pthread_mutex_t compact_lock;
+    unsigned long long next_segment_id;
+    ID3v2_IndexSnapshot* current;
+    unsigned int epoch;
+    int acquiring[2];
+};
+
+/**
+ * Files
+ */
+
+static char* read_file(const char* path, long* size)
+{
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    char* data = NULL;
+
+    if (fstat(fd, &st) == 0 && (data = (char*) malloc(st.st_size + 1)) != NULL)
+    {
+        long read_size = 0;
+        ssize_t result = 0;
+
+        while (read_size < st.st_size &&
+               (result = pread(fd, data + read_size, st.st_size - read_size, read_size)) > 0)
+        {
+            read_size += result;
+        }
+
+        if (read_size != st.st_size)
+        {
+            free(data);
+            data = NULL;
+        }
+
+        *size = read_size;
+    }
+
+    close(fd);
+    return data;
+}
+
+static int write_file(const char* path, const char* data, const long size)
+{
+    const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+
+    long written = 0;
+    ssize_t result = 0;
+
+    while (written < size && (result = write(fd, data + written, size - written)) > 0)
+    {
+        written += result;
+    }
+
+    const bool synced = written == size && fsync(fd) == 0;
+    close(fd);
+
+    return synced ? 0 : -1;
+}
+
+static int sync_directory(const char* directory)
+{
+    const int fd = open(directory, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return -1;
+
+    const int result = fsync(fd);
+    close(fd);
+
+    return result;
+}
+
+static char* segment_file_name(const ID3v2_LibraryIndex* index, const unsigned long long id)
+{
+    char* file_name = NULL;
+    if (asprintf(&file_name, SEGMENT_FILE_NAME_FORMAT, index->directory, id) < 0) return NULL;
+
+    return file_name;
+}
+
+static void remove_segment_file(const ID3v2_LibraryIndex* index, const unsigned long long id)
+{
+    char* file_name = segment_file_name(index, id);
+    if (file_name != NULL) unlink(file_name);
+    free(file_name);
+}
+
+/**
+ * Segments
+ */
+
+static void IndexSegment_release(IndexSegment* segment)
+{
+    if (segment == NULL || __atomic_sub_fetch(&segment->refs, 1, __ATOMIC_ACQ_REL) != 0) return;
+
+    for (int column = 0; column < ID3v2_INDEX_STRING_COLUMN_COUNT; column++)
+    {
+        free(segment->strings[column].values);
+        free(segment->strings[column].codes);
+    }
+
+    for (int column = ID3v2_INDEX_STRING_COLUMN_COUNT; column < ID3v2_INDEX_COLUMN_COUNT; column++)
+    {
+        free(segment->numbers[column]);
+    }
+
+    IndexStats_free(segment->stats);
+    free(segment->data);
+    free(segment);
+}
+
+/**
+ * Loads a segment out of the contents of its file, which it keeps. Returns
+ * NULL, freeing data, if the file isn't a valid segment.
+ */
+static IndexSegment* IndexSegment_parse(const unsigned long long id, char* data, const long size)
+{
+    IndexSegment* segment = (IndexSegment*) calloc(1, sizeof(IndexSegment));
+    segment->id = id;
+    segment->refs = 1;
+    segment->data = data;
+
+    if (size < SEGMENT_HEADER_LENGTH || memcmp(data, INDEX_SEGMENT_MAGIC, 4) != 0 ||
+        data[4] != INDEX_FORMAT_VERSION)
+    {
+        IndexSegment_release(segment);
+        return NULL;
+    }
+
+    const long row_count = btoi(data + 8, 4);
+    const long heap_size = btoi(data + 12, 4);
+    const long heap_offset = size - heap_size;
+    long cursor = SEGMENT_HEADER_LENGTH;
+    bool valid = heap_offset >= cursor && (heap_size == 0 || data[size - 1] == '\0');
+
+    segment->row_count = row_count;
+
+    for (int column = 0; valid && column < ID3v2_INDEX_STRING_COLUMN_COUNT; column++)
+    {
+        IndexDictionary* dictionary = &segment->strings[column];
+
+        if (cursor + 4 > heap_offset)
+        {
+            valid = false;
+            break;
+        }
+
+        const long count = btoi(data + cursor, 4);
+        cursor += 4;
+
+        if (cursor + (count + row_count) * 4 > heap_offset)
+        {
+            valid = false;
+            break;
+        }
+
+        dictionary->count = count;
+        dictionary->values = (const char**) malloc((count + 1) * sizeof(char*));
+        dictionary->codes = (int*) malloc((row_count + 1) * sizeof(int));
+
+        for (long i = 0; valid && i < count; i++, cursor += 4)
+        {
+            const long offset = btoi(data + cursor, 4);
+            valid = offset < heap_size;
+            if (valid) dictionary->values[i] = data + heap_offset + offset;
+        }
+
+        for (long row = 0; valid && row < row_count; row++, cursor += 4)
+        {
+            // Checked before it's stored, codes past INT_MAX would turn negative
+            const unsigned int code = btoi(data + cursor, 4);
+            valid = code < (unsigned long) count;
+            if (valid) dictionary->codes[row] = code;
+        }
+    }
+
+    for (int column = ID3v2_INDEX_STRING_COLUMN_COUNT; valid && column < ID3v2_INDEX_COLUMN_COUNT;
+         column++)
+    {
+        if (cursor + row_count * 4 > heap_offset)
+        {
+            valid = false;
+            break;
+        }
+
+        segment->numbers[column] = (int*) malloc((row_count + 1) * sizeof(int));
+
+        for (long row = 0; row < row_count; row++, cursor += 4)
+        {
+            segment->numbers[column][row] = (int) btoi(data + cursor, 4);
+        }
+    }
+
+    valid = valid && cursor + row_count == heap_offset;
+
+    // Finding paths relies on them being sorted
+    const IndexDictionary* paths = &segment->strings[ID3v2_INDEX_PATH];
+    valid = valid && paths->count == row_count;
+
+    for (long row = 0; valid && row < row_count; row++)
+    {
+        valid = paths->codes[row] == row &&
+                (row == 0 || strcmp(paths->values[row - 1], paths->values[row]) < 0);
+    }
+
+    if (!valid)
+    {
+        IndexSegment_release(segment);
+        return NULL;
+    }
+
+    segment->flags = (const unsigned char*) data + cursor;
+    return segment;
+}
+
+typedef struct _IndexValue
+{
+    const char* text;
+    int row;
+} IndexValue;
+
+static int IndexValue_compare(const void* a, const void* b)
+{
+    const IndexValue* value_a = (const IndexValue*) a;
+    const IndexValue* value_b = (const IndexValue*) b;
+
+    const int result = strcmp(value_a->text, value_b->text);
+    return result != 0 ? result : value_a->row - value_b->row;
+}
+
+/**
+ * Lays out a segment file holding entries, which have to be sorted by path
+ * and hold every path once.
+ */
+static char* IndexSegment_encode(const IndexEntry* entries, const int count, long* size)
+{
+    IndexValue* values[ID3v2_INDEX_STRING_COLUMN_COUNT];
+    int distinct[ID3v2_INDEX_STRING_COLUMN_COUNT];
+    long heap_size = 0;
+
+    for (int column = 0; column < ID3v2_INDEX_STRING_COLUMN_COUNT; column++)
+    {
+        values[column] = (IndexValue*) malloc((count + 1) * sizeof(IndexValue));
+
+        for (int row = 0; row < count; row++)
+        {
+            const char* text = entries[row].row.strings[column];
+            values[column][row] = (IndexValue){text != NULL ? text : "", row};
+        }
+
+        // Paths are sorted already
+        if (column != ID3v2_INDEX_PATH)
+        {
+            qsort(values[column], count, sizeof(IndexValue), IndexValue_compare);
+        }
+
+        distinct[column] = 0;
+
+        for (int i = 0; i < count; i++)
+        {
+            if (i > 0 && strcmp(values[column][i - 1].text, values[column][i].text) == 0) continue;
+
+            distinct[column]++;
+            heap_size += strlen(values[column][i].text) + 1;
+        }
+    }
+
+    *size = SEGMENT_HEADER_LENGTH + count +
+            (long) ID3v2_INDEX_STRING_COLUMN_COUNT * 4 * (count + 1) +
+            (long) (ID3v2_INDEX_COLUMN_COUNT - ID3v2_INDEX_STRING_COLUMN_COUNT) * 4 * count +
+            heap_size;
+
+    for (int column = 0; column < ID3v2_INDEX_STRING_COLUMN_COUNT; column++)
+    {
+        *size += (long) distinct[column] * 4;
+    }
+
+    char* data = (char*) malloc(*size);
+    char* heap = data + *size - heap_size;
+    long heap_cursor = 0;
+    long cursor = SEGMENT_HEADER_LENGTH;
+
+    memcpy(data, INDEX_SEGMENT_MAGIC, 4);
+    memset(data + 4, 0, 4);
+    data[4] = INDEX_FORMAT_VERSION;
+    ulltob(count, data + 8, 4);
+    ulltob(heap_size, data + 12, 4);
+
+    for (int column = 0; column < ID3v2_INDEX_STRING_COLUMN_COUNT; column++)
+    {
+        char* offsets = data + cursor + 4;
+        char* codes = offsets + distinct[column] * 4;
+        int code = -1;
+
+        ulltob(distinct[column], data + cursor, 4);
+
+        for (int i = 0; i < count; i++)
+        {
+            const IndexValue* value = &values[column][i];
+
+            if (i == 0 || strcmp(values[column][i - 1].text, value->text) != 0)
+            {
+                const long length = strlen(value->text) + 1;
+
+                ulltob(heap_cursor, offsets + ++code * 4, 4);
+                memcpy(heap + heap_cursor, value->text, length);
+                heap_cursor += length;
+            }
+
+            ulltob(code, codes + value->row * 4, 4);
+        }
+
+        cursor += 4 + (long) (distinct[column] + count) * 4;
+        free(values[column]);
+    }
+
+    for (int column = ID3v2_INDEX_STRING_COLUMN_COUNT; column < ID3v2_INDEX_COLUMN_COUNT; column++)
+    {
+        for (int row = 0; row < count; row++, cursor += 4)
+        {
+            ulltob((unsigned int) entries[row].row.numbers[column], data + cursor, 4);
+        }
+    }
+
+    for (int row = 0; row < count; row++)
+    {
+        data[cursor++] = entries[row].deleted ? INDEX_ROW_DELETED : 0;
+    }
+
+    return data;
+}
+
+/**
+ * Writes entries as the segment file id and loads it.
+ */
+static IndexSegment* IndexSegment_write(
+    const ID3v2_LibraryIndex* index,
+    const unsigned long long id,
+    const IndexEntry* entries,
+    const int count
+)
+{
+    char* file_name = segment_file_name(index, id);
+    long size = 0;
+    char* data = IndexSegment_encode(entries, count, &size);
+    IndexSegment* segment = NULL;
+
+    if (file_name != NULL && write_file(file_name, data, size) == 0)
+    {
+        segment = IndexSegment_parse(id, data, size);
+    }
+    else
+    {
+        free(data);
+    }
+
+    if (segment == NULL) remove_segment_file(index, id);
+
+    free(file_name);
+    return segment;
+}
+
+static IndexSegment* IndexSegment_load(const ID3v2_LibraryIndex* index, const unsigned long long id)
+{
+    char* file_name = segment_file_name(index, id);
+    long size = 0;
+    char* data = file_name != NULL ? read_file(file_name, &size) : NULL;
+
+    free(file_name);
+    return data != NULL ? IndexSegment_parse(id, data, size) : NULL;
+}
+
+int IndexSegment_find(const IndexSegment* segment, const char* path)
+{
+    const char* const* paths = segment->strings[ID3v2_INDEX_PATH].values;
+    int low = 0;
+    int high = segment->row_count - 1;
+
+    while (low <= high)
+    {
+        const int middle = low + (high - low) / 2;
+        const int result = strcmp(paths[middle], path);
+
+        if (result == 0) return middle;
+
+        if (result < 0) low = middle + 1;
+        else high = middle - 1;
+    }
+
+    return -1;
+}
+
+void IndexSegment_get_row(const IndexSegment* segment, const int row, ID3v2_IndexRow* dest)
+{
+    memset(dest, 0, sizeof(ID3v2_IndexRow));
+
+    for (int column = 0; column < ID3v2_INDEX_STRING_COLUMN_COUNT; column++)
+    {
+        const IndexDictionary* dictionary = &segment->strings[column];
+        dest->strings[column] = dictionary->values[dictionary->codes[row]];
+    }
+
+    for (int column = ID3v2_INDEX_STRING_COLUMN_COUNT; column < ID3v2_INDEX_COLUMN_COUNT; column++)
+    {
+        dest->numbers[column] = segment->numbers[column][row];
+    }
+}
+
+/**
+ * Generations
+ */
+
+static void IndexDeadMap_release(IndexDeadMap* map)
+{
+    if (map != NULL && __atomic_sub_fetch(&map->refs, 1, __ATOMIC_ACQ_REL) == 0) free(map);
+}
+
+static ID3v2_IndexSnapshot* IndexSnapshot_new(
+    const ID3v2_IndexSnapshot* base,
+    const int capacity,
+    const unsigned long long generation
+)
+{
+    ID3v2_IndexSnapshot* snapshot = (ID3v2_IndexSnapshot*) malloc(sizeof(ID3v2_IndexSnapshot));
+    snapshot->refs = 1;
+    snapshot->generation = generation;
+    snapshot->row_count = 0;
+    snapshot->segment_count = 0;
+    snapshot->segments = (IndexSegment**) malloc((capacity + 1) * sizeof(IndexSegment*));
+    snapshot->dead = (IndexDeadMap**) malloc((capacity + 1) * sizeof(IndexDeadMap*));
+
+    if (base == NULL) return snapshot;
+
+    // The segments of the base and their dead maps are shared, not copied
+    for (int i = 0; i < base->segment_count; i++)
+    {
+        snapshot->segments[i] = base->segments[i];
+        snapshot->dead[i] = base->dead[i];
+
+        __atomic_add_fetch(&snapshot->segments[i]->refs, 1, __ATOMIC_RELAXED);
+
+        if (snapshot->dead[i] != NULL)
+        {
+            __atomic_add_fetch(&snapshot->dead[i]->refs, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    snapshot->segment_count = base->segment_count;
+    snapshot->row_count = base->row_count;
+
+    return snapshot;
+}
+
+void ID3v2_IndexSnapshot_release(ID3v2_IndexSnapshot* snapshot)
+{
+    if (snapshot == NULL || __atomic_sub_fetch(&snapshot->refs, 1, __ATOMIC_ACQ_REL) != 0) return;
+
+    for (int i = 0; i < snapshot->segment_count; i++)
+    {
+        IndexSegment_release(snapshot->segments[i]);
+        IndexDeadMap_release(snapshot->dead[i]);
+    }
+
+    free(snapshot->segments);
+    free(snapshot->dead);
+    free(snapshot);
+}
+
+bool IndexSnapshot_is_visible(
+    const ID3v2_IndexSnapshot* snapshot,
+    const int segment,
+    const int row
+)
+{
+    const IndexDeadMap* map = snapshot->dead[segment];
+    return map == NULL || (map->bits[row >> 3] & (1 << (row & 7))) == 0;
+}
+
+/**
+ * Hides a row of one of the segments of a generation that isn't published
+ * yet. Dead maps shared with other generations are copied first.
+ */
+static void IndexSnapshot_hide(ID3v2_IndexSnapshot* snapshot, const int segment, const int row)
+{
+    IndexDeadMap* map = snapshot->dead[segment];
+
+    if (map == NULL || __atomic_load_n(&map->refs, __ATOMIC_ACQUIRE) > 1)
+    {
+        const int size = (snapshot->segments[segment]->row_count + 7) / 8;
+        IndexDeadMap* copy = (IndexDeadMap*) calloc(1, sizeof(IndexDeadMap) + size);
+        copy->refs = 1;
+
+        if (map != NULL)
+        {
+            memcpy(copy->bits, map->bits, size);
+            IndexDeadMap_release(map);
+        }
+
+        snapshot->dead[segment] = map = copy;
+    }
+
+    map->bits[row >> 3] |= 1 << (row & 7);
+}
+
+/**
+ * Adds a segment on top of the others. The rows it holds replace the ones
+ * older segments hold for the same paths, so the cost only depends on its
+ * own size.
+ */
+static void IndexSnapshot_append(ID3v2_IndexSnapshot* snapshot, IndexSegment* segment)
+{
+    const int index = snapshot->segment_count++;
+
+    __atomic_add_fetch(&segment->refs, 1, __ATOMIC_RELAXED);
+    snapshot->segments[index] = segment;
+    snapshot->dead[index] = NULL;
+
+    for (int row = 0; row < segment->row_count; row++)
+    {
+        const char* path = segment->strings[ID3v2_INDEX_PATH].values[row];
+
+        // Only the newest older row for the path can still be visible
+        for (int older = index - 1; older >= 0; older--)
+        {
+            const int older_row = IndexSegment_find(snapshot->segments[older], path);
+            if (older_row < 0) continue;
+
+            if (IndexSnapshot_is_visible(snapshot, older, older_row))
+            {
+                IndexSnapshot_hide(snapshot, older, older_row);
+                snapshot->row_count--;
+            }
+
+            break;
+        }
+
+        if (segment->flags[row] & INDEX_ROW_DELETED)
+        {
+            IndexSnapshot_hide(snapshot, index, row);
+        }
+        else
+        {
+            snapshot->row_count++;
+        }
+    }
+}
+
+unsigned long long ID3v2_IndexSnapshot_get_generation(const ID3v2_IndexSnapshot* snapshot)
+{
+    return snapshot->generation;
+}
+
+int ID3v2_IndexSnapshot_get_segment_count(const ID3v2_IndexSnapshot* snapshot)
+{
+    return snapshot->segment_count;
+}
+
+int ID3v2_IndexSnapshot_get_row_count(const ID3v2_IndexSnapshot* snapshot)
+{
+    return snapshot->row_count;
+}
+
+bool ID3v2_IndexSnapshot_find(
+    const ID3v2_IndexSnapshot* snapshot,
+    const char* path,
+    ID3v2_IndexRow* row
+)
+{
+    for (int segment = snapshot->segment_count - 1; segment >= 0; segment--)
+    {
+        const int found = IndexSegment_find(snapshot->segments[segment], path);
+        if (found < 0) continue;
+
+        // Only deleted rows can be hidden in the newest segment holding a path
+        if (!IndexSnapshot_is_visible(snapshot, segment, found)) return false;
+
+        IndexSegment_get_row(snapshot->segments[segment], found, row);
+        return true;
+    }
+
+    return false;
+}
+
+int ID3v2_IndexSnapshot_for_each(
+    const ID3v2_IndexSnapshot* snapshot,
+    ID3v2_IndexRowCallback callback,
+    void* callback_ctx
+)
+{
+    ID3v2_IndexRow row;
+
+    for (int segment = 0; segment < snapshot->segment_count; segment++)
+    {
+        for (int i = 0; i < snapshot->segments[segment]->row_count; i++)
+        {
+            if (!IndexSnapshot_is_visible(snapshot, segment, i)) continue;
+
+            IndexSegment_get_row(snapshot->segments[segment], i, &row);
+            if (!callback(&row, callback_ctx)) return ID3v2_OPERATION_CANCELLED;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Manifest
+ */
+
+/**
+ * Reads the list of segments of the index, which is empty if there isn't
+ * a manifest yet. Returns 0 on success and -1 on error.
+ */
+static int LibraryIndex_read_manifest(
+    const ID3v2_LibraryIndex* index,
+    unsigned long long* generation,
+    unsigned long long* next_segment_id,
+    unsigned long long** segment_ids,
+    int* segment_count
+)
+{
+    char* file_name = NULL;
+    if (asprintf(&file_name, "%s/" MANIFEST_FILE_NAME, index->directory) < 0) return -1;
+
+    long size = 0;
+    char* data = read_file(file_name, &size);
+    const bool missing = data == NULL && errno == ENOENT;
+    free(file_name);
+
+    *generation = 0;
+    *next_segment_id = 0;
+    *segment_ids = NULL;
+    *segment_count = 0;
+
+    if (data == NULL) return missing ? 0 : -1;
+
+    const bool valid = size >= MANIFEST_HEADER_LENGTH &&
+                       memcmp(data, INDEX_MANIFEST_MAGIC, 4) == 0 &&
+                       data[4] == INDEX_FORMAT_VERSION &&
+                       size == MANIFEST_HEADER_LENGTH + (long) btoi(data + 24, 4) * 8;
+
+    if (valid)
+    {
+        *generation = btoull(data + 8, 8);
+        *next_segment_id = btoull(data + 16, 8);
+        *segment_count = btoi(data + 24, 4);
+        *segment_ids = (unsigned long long*) malloc((*segment_count + 1) * sizeof(long long));
+
+        for (int i = 0; i < *segment_count; i++)
+        {
+            (*segment_ids)[i] = btoull(data + MANIFEST_HEADER_LENGTH + i * 8, 8);
+        }
+    }
+
+    free(data);
+    return valid ? 0 : -1;
+}
+
+/**
+ * Replaces the manifest with the one listing the segments of snapshot. The
+ * new one is written apart and renamed over the old one, so readers either
+ * see one or the other.
+ */
+static int LibraryIndex_write_manifest(
+    const ID3v2_LibraryIndex* index,
+    const ID3v2_IndexSnapshot* snapshot,
+    const unsigned long long next_segment_id
+)
+{
+    const long size = MANIFEST_HEADER_LENGTH + (long) snapshot->segment_count * 8;
+    char* data = (char*) calloc(1, size);
+
+    memcpy(data, INDEX_MANIFEST_MAGIC, 4);
+    data[4] = INDEX_FORMAT_VERSION;
+    ulltob(snapshot->generation, data + 8, 8);
+    ulltob(next_segment_id, data + 16, 8);
+    ulltob(snapshot->segment_count, data + 24, 4);
+
+    for (int i = 0; i < snapshot->segment_count; i++)
+    {
+        ulltob(snapshot->segments[i]->id, data + MANIFEST_HEADER_LENGTH + i * 8, 8);
+    }
+
+    char* tmp_file_name = NULL;
+    char* file_name = NULL;
+    int result = -1;
+
+    if (asprintf(&tmp_file_name, "%s/" MANIFEST_TMP_FILE_NAME, index->directory) >= 0 &&
+        asprintf(&file_name, "%s/" MANIFEST_FILE_NAME, index->directory) >= 0 &&
+        write_file(tmp_file_name, data, size) == 0 && rename(tmp_file_name, file_name) == 0)
+    {
+        result = sync_directory(index->directory);
+    }
+
+    free(tmp_file_name);
+    free(file_name);
+    free(data);
+
+    return result;
+}
+
+/**
+ * Index
+ */
+
+static void LibraryIndex_publish(ID3v2_LibraryIndex* index, ID3v2_IndexSnapshot* snapshot)
+{
+    ID3v2_IndexSnapshot* previous =
+        __atomic_exchange_n(&index->current, snapshot, __ATOMIC_SEQ_CST);
+    const unsigned int epoch = __atomic_fetch_add(&index->epoch, 1, __ATOMIC_SEQ_CST) & 1;
+
+    // Readers that may have loaded the previous generation are about done
+    while (__atomic_load_n(&index->acquiring[epoch], __ATOMIC_SEQ_CST) != 0)
+    {
+        sched_yield();
+    }
+
+    ID3v2_IndexSnapshot_release(previous);
+}
+
+ID3v2_IndexSnapshot* ID3v2_LibraryIndex_acquire(ID3v2_LibraryIndex* index)
+{
+    for (;;)
+    {
+        const unsigned int epoch = __atomic_load_n(&index->epoch, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&index->acquiring[epoch & 1], 1, __ATOMIC_SEQ_CST);
+
+        // A publish that flipped the epoch before we were counted won't
+        // wait for us, and the one after it would only wait on the other
+        // counter
+        if (__atomic_load_n(&index->epoch, __ATOMIC_SEQ_CST) != epoch)
+        {
+            __atomic_sub_fetch(&index->acquiring[epoch & 1], 1, __ATOMIC_SEQ_CST);
+            continue;
+        }
+
+        ID3v2_IndexSnapshot* snapshot = __atomic_load_n(&index->current, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&snapshot->refs, 1, __ATOMIC_RELAXED);
+
+        __atomic_sub_fetch(&index->acquiring[epoch & 1], 1, __ATOMIC_SEQ_CST);
+        return snapshot;
+    }
+}
+
+static IndexSegment* IndexSnapshot_get_segment(
+    const ID3v2_IndexSnapshot* snapshot,
+    const unsigned long long id
+)
+{
+    for (int i = 0; i < snapshot->segment_count; i++)
+    {
+        if (snapshot->segments[i]->id == id) return snapshot->segments[i];
+    }
+
+    return NULL;
+}
+
+/**
+ * Builds the generation listing segment_ids. When it only adds segments on
+ * top of the current one, the current one is extended. Otherwise (after a
+ * compaction) it's built from scratch, reusing the segments that are
+ * loaded already.
+ */
+static ID3v2_IndexSnapshot* LibraryIndex_load(
+    ID3v2_LibraryIndex* index,
+    const unsigned long long generation,
+    const unsigned long long* segment_ids,
+    const int segment_count
+)
+{
+    const ID3v2_IndexSnapshot* current = index->current;
+    bool extends = current->segment_count <= segment_count;
+
+    for (int i = 0; extends && i < current->segment_count; i++)
+    {
+        extends = current->segments[i]->id == segment_ids[i];
+    }
+
+    ID3v2_IndexSnapshot* snapshot =
+        IndexSnapshot_new(extends ? current : NULL, segment_count, generation);
+
+    for (int i = snapshot->segment_count; i < segment_count; i++)
+    {
+        IndexSegment* segment = IndexSnapshot_get_segment(current, segment_ids[i]);
+
+        if (segment != NULL)
+        {
+            IndexSnapshot_append(snapshot, segment);
+            continue;
+        }
+
+        if ((segment = IndexSegment_load(index, segment_ids[i])) == NULL)
+        {
+            ID3v2_IndexSnapshot_release(snapshot);
+            return NULL;
+        }
+
+        IndexSnapshot_append(snapshot, segment);
+        IndexSegment_release(segment);
+    }
+
+    return snapshot;
+}
+
+int ID3v2_LibraryIndex_refresh(ID3v2_LibraryIndex* index)
+{
+    int result = -1;
+
+    pthread_mutex_lock(&index->write_lock);
+
+    for (int attempt = 0; result < 0 && attempt < MAX_REFRESH_ATTEMPTS; attempt++)
+    {
+        unsigned long long generation = 0;
+        unsigned long long next_segment_id = 0;
+        unsigned long long* segment_ids = NULL;
+        int segment_count = 0;
+
+        if (LibraryIndex_read_manifest(
+                index,
+                &generation,
+                &next_segment_id,
+                &segment_ids,
+                &segment_count
+            ) < 0)
+        {
+            break;
+        }
+
+        if (generation == index->current->generation)
+        {
+            result = 0;
+        }
+        else
+        {
+            ID3v2_IndexSnapshot* snapshot =
+                LibraryIndex_load(index, generation, segment_ids, segment_count);
+
+            if (snapshot != NULL)
+            {
+                index->next_segment_id = next_segment_id;
+                LibraryIndex_publish(index, snapshot);
+                result = 0;
+            }
+        }
+
+        free(segment_ids);
+    }
+
+    pthread_mutex_unlock(&index->write_lock);
+
+    return result;
+}
+
+ID3v2_LibraryIndex* ID3v2_LibraryIndex_open(const char* directory)
+{
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) return NULL;
+
+    ID3v2_LibraryIndex* index = (ID3v2_LibraryIndex*) calloc(1, sizeof(ID3v2_LibraryIndex));
+    index->directory = strdup(directory);
+    index->current = IndexSnapshot_new(NULL, 0, 0);
+    pthread_mutex_init(&index->write_lock, NULL);
+    pthread_mutex_init(&index->compact_lock, NULL);
+
+    if (ID3v2_LibraryIndex_refresh(index) < 0)
+    {
+        ID3v2_LibraryIndex_close(index);
+        return NULL;
+    }
+
+    return index;
+}
+
+void ID3v2_LibraryIndex_close(ID3v2_LibraryIndex* index)
+{
+    if (index == NULL) return;
+
+    ID3v2_IndexSnapshot_release(index->current);
+    pthread_mutex_destroy(&index->write_lock);
+    pthread_mutex_destroy(&index->compact_lock);
+    free(index->directory);
+    free(index);
+}
+
+static int IndexEntry_compare(const void* a, const void* b)
+{
+    const IndexEntry* entry_a = (const IndexEntry*) a;
+    const IndexEntry* entry_b = (const IndexEntry*) b;
+
+    const int result =
+        strcmp(entry_a->row.strings[ID3v2_INDEX_PATH], entry_b->row.strings[ID3v2_INDEX_PATH]);
+    return result != 0 ? result : entry_a->sequence - entry_b->sequence;
+}
+
+int ID3v2_LibraryIndex_commit(ID3v2_LibraryIndex* index, ID3v2_IndexBatch* batch)
+{
+    if (batch->count == 0) return 0;
+
+    // Keep the last entry of every path
+    IndexEntry* entries = (IndexEntry*) malloc(batch->count * sizeof(IndexEntry));
+    memcpy(entries, batch->entries, batch->count * sizeof(IndexEntry));
+    qsort(entries, batch->count, sizeof(IndexEntry), IndexEntry_compare);
+
+    int count = 0;
+
+    for (int i = 0; i < batch->count; i++)
+    {
+        if (count > 0 && strcmp(
+                             entries[count - 1].row.strings[ID3v2_INDEX_PATH],
+                             entries[i].row.strings[ID3v2_INDEX_PATH]
+                         ) == 0)
+        {
+            count--;
+        }
+
+        entries[count++] = entries[i];
+    }
+
+    pthread_mutex_lock(&index->write_lock);
+
+    const unsigned long long id = index->next_segment_id;
+    IndexSegment* segment = IndexSegment_write(index, id, entries, count);
+    int result = -1;
+
+    if (segment != NULL)
+    {
+        ID3v2_IndexSnapshot* snapshot = IndexSnapshot_new(
+            index->current,
+            index->current->segment_count + 1,
+            index->current->generation + 1
+        );
+        IndexSnapshot_append(snapshot, segment);
+
+        if (LibraryIndex_write_manifest(index, snapshot, id + 1) == 0)
+        {
+            index->next_segment_id = id + 1;
+            LibraryIndex_publish(index, snapshot);
+            result = 0;
+        }
+        else
+        {
+            ID3v2_IndexSnapshot_release(snapshot);
+            remove_segment_file(index, id);
+        }
+
+        IndexSegment_release(segment);
+    }
+
+    pthread_mutex_unlock(&index->write_lock);
+
+    free(entries);
+    return result;
+}
+
+int ID3v2_LibraryIndex_compact(ID3v2_LibraryIndex* index)
+{
+    pthread_mutex_lock(&index->compact_lock);
+
+    pthread_mutex_lock(&index->write_lock);
+    ID3v2_IndexSnapshot* compacted = ID3v2_LibraryIndex_acquire(index);
+    const unsigned long long id = index->next_segment_id++;
+    pthread_mutex_unlock(&index->write_lock);
+
+    bool has_dead_rows = false;
+
+    for (int i = 0; i < compacted->segment_count; i++)
+    {
+        has_dead_rows = has_dead_rows || compacted->dead[i] != NULL;
+    }
+
+    if (compacted->segment_count < 2 && !has_dead_rows)
+    {
+        ID3v2_IndexSnapshot_release(compacted);
+        pthread_mutex_unlock(&index->compact_lock);
+        return 0;
+    }
+
+    // Rows keep pointing into the segments, which the snapshot keeps loaded
+    IndexEntry* entries = (IndexEntry*) malloc((compacted->row_count + 1) * sizeof(IndexEntry));
+    int count = 0;
+
+    for (int segment = 0; segment < compacted->segment_count; segment++)
+    {
+        for (int row = 0; row < compacted->segments[segment]->row_count; row++)
+        {
+            if (!IndexSnapshot_is_visible(compacted, segment, row)) continue;
+
+            IndexSegment_get_row(compacted->segments[segment], row, &entries[count].row);
+            entries[count].deleted = false;
+            entries[count].sequence = count;
+            count++;
+        }
+    }
+
+    qsort(entries, count, sizeof(IndexEntry), IndexEntry_compare);
+
+    IndexSegment* merged = IndexSegment_write(index, id, entries, count);
+    const bool written = merged != NULL;
+    int result = -1;
+    free(entries);
+
+    if (merged != NULL)
+    {
+        pthread_mutex_lock(&index->write_lock);
+
+        // Segments committed since the merge started go on top of it
+        const ID3v2_IndexSnapshot* current = index->current;
+        bool compactable = current->segment_count >= compacted->segment_count;
+
+        for (int i = 0; compactable && i < compacted->segment_count; i++)
+        {
+            compactable = current->segments[i] == compacted->segments[i];
+        }
+
+        ID3v2_IndexSnapshot* snapshot = NULL;
+
+        if (compactable)
+        {
+            const int newer_count = current->segment_count - compacted->segment_count;
+            snapshot = IndexSnapshot_new(NULL, newer_count + 1, current->generation + 1);
+            IndexSnapshot_append(snapshot, merged);
+
+            for (int i = compacted->segment_count; i < current->segment_count; i++)
+            {
+                IndexSnapshot_append(snapshot, current->segments[i]);
+            }
+        }
+
+        if (snapshot != NULL &&
+            LibraryIndex_write_manifest(index, snapshot, index->next_segment_id) == 0)
+        {
+            LibraryIndex_publish(index, snapshot);
+            result = 0;
+        }
+        else
+        {
+            ID3v2_IndexSnapshot_release(snapshot);
+        }
+
+        pthread_mutex_unlock(&index->write_lock);
+        IndexSegment_release(merged);
+    }
+
+    if (result == 0)
+    {
+        // Segments stay loaded for as long as a generation lists them
+        for (int i = 0; i < compacted->segment_count; i++)
+        {
+            remove_segment_file(index, compacted->segments[i]->id);
+        }
+    }
+    else if (written)
+    {
+        remove_segment_file(index, id);
+    }
+
+    ID3v2_IndexSnapshot_release(compacted);
+    pthread_mutex_unlock(&index->compact_lock);
+
+    return result;
+}
+
+/**
+ * Batches
+ */
+
+ID3v2_IndexBatch* ID3v2_IndexBatch_new()
+{
+    return (ID3v2_IndexBatch*) calloc(1, sizeof(ID3v2_IndexBatch));
+}
+
+void ID3v2_IndexBatch_free(ID3v2_IndexBatch* batch)
+{
+    if (batch == NULL) return;
+
+    for (int i = 0; i < batch->count; i++)
+    {
+        for (int column = 0; column < ID3v2_INDEX_STRING_COLUMN_COUNT; column++)
+        {
+            free((char*) batch->entries[i].row.strings[column]);
+        }
+    }
+
+    free(batch->entries);
+    free(batch);
+}
+
+/**
+ * Adds an empty entry for path, whose strings are owned by the batch.
+ */
+static IndexEntry* IndexBatch_add(ID3v2_IndexBatch* batch, const char* path, const bool deleted)
+{
+    if (batch->count == batch->capacity)
+    {
+        batch->capacity = batch->capacity == 0 ? 64 : batch->capacity * 2;
+        batch->entries =
+            (IndexEntry*) realloc(batch->entries, batch->capacity * sizeof(IndexEntry));
+    }
+
+    IndexEntry* entry = &batch->entries[batch->count];
+    memset(entry, 0, sizeof(IndexEntry));
+    entry->row.strings[ID3v2_INDEX_PATH] = strdup(path);
+    entry->deleted = deleted;
+    entry->sequence = batch->count++;
+
+    return entry;
+}
+
+void ID3v2_IndexBatch_put(ID3v2_IndexBatch* batch, const ID3v2_IndexRow* row)
+{
+    IndexEntry* entry = IndexBatch_add(batch, row->strings[ID3v2_INDEX_PATH], false);
+
+    for (int column = 0; column < ID3v2_INDEX_COLUMN_COUNT; column++)
+    {
+        if (column == ID3v2_INDEX_PATH) continue;
+
+        if (column < ID3v2_INDEX_STRING_COLUMN_COUNT)
+        {
+            const char* text = row->strings[column];
+            entry->row.strings[column] = strdup(text != NULL ? text : "");
+        }
+        else
+        {
+            entry->row.numbers[column] = row->numbers[column];
+        }
+    }
+}
+
+static const char* text_frame_utf8(ID3v2_TextFrame* frame)
+{
+    return frame != NULL ? TextFrame_get_utf8(frame) : strdup("");
+}
+
+void ID3v2_IndexBatch_put_tag(ID3v2_IndexBatch* batch, const char* path, ID3v2_Tag* tag)
+{
+    IndexEntry* entry = IndexBatch_add(batch, path, false);
+    ID3v2_IndexRow* row = &entry->row;
+
+    row->strings[ID3v2_INDEX_TITLE] = text_frame_utf8(ID3v2_Tag_get_title_frame(tag));
+    row->strings[ID3v2_INDEX_ARTIST] = text_frame_utf8(ID3v2_Tag_get_artist_frame(tag));
+    row->strings[ID3v2_INDEX_ALBUM] = text_frame_utf8(ID3v2_Tag_get_album_frame(tag));
+    row->strings[ID3v2_INDEX_ALBUM_ARTIST] =
+        text_frame_utf8(ID3v2_Tag_get_album_artist_frame(tag));
+
+    // Numeric genres are stored by their name
+    ID3v2_Genre genre;
+
+    if (ID3v2_Tag_get_genres(tag, &genre, 1) == 1 && genre.name != NULL)
+    {
+        row->strings[ID3v2_INDEX_GENRE] = strdup(genre.name);
+    }
+    else
+    {
+        row->strings[ID3v2_INDEX_GENRE] = text_frame_utf8(ID3v2_Tag_get_genre_frame(tag));
+    }
+
+    int total = 0;
+    ID3v2_Tag_get_year(tag, &row->numbers[ID3v2_INDEX_YEAR]);
+    ID3v2_Tag_get_track(tag, &row->numbers[ID3v2_INDEX_TRACK], &total);
+    row->numbers[ID3v2_INDEX_HAS_COVER] =
+        ID3v2_Tag_get_frame(tag, ID3v2_ALBUM_COVER_FRAME_ID) != NULL;
+}
+
+void ID3v2_IndexBatch_delete(ID3v2_IndexBatch* batch, const char* path)
+{
+    IndexEntry* entry = IndexBatch_add(batch, path, true);
+
+    for (int column = 0; column < ID3v2_INDEX_STRING_COLUMN_COUNT; column++)
+    {
+        if (column != ID3v2_INDEX_PATH) entry->row.strings[column] = strdup("");
+    }
+}
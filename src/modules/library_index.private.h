@@ -0,0 +1,101 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_library_index_private_h
+#define id3v2lib_library_index_private_h
+
+#include <stdbool.h>
+
+#include "modules/library_index.h"
+
+#define INDEX_SEGMENT_MAGIC "ID3I"
+#define INDEX_MANIFEST_MAGIC "ID3M"
+#define INDEX_FORMAT_VERSION 1
+
+// Rows that delete their path instead of storing it
+#define INDEX_ROW_DELETED (1 << 0)
+
+/**
+ * Every string column is dictionary encoded: values holds its distinct
+ * values, sorted by their bytes, and codes holds the position in values of
+ * the value of every row.
+ */
+typedef struct _IndexDictionary
+{
+    int count;
+    const char** values;
+    int* codes;
+} IndexDictionary;
+
+/**
+ * An immutable segment file, loaded in memory and shared by every
+ * generation that lists it. Segment files are laid out as follows, with
+ * integers stored big endian and strings offsets relative to the heap:
+ *
+ *   header    magic[4] version[1] reserved[3] row_count[4] heap_size[4]
+ *   strings   for every string column, value_count[4], the offset[4] of
+ *             every value and the code[4] of every row
+ *   numbers   for every numeric column, the value[4] of every row
+ *   flags     flags[1] of every row
+ *   heap      the null terminated values of every string column
+ *
+ * Rows are sorted by path and every path is found once, so the path of a
+ * row is paths.values[row].
+ */
+typedef struct _IndexSegment
+{
+    unsigned long long id;
+    int refs;
+    int row_count;
+    IndexDictionary strings[ID3v2_INDEX_STRING_COLUMN_COUNT];
+    // Indexed by column, only set for numeric ones
+    int* numbers[ID3v2_INDEX_COLUMN_COUNT];
+    const unsigned char* flags;
+    // Contents of the file, values and flags point into it
+    char* data;
+    // Built the first time the segment is filtered
+    struct _IndexStats* stats;
+} IndexSegment;
+
+/**
+ * Rows of a segment that aren't visible in a generation, because they
+ * were replaced or deleted by a newer segment. Generations share them
+ * until one has to change.
+ */
+typedef struct _IndexDeadMap
+{
+    int refs;
+    unsigned char bits[];
+} IndexDeadMap;
+
+struct _ID3v2_IndexSnapshot
+{
+    int refs;
+    unsigned long long generation;
+    int row_count;
+    int segment_count;
+    // Oldest first
+    IndexSegment** segments;
+    // One per segment, NULL when all of its rows are visible
+    IndexDeadMap** dead;
+};
+
+/**
+ * Returns the row of path in the segment, or -1 if it doesn't hold it.
+ */
+int IndexSegment_find(const IndexSegment* segment, const char* path);
+void IndexSegment_get_row(const IndexSegment* segment, const int row, ID3v2_IndexRow* dest);
+
+bool IndexSnapshot_is_visible(
+    const ID3v2_IndexSnapshot* snapshot,
+    const int segment,
+    const int row
+);
+
+#endif
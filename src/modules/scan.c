@@ -0,0 +1,95 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include "id3v2lib.h"
+
+#include "scheduler.private.h"
+#include "tag.private.h"
+#include "throttle.private.h"
+
+static void decode_codepage(ID3v2_Tag* tag, const ID3v2_ScanOptions* options)
+{
+    if (tag != NULL && options != NULL && options->codepage != ID3v2_CODEPAGE_LATIN1)
+    {
+        ID3v2_Tag_decode_codepage(tag, options->codepage);
+    }
+}
+
+int ID3v2_scan_files(
+    const char* const* file_names,
+    const int count,
+    const ID3v2_ScanOptions* options,
+    ID3v2_ScanCallback callback,
+    void* callback_ctx
+)
+{
+    Scheduler* scheduler = Scheduler_new(file_names, count, options);
+    int result = 0;
+    int index;
+
+    // Scans run with the I/O class of the installed throttle
+    ID3v2_Throttle* throttle = Throttle_get_installed();
+    const int previous_priority = Throttle_begin_io(throttle);
+
+    while ((index = Scheduler_next(scheduler)) != -1)
+    {
+        ID3v2_Tag* tag = ID3v2_read_tag(file_names[index]);
+        decode_codepage(tag, options);
+
+        const bool proceed = callback(file_names[index], tag, callback_ctx);
+        if (tag != NULL) ID3v2_Tag_free(tag);
+
+        if (!proceed)
+        {
+            result = ID3v2_OPERATION_CANCELLED;
+            break;
+        }
+    }
+
+    Throttle_end_io(throttle, previous_priority);
+    Scheduler_free(scheduler);
+    return result;
+}
+
+int ID3v2_update_files(
+    const char* const* file_names,
+    const int count,
+    const ID3v2_ScanOptions* options,
+    ID3v2_UpdateCallback callback,
+    void* callback_ctx
+)
+{
+    Scheduler* scheduler = Scheduler_new(file_names, count, options);
+    int result = 0;
+    int index;
+
+    // Reads run with the I/O class of the installed throttle too, rewrites
+    // still take their slots on top of it
+    ID3v2_Throttle* throttle = Throttle_get_installed();
+    const int previous_priority = Throttle_begin_io(throttle);
+
+    while ((index = Scheduler_next(scheduler)) != -1)
+    {
+        // Written back, so the whole tag is read from the file and left in its codepage
+        ID3v2_Tag* tag = Tag_read_from_file(file_names[index]);
+        if (tag == NULL) tag = ID3v2_Tag_new_empty();
+
+        if (callback(file_names[index], tag, callback_ctx) &&
+            ID3v2_write_tag_with_progress(file_names[index], tag, NULL, NULL) != 0)
+        {
+            result = -1;
+        }
+
+        ID3v2_Tag_free(tag);
+    }
+
+    Throttle_end_io(throttle, previous_priority);
+    Scheduler_free(scheduler);
+    return result;
+}
@@ -0,0 +1,190 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "scheduler.private.h"
+
+/**
+ * Where a file sits on disk. Files whose extents are known come first, then
+ * those only known by inode number and last those that can't be opened, so
+ * positions of different kinds are never compared with each other.
+ */
+#define POSITION_EXTENT 0
+#define POSITION_INODE 1
+#define POSITION_UNKNOWN 2
+
+typedef struct _ScheduledFile
+{
+    int index;
+    unsigned long long device;
+    int kind;
+    unsigned long long position;
+} ScheduledFile;
+
+struct _Scheduler
+{
+    const char* const* file_names;
+    int count;
+    int order;
+    int next_file;
+
+    ScheduledFile* window;
+    int window_size;
+    int window_capacity;
+
+    // The last file handed out, the window is swept from there on
+    ScheduledFile head;
+    bool has_head;
+};
+
+static bool first_extent(const int fd, unsigned long long* position)
+{
+#ifdef FS_IOC_FIEMAP
+    struct
+    {
+        struct fiemap map;
+        struct fiemap_extent extent;
+    } request;
+
+    memset(&request, 0, sizeof(request));
+    request.map.fm_start = 0;
+    request.map.fm_length = FIEMAP_MAX_OFFSET;
+    request.map.fm_extent_count = 1;
+
+    if (ioctl(fd, FS_IOC_FIEMAP, &request.map) != 0) return false;
+    if (request.map.fm_mapped_extents != 1) return false;
+    if (request.extent.fe_flags & FIEMAP_EXTENT_UNKNOWN) return false;
+
+    *position = request.extent.fe_physical;
+    return true;
+#else
+    return false;
+#endif
+}
+
+static void locate_file(const char* file_name, ScheduledFile* file)
+{
+    file->device = ULLONG_MAX;
+    file->kind = POSITION_UNKNOWN;
+    file->position = file->index;
+
+    const int fd = open(file_name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0)
+    {
+        file->device = st.st_dev;
+
+        if (first_extent(fd, &file->position))
+        {
+            file->kind = POSITION_EXTENT;
+        }
+        else
+        {
+            file->kind = POSITION_INODE;
+            file->position = st.st_ino;
+        }
+    }
+
+    close(fd);
+}
+
+static int compare_files(const ScheduledFile* a, const ScheduledFile* b)
+{
+    if (a->device != b->device) return a->device < b->device ? -1 : 1;
+    if (a->kind != b->kind) return a->kind < b->kind ? -1 : 1;
+    if (a->position != b->position) return a->position < b->position ? -1 : 1;
+    return a->index < b->index ? -1 : a->index > b->index;
+}
+
+Scheduler* Scheduler_new(
+    const char* const* file_names,
+    const int count,
+    const ID3v2_ScanOptions* options
+)
+{
+    Scheduler* scheduler = (Scheduler*) calloc(1, sizeof(Scheduler));
+    scheduler->file_names = file_names;
+    scheduler->count = count;
+    scheduler->order = options != NULL ? options->order : ID3v2_SCAN_ORDER_GIVEN;
+
+    if (scheduler->order == ID3v2_SCAN_ORDER_PHYSICAL)
+    {
+        const int window = options->window > 0 ? options->window : ID3v2_SCAN_DEFAULT_WINDOW;
+        scheduler->window_capacity = window < count ? window : count;
+        scheduler->window =
+            (ScheduledFile*) malloc((scheduler->window_capacity + 1) * sizeof(ScheduledFile));
+    }
+
+    return scheduler;
+}
+
+int Scheduler_next(Scheduler* scheduler)
+{
+    if (scheduler->order != ID3v2_SCAN_ORDER_PHYSICAL)
+    {
+        return scheduler->next_file < scheduler->count ? scheduler->next_file++ : -1;
+    }
+
+    while (scheduler->window_size < scheduler->window_capacity &&
+           scheduler->next_file < scheduler->count)
+    {
+        ScheduledFile* file = &scheduler->window[scheduler->window_size++];
+        file->index = scheduler->next_file++;
+        locate_file(scheduler->file_names[file->index], file);
+    }
+
+    if (scheduler->window_size == 0) return -1;
+
+    // Elevator order: the closest file past the head, or back to the
+    // lowest one once the head went past all of them
+    int lowest = 0;
+    int next = -1;
+
+    for (int i = 0; i < scheduler->window_size; i++)
+    {
+        const ScheduledFile* file = &scheduler->window[i];
+
+        if (compare_files(file, &scheduler->window[lowest]) < 0) lowest = i;
+
+        if (scheduler->has_head && compare_files(file, &scheduler->head) > 0 &&
+            (next == -1 || compare_files(file, &scheduler->window[next]) < 0))
+        {
+            next = i;
+        }
+    }
+
+    if (next == -1) next = lowest;
+
+    scheduler->head = scheduler->window[next];
+    scheduler->has_head = true;
+    scheduler->window[next] = scheduler->window[--scheduler->window_size];
+
+    return scheduler->head.index;
+}
+
+void Scheduler_free(Scheduler* scheduler)
+{
+    if (scheduler == NULL) return;
+
+    free(scheduler->window);
+    free(scheduler);
+}
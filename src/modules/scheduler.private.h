@@ -0,0 +1,35 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_scheduler_private_h
+#define id3v2lib_scheduler_private_h
+
+#include "modules/scan.h"
+
+typedef struct _Scheduler Scheduler;
+
+/**
+ * Hands out the indexes of file_names in the order set by options (NULL
+ * keeps the given order). file_names has to outlive the scheduler.
+ */
+Scheduler* Scheduler_new(
+    const char* const* file_names,
+    const int count,
+    const ID3v2_ScanOptions* options
+);
+
+/**
+ * Returns the index of the next file to visit, or -1 once they have all
+ * been handed out.
+ */
+int Scheduler_next(Scheduler* scheduler);
+
+void Scheduler_free(Scheduler* scheduler);
+
+#endif
@@ -0,0 +1,155 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <string.h>
+
+#include "sha256.private.h"
+
+static const unsigned int round_constants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static unsigned int rotate_right(const unsigned int value, const int bits)
+{
+    return (value >> bits) | (value << (32 - bits));
+}
+
+static void Sha256_compress(Sha256* sha, const unsigned char* block)
+{
+    unsigned int words[64];
+
+    for (int i = 0; i < 16; i++)
+    {
+        words[i] = (unsigned int) block[i * 4] << 24 | (unsigned int) block[i * 4 + 1] << 16 |
+                   (unsigned int) block[i * 4 + 2] << 8 | (unsigned int) block[i * 4 + 3];
+    }
+
+    for (int i = 16; i < 64; i++)
+    {
+        const unsigned int s0 = rotate_right(words[i - 15], 7) ^ rotate_right(words[i - 15], 18) ^
+                                (words[i - 15] >> 3);
+        const unsigned int s1 = rotate_right(words[i - 2], 17) ^ rotate_right(words[i - 2], 19) ^
+                                (words[i - 2] >> 10);
+        words[i] = words[i - 16] + s0 + words[i - 7] + s1;
+    }
+
+    unsigned int a = sha->state[0], b = sha->state[1], c = sha->state[2], d = sha->state[3];
+    unsigned int e = sha->state[4], f = sha->state[5], g = sha->state[6], h = sha->state[7];
+
+    for (int i = 0; i < 64; i++)
+    {
+        const unsigned int s1 = rotate_right(e, 6) ^ rotate_right(e, 11) ^ rotate_right(e, 25);
+        const unsigned int choice = (e & f) ^ (~e & g);
+        const unsigned int t1 = h + s1 + choice + round_constants[i] + words[i];
+        const unsigned int s0 = rotate_right(a, 2) ^ rotate_right(a, 13) ^ rotate_right(a, 22);
+        const unsigned int majority = (a & b) ^ (a & c) ^ (b & c);
+        const unsigned int t2 = s0 + majority;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    sha->state[0] += a;
+    sha->state[1] += b;
+    sha->state[2] += c;
+    sha->state[3] += d;
+    sha->state[4] += e;
+    sha->state[5] += f;
+    sha->state[6] += g;
+    sha->state[7] += h;
+}
+
+void Sha256_init(Sha256* sha)
+{
+    static const unsigned int initial_state[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+
+    memcpy(sha->state, initial_state, sizeof(initial_state));
+    sha->length = 0;
+    sha->block_size = 0;
+}
+
+void Sha256_update(Sha256* sha, const char* data, long size)
+{
+    const unsigned char* bytes = (const unsigned char*) data;
+    sha->length += size;
+
+    // Whole blocks are compressed straight from data
+    while (size > 0)
+    {
+        if (sha->block_size == 0 && size >= SHA256_BLOCK_LENGTH)
+        {
+            Sha256_compress(sha, bytes);
+            bytes += SHA256_BLOCK_LENGTH;
+            size -= SHA256_BLOCK_LENGTH;
+            continue;
+        }
+
+        const int copied = SHA256_BLOCK_LENGTH - sha->block_size < size
+                               ? SHA256_BLOCK_LENGTH - sha->block_size
+                               : (int) size;
+
+        memcpy(sha->block + sha->block_size, bytes, copied);
+        sha->block_size += copied;
+        bytes += copied;
+        size -= copied;
+
+        if (sha->block_size == SHA256_BLOCK_LENGTH)
+        {
+            Sha256_compress(sha, sha->block);
+            sha->block_size = 0;
+        }
+    }
+}
+
+void Sha256_final(Sha256* sha, unsigned char* digest)
+{
+    const unsigned long long bits = sha->length * 8;
+
+    sha->block[sha->block_size++] = 0x80;
+
+    if (sha->block_size > SHA256_BLOCK_LENGTH - 8)
+    {
+        memset(sha->block + sha->block_size, 0, SHA256_BLOCK_LENGTH - sha->block_size);
+        Sha256_compress(sha, sha->block);
+        sha->block_size = 0;
+    }
+
+    memset(sha->block + sha->block_size, 0, SHA256_BLOCK_LENGTH - 8 - sha->block_size);
+
+    for (int i = 0; i < 8; i++)
+    {
+        sha->block[SHA256_BLOCK_LENGTH - 1 - i] = (bits >> (i * 8)) & 0xFF;
+    }
+
+    Sha256_compress(sha, sha->block);
+
+    for (int i = 0; i < 8; i++)
+    {
+        digest[i * 4] = sha->state[i] >> 24;
+        digest[i * 4 + 1] = (sha->state[i] >> 16) & 0xFF;
+        digest[i * 4 + 2] = (sha->state[i] >> 8) & 0xFF;
+        digest[i * 4 + 3] = sha->state[i] & 0xFF;
+    }
+}
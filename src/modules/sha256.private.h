@@ -0,0 +1,32 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_sha256_private_h
+#define id3v2lib_sha256_private_h
+
+#define SHA256_DIGEST_LENGTH 32
+#define SHA256_BLOCK_LENGTH 64
+
+/**
+ * SHA-256 of data hashed in parts: every part goes through
+ * Sha256_update, and Sha256_final stores the digest.
+ */
+typedef struct _Sha256
+{
+    unsigned int state[8];
+    unsigned long long length;
+    unsigned char block[SHA256_BLOCK_LENGTH];
+    int block_size;
+} Sha256;
+
+void Sha256_init(Sha256* sha);
+void Sha256_update(Sha256* sha, const char* data, long size);
+void Sha256_final(Sha256* sha, unsigned char* digest);
+
+#endif
@@ -0,0 +1,228 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "modules/char_stream.private.h"
+#include "modules/frame.private.h"
+#include "modules/frame_header.private.h"
+#include "modules/frame_list.h"
+#include "modules/tag.h"
+#include "modules/tag_header.h"
+#include "modules/utils.private.h"
+
+#include "modules/snapshot.h"
+
+#define SNAPSHOT_VERSION_OFFSET 4
+#define SNAPSHOT_MAJOR_VERSION_OFFSET 5
+#define SNAPSHOT_MINOR_VERSION_OFFSET 6
+#define SNAPSHOT_FLAGS_OFFSET 7
+#define SNAPSHOT_SIZE_OFFSET 8
+#define SNAPSHOT_FRAME_COUNT_OFFSET 12
+#define SNAPSHOT_PAYLOAD_OFFSET_OFFSET 16
+#define SNAPSHOT_PADDING_SIZE_OFFSET 20
+
+#define FRAME_ENTRY_FLAGS_OFFSET 4
+#define FRAME_ENTRY_OFFSET_OFFSET 8
+#define FRAME_ENTRY_SIZE_OFFSET 12
+
+#define SNAPSHOT_INT_LENGTH 4
+
+static void write_int(char* dest, const unsigned int value)
+{
+    ulltob(value, dest, SNAPSHOT_INT_LENGTH);
+}
+
+static unsigned int read_int(const char* src)
+{
+    return btoi(src, SNAPSHOT_INT_LENGTH);
+}
+
+static const char* frame_entry(const char* snapshot, const int index)
+{
+    return snapshot + ID3v2_SNAPSHOT_HEADER_LENGTH + (index * ID3v2_SNAPSHOT_FRAME_ENTRY_LENGTH);
+}
+
+char* ID3v2_Snapshot_new(ID3v2_Tag* tag, int* size)
+{
+    int frame_count = 0;
+
+    for (ID3v2_FrameList* head = tag->frames; head != NULL && head->frame != NULL;
+         head = head->next)
+    {
+        frame_count++;
+    }
+
+    // Frames are serialized once, the payload is sized from what they turn into
+    CharStream** frame_streams = (CharStream**) malloc(frame_count * sizeof(CharStream*));
+    int payload_size = 0;
+    int index = 0;
+
+    for (ID3v2_FrameList* head = tag->frames; head != NULL && head->frame != NULL;
+         head = head->next)
+    {
+        frame_streams[index] = Frame_to_char_stream(head->frame);
+        payload_size += frame_streams[index]->size - ID3v2_FRAME_HEADER_LENGTH;
+        index++;
+    }
+
+    const int payload_offset =
+        ID3v2_SNAPSHOT_HEADER_LENGTH + (frame_count * ID3v2_SNAPSHOT_FRAME_ENTRY_LENGTH);
+    *size = payload_offset + payload_size;
+
+    char* snapshot = (char*) calloc(*size, sizeof(char));
+
+    memcpy(snapshot, ID3v2_SNAPSHOT_MAGIC, ID3v2_SNAPSHOT_MAGIC_LENGTH);
+    snapshot[SNAPSHOT_VERSION_OFFSET] = ID3v2_SNAPSHOT_VERSION;
+    snapshot[SNAPSHOT_MAJOR_VERSION_OFFSET] = tag->header->major_version;
+    snapshot[SNAPSHOT_MINOR_VERSION_OFFSET] = tag->header->minor_version;
+    snapshot[SNAPSHOT_FLAGS_OFFSET] = tag->header->flags;
+    write_int(snapshot + SNAPSHOT_SIZE_OFFSET, *size);
+    write_int(snapshot + SNAPSHOT_FRAME_COUNT_OFFSET, frame_count);
+    write_int(snapshot + SNAPSHOT_PAYLOAD_OFFSET_OFFSET, payload_offset);
+    write_int(snapshot + SNAPSHOT_PADDING_SIZE_OFFSET, tag->padding_size);
+
+    int offset = payload_offset;
+    index = 0;
+
+    for (ID3v2_FrameList* head = tag->frames; head != NULL && head->frame != NULL;
+         head = head->next)
+    {
+        CharStream* frame_cs = frame_streams[index];
+        const int data_size = frame_cs->size - ID3v2_FRAME_HEADER_LENGTH;
+        char* entry = (char*) frame_entry(snapshot, index);
+
+        memcpy(entry, head->frame->header->id, ID3v2_FRAME_HEADER_ID_LENGTH);
+        memcpy(
+            entry + FRAME_ENTRY_FLAGS_OFFSET,
+            head->frame->header->flags,
+            ID3v2_FRAME_HEADER_FLAGS_LENGTH
+        );
+        write_int(entry + FRAME_ENTRY_OFFSET_OFFSET, offset);
+        write_int(entry + FRAME_ENTRY_SIZE_OFFSET, data_size);
+        memcpy(snapshot + offset, frame_cs->stream + ID3v2_FRAME_HEADER_LENGTH, data_size);
+
+        CharStream_free(frame_cs);
+
+        offset += data_size;
+        index++;
+    }
+
+    free(frame_streams);
+
+    return snapshot;
+}
+
+bool ID3v2_Snapshot_is_valid(const char* snapshot, const int size)
+{
+    if (snapshot == NULL || size < ID3v2_SNAPSHOT_HEADER_LENGTH) return false;
+    if (memcmp(snapshot, ID3v2_SNAPSHOT_MAGIC, ID3v2_SNAPSHOT_MAGIC_LENGTH) != 0) return false;
+    if (snapshot[SNAPSHOT_VERSION_OFFSET] != ID3v2_SNAPSHOT_VERSION) return false;
+    if (read_int(snapshot + SNAPSHOT_SIZE_OFFSET) != size) return false;
+
+    const unsigned int frame_count = read_int(snapshot + SNAPSHOT_FRAME_COUNT_OFFSET);
+    const unsigned int payload_offset = read_int(snapshot + SNAPSHOT_PAYLOAD_OFFSET_OFFSET);
+
+    if (frame_count > (size - ID3v2_SNAPSHOT_HEADER_LENGTH) / ID3v2_SNAPSHOT_FRAME_ENTRY_LENGTH ||
+        payload_offset !=
+            ID3v2_SNAPSHOT_HEADER_LENGTH + (frame_count * ID3v2_SNAPSHOT_FRAME_ENTRY_LENGTH) ||
+        payload_offset > size)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < frame_count; i++)
+    {
+        const char* entry = frame_entry(snapshot, i);
+        const unsigned int offset = read_int(entry + FRAME_ENTRY_OFFSET_OFFSET);
+        const unsigned int frame_size = read_int(entry + FRAME_ENTRY_SIZE_OFFSET);
+
+        if (offset < payload_offset || offset > size || frame_size > size - offset) return false;
+    }
+
+    return true;
+}
+
+int ID3v2_Snapshot_get_frame_count(const char* snapshot)
+{
+    return read_int(snapshot + SNAPSHOT_FRAME_COUNT_OFFSET);
+}
+
+char ID3v2_Snapshot_get_major_version(const char* snapshot)
+{
+    return snapshot[SNAPSHOT_MAJOR_VERSION_OFFSET];
+}
+
+bool ID3v2_Snapshot_get_frame(const char* snapshot, const int index, ID3v2_FrameRef* frame)
+{
+    if (index < 0 || index >= ID3v2_Snapshot_get_frame_count(snapshot)) return false;
+
+    const char* entry = frame_entry(snapshot, index);
+
+    frame->id = entry;
+    frame->flags = entry + FRAME_ENTRY_FLAGS_OFFSET;
+    frame->data = snapshot + read_int(entry + FRAME_ENTRY_OFFSET_OFFSET);
+    frame->size = read_int(entry + FRAME_ENTRY_SIZE_OFFSET);
+    frame->unsynchronised = false;
+
+    return true;
+}
+
+int ID3v2_Snapshot_find_frame(
+    const char* snapshot,
+    const char* frame_id,
+    const int start,
+    ID3v2_FrameRef* frame
+)
+{
+    const int frame_count = ID3v2_Snapshot_get_frame_count(snapshot);
+
+    // The frame table is contiguous, so looking for a frame doesn't touch the payload
+    for (int i = start < 0 ? 0 : start; i < frame_count; i++)
+    {
+        if (memcmp(frame_entry(snapshot, i), frame_id, ID3v2_FRAME_HEADER_ID_LENGTH) == 0)
+        {
+            ID3v2_Snapshot_get_frame(snapshot, i, frame);
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+ID3v2_Frame* ID3v2_Snapshot_decode_frame(const char* snapshot, const int index)
+{
+    ID3v2_FrameRef ref;
+    if (!ID3v2_Snapshot_get_frame(snapshot, index, &ref)) return NULL;
+
+    // The frame header is put back in front of the data and parsed as in a tag
+    const char major_version = ID3v2_Snapshot_get_major_version(snapshot);
+    const int frame_size = ID3v2_FRAME_HEADER_LENGTH + ref.size;
+    char* frame_bytes = (char*) malloc(frame_size * sizeof(char));
+
+    memcpy(frame_bytes, ref.id, ID3v2_FRAME_HEADER_ID_LENGTH);
+    ulltob(
+        major_version == 4 ? syncint_encode(ref.size) : ref.size,
+        frame_bytes + ID3v2_FRAME_HEADER_ID_LENGTH,
+        ID3v2_FRAME_HEADER_SIZE_LENGTH
+    );
+    memcpy(
+        frame_bytes + ID3v2_FRAME_HEADER_ID_LENGTH + ID3v2_FRAME_HEADER_SIZE_LENGTH,
+        ref.flags,
+        ID3v2_FRAME_HEADER_FLAGS_LENGTH
+    );
+    memcpy(frame_bytes + ID3v2_FRAME_HEADER_LENGTH, ref.data, ref.size);
+
+    CharStream frame_cs = {0, frame_size, frame_bytes};
+    ID3v2_Frame* frame = Frame_parse(&frame_cs, major_version);
+    free(frame_bytes);
+
+    return frame;
+}
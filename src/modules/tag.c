@@ -14,14 +14,19 @@
 
 #include "frames/apic_frame.private.h"
 #include "frames/comment_frame.private.h"
+#include "frames/pcnt_frame.private.h"
+#include "frames/popm_frame.private.h"
 #include "frames/text_frame.private.h"
 #include "modules/char_stream.private.h"
 #include "modules/frame.private.h"
+#include "modules/frame_decoder.private.h"
 #include "modules/frame_header.private.h"
 #include "modules/frame_ids.h"
 #include "modules/frame_list.private.h"
+#include "modules/genres.private.h"
 #include "modules/picture_types.h"
 #include "modules/tag_header.private.h"
+#include "modules/tag_index.private.h"
 #include "modules/utils.private.h"
 
 #include "tag.private.h"
@@ -32,6 +37,8 @@ ID3v2_Tag* ID3v2_Tag_new(ID3v2_TagHeader* header, const int padding_size)
     tag->header = header == NULL ? TagHeader_new_empty() : header;
     tag->frames = FrameList_new();
     tag->padding_size = 0;
+    tag->index = NULL;
+    tag->partial = false;
 
     return tag;
 }
@@ -54,22 +61,50 @@ ID3v2_Tag* Tag_parse(CharStream* tag_cs)
         CharStream_seek(tag_cs, header->extended_header_size, SEEK_SET);
     }
 
-    ID3v2_Frame* current_frame;
-    while (tag_cs->cursor < tag->header->tag_size)
+    // v2.3 unsynchronises the whole tag, undo it before looking for frames
+    CharStream* synchronised_cs = NULL;
+    if (header->major_version == 3 && (header->flags & TAG_HEADER_UNSYNCHRONISATION_FLAG))
     {
-        current_frame = Frame_parse(tag_cs, tag->header->major_version);
-        if (current_frame == NULL) break;
-        FrameList_add_frame(tag->frames, current_frame);
+        synchronised_cs = CharStream_new(tag_cs->size);
+        memcpy(synchronised_cs->stream, tag_cs->stream, tag_cs->cursor);
+        const int frames_size = unsync_decode(
+            CharStream_get_cur(tag_cs),
+            tag_cs->size - tag_cs->cursor,
+            synchronised_cs->stream + tag_cs->cursor
+        );
+        synchronised_cs->size = tag_cs->cursor + frames_size;
+        synchronised_cs->cursor = tag_cs->cursor;
+        header->tag_size -= tag_cs->size - synchronised_cs->size;
+        tag_cs = synchronised_cs;
+    }
+
+    // v2.4 unsynchronises frame by frame, which happens as they're decoded
+    const bool unsynchronised =
+        header->major_version == 4 && (header->flags & TAG_HEADER_UNSYNCHRONISATION_FLAG);
+    header->flags &= ~TAG_HEADER_UNSYNCHRONISATION_FLAG;
+
+    FrameSpan* spans;
+    const int count = FrameDecoder_locate(tag_cs, header->tag_size, header->major_version, &spans);
+    ID3v2_Frame** frames = (ID3v2_Frame**) malloc(count * sizeof(ID3v2_Frame*));
+    FrameDecoder_decode(tag_cs, spans, count, header->major_version, unsynchronised, frames);
+
+    for (int i = 0; i < count; i++)
+    {
+        if (frames[i] != NULL) FrameList_add_frame(tag->frames, frames[i]);
     }
 
     tag->padding_size = tag_cs->size - tag_cs->cursor;
 
+    free(frames);
+    free(spans);
+    if (synchronised_cs != NULL) CharStream_free(synchronised_cs);
+
     return tag;
 }
 
-CharStream* Tag_to_char_stream(ID3v2_Tag* tag)
+static CharStream* Tag_write_char_stream(ID3v2_Tag* tag, const int size)
 {
-    CharStream* tag_cs = CharStream_new(tag->header->tag_size + ID3v2_TAG_HEADER_LENGTH);
+    CharStream* tag_cs = CharStream_new(size);
 
     // Write header
     CharStream_write(tag_cs, tag->header->identifier, ID3v2_TAG_HEADER_IDENTIFIER_LENGTH);
@@ -105,6 +140,125 @@ CharStream* Tag_to_char_stream(ID3v2_Tag* tag)
     return tag_cs;
 }
 
+CharStream* Tag_to_char_stream(ID3v2_Tag* tag)
+{
+    return Tag_write_char_stream(tag, tag->header->tag_size + ID3v2_TAG_HEADER_LENGTH);
+}
+
+CharStream* Tag_to_char_stream_without_padding(ID3v2_Tag* tag)
+{
+    return Tag_write_char_stream(tag, Tag_get_frames_size(tag) + ID3v2_TAG_HEADER_LENGTH);
+}
+
+int Tag_get_frames_size(ID3v2_Tag* tag)
+{
+    int size = 0;
+    ID3v2_FrameList* frames = tag->frames;
+
+    while (frames != NULL && frames->frame != NULL)
+    {
+        size += frames->frame->header->size + ID3v2_FRAME_HEADER_LENGTH;
+        frames = frames->next;
+    }
+
+    return size;
+}
+
+/**
+ * The index is only built once a keyed lookup needs it, so tags that are
+ * read and written without keyed lookups never pay for it.
+ */
+static ID3v2_TagIndex* Tag_get_index(ID3v2_Tag* tag)
+{
+    if (tag->index == NULL)
+    {
+        tag->index = TagIndex_build(tag->frames);
+    }
+
+    return tag->index;
+}
+
+static void Tag_add_frame(ID3v2_Tag* tag, ID3v2_Frame* frame)
+{
+    FrameList_add_frame(tag->frames, frame);
+    tag->header->tag_size += frame->header->size + ID3v2_FRAME_HEADER_LENGTH;
+
+    if (tag->index != NULL) TagIndex_add_frame(tag->index, frame);
+}
+
+/**
+ * Replaces existing_frame with new_frame keeping its position in the tag, or
+ * appends new_frame if there's nothing to replace. The replaced frame is freed.
+ */
+static void Tag_set_frame(ID3v2_Tag* tag, ID3v2_Frame* existing_frame, ID3v2_Frame* new_frame)
+{
+    if (existing_frame == NULL)
+    {
+        Tag_add_frame(tag, new_frame);
+        return;
+    }
+
+    FrameList_replace_frame(tag->frames, existing_frame, new_frame);
+    tag->header->tag_size += (new_frame->header->size - existing_frame->header->size);
+
+    if (tag->index != NULL) TagIndex_replace_frame(tag->index, existing_frame, new_frame);
+
+    ID3v2_Frame_free(existing_frame);
+}
+
+/**
+ * Forgets about a frame that's no longer part of the frame list, the
+ * frame itself isn't freed.
+ */
+static void Tag_forget_frame(ID3v2_Frame* frame, void* tag_ptr)
+{
+    ID3v2_Tag* tag = (ID3v2_Tag*) tag_ptr;
+
+    if (tag->index != NULL) TagIndex_remove_frame(tag->index, frame);
+    tag->header->tag_size -= frame->header->size + ID3v2_FRAME_HEADER_LENGTH;
+}
+
+static void Tag_remove_frame(ID3v2_Tag* tag, ID3v2_Frame* frame)
+{
+    if (FrameList_remove_frame(tag->frames, frame) != NULL) Tag_forget_frame(frame, tag);
+}
+
+static void Tag_free_removed_frame(ID3v2_Frame* frame, void* tag)
+{
+    Tag_forget_frame(frame, tag);
+    ID3v2_Frame_free(frame);
+}
+
+void Tag_set_frames(ID3v2_Tag* tag, const char* frame_id, ID3v2_Frame** frames, const int count)
+{
+    ID3v2_FrameList* existing = FrameList_get_frames_by_id(tag->frames, frame_id);
+    ID3v2_FrameList* head = existing;
+    int i = 0;
+
+    while (head != NULL && head->frame != NULL)
+    {
+        if (i < count)
+        {
+            Tag_set_frame(tag, head->frame, frames[i]);
+        }
+        else
+        {
+            Tag_remove_frame(tag, head->frame);
+            ID3v2_Frame_free(head->frame);
+        }
+
+        i++;
+        head = head->next;
+    }
+
+    for (; i < count; i++)
+    {
+        Tag_add_frame(tag, frames[i]);
+    }
+
+    ID3v2_FrameList_unlink(existing);
+}
+
 /**
  * Getter functions
  */
@@ -185,40 +339,208 @@ ID3v2_FrameList* ID3v2_Tag_get_comment_frames(ID3v2_Tag* tag)
     return ID3v2_Tag_get_frames(tag, ID3v2_COMMENT_FRAME_ID);
 }
 
+ID3v2_CommentFrame* ID3v2_Tag_get_comment(
+    ID3v2_Tag* tag,
+    const char* language,
+    const char* short_description
+)
+{
+    if (tag == NULL || language == NULL) return NULL;
+    return TagIndex_get_comment(Tag_get_index(tag), language, short_description);
+}
+
+/**
+ * Returns the front cover if the tag has one, otherwise the first APIC
+ * frame found, whatever its picture type.
+ */
 ID3v2_ApicFrame* ID3v2_Tag_get_album_cover_frame(ID3v2_Tag* tag)
 {
+    ID3v2_ApicFrame* front_cover = ID3v2_Tag_get_picture(tag, ID3v2_PIC_TYPE_FRONT_COVER);
+
+    if (front_cover != NULL) return front_cover;
+
     return (ID3v2_ApicFrame*) ID3v2_Tag_get_frame(tag, ID3v2_ALBUM_COVER_FRAME_ID);
 }
 
+ID3v2_ApicFrame* ID3v2_Tag_get_picture(ID3v2_Tag* tag, const char picture_type)
+{
+    if (tag == NULL) return NULL;
+    return TagIndex_get_picture(Tag_get_index(tag), (unsigned char) picture_type);
+}
+
 ID3v2_FrameList* ID3v2_Tag_get_apic_frames(ID3v2_Tag* tag)
 {
     return ID3v2_Tag_get_frames(tag, ID3v2_ALBUM_COVER_FRAME_ID);
 }
 
+ID3v2_PcntFrame* ID3v2_Tag_get_play_counter_frame(ID3v2_Tag* tag)
+{
+    return (ID3v2_PcntFrame*) ID3v2_Tag_get_frame(tag, ID3v2_PLAY_COUNTER_FRAME_ID);
+}
+
+ID3v2_PopmFrame* ID3v2_Tag_get_popm_frame(ID3v2_Tag* tag, const char* email)
+{
+    if (tag == NULL) return NULL;
+
+    ID3v2_FrameList* list = tag->frames;
+
+    while (list != NULL && list->frame != NULL)
+    {
+        if (FrameHeader_isPopmFrame(list->frame->header))
+        {
+            ID3v2_PopmFrame* frame = (ID3v2_PopmFrame*) list->frame;
+            if (email == NULL || strcmp(frame->data->email, email) == 0) return frame;
+        }
+
+        list = list->next;
+    }
+
+    return NULL;
+}
+
+/**
+ * Returns how many numbers the text frame holds, see TextFrame_get_numbers.
+ */
+static int Tag_get_numbers(ID3v2_Tag* tag, const char* frame_id, const long** numbers)
+{
+    ID3v2_TextFrame* frame = (ID3v2_TextFrame*) ID3v2_Tag_get_frame(tag, frame_id);
+    if (frame == NULL) return 0;
+
+    return TextFrame_get_numbers(frame, numbers);
+}
+
+static bool Tag_get_number_pair(ID3v2_Tag* tag, const char* frame_id, int* number, int* total)
+{
+    const long* numbers;
+    const int count = Tag_get_numbers(tag, frame_id, &numbers);
+    if (count == 0) return false;
+
+    *number = numbers[0];
+    *total = count > 1 ? numbers[1] : 0;
+
+    return true;
+}
+
+static bool Tag_get_number(ID3v2_Tag* tag, const char* frame_id, long* number)
+{
+    const long* numbers;
+    if (Tag_get_numbers(tag, frame_id, &numbers) == 0) return false;
+
+    *number = numbers[0];
+
+    return true;
+}
+
+bool ID3v2_Tag_get_track(ID3v2_Tag* tag, int* number, int* total)
+{
+    return Tag_get_number_pair(tag, ID3v2_TRACK_FRAME_ID, number, total);
+}
+
+bool ID3v2_Tag_get_disc(ID3v2_Tag* tag, int* number, int* total)
+{
+    return Tag_get_number_pair(tag, ID3v2_DISC_NUMBER_FRAME_ID, number, total);
+}
+
+bool ID3v2_Tag_get_year(ID3v2_Tag* tag, int* year)
+{
+    int date;
+    if (!ID3v2_Tag_get_date(tag, &date)) return false;
+
+    *year = ID3v2_DATE_YEAR(date);
+
+    return true;
+}
+
+bool ID3v2_Tag_get_date(ID3v2_Tag* tag, int* date)
+{
+    const long* numbers;
+    int count = Tag_get_numbers(tag, ID3v2_RECORDING_TIME_FRAME_ID, &numbers);
+
+    if (count > 0)
+    {
+        // yyyy-MM-ddTHH:mm:ss, every part but the year is optional
+        *date = ID3v2_DATE(numbers[0], count > 1 ? numbers[1] : 0, count > 2 ? numbers[2] : 0);
+        return true;
+    }
+
+    long year;
+    if (!Tag_get_number(tag, ID3v2_YEAR_FRAME_ID, &year)) return false;
+
+    // TDAT is stored as DDMM
+    long day_month;
+    if (!Tag_get_number(tag, ID3v2_DATE_FRAME_ID, &day_month)) day_month = 0;
+
+    *date = ID3v2_DATE(year, day_month % 100, day_month / 100);
+
+    return true;
+}
+
+bool ID3v2_Tag_get_bpm(ID3v2_Tag* tag, int* bpm)
+{
+    long number;
+    if (!Tag_get_number(tag, ID3v2_BPM_FRAME_ID, &number)) return false;
+
+    *bpm = number;
+
+    return true;
+}
+
+bool ID3v2_Tag_get_length(ID3v2_Tag* tag, long* milliseconds)
+{
+    return Tag_get_number(tag, ID3v2_LENGTH_FRAME_ID, milliseconds);
+}
+
+int ID3v2_Tag_get_genres(ID3v2_Tag* tag, ID3v2_Genre* genres, const int max_genres)
+{
+    ID3v2_TextFrame* frame = ID3v2_Tag_get_genre_frame(tag);
+    if (frame == NULL) return 0;
+
+    return Genres_parse(frame, genres, max_genres);
+}
+
 /**
  * Setter functions
  */
 void ID3v2_Tag_set_text_frame(ID3v2_Tag* tag, ID3v2_TextFrameInput* input)
 {
     ID3v2_TextFrame* new_frame = TextFrame_new(input->id, input->flags, input->text);
-    ID3v2_TextFrame* existing_frame =
-        (ID3v2_TextFrame*) FrameList_get_frame_by_id(tag->frames, input->id);
+    ID3v2_Frame* existing_frame = FrameList_get_frame_by_id(tag->frames, input->id);
 
-    if (existing_frame == NULL)
-    {
-        FrameList_add_frame(tag->frames, (ID3v2_Frame*) new_frame);
-        tag->header->tag_size += new_frame->header->size;
-    }
-    else
-    {
-        FrameList_replace_frame(
-            tag->frames,
-            (ID3v2_Frame*) existing_frame,
-            (ID3v2_Frame*) new_frame
-        );
-        tag->header->tag_size += (new_frame->header->size - existing_frame->header->size);
-        ID3v2_Frame_free((ID3v2_Frame*) existing_frame);
-    }
+    Tag_set_frame(tag, existing_frame, (ID3v2_Frame*) new_frame);
+}
+
+void ID3v2_Tag_set_text(
+    ID3v2_Tag* tag,
+    const char* frame_id,
+    const char* text,
+    const int size,
+    const char encoding
+)
+{
+    ID3v2_Tag_set_text_values(tag, frame_id, &(ID3v2_TextValue){text, size}, 1, encoding);
+}
+
+void ID3v2_Tag_set_text_values(
+    ID3v2_Tag* tag,
+    const char* frame_id,
+    const ID3v2_TextValue* values,
+    const int count,
+    const char encoding
+)
+{
+    if (encoding < ID3v2_ENCODING_ISO || encoding > ID3v2_ENCODING_UTF8) return;
+
+    ID3v2_TextFrame* new_frame = TextFrame_new_values(
+        frame_id,
+        "\0\0",
+        values,
+        count,
+        encoding,
+        tag->header->major_version
+    );
+    ID3v2_Frame* existing_frame = FrameList_get_frame_by_id(tag->frames, frame_id);
+
+    Tag_set_frame(tag, existing_frame, (ID3v2_Frame*) new_frame);
 }
 
 void ID3v2_Tag_set_artist(ID3v2_Tag* tag, const char* artist)
@@ -329,38 +651,121 @@ void ID3v2_Tag_set_composer(ID3v2_Tag* tag, const char* composer)
     );
 }
 
+static void Tag_set_text(ID3v2_Tag* tag, const char* frame_id, const char* text)
+{
+    ID3v2_Tag_set_text_frame(
+        tag,
+        &(ID3v2_TextFrameInput){
+            .id = frame_id,
+            .flags = "\0\0",
+            .text = text,
+        }
+    );
+}
+
+static void Tag_set_number_pair(
+    ID3v2_Tag* tag,
+    const char* frame_id,
+    const int number,
+    const int total
+)
+{
+    char text[24];
+
+    if (total > 0) snprintf(text, sizeof(text), "%d/%d", number, total);
+    else snprintf(text, sizeof(text), "%d", number);
+
+    Tag_set_text(tag, frame_id, text);
+}
+
+void ID3v2_Tag_set_track_value(ID3v2_Tag* tag, const int number, const int total)
+{
+    Tag_set_number_pair(tag, ID3v2_TRACK_FRAME_ID, number, total);
+}
+
+void ID3v2_Tag_set_disc_value(ID3v2_Tag* tag, const int number, const int total)
+{
+    Tag_set_number_pair(tag, ID3v2_DISC_NUMBER_FRAME_ID, number, total);
+}
+
+void ID3v2_Tag_set_year_value(ID3v2_Tag* tag, const int year)
+{
+    int date = 0;
+
+    if (tag->header->major_version >= 4)
+    {
+        // TYER is gone in v2.4, keep the month and day TDRC may have
+        ID3v2_Tag_get_date(tag, &date);
+        date = ID3v2_DATE(year, ID3v2_DATE_MONTH(date), ID3v2_DATE_DAY(date));
+        ID3v2_Tag_set_date_value(tag, date);
+        return;
+    }
+
+    Tag_set_number_pair(tag, ID3v2_YEAR_FRAME_ID, year, 0);
+}
+
+void ID3v2_Tag_set_date_value(ID3v2_Tag* tag, const int date)
+{
+    const int year = ID3v2_DATE_YEAR(date);
+    const int month = ID3v2_DATE_MONTH(date);
+    const int day = ID3v2_DATE_DAY(date);
+    char text[16];
+
+    if (tag->header->major_version >= 4)
+    {
+        if (month == 0) snprintf(text, sizeof(text), "%04d", year);
+        else if (day == 0) snprintf(text, sizeof(text), "%04d-%02d", year, month);
+        else snprintf(text, sizeof(text), "%04d-%02d-%02d", year, month, day);
+
+        Tag_set_text(tag, ID3v2_RECORDING_TIME_FRAME_ID, text);
+        return;
+    }
+
+    ID3v2_Tag_set_year_value(tag, year);
+
+    if (month == 0 || day == 0)
+    {
+        // TDAT can't hold a partial date
+        ID3v2_Tag_delete_frame(tag, ID3v2_DATE_FRAME_ID);
+        return;
+    }
+
+    snprintf(text, sizeof(text), "%02d%02d", day, month);
+    Tag_set_text(tag, ID3v2_DATE_FRAME_ID, text);
+}
+
+void ID3v2_Tag_set_bpm(ID3v2_Tag* tag, const int bpm)
+{
+    Tag_set_number_pair(tag, ID3v2_BPM_FRAME_ID, bpm, 0);
+}
+
+void ID3v2_Tag_set_length(ID3v2_Tag* tag, const long milliseconds)
+{
+    char text[24];
+    snprintf(text, sizeof(text), "%ld", milliseconds);
+
+    Tag_set_text(tag, ID3v2_LENGTH_FRAME_ID, text);
+}
+
 /**
- * This only sets the first COMM frame found.
+ * Replaces the COMM frame with the same language and short description as
+ * the input, or adds a new one if there isn't any.
  */
 void ID3v2_Tag_set_comment_frame(ID3v2_Tag* tag, ID3v2_CommentFrameInput* input)
 {
     ID3v2_CommentFrame* new_frame =
         CommentFrame_new(input->flags, input->language, input->short_description, input->comment);
-    ID3v2_CommentFrame* existing_frame = ID3v2_Tag_get_comment_frame(tag);
+    ID3v2_CommentFrame* existing_frame =
+        ID3v2_Tag_get_comment(tag, input->language, input->short_description);
 
-    if (existing_frame == NULL)
-    {
-        FrameList_add_frame(tag->frames, (ID3v2_Frame*) new_frame);
-        tag->header->tag_size += new_frame->header->size;
-    }
-    else
-    {
-        FrameList_replace_frame(
-            tag->frames,
-            (ID3v2_Frame*) existing_frame,
-            (ID3v2_Frame*) new_frame
-        );
-        tag->header->tag_size += (new_frame->header->size - existing_frame->header->size);
-        ID3v2_Frame_free((ID3v2_Frame*) existing_frame);
-    }
+    Tag_set_frame(tag, (ID3v2_Frame*) existing_frame, (ID3v2_Frame*) new_frame);
 }
 
 void ID3v2_Tag_add_comment_frame(ID3v2_Tag* tag, ID3v2_CommentFrameInput* input)
 {
     ID3v2_CommentFrame* new_frame =
         CommentFrame_new(input->flags, input->language, input->short_description, input->comment);
-    FrameList_add_frame(tag->frames, (ID3v2_Frame*) new_frame);
-    tag->header->tag_size += new_frame->header->size;
+    Tag_add_frame(tag, (ID3v2_Frame*) new_frame);
 }
 
 void ID3v2_Tag_set_comment(ID3v2_Tag* tag, const char* lang, const char* comment)
@@ -377,7 +782,8 @@ void ID3v2_Tag_set_comment(ID3v2_Tag* tag, const char* lang, const char* comment
 }
 
 /**
- * This only sets the first APIC frame found.
+ * Replaces the first APIC frame with the same picture type as the input,
+ * or adds a new one if there isn't any.
  */
 void ID3v2_Tag_set_apic_frame(ID3v2_Tag* tag, ID3v2_ApicFrameInput* input)
 {
@@ -389,23 +795,9 @@ void ID3v2_Tag_set_apic_frame(ID3v2_Tag* tag, ID3v2_ApicFrameInput* input)
         input->picture_size,
         input->data
     );
-    ID3v2_ApicFrame* existing_frame = ID3v2_Tag_get_album_cover_frame(tag);
+    ID3v2_ApicFrame* existing_frame = ID3v2_Tag_get_picture(tag, input->picture_type);
 
-    if (existing_frame == NULL)
-    {
-        FrameList_add_frame(tag->frames, (ID3v2_Frame*) new_frame);
-        tag->header->tag_size += new_frame->header->size;
-    }
-    else
-    {
-        FrameList_replace_frame(
-            tag->frames,
-            (ID3v2_Frame*) existing_frame,
-            (ID3v2_Frame*) new_frame
-        );
-        tag->header->tag_size += (new_frame->header->size - existing_frame->header->size);
-        ID3v2_Frame_free((ID3v2_Frame*) existing_frame);
-    }
+    Tag_set_frame(tag, (ID3v2_Frame*) existing_frame, (ID3v2_Frame*) new_frame);
 }
 
 void ID3v2_Tag_add_apic_frame(ID3v2_Tag* tag, ID3v2_ApicFrameInput* input)
@@ -418,15 +810,12 @@ void ID3v2_Tag_add_apic_frame(ID3v2_Tag* tag, ID3v2_ApicFrameInput* input)
         input->picture_size,
         input->data
     );
-    FrameList_add_frame(tag->frames, (ID3v2_Frame*) new_frame);
-    tag->header->tag_size += new_frame->header->size;
+    Tag_add_frame(tag, (ID3v2_Frame*) new_frame);
 }
 
-/**
- * This only sets the front album cover (picture_type = 0x03)
- */
-void ID3v2_Tag_set_album_cover(
+void ID3v2_Tag_set_picture(
     ID3v2_Tag* tag,
+    const char picture_type,
     const char* mime_type,
     const int size,
     const char* data
@@ -439,14 +828,45 @@ void ID3v2_Tag_set_album_cover(
             .mime_type = mime_type,
             .description = EMPTY_UNICODE_STR,
             .picture_size = size,
-            .picture_type = ID3v2_PIC_TYPE_FRONT_COVER,
+            .picture_type = picture_type,
             .data = data,
         }
     );
 }
 
+/**
+ * This only sets the front album cover (picture_type = 0x03)
+ */
+void ID3v2_Tag_set_album_cover(
+    ID3v2_Tag* tag,
+    const char* mime_type,
+    const int size,
+    const char* data
+)
+{
+    ID3v2_Tag_set_picture(tag, ID3v2_PIC_TYPE_FRONT_COVER, mime_type, size, data);
+}
+
+void ID3v2_Tag_set_popm_frame(ID3v2_Tag* tag, ID3v2_PopmFrameInput* input)
+{
+    ID3v2_PopmFrame* new_frame =
+        PopmFrame_new(input->flags, input->email, input->rating, input->counter);
+    ID3v2_PopmFrame* existing_frame = ID3v2_Tag_get_popm_frame(tag, input->email);
+
+    Tag_set_frame(tag, (ID3v2_Frame*) existing_frame, (ID3v2_Frame*) new_frame);
+}
+
+void ID3v2_Tag_set_play_count(ID3v2_Tag* tag, const unsigned long long count)
+{
+    ID3v2_PcntFrame* new_frame = PcntFrame_new("\0\0", count);
+    ID3v2_PcntFrame* existing_frame = ID3v2_Tag_get_play_counter_frame(tag);
+
+    Tag_set_frame(tag, (ID3v2_Frame*) existing_frame, (ID3v2_Frame*) new_frame);
+}
+
 void ID3v2_Tag_free(ID3v2_Tag* tag)
 {
+    TagIndex_free(tag->index);
     ID3v2_TagHeader_free(tag->header);
     ID3v2_FrameList_free(tag->frames);
     free(tag);
@@ -455,10 +875,51 @@ void ID3v2_Tag_free(ID3v2_Tag* tag)
 void ID3v2_Tag_delete_frame(ID3v2_Tag* tag, const char* frame_id)
 {
     ID3v2_Frame* deleted = FrameList_remove_frame_by_id(tag->frames, frame_id);
-    tag->header->tag_size -= deleted->header->size + ID3v2_FRAME_HEADER_LENGTH;
+    if (deleted == NULL) return;
+
     // Maybe we should just return the frame instead of taking the responsibility
     // of freeing it?
-    ID3v2_Frame_free(deleted);
+    Tag_free_removed_frame(deleted, tag);
+}
+
+int ID3v2_Tag_delete_frames_if(ID3v2_Tag* tag, ID3v2_FramePredicate predicate, void* ctx)
+{
+    if (tag == NULL) return 0;
+    return FrameList_remove_frames_if(tag->frames, predicate, ctx, Tag_free_removed_frame, tag);
+}
+
+typedef struct _FrameIdSet
+{
+    const char* const* frame_ids;
+    int count;
+    bool in_set;
+} FrameIdSet;
+
+static bool frame_id_set_matches(ID3v2_Frame* frame, void* set_ptr)
+{
+    FrameIdSet* set = (FrameIdSet*) set_ptr;
+
+    for (int i = 0; i < set->count; i++)
+    {
+        if (memcmp(frame->header->id, set->frame_ids[i], ID3v2_FRAME_HEADER_ID_LENGTH) == 0)
+        {
+            return set->in_set;
+        }
+    }
+
+    return !set->in_set;
+}
+
+int ID3v2_Tag_delete_frames_in(ID3v2_Tag* tag, const char* const* frame_ids, const int count)
+{
+    FrameIdSet set = {frame_ids, count, true};
+    return ID3v2_Tag_delete_frames_if(tag, frame_id_set_matches, &set);
+}
+
+int ID3v2_Tag_delete_frames_not_in(ID3v2_Tag* tag, const char* const* frame_ids, const int count)
+{
+    FrameIdSet set = {frame_ids, count, false};
+    return ID3v2_Tag_delete_frames_if(tag, frame_id_set_matches, &set);
 }
 
 void ID3v2_Tag_delete_artist(ID3v2_Tag* tag)
@@ -506,27 +967,29 @@ void ID3v2_Tag_delete_composer(ID3v2_Tag* tag)
     ID3v2_Tag_delete_frame(tag, ID3v2_COMPOSER_FRAME_ID);
 }
 
-void ID3v2_Tag_delete_comment_frame(ID3v2_Tag* tag, const int index)
+/**
+ * Deletes the index-th frame matching frame_id, if there's any.
+ */
+static void Tag_delete_nth_frame(ID3v2_Tag* tag, const char* frame_id, const int index)
 {
-    int i = 0;
-    ID3v2_FrameList* head = ID3v2_Tag_get_comment_frames(tag);
+    ID3v2_FrameList* frames = ID3v2_Tag_get_frames(tag, frame_id);
+    ID3v2_FrameList* head = frames;
 
-    while (head != NULL)
+    for (int i = 0; head != NULL && head->frame != NULL; i++, head = head->next)
     {
-        ID3v2_CommentFrame* to_delete = (ID3v2_CommentFrame*) head->frame;
-
         if (i == index)
         {
-            FrameList_remove_frame(tag->frames, (ID3v2_Frame*) to_delete);
-            ID3v2_Frame_free((ID3v2_Frame*) to_delete);
+            Tag_free_removed_frame(FrameList_remove_frame(tag->frames, head->frame), tag);
             break;
         }
-
-        i++;
-        head = head->next;
     }
 
-    ID3v2_FrameList_unlink(head);
+    ID3v2_FrameList_unlink(frames);
+}
+
+void ID3v2_Tag_delete_comment_frame(ID3v2_Tag* tag, const int index)
+{
+    Tag_delete_nth_frame(tag, ID3v2_COMMENT_FRAME_ID, index);
 }
 
 void ID3v2_Tag_delete_comment(ID3v2_Tag* tag)
@@ -536,28 +999,25 @@ void ID3v2_Tag_delete_comment(ID3v2_Tag* tag)
 
 void ID3v2_Tag_delete_apic_frame(ID3v2_Tag* tag, const int index)
 {
-    int i = 0;
-    ID3v2_FrameList* head = ID3v2_Tag_get_apic_frames(tag);
+    Tag_delete_nth_frame(tag, ID3v2_ALBUM_COVER_FRAME_ID, index);
+}
 
-    while (head != NULL)
-    {
-        ID3v2_ApicFrame* to_delete = (ID3v2_ApicFrame*) head->frame;
+void ID3v2_Tag_delete_album_cover(ID3v2_Tag* tag)
+{
+    ID3v2_Tag_delete_frame(tag, ID3v2_ALBUM_COVER_FRAME_ID);
+}
 
-        if (i == index)
-        {
-            FrameList_remove_frame(tag->frames, (ID3v2_Frame*) to_delete);
-            ID3v2_Frame_free((ID3v2_Frame*) to_delete);
-            break;
-        }
+void ID3v2_Tag_delete_popm_frame(ID3v2_Tag* tag, const char* email)
+{
+    ID3v2_PopmFrame* to_delete = ID3v2_Tag_get_popm_frame(tag, email);
 
-        i++;
-        head = head->next;
-    }
+    if (to_delete == NULL) return;
 
-    ID3v2_FrameList_unlink(head);
+    Tag_remove_frame(tag, (ID3v2_Frame*) to_delete);
+    ID3v2_Frame_free((ID3v2_Frame*) to_delete);
 }
 
-void ID3v2_Tag_delete_album_cover(ID3v2_Tag* tag)
+void ID3v2_Tag_delete_play_counter(ID3v2_Tag* tag)
 {
-    ID3v2_Tag_delete_frame(tag, ID3v2_ALBUM_COVER_FRAME_ID);
+    ID3v2_Tag_delete_frame(tag, ID3v2_PLAY_COUNTER_FRAME_ID);
 }
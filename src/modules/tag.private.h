@@ -15,6 +15,32 @@
 typedef struct _CharStream CharStream;
 
 ID3v2_Tag* Tag_parse(CharStream* tag_cs);
+
+/**
+ * Reads the tag of the file without going through the installed cache,
+ * for callers that write it back.
+ */
+ID3v2_Tag* Tag_read_from_file(const char* file_name);
 CharStream* Tag_to_char_stream(ID3v2_Tag* tag);
 
+/**
+ * Same as Tag_to_char_stream, but the stream ends right after the last
+ * frame. The tag size in the header still counts the padding, so the
+ * padding can be written separately.
+ */
+CharStream* Tag_to_char_stream_without_padding(ID3v2_Tag* tag);
+
+/**
+ * Size of every frame in the tag, headers included. Unlike the tag size
+ * found in the header, this doesn't include the padding.
+ */
+int Tag_get_frames_size(ID3v2_Tag* tag);
+
+/**
+ * Replaces every frame matching frame_id with the provided ones. Existing
+ * frames are replaced in place, extra ones are removed and missing ones are
+ * appended. The tag takes ownership of the new frames.
+ */
+void Tag_set_frames(ID3v2_Tag* tag, const char* frame_id, ID3v2_Frame** frames, const int count);
+
 #endif
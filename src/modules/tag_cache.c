@@ -0,0 +1,461 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "modules/char_stream.private.h"
+#include "modules/frame.private.h"
+#include "modules/frame_list.private.h"
+#include "modules/frame_header.h"
+#include "modules/frame_ids.h"
+#include "modules/tag.private.h"
+#include "modules/tag_header.h"
+#include "modules/utils.private.h"
+
+#include "tag_cache.private.h"
+
+#define INITIAL_BUCKET_COUNT 64
+#define TAG_HEADER_EXTENDED_HEADER_FLAG (1 << 6)
+
+typedef struct _TagCacheEntry
+{
+    TagCacheKey key;
+    // The tag without its padding, which is kept apart
+    char* tag;
+    int tag_size;
+    int padding_size;
+    // Large pictures were dropped from it
+    bool partial;
+    struct _TagCacheEntry* next_in_bucket;
+    struct _TagCacheEntry* newer;
+    struct _TagCacheEntry* older;
+} TagCacheEntry;
+
+struct _ID3v2_TagCacheShard
+{
+    pthread_mutex_t lock;
+    TagCacheEntry** buckets;
+    int bucket_count;
+    TagCacheEntry* newest;
+    TagCacheEntry* oldest;
+    size_t bytes;
+    unsigned long long entries;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+};
+
+static ID3v2_TagCache* installed_cache = NULL;
+
+ID3v2_TagCache* ID3v2_TagCache_new(
+    const size_t max_bytes,
+    const int picture_policy,
+    const int max_picture_size
+)
+{
+    ID3v2_TagCache* cache = (ID3v2_TagCache*) malloc(sizeof(ID3v2_TagCache));
+    cache->max_bytes = max_bytes;
+    cache->picture_policy = picture_policy;
+    cache->max_picture_size = max_picture_size;
+    cache->shards =
+        (ID3v2_TagCacheShard*) calloc(ID3v2_TAG_CACHE_SHARDS, sizeof(ID3v2_TagCacheShard));
+
+    for (int i = 0; i < ID3v2_TAG_CACHE_SHARDS; i++)
+    {
+        ID3v2_TagCacheShard* shard = &cache->shards[i];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->bucket_count = INITIAL_BUCKET_COUNT;
+        shard->buckets = (TagCacheEntry**) calloc(shard->bucket_count, sizeof(TagCacheEntry*));
+    }
+
+    return cache;
+}
+
+static void TagCacheEntry_free(TagCacheEntry* entry)
+{
+    free(entry->tag);
+    free(entry);
+}
+
+static size_t TagCacheEntry_bytes(TagCacheEntry* entry)
+{
+    return sizeof(TagCacheEntry) + entry->tag_size;
+}
+
+static void TagCacheShard_clear(ID3v2_TagCacheShard* shard)
+{
+    TagCacheEntry* entry = shard->newest;
+
+    while (entry != NULL)
+    {
+        TagCacheEntry* older = entry->older;
+        TagCacheEntry_free(entry);
+        entry = older;
+    }
+
+    memset(shard->buckets, 0, shard->bucket_count * sizeof(TagCacheEntry*));
+    shard->newest = NULL;
+    shard->oldest = NULL;
+    shard->bytes = 0;
+    shard->entries = 0;
+}
+
+void ID3v2_TagCache_free(ID3v2_TagCache* cache)
+{
+    if (cache == NULL) return;
+
+    for (int i = 0; i < ID3v2_TAG_CACHE_SHARDS; i++)
+    {
+        TagCacheShard_clear(&cache->shards[i]);
+        pthread_mutex_destroy(&cache->shards[i].lock);
+        free(cache->shards[i].buckets);
+    }
+
+    free(cache->shards);
+    free(cache);
+}
+
+void ID3v2_TagCache_install(ID3v2_TagCache* cache)
+{
+    // Released so threads that pick it up see it fully set up
+    __atomic_store_n(&installed_cache, cache, __ATOMIC_RELEASE);
+}
+
+ID3v2_TagCache* TagCache_get_installed()
+{
+    return __atomic_load_n(&installed_cache, __ATOMIC_ACQUIRE);
+}
+
+void ID3v2_TagCache_clear(ID3v2_TagCache* cache)
+{
+    for (int i = 0; i < ID3v2_TAG_CACHE_SHARDS; i++)
+    {
+        pthread_mutex_lock(&cache->shards[i].lock);
+        TagCacheShard_clear(&cache->shards[i]);
+        pthread_mutex_unlock(&cache->shards[i].lock);
+    }
+}
+
+void ID3v2_TagCache_get_stats(ID3v2_TagCache* cache, ID3v2_TagCacheStats* stats)
+{
+    memset(stats, 0, sizeof(ID3v2_TagCacheStats));
+
+    for (int i = 0; i < ID3v2_TAG_CACHE_SHARDS; i++)
+    {
+        ID3v2_TagCacheShard* shard = &cache->shards[i];
+
+        pthread_mutex_lock(&shard->lock);
+        stats->hits += shard->hits;
+        stats->misses += shard->misses;
+        stats->evictions += shard->evictions;
+        stats->entries += shard->entries;
+        stats->bytes += shard->bytes;
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+bool TagCache_stat(const char* file_name, TagCacheKey* key)
+{
+    struct stat st;
+
+    if (fstatat(AT_FDCWD, file_name, &st, 0) != 0) return false;
+
+    key->device = st.st_dev;
+    key->inode = st.st_ino;
+    key->size = st.st_size;
+    key->mtime = st.st_mtim;
+
+    return true;
+}
+
+static unsigned long long TagCacheKey_hash(TagCacheKey* key)
+{
+    unsigned long long hash = FNV1A_64_OFFSET_BASIS;
+    hash = fnv1a_64((const char*) &key->device, sizeof(key->device), hash);
+    return fnv1a_64((const char*) &key->inode, sizeof(key->inode), hash);
+}
+
+static bool TagCacheKey_same_file(TagCacheKey* a, TagCacheKey* b)
+{
+    return a->device == b->device && a->inode == b->inode;
+}
+
+static bool TagCacheKey_same_version(TagCacheKey* a, TagCacheKey* b)
+{
+    return a->size == b->size && a->mtime.tv_sec == b->mtime.tv_sec &&
+           a->mtime.tv_nsec == b->mtime.tv_nsec;
+}
+
+/**
+ * The low bits of the hash pick the shard, the rest pick the bucket.
+ */
+static ID3v2_TagCacheShard* TagCache_get_shard(ID3v2_TagCache* cache, const unsigned long long hash)
+{
+    return &cache->shards[hash % ID3v2_TAG_CACHE_SHARDS];
+}
+
+static TagCacheEntry** TagCacheShard_get_bucket(
+    ID3v2_TagCacheShard* shard,
+    const unsigned long long hash
+)
+{
+    return &shard->buckets[(hash / ID3v2_TAG_CACHE_SHARDS) % shard->bucket_count];
+}
+
+static TagCacheEntry** TagCacheShard_find(
+    ID3v2_TagCacheShard* shard,
+    TagCacheKey* key,
+    const unsigned long long hash
+)
+{
+    TagCacheEntry** link = TagCacheShard_get_bucket(shard, hash);
+
+    while (*link != NULL && !TagCacheKey_same_file(&(*link)->key, key))
+    {
+        link = &(*link)->next_in_bucket;
+    }
+
+    return link;
+}
+
+static void TagCacheShard_unlink_lru(ID3v2_TagCacheShard* shard, TagCacheEntry* entry)
+{
+    if (entry->newer != NULL) entry->newer->older = entry->older;
+    else shard->newest = entry->older;
+
+    if (entry->older != NULL) entry->older->newer = entry->newer;
+    else shard->oldest = entry->newer;
+}
+
+static void TagCacheShard_push_newest(ID3v2_TagCacheShard* shard, TagCacheEntry* entry)
+{
+    entry->newer = NULL;
+    entry->older = shard->newest;
+
+    if (shard->newest != NULL) shard->newest->newer = entry;
+    else shard->oldest = entry;
+
+    shard->newest = entry;
+}
+
+/**
+ * Removes the entry that link points to.
+ */
+static void TagCacheShard_remove(ID3v2_TagCacheShard* shard, TagCacheEntry** link)
+{
+    TagCacheEntry* entry = *link;
+
+    *link = entry->next_in_bucket;
+    TagCacheShard_unlink_lru(shard, entry);
+
+    shard->bytes -= TagCacheEntry_bytes(entry);
+    shard->entries--;
+    TagCacheEntry_free(entry);
+}
+
+static void TagCacheShard_grow(ID3v2_TagCacheShard* shard)
+{
+    const int bucket_count = shard->bucket_count * 2;
+    TagCacheEntry** buckets = (TagCacheEntry**) calloc(bucket_count, sizeof(TagCacheEntry*));
+
+    for (TagCacheEntry* entry = shard->newest; entry != NULL; entry = entry->older)
+    {
+        const unsigned long long hash = TagCacheKey_hash(&entry->key);
+        TagCacheEntry** bucket = &buckets[(hash / ID3v2_TAG_CACHE_SHARDS) % bucket_count];
+
+        entry->next_in_bucket = *bucket;
+        *bucket = entry;
+    }
+
+    free(shard->buckets);
+    shard->buckets = buckets;
+    shard->bucket_count = bucket_count;
+}
+
+ID3v2_Tag* TagCache_get(ID3v2_TagCache* cache, TagCacheKey* key)
+{
+    const unsigned long long hash = TagCacheKey_hash(key);
+    ID3v2_TagCacheShard* shard = TagCache_get_shard(cache, hash);
+    CharStream* tag_cs = NULL;
+    int padding_size = 0;
+    bool partial = false;
+
+    pthread_mutex_lock(&shard->lock);
+
+    TagCacheEntry** link = TagCacheShard_find(shard, key, hash);
+
+    if (*link != NULL && !TagCacheKey_same_version(&(*link)->key, key))
+    {
+        // The file changed since it was cached
+        TagCacheShard_remove(shard, link);
+    }
+
+    if (*link != NULL)
+    {
+        TagCacheEntry* entry = *link;
+
+        TagCacheShard_unlink_lru(shard, entry);
+        TagCacheShard_push_newest(shard, entry);
+
+        // The copy is parsed once the shard is unlocked
+        tag_cs = CharStream_from_buffer(entry->tag, entry->tag_size);
+        padding_size = entry->padding_size;
+        partial = entry->partial;
+        shard->hits++;
+    }
+    else
+    {
+        shard->misses++;
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    if (tag_cs == NULL) return NULL;
+
+    ID3v2_Tag* tag = Tag_parse(tag_cs);
+    CharStream_free(tag_cs);
+
+    tag->padding_size = padding_size;
+    tag->header->tag_size += padding_size;
+    tag->partial = partial;
+
+    return tag;
+}
+
+static bool is_large_picture(ID3v2_Frame* frame, void* max_picture_size)
+{
+    const bool is_picture =
+        memcmp(frame->header->id, ID3v2_ALBUM_COVER_FRAME_ID, ID3v2_FRAME_HEADER_ID_LENGTH) == 0;
+
+    return is_picture && frame->header->size > *(int*) max_picture_size;
+}
+
+static bool has_large_picture(ID3v2_Tag* tag, int max_picture_size)
+{
+    ID3v2_FrameList* head = tag->frames;
+
+    for (; head != NULL && head->frame != NULL; head = head->next)
+    {
+        if (is_large_picture(head->frame, &max_picture_size)) return true;
+    }
+
+    return false;
+}
+
+/**
+ * Serializes the tag without its large pictures. The copy shares the
+ * frames of the tag, which is left as it is.
+ */
+static CharStream* serialize_without_large_pictures(ID3v2_Tag* tag, int max_picture_size)
+{
+    ID3v2_Tag filtered = *tag;
+    filtered.frames = FrameList_new();
+
+    for (ID3v2_FrameList* head = tag->frames; head != NULL && head->frame != NULL;
+         head = head->next)
+    {
+        if (!is_large_picture(head->frame, &max_picture_size))
+        {
+            FrameList_add_frame(filtered.frames, head->frame);
+        }
+    }
+
+    CharStream* tag_cs = Tag_to_char_stream_without_padding(&filtered);
+    ID3v2_FrameList_unlink(filtered.frames);
+
+    return tag_cs;
+}
+
+void TagCache_put(ID3v2_TagCache* cache, TagCacheKey* key, ID3v2_Tag* tag)
+{
+    if (tag == NULL) return;
+
+    const bool large_picture = has_large_picture(tag, cache->max_picture_size);
+    if (large_picture && cache->picture_policy == ID3v2_TAG_CACHE_SKIP_PICTURES) return;
+
+    const bool partial = large_picture && cache->picture_policy == ID3v2_TAG_CACHE_DROP_PICTURES;
+
+    // Padding is only stored as a size, the cached tag claims to have none
+    const int padding_size = tag->padding_size;
+    CharStream* tag_cs = partial ? serialize_without_large_pictures(tag, cache->max_picture_size)
+                                 : Tag_to_char_stream_without_padding(tag);
+    char* size_bytes = itob(syncint_encode(tag_cs->size - ID3v2_TAG_HEADER_LENGTH));
+    memcpy(tag_cs->stream + 6, size_bytes, ID3v2_TAG_HEADER_TAG_SIZE_LENGTH);
+    free(size_bytes);
+
+    // The extended header isn't serialized
+    tag_cs->stream[5] &= ~TAG_HEADER_EXTENDED_HEADER_FLAG;
+
+    TagCacheEntry* entry = (TagCacheEntry*) malloc(sizeof(TagCacheEntry));
+    entry->key = *key;
+    entry->tag = tag_cs->stream;
+    entry->tag_size = tag_cs->size;
+    entry->padding_size = padding_size;
+    entry->partial = partial;
+    free(tag_cs);
+
+    const unsigned long long hash = TagCacheKey_hash(key);
+    ID3v2_TagCacheShard* shard = TagCache_get_shard(cache, hash);
+    const size_t max_shard_bytes = cache->max_bytes / ID3v2_TAG_CACHE_SHARDS;
+
+    if (TagCacheEntry_bytes(entry) > max_shard_bytes)
+    {
+        TagCacheEntry_free(entry);
+        return;
+    }
+
+    pthread_mutex_lock(&shard->lock);
+
+    // Another thread may have cached it meanwhile
+    TagCacheEntry** link = TagCacheShard_find(shard, key, hash);
+    if (*link != NULL) TagCacheShard_remove(shard, link);
+
+    while (shard->oldest != NULL && shard->bytes + TagCacheEntry_bytes(entry) > max_shard_bytes)
+    {
+        TagCacheShard_remove(
+            shard,
+            TagCacheShard_find(shard, &shard->oldest->key, TagCacheKey_hash(&shard->oldest->key))
+        );
+        shard->evictions++;
+    }
+
+    if (shard->entries >= shard->bucket_count) TagCacheShard_grow(shard);
+
+    TagCacheEntry** bucket = TagCacheShard_get_bucket(shard, hash);
+    entry->next_in_bucket = *bucket;
+    *bucket = entry;
+    TagCacheShard_push_newest(shard, entry);
+
+    shard->bytes += TagCacheEntry_bytes(entry);
+    shard->entries++;
+
+    pthread_mutex_unlock(&shard->lock);
+}
+
+void TagCache_invalidate(ID3v2_TagCache* cache, const char* file_name)
+{
+    TagCacheKey key;
+
+    if (cache == NULL || !TagCache_stat(file_name, &key)) return;
+
+    const unsigned long long hash = TagCacheKey_hash(&key);
+    ID3v2_TagCacheShard* shard = TagCache_get_shard(cache, hash);
+
+    pthread_mutex_lock(&shard->lock);
+
+    TagCacheEntry** link = TagCacheShard_find(shard, &key, hash);
+    if (*link != NULL) TagCacheShard_remove(shard, link);
+
+    pthread_mutex_unlock(&shard->lock);
+}
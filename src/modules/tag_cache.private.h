@@ -0,0 +1,49 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_tag_cache_private_h
+#define id3v2lib_tag_cache_private_h
+
+#include <stdbool.h>
+#include <sys/stat.h>
+
+#include "modules/tag_cache.h"
+
+typedef struct _ID3v2_Tag ID3v2_Tag;
+
+typedef struct _TagCacheKey
+{
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    struct timespec mtime;
+} TagCacheKey;
+
+ID3v2_TagCache* TagCache_get_installed();
+
+/**
+ * Fills the key of the file, false if it can't be stat'ed.
+ */
+bool TagCache_stat(const char* file_name, TagCacheKey* key);
+
+/**
+ * Returns a new copy of the cached tag, or NULL if it isn't cached or the
+ * file changed since it was.
+ */
+ID3v2_Tag* TagCache_get(ID3v2_TagCache* cache, TagCacheKey* key);
+
+/**
+ * Applies the picture policy to a copy of a tag just read from disk and
+ * caches it. The tag itself is left as it is.
+ */
+void TagCache_put(ID3v2_TagCache* cache, TagCacheKey* key, ID3v2_Tag* tag);
+
+void TagCache_invalidate(ID3v2_TagCache* cache, const char* file_name);
+
+#endif
@@ -12,6 +12,8 @@
 
 #include "modules/tag_header.h"
 
+#define TAG_HEADER_UNSYNCHRONISATION_FLAG (1 << 7)
+
 typedef struct _CharStream CharStream;
 
 ID3v2_TagHeader* TagHeader_new(
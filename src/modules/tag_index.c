@@ -0,0 +1,368 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "modules/frame_header.h"
+#include "modules/frame_ids.h"
+#include "modules/utils.private.h"
+
+#include "tag_index.private.h"
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+/**
+ * Descriptions can be stored either as ISO or as UTF-16 with a BOM, so keys
+ * are compared by code unit rather than by byte. That way an empty ISO
+ * description and EMPTY_UNICODE_STR, for example, are the same key.
+ */
+typedef struct _KeyText
+{
+    const unsigned char* units;
+    int length;
+    int width;
+    bool big_endian;
+} KeyText;
+
+static KeyText KeyText_from_string(const char* text)
+{
+    KeyText key_text = {NULL, 0, 1, false};
+
+    if (text == NULL) return key_text;
+
+    if (string_has_bom(text))
+    {
+        key_text.units = (const unsigned char*) text + 2;
+        key_text.length = (ID3v2_strlen(text) - 2) / 2;
+        key_text.width = 2;
+        key_text.big_endian = (unsigned char) text[0] == 0xFE;
+    }
+    else
+    {
+        key_text.units = (const unsigned char*) text;
+        key_text.length = strlen(text);
+    }
+
+    return key_text;
+}
+
+static unsigned int KeyText_unit_at(KeyText* key_text, const int i)
+{
+    const unsigned char* unit = key_text->units + (i * key_text->width);
+
+    if (key_text->width == 1) return unit[0];
+    return key_text->big_endian ? (unit[0] << 8) | unit[1] : (unit[1] << 8) | unit[0];
+}
+
+static unsigned int comment_key_hash(const char* lang, const char* short_desc)
+{
+    unsigned int hash = FNV_OFFSET_BASIS;
+
+    for (int i = 0; i < ID3v2_COMMENT_FRAME_LANGUAGE_LENGTH; i++)
+    {
+        hash = (hash ^ (unsigned char) lang[i]) * FNV_PRIME;
+    }
+
+    KeyText desc = KeyText_from_string(short_desc);
+
+    for (int i = 0; i < desc.length; i++)
+    {
+        const unsigned int unit = KeyText_unit_at(&desc, i);
+        hash = (hash ^ (unit & 0xFF)) * FNV_PRIME;
+        hash = (hash ^ (unit >> 8)) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+static bool comment_key_equals(ID3v2_CommentFrame* frame, const char* lang, const char* short_desc)
+{
+    if (memcmp(frame->data->language, lang, ID3v2_COMMENT_FRAME_LANGUAGE_LENGTH) != 0)
+    {
+        return false;
+    }
+
+    KeyText a = KeyText_from_string(frame->data->short_description);
+    KeyText b = KeyText_from_string(short_desc);
+
+    if (a.length != b.length) return false;
+
+    for (int i = 0; i < a.length; i++)
+    {
+        if (KeyText_unit_at(&a, i) != KeyText_unit_at(&b, i)) return false;
+    }
+
+    return true;
+}
+
+static bool is_comment_frame(ID3v2_Frame* frame)
+{
+    return memcmp(frame->header->id, ID3v2_COMMENT_FRAME_ID, ID3v2_FRAME_HEADER_ID_LENGTH) == 0;
+}
+
+/**
+ * Returns the picture type of an APIC frame or -1 if the frame isn't an
+ * APIC frame or uses a picture type not defined by the spec.
+ */
+static int picture_type_of(ID3v2_Frame* frame)
+{
+    if (memcmp(frame->header->id, ID3v2_ALBUM_COVER_FRAME_ID, ID3v2_FRAME_HEADER_ID_LENGTH) != 0)
+    {
+        return -1;
+    }
+
+    const int picture_type = (unsigned char) ((ID3v2_ApicFrame*) frame)->data->picture_type;
+    return picture_type < ID3v2_PIC_TYPE_COUNT ? picture_type : -1;
+}
+
+static void TagIndex_grow_comments(ID3v2_TagIndex* index)
+{
+    const int bucket_count = index->comment_bucket_count * 2;
+    TagIndexEntry** buckets = (TagIndexEntry**) calloc(bucket_count, sizeof(TagIndexEntry*));
+
+    for (int i = 0; i < index->comment_bucket_count; i++)
+    {
+        TagIndexEntry* entry = index->comment_buckets[i];
+
+        while (entry != NULL)
+        {
+            TagIndexEntry* next = entry->next;
+            const int bucket = entry->hash & (bucket_count - 1);
+            entry->next = buckets[bucket];
+            buckets[bucket] = entry;
+            entry = next;
+        }
+    }
+
+    free(index->comment_buckets);
+    index->comment_buckets = buckets;
+    index->comment_bucket_count = bucket_count;
+}
+
+ID3v2_TagIndex* TagIndex_new()
+{
+    ID3v2_TagIndex* index = (ID3v2_TagIndex*) malloc(sizeof(ID3v2_TagIndex));
+
+    index->comment_count = 0;
+    index->comment_bucket_count = TAG_INDEX_INITIAL_BUCKET_COUNT;
+    index->comment_buckets =
+        (TagIndexEntry**) calloc(TAG_INDEX_INITIAL_BUCKET_COUNT, sizeof(TagIndexEntry*));
+
+    for (int i = 0; i < ID3v2_PIC_TYPE_COUNT; i++)
+    {
+        index->pictures[i] = NULL;
+    }
+
+    return index;
+}
+
+ID3v2_TagIndex* TagIndex_build(ID3v2_FrameList* frames)
+{
+    ID3v2_TagIndex* index = TagIndex_new();
+
+    while (frames != NULL && frames->frame != NULL)
+    {
+        TagIndex_add_frame(index, frames->frame);
+        frames = frames->next;
+    }
+
+    return index;
+}
+
+/**
+ * Tags holding more than one COMM frame with the same key aren't valid, but
+ * in that case the frame that was indexed first is returned. Entries are
+ * pushed at the front of their bucket, so that's the last match in the chain.
+ */
+ID3v2_CommentFrame* TagIndex_get_comment(
+    ID3v2_TagIndex* index,
+    const char* lang,
+    const char* short_desc
+)
+{
+    const unsigned int hash = comment_key_hash(lang, short_desc);
+    TagIndexEntry* entry = index->comment_buckets[hash & (index->comment_bucket_count - 1)];
+    ID3v2_CommentFrame* found = NULL;
+
+    while (entry != NULL)
+    {
+        ID3v2_CommentFrame* frame = (ID3v2_CommentFrame*) entry->frame;
+
+        if (entry->hash == hash && comment_key_equals(frame, lang, short_desc))
+        {
+            found = frame;
+        }
+
+        entry = entry->next;
+    }
+
+    return found;
+}
+
+ID3v2_ApicFrame* TagIndex_get_picture(ID3v2_TagIndex* index, const int picture_type)
+{
+    if (picture_type < 0 || picture_type >= ID3v2_PIC_TYPE_COUNT) return NULL;
+    if (index->pictures[picture_type] == NULL) return NULL;
+
+    return (ID3v2_ApicFrame*) index->pictures[picture_type]->frame;
+}
+
+static void TagIndex_add_comment(ID3v2_TagIndex* index, ID3v2_CommentFrame* comment)
+{
+    if (index->comment_count >= index->comment_bucket_count)
+    {
+        TagIndex_grow_comments(index);
+    }
+
+    TagIndexEntry* entry = (TagIndexEntry*) malloc(sizeof(TagIndexEntry));
+    entry->hash = comment_key_hash(comment->data->language, comment->data->short_description);
+    entry->frame = (ID3v2_Frame*) comment;
+
+    const int bucket = entry->hash & (index->comment_bucket_count - 1);
+    entry->next = index->comment_buckets[bucket];
+    index->comment_buckets[bucket] = entry;
+    index->comment_count++;
+}
+
+static void TagIndex_add_picture(ID3v2_TagIndex* index, ID3v2_Frame* frame, const int picture_type)
+{
+    TagIndexEntry* entry = (TagIndexEntry*) malloc(sizeof(TagIndexEntry));
+    entry->hash = picture_type;
+    entry->frame = frame;
+    entry->next = NULL;
+
+    TagIndexEntry** link = &index->pictures[picture_type];
+
+    while (*link != NULL)
+    {
+        link = &(*link)->next;
+    }
+
+    *link = entry;
+}
+
+void TagIndex_add_frame(ID3v2_TagIndex* index, ID3v2_Frame* frame)
+{
+    if (is_comment_frame(frame))
+    {
+        TagIndex_add_comment(index, (ID3v2_CommentFrame*) frame);
+        return;
+    }
+
+    const int picture_type = picture_type_of(frame);
+    if (picture_type >= 0) TagIndex_add_picture(index, frame, picture_type);
+}
+
+/**
+ * Returns the link pointing to the entry holding frame, or NULL if the
+ * frame isn't indexed.
+ */
+static TagIndexEntry** TagIndex_find_link(ID3v2_TagIndex* index, ID3v2_Frame* frame)
+{
+    TagIndexEntry** link = NULL;
+
+    if (is_comment_frame(frame))
+    {
+        ID3v2_CommentFrame* comment = (ID3v2_CommentFrame*) frame;
+        const unsigned int hash =
+            comment_key_hash(comment->data->language, comment->data->short_description);
+        link = &index->comment_buckets[hash & (index->comment_bucket_count - 1)];
+    }
+    else
+    {
+        const int picture_type = picture_type_of(frame);
+        if (picture_type < 0) return NULL;
+        link = &index->pictures[picture_type];
+    }
+
+    while (*link != NULL)
+    {
+        if ((*link)->frame == frame) return link;
+        link = &(*link)->next;
+    }
+
+    return NULL;
+}
+
+void TagIndex_remove_frame(ID3v2_TagIndex* index, ID3v2_Frame* frame)
+{
+    TagIndexEntry** link = TagIndex_find_link(index, frame);
+
+    if (link == NULL) return;
+
+    TagIndexEntry* removed = *link;
+    *link = removed->next;
+    free(removed);
+
+    if (is_comment_frame(frame)) index->comment_count--;
+}
+
+static bool same_key(ID3v2_Frame* a, ID3v2_Frame* b)
+{
+    if (is_comment_frame(a) && is_comment_frame(b))
+    {
+        ID3v2_CommentFrame* comment = (ID3v2_CommentFrame*) b;
+        return comment_key_equals(
+            (ID3v2_CommentFrame*) a,
+            comment->data->language,
+            comment->data->short_description
+        );
+    }
+
+    return picture_type_of(a) >= 0 && picture_type_of(a) == picture_type_of(b);
+}
+
+/**
+ * When both frames share the same key the new frame takes the place of the
+ * old one, so the relative order of frames with the same key is preserved.
+ */
+void TagIndex_replace_frame(ID3v2_TagIndex* index, ID3v2_Frame* old_frame, ID3v2_Frame* new_frame)
+{
+    TagIndexEntry** link = TagIndex_find_link(index, old_frame);
+
+    if (link != NULL && same_key(old_frame, new_frame))
+    {
+        (*link)->frame = new_frame;
+        return;
+    }
+
+    TagIndex_remove_frame(index, old_frame);
+    TagIndex_add_frame(index, new_frame);
+}
+
+static void TagIndexEntry_free_chain(TagIndexEntry* entry)
+{
+    while (entry != NULL)
+    {
+        TagIndexEntry* next = entry->next;
+        free(entry);
+        entry = next;
+    }
+}
+
+void TagIndex_free(ID3v2_TagIndex* index)
+{
+    if (index == NULL) return;
+
+    for (int i = 0; i < index->comment_bucket_count; i++)
+    {
+        TagIndexEntry_free_chain(index->comment_buckets[i]);
+    }
+
+    for (int i = 0; i < ID3v2_PIC_TYPE_COUNT; i++)
+    {
+        TagIndexEntry_free_chain(index->pictures[i]);
+    }
+
+    free(index->comment_buckets);
+    free(index);
+}
@@ -0,0 +1,60 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_tag_index_private_h
+#define id3v2lib_tag_index_private_h
+
+#include "modules/frame.h"
+#include "modules/frame_list.h"
+#include "modules/frames/apic_frame.h"
+#include "modules/frames/comment_frame.h"
+#include "modules/picture_types.h"
+
+#define TAG_INDEX_INITIAL_BUCKET_COUNT 8
+
+typedef struct _TagIndexEntry
+{
+    unsigned int hash;
+    ID3v2_Frame* frame;
+    struct _TagIndexEntry* next;
+} TagIndexEntry;
+
+/**
+ * Per tag lookup structure for frames that are looked up by something
+ * other than their id. It's built lazily from the frame list
+ * the first time a keyed lookup is performed and kept in sync by the
+ * tag setters from then on.
+ */
+typedef struct _ID3v2_TagIndex
+{
+    int comment_count;
+    int comment_bucket_count;
+    TagIndexEntry** comment_buckets;
+    // One list per picture type, in tag order
+    TagIndexEntry* pictures[ID3v2_PIC_TYPE_COUNT];
+} ID3v2_TagIndex;
+
+ID3v2_TagIndex* TagIndex_new();
+ID3v2_TagIndex* TagIndex_build(ID3v2_FrameList* frames);
+
+ID3v2_CommentFrame* TagIndex_get_comment(
+    ID3v2_TagIndex* index,
+    const char* lang,
+    const char* short_desc
+);
+
+ID3v2_ApicFrame* TagIndex_get_picture(ID3v2_TagIndex* index, const int picture_type);
+
+void TagIndex_add_frame(ID3v2_TagIndex* index, ID3v2_Frame* frame);
+void TagIndex_remove_frame(ID3v2_TagIndex* index, ID3v2_Frame* frame);
+void TagIndex_replace_frame(ID3v2_TagIndex* index, ID3v2_Frame* old_frame, ID3v2_Frame* new_frame);
+
+void TagIndex_free(ID3v2_TagIndex* index);
+
+#endif
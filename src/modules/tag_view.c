@@ -0,0 +1,254 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <string.h>
+
+#include "modules/frame.h"
+#include "modules/frame_header.h"
+#include "modules/tag_header.private.h"
+#include "modules/utils.private.h"
+
+#include "modules/tag_view.h"
+
+#define TAG_HEADER_EXTENDED_HEADER_FLAG (1 << 6)
+
+// Second byte of the frame flags. Every other bit of it, in either version,
+// means the body has to be decoded before it can be read.
+#define FRAME_DATA_LENGTH_FLAG (1 << 0)
+#define FRAME_DATA_LENGTH_SIZE 4
+
+#define COMMENT_LANGUAGE_LENGTH 3
+
+bool ID3v2_TagView_init(ID3v2_TagView* view, const char* buffer, const int size)
+{
+    if (size < ID3v2_TAG_HEADER_LENGTH) return false;
+    if (memcmp(buffer, "ID3", ID3v2_TAG_HEADER_IDENTIFIER_LENGTH) != 0) return false;
+    if (buffer[3] != 3 && buffer[3] != 4) return false;
+
+    const char* raw_size = buffer + 6;
+    for (int i = 0; i < ID3v2_TAG_HEADER_TAG_SIZE_LENGTH; i++)
+    {
+        if (raw_size[i] & 0x80) return false;
+    }
+
+    view->buffer = buffer;
+    view->major_version = buffer[3];
+    view->flags = (unsigned char) buffer[5];
+    view->unsynchronised = (view->flags & TAG_HEADER_UNSYNCHRONISATION_FLAG) != 0;
+
+    if (view->major_version == 3 && (view->flags & TAG_HEADER_UNSYNCHRONISATION_FLAG))
+    {
+        return false;
+    }
+
+    const long tag_end =
+        ID3v2_TAG_HEADER_LENGTH +
+        (long) syncint_decode(btoi(raw_size, ID3v2_TAG_HEADER_TAG_SIZE_LENGTH));
+    view->end = tag_end < size ? tag_end : size;
+    view->frames_offset = ID3v2_TAG_HEADER_LENGTH;
+
+    if (view->flags & TAG_HEADER_EXTENDED_HEADER_FLAG)
+    {
+        if (view->end - view->frames_offset < ID3v2_EXTENDED_HEADER_SIZE_LENGTH) return false;
+
+        // v2.4 sizes are syncsafe and include the size field, v2.3 ones do neither
+        const unsigned int extended_size =
+            btoi(buffer + view->frames_offset, ID3v2_EXTENDED_HEADER_SIZE_LENGTH);
+        const long skipped = view->major_version == 4
+                                 ? (long) syncint_decode(extended_size)
+                                 : (long) extended_size + ID3v2_EXTENDED_HEADER_SIZE_LENGTH;
+
+        if (skipped > view->end - view->frames_offset) return false;
+        view->frames_offset += skipped;
+    }
+
+    view->cursor = view->frames_offset;
+
+    return true;
+}
+
+bool ID3v2_TagView_next(ID3v2_TagView* view, ID3v2_FrameRef* frame)
+{
+    if (view->end - view->cursor < ID3v2_FRAME_HEADER_LENGTH) return false;
+
+    const char* header = view->buffer + view->cursor;
+
+    // A zeroed id means we're inside the padding
+    if (header[0] == '\0') return false;
+
+    unsigned int size = btoi(header + ID3v2_FRAME_HEADER_ID_LENGTH, ID3v2_FRAME_HEADER_SIZE_LENGTH);
+    if (view->major_version == 4) size = syncint_decode(size);
+
+    if (size > (unsigned int) (view->end - view->cursor - ID3v2_FRAME_HEADER_LENGTH)) return false;
+
+    frame->id = header;
+    frame->flags = header + ID3v2_FRAME_HEADER_ID_LENGTH + ID3v2_FRAME_HEADER_SIZE_LENGTH;
+    frame->data = header + ID3v2_FRAME_HEADER_LENGTH;
+    frame->size = size;
+    frame->unsynchronised = view->unsynchronised;
+
+    if (view->major_version == 4 && (frame->flags[1] & FRAME_DATA_LENGTH_FLAG) &&
+        frame->size >= FRAME_DATA_LENGTH_SIZE)
+    {
+        frame->data += FRAME_DATA_LENGTH_SIZE;
+        frame->size -= FRAME_DATA_LENGTH_SIZE;
+    }
+
+    view->cursor += ID3v2_FRAME_HEADER_LENGTH + size;
+
+    return true;
+}
+
+void ID3v2_TagView_rewind(ID3v2_TagView* view)
+{
+    view->cursor = view->frames_offset;
+}
+
+bool ID3v2_TagView_find_frame(
+    const ID3v2_TagView* view,
+    const char* frame_id,
+    ID3v2_FrameRef* frame
+)
+{
+    ID3v2_TagView walk = *view;
+    ID3v2_TagView_rewind(&walk);
+
+    while (ID3v2_TagView_next(&walk, frame))
+    {
+        if (memcmp(frame->id, frame_id, ID3v2_FRAME_HEADER_ID_LENGTH) == 0) return true;
+    }
+
+    return false;
+}
+
+static bool is_readable(const ID3v2_FrameRef* frame)
+{
+    // Writers don't always flag the frames of an unsynchronised tag too
+    if (frame->unsynchronised) return false;
+
+    return (frame->flags[1] & ~FRAME_DATA_LENGTH_FLAG) == 0 && frame->size >= 1;
+}
+
+static int unit_size(const char encoding)
+{
+    return encoding == ID3v2_ENCODING_UNICODE || encoding == ID3v2_ENCODING_UTF16BE ? 2 : 1;
+}
+
+/**
+ * Reads a terminated string from data. Returns how many bytes it took,
+ * terminator included, or -1 if it isn't terminated.
+ */
+static int read_terminated(
+    const char encoding,
+    const char* data,
+    const int size,
+    ID3v2_TextRef* text
+)
+{
+    const int width = unit_size(encoding);
+
+    for (int i = 0; i + width <= size; i += width)
+    {
+        if (data[i] == '\0' && (width == 1 || data[i + 1] == '\0'))
+        {
+            text->encoding = encoding;
+            text->text = data;
+            text->size = i;
+            return i + width;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Reads whatever is left of the frame, without its trailing terminators.
+ */
+static void read_rest(const char encoding, const char* data, int size, ID3v2_TextRef* text)
+{
+    const int width = unit_size(encoding);
+    size -= size % width;
+
+    while (size >= width && data[size - width] == '\0' && (width == 1 || data[size - 1] == '\0'))
+    {
+        size -= width;
+    }
+
+    text->encoding = encoding;
+    text->text = data;
+    text->size = size;
+}
+
+bool ID3v2_FrameRef_get_text(const ID3v2_FrameRef* frame, ID3v2_TextRef* text)
+{
+    if (!is_readable(frame)) return false;
+
+    read_rest(frame->data[0], frame->data + 1, frame->size - 1, text);
+    return true;
+}
+
+bool ID3v2_FrameRef_get_comment(const ID3v2_FrameRef* frame, ID3v2_CommentRef* comment)
+{
+    if (!is_readable(frame) || frame->size < 1 + COMMENT_LANGUAGE_LENGTH) return false;
+
+    const char encoding = frame->data[0];
+    const char* data = frame->data + 1 + COMMENT_LANGUAGE_LENGTH;
+    const int size = frame->size - 1 - COMMENT_LANGUAGE_LENGTH;
+
+    const int consumed = read_terminated(encoding, data, size, &comment->short_description);
+    if (consumed < 0) return false;
+
+    comment->language = frame->data + 1;
+    read_rest(encoding, data + consumed, size - consumed, &comment->comment);
+
+    return true;
+}
+
+bool ID3v2_FrameRef_get_picture(const ID3v2_FrameRef* frame, ID3v2_PictureRef* picture)
+{
+    if (!is_readable(frame)) return false;
+
+    const char encoding = frame->data[0];
+    const char* data = frame->data + 1;
+    int size = frame->size - 1;
+
+    // The mime type is always Latin-1
+    ID3v2_TextRef mime_type;
+    int consumed = read_terminated(ID3v2_ENCODING_ISO, data, size, &mime_type);
+    if (consumed < 0 || consumed >= size) return false;
+
+    picture->mime_type = mime_type.text;
+    picture->picture_type = data[consumed];
+    data += consumed + 1;
+    size -= consumed + 1;
+
+    consumed = read_terminated(encoding, data, size, &picture->description);
+    if (consumed < 0) return false;
+
+    picture->data = data + consumed;
+    picture->size = size - consumed;
+
+    return true;
+}
+
+bool ID3v2_FrameRef_get_user_text(const ID3v2_FrameRef* frame, ID3v2_UserTextRef* user_text)
+{
+    if (!is_readable(frame)) return false;
+
+    const char encoding = frame->data[0];
+    const char* data = frame->data + 1;
+    const int size = frame->size - 1;
+
+    const int consumed = read_terminated(encoding, data, size, &user_text->description);
+    if (consumed < 0) return false;
+
+    read_rest(encoding, data + consumed, size - consumed, &user_text->value);
+
+    return true;
+}
@@ -0,0 +1,192 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "throttle.private.h"
+
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_VALUE(class, level) (((class) << IOPRIO_CLASS_SHIFT) | (level))
+
+// The bucket holds up to a tenth of a second worth of bytes
+#define BURST_DIVISOR 10
+
+#define NS_PER_SECOND 1000000000ULL
+
+static ID3v2_Throttle* installed_throttle = NULL;
+
+static unsigned long long now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NS_PER_SECOND + now.tv_nsec;
+}
+
+static double bucket_size(ID3v2_Throttle* throttle)
+{
+    return (double) throttle->bytes_per_second / BURST_DIVISOR;
+}
+
+ID3v2_Throttle* ID3v2_Throttle_new(
+    const int io_class,
+    const int io_level,
+    const unsigned long long bytes_per_second,
+    const int max_rewrites
+)
+{
+    ID3v2_Throttle* throttle = (ID3v2_Throttle*) calloc(1, sizeof(ID3v2_Throttle));
+    throttle->io_class = io_class;
+    throttle->io_level = io_level;
+    throttle->bytes_per_second = bytes_per_second;
+    throttle->max_rewrites = max_rewrites;
+    throttle->tokens = bucket_size(throttle);
+    throttle->last_refill_ns = now_ns();
+
+    pthread_mutex_init(&throttle->lock, NULL);
+    pthread_cond_init(&throttle->rewrite_done, NULL);
+
+    return throttle;
+}
+
+void ID3v2_Throttle_free(ID3v2_Throttle* throttle)
+{
+    if (throttle == NULL) return;
+
+    pthread_mutex_destroy(&throttle->lock);
+    pthread_cond_destroy(&throttle->rewrite_done);
+    free(throttle);
+}
+
+void ID3v2_Throttle_install(ID3v2_Throttle* throttle)
+{
+    // Released so threads that pick it up see it fully set up
+    __atomic_store_n(&installed_throttle, throttle, __ATOMIC_RELEASE);
+}
+
+ID3v2_Throttle* Throttle_get_installed()
+{
+    return __atomic_load_n(&installed_throttle, __ATOMIC_ACQUIRE);
+}
+
+void ID3v2_Throttle_get_stats(ID3v2_Throttle* throttle, ID3v2_ThrottleStats* stats)
+{
+    pthread_mutex_lock(&throttle->lock);
+    *stats = throttle->stats;
+    pthread_mutex_unlock(&throttle->lock);
+}
+
+/**
+ * The priority is set for the calling thread only.
+ */
+static int set_io_priority(const int priority)
+{
+#ifdef SYS_ioprio_set
+    const int previous = syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0);
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, priority);
+    return previous;
+#else
+    return -1;
+#endif
+}
+
+int Throttle_begin_io(ID3v2_Throttle* throttle)
+{
+    if (throttle == NULL || throttle->io_class == ID3v2_IO_CLASS_NONE) return -1;
+
+    return set_io_priority(IOPRIO_VALUE(throttle->io_class, throttle->io_level));
+}
+
+void Throttle_end_io(ID3v2_Throttle* throttle, const int previous_priority)
+{
+    if (throttle != NULL && previous_priority >= 0) set_io_priority(previous_priority);
+}
+
+int Throttle_begin_rewrite(ID3v2_Throttle* throttle)
+{
+    if (throttle == NULL) return -1;
+
+    pthread_mutex_lock(&throttle->lock);
+
+    if (throttle->max_rewrites > 0 && throttle->rewrites >= throttle->max_rewrites)
+    {
+        const unsigned long long start = now_ns();
+
+        while (throttle->rewrites >= throttle->max_rewrites)
+        {
+            pthread_cond_wait(&throttle->rewrite_done, &throttle->lock);
+        }
+
+        throttle->stats.rewrite_wait_ns += now_ns() - start;
+    }
+
+    throttle->rewrites++;
+    throttle->stats.rewrites++;
+
+    pthread_mutex_unlock(&throttle->lock);
+
+    return Throttle_begin_io(throttle);
+}
+
+void Throttle_end_rewrite(ID3v2_Throttle* throttle, const int previous_priority)
+{
+    if (throttle == NULL) return;
+
+    Throttle_end_io(throttle, previous_priority);
+
+    pthread_mutex_lock(&throttle->lock);
+    throttle->rewrites--;
+    pthread_cond_signal(&throttle->rewrite_done);
+    pthread_mutex_unlock(&throttle->lock);
+}
+
+void Throttle_consume(ID3v2_Throttle* throttle, const int size)
+{
+    if (throttle == NULL) return;
+
+    unsigned long long wait_ns = 0;
+
+    pthread_mutex_lock(&throttle->lock);
+
+    throttle->stats.bytes_moved += size;
+
+    if (throttle->bytes_per_second > 0)
+    {
+        const unsigned long long now = now_ns();
+        const double refill =
+            (double) (now - throttle->last_refill_ns) * throttle->bytes_per_second / NS_PER_SECOND;
+
+        throttle->last_refill_ns = now;
+        throttle->tokens += refill;
+        if (throttle->tokens > bucket_size(throttle)) throttle->tokens = bucket_size(throttle);
+
+        // Going into debt keeps concurrent callers queued in order
+        throttle->tokens -= size;
+
+        if (throttle->tokens < 0)
+        {
+            wait_ns = -throttle->tokens * NS_PER_SECOND / throttle->bytes_per_second;
+            throttle->stats.throttled_ns += wait_ns;
+        }
+    }
+
+    pthread_mutex_unlock(&throttle->lock);
+
+    if (wait_ns > 0)
+    {
+        const struct timespec wait = {wait_ns / NS_PER_SECOND, wait_ns % NS_PER_SECOND};
+        nanosleep(&wait, NULL);
+    }
+}
@@ -0,0 +1,38 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_throttle_private_h
+#define id3v2lib_throttle_private_h
+
+#include "modules/throttle.h"
+
+ID3v2_Throttle* Throttle_get_installed();
+
+/**
+ * Lowers the I/O priority of the thread to the one of throttle, without
+ * taking a rewrite slot. Returns the priority to give back to
+ * Throttle_end_io. Both do nothing when throttle is NULL.
+ */
+int Throttle_begin_io(ID3v2_Throttle* throttle);
+void Throttle_end_io(ID3v2_Throttle* throttle, const int previous_priority);
+
+/**
+ * Waits for a rewrite slot and lowers the I/O priority of the thread.
+ * Returns the priority to give back to Throttle_end_rewrite. Both do
+ * nothing when throttle is NULL.
+ */
+int Throttle_begin_rewrite(ID3v2_Throttle* throttle);
+void Throttle_end_rewrite(ID3v2_Throttle* throttle, const int previous_priority);
+
+/**
+ * Takes size bytes from the bucket, sleeping until they're available.
+ */
+void Throttle_consume(ID3v2_Throttle* throttle, const int size);
+
+#endif
@@ -7,15 +7,22 @@
  * file that was distributed with this source code.
  */
 
+#define _GNU_SOURCE
+
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "utils.private.h"
 
 #define BOM_LENGTH 2
 
+// Never written to, so it stays on the shared zero page
+#define ZEROS_LENGTH (64 * 1024)
+static const char zeros[ZEROS_LENGTH];
+
 char* ID3v2_to_unicode(char* string)
 {
     if (string_has_bom(string))
@@ -145,6 +152,46 @@ int clamp_int(const int value, const int min, const int max)
     return value < min ? min : (value > max ? max : value);
 }
 
+int unsync_decode(const char* src, const int size, char* dest)
+{
+    int written = 0;
+
+    for (int i = 0; i < size; i++)
+    {
+        dest[written++] = src[i];
+        if ((unsigned char) src[i] == 0xFF && i + 1 < size && src[i + 1] == 0) i++;
+    }
+
+    return written;
+}
+
+bool pwrite_zeros(const int fd, long offset, long size)
+{
+    while (size > 0)
+    {
+        const long length = size < ZEROS_LENGTH ? size : ZEROS_LENGTH;
+        if (pwrite(fd, zeros, length, offset) != length) return false;
+
+        offset += length;
+        size -= length;
+    }
+
+    return true;
+}
+
+bool fwrite_zeros(FILE* fp, long size)
+{
+    while (size > 0)
+    {
+        const long length = size < ZEROS_LENGTH ? size : ZEROS_LENGTH;
+        if (fwrite(zeros, sizeof(char), length, fp) != (size_t) length) return false;
+
+        size -= length;
+    }
+
+    return true;
+}
+
 bool string_has_bom(const char* string)
 {
     if (string == NULL)
@@ -159,3 +206,78 @@ bool string_has_bom(const char* string)
 
     return false;
 }
+
+unsigned long long btoull(const char* bytes, int size)
+{
+    unsigned long long result = 0;
+
+    for (int i = 0; i < size; i++)
+    {
+        result = (result << 8) | (unsigned char) bytes[i];
+    }
+
+    return result;
+}
+
+void ulltob(unsigned long long value, char* dest, int size)
+{
+    for (int i = size - 1; i >= 0; i--)
+    {
+        dest[i] = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+/**
+ * The spec requires counters to be at least 4 bytes wide and to grow one
+ * byte at a time when they overflow.
+ */
+int counter_size(unsigned long long value)
+{
+    int size = 4;
+
+    while (size < 8 && (value >> (size * 8)) != 0)
+    {
+        size++;
+    }
+
+    return size;
+}
+
+unsigned long long fnv1a_64(const char* data, const int size, unsigned long long hash)
+{
+    for (int i = 0; i < size; i++)
+    {
+        hash = (hash ^ (unsigned char) data[i]) * 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+char* utf8_encode(char* dest, const unsigned int code_point)
+{
+    if (code_point < 0x80)
+    {
+        *dest++ = code_point;
+    }
+    else if (code_point < 0x800)
+    {
+        *dest++ = 0xC0 | (code_point >> 6);
+        *dest++ = 0x80 | (code_point & 0x3F);
+    }
+    else if (code_point < 0x10000)
+    {
+        *dest++ = 0xE0 | (code_point >> 12);
+        *dest++ = 0x80 | ((code_point >> 6) & 0x3F);
+        *dest++ = 0x80 | (code_point & 0x3F);
+    }
+    else
+    {
+        *dest++ = 0xF0 | (code_point >> 18);
+        *dest++ = 0x80 | ((code_point >> 12) & 0x3F);
+        *dest++ = 0x80 | ((code_point >> 6) & 0x3F);
+        *dest++ = 0x80 | (code_point & 0x3F);
+    }
+
+    return dest;
+}
@@ -11,6 +11,7 @@
 #define id3v2lib_utils_private_h
 
 #include <stdbool.h>
+#include <stdio.h>
 
 #include "modules/utils.h"
 
@@ -21,4 +22,37 @@ unsigned int syncint_decode(int value);
 int clamp_int(const int value, const int min, const int max);
 bool string_has_bom(const char* string);
 
+/**
+ * Write size zero bytes (padding) without allocating them. Both return
+ * false if the write fails.
+ */
+bool pwrite_zeros(const int fd, long offset, long size);
+bool fwrite_zeros(FILE* fp, long size);
+
+/**
+ * Undoes unsynchronisation, turning every 0xFF 0x00 pair back into 0xFF.
+ * dest needs room for size bytes, returns how many were written.
+ */
+int unsync_decode(const char* src, const int size, char* dest);
+
+/**
+ * Writes code_point as UTF-8 (1 to 4 bytes) and returns where it ends.
+ */
+char* utf8_encode(char* dest, const unsigned int code_point);
+
+/**
+ * Big endian counters of arbitrary width, as used by the PCNT and POPM
+ * frames. Counters wider than 8 bytes only keep their lowest 8 bytes.
+ */
+unsigned long long btoull(const char* bytes, int size);
+void ulltob(unsigned long long value, char* dest, int size);
+int counter_size(unsigned long long value);
+
+/**
+ * 64 bit FNV-1a, seeded with the hash of any previous chunk (or
+ * FNV1A_64_OFFSET_BASIS for the first one) so data can be hashed in parts.
+ */
+#define FNV1A_64_OFFSET_BASIS 14695981039346656037ULL
+unsigned long long fnv1a_64(const char* data, const int size, unsigned long long hash);
+
 #endif
@@ -0,0 +1,515 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "id3v2lib.h"
+
+#define DIRECTORY_BUFFER_SIZE (256 * 1024)
+#define MAX_EXTENSION_LENGTH 8
+#define IDLE_WAIT_NS 1000000
+
+typedef struct _DirectoryEntry
+{
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+} DirectoryEntry;
+
+/**
+ * Open addressing table without collisions: the seed of the hash is picked
+ * so every extension gets a slot of its own, and a lookup is a single hash
+ * and compare.
+ */
+typedef struct _ExtensionSet
+{
+    const char** slots;
+    unsigned int mask;
+    unsigned int seed;
+} ExtensionSet;
+
+/**
+ * Open directory shared by the subdirectories queued from it, so they can
+ * be opened relative to it. Closed once the last of them has been opened.
+ */
+typedef struct _DirectoryHandle
+{
+    int fd;
+    int references;
+} DirectoryHandle;
+
+/**
+ * Directory waiting to be read. name points into path, and parent is NULL
+ * for the root, which is opened by path.
+ */
+typedef struct _Directory
+{
+    char* path;
+    const char* name;
+    DirectoryHandle* parent;
+} Directory;
+
+/**
+ * Directories waiting to be read. The owner pushes and pops at the tail,
+ * other walkers steal from the head, so they take the oldest (and usually
+ * biggest) subtrees.
+ */
+typedef struct _WorkDeque
+{
+    pthread_mutex_t lock;
+    Directory* items;
+    int head;
+    int tail;
+    int capacity;
+} WorkDeque;
+
+typedef struct _Walk
+{
+    ExtensionSet extensions;
+    ID3v2_WalkCallback callback;
+    void* callback_ctx;
+
+    WorkDeque* deques;
+    int threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_changed;
+    // Directories queued or being read, the walk is over once it's 0
+    int pending;
+    bool stopped;
+} Walk;
+
+typedef struct _Walker
+{
+    Walk* walk;
+    int id;
+    char* buffer;
+    char* path;
+    size_t path_capacity;
+} Walker;
+
+static bool is_stopped(Walk* walk)
+{
+    return __atomic_load_n(&walk->stopped, __ATOMIC_RELAXED);
+}
+
+static unsigned int hash_extension(const char* extension, const int length, const unsigned int seed)
+{
+    unsigned int hash = 2166136261u ^ seed;
+
+    for (int i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char) tolower((unsigned char) extension[i]);
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static bool ExtensionSet_try_seed(ExtensionSet* set, const char* const* extensions, const int count)
+{
+    memset(set->slots, 0, (set->mask + 1) * sizeof(const char*));
+
+    for (int i = 0; i < count; i++)
+    {
+        const int length = strlen(extensions[i]);
+        if (length == 0 || length > MAX_EXTENSION_LENGTH) continue;
+
+        const unsigned int slot = hash_extension(extensions[i], length, set->seed) & set->mask;
+        if (set->slots[slot] != NULL && strcasecmp(set->slots[slot], extensions[i]) != 0)
+        {
+            return false;
+        }
+
+        set->slots[slot] = extensions[i];
+    }
+
+    return true;
+}
+
+static void ExtensionSet_init(ExtensionSet* set, const char* const* extensions, const int count)
+{
+    unsigned int size = 8;
+    while (size < (unsigned int) count * 2) size *= 2;
+
+    for (;; size *= 2)
+    {
+        set->slots = (const char**) malloc(size * sizeof(const char*));
+        set->mask = size - 1;
+
+        for (set->seed = 0; set->seed < 1024; set->seed++)
+        {
+            if (ExtensionSet_try_seed(set, extensions, count)) return;
+        }
+
+        free(set->slots);
+    }
+}
+
+static bool ExtensionSet_contains(ExtensionSet* set, const char* file_name)
+{
+    const char* dot = strrchr(file_name, '.');
+    if (dot == NULL) return false;
+
+    const char* extension = dot + 1;
+    const int length = strlen(extension);
+    if (length == 0 || length > MAX_EXTENSION_LENGTH) return false;
+
+    const char* candidate = set->slots[hash_extension(extension, length, set->seed) & set->mask];
+    return candidate != NULL && strcasecmp(candidate, extension) == 0;
+}
+
+static DirectoryHandle* DirectoryHandle_new(const int fd)
+{
+    DirectoryHandle* handle = (DirectoryHandle*) malloc(sizeof(DirectoryHandle));
+    handle->fd = fd;
+    handle->references = 1;
+
+    return handle;
+}
+
+static void DirectoryHandle_retain(DirectoryHandle* handle)
+{
+    __atomic_add_fetch(&handle->references, 1, __ATOMIC_RELAXED);
+}
+
+static void DirectoryHandle_release(DirectoryHandle* handle)
+{
+    if (handle == NULL) return;
+
+    if (__atomic_sub_fetch(&handle->references, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        close(handle->fd);
+        free(handle);
+    }
+}
+
+static void WorkDeque_push(WorkDeque* deque, const Directory directory)
+{
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->tail == deque->capacity)
+    {
+        // Reclaim the slots freed by thieves before growing
+        const int size = deque->tail - deque->head;
+        memmove(deque->items, deque->items + deque->head, size * sizeof(Directory));
+        deque->head = 0;
+        deque->tail = size;
+
+        if (deque->tail == deque->capacity)
+        {
+            deque->capacity = deque->capacity > 0 ? deque->capacity * 2 : 64;
+            deque->items =
+                (Directory*) realloc(deque->items, deque->capacity * sizeof(Directory));
+        }
+    }
+
+    deque->items[deque->tail++] = directory;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+static bool WorkDeque_take(WorkDeque* deque, const bool steal, Directory* directory)
+{
+    bool taken = false;
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->head < deque->tail)
+    {
+        *directory = steal ? deque->items[deque->head++] : deque->items[--deque->tail];
+        if (deque->head == deque->tail) deque->head = deque->tail = 0;
+        taken = true;
+    }
+
+    pthread_mutex_unlock(&deque->lock);
+    return taken;
+}
+
+static void push_directory(Walker* walker, const Directory directory)
+{
+    Walk* walk = walker->walk;
+
+    pthread_mutex_lock(&walk->lock);
+    walk->pending++;
+    pthread_mutex_unlock(&walk->lock);
+
+    WorkDeque_push(&walk->deques[walker->id], directory);
+    pthread_cond_signal(&walk->work_changed);
+}
+
+static bool take_directory(Walker* walker, Directory* directory)
+{
+    Walk* walk = walker->walk;
+    bool taken = WorkDeque_take(&walk->deques[walker->id], false, directory);
+
+    for (int i = 1; !taken && i < walk->threads; i++)
+    {
+        taken = WorkDeque_take(&walk->deques[(walker->id + i) % walk->threads], true, directory);
+    }
+
+    return taken;
+}
+
+static const char* join_path(Walker* walker, const char* directory, const char* name)
+{
+    const size_t directory_length = strlen(directory);
+    const size_t name_length = strlen(name);
+    const bool has_separator = directory_length > 0 && directory[directory_length - 1] == '/';
+    const size_t size = directory_length + !has_separator + name_length + 1;
+
+    if (size > walker->path_capacity)
+    {
+        walker->path_capacity = size * 2;
+        walker->path = (char*) realloc(walker->path, walker->path_capacity);
+    }
+
+    memcpy(walker->path, directory, directory_length);
+    if (!has_separator) walker->path[directory_length] = '/';
+    memcpy(walker->path + directory_length + !has_separator, name, name_length + 1);
+
+    return walker->path;
+}
+
+static unsigned char entry_type(const int directory_fd, const DirectoryEntry* entry)
+{
+    if (entry->d_type != DT_UNKNOWN) return entry->d_type;
+
+    // Only some file systems leave the type out, stat just those entries
+    struct stat st;
+    if (fstatat(directory_fd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) return DT_UNKNOWN;
+    if (S_ISDIR(st.st_mode)) return DT_DIR;
+    if (S_ISREG(st.st_mode)) return DT_REG;
+    return DT_UNKNOWN;
+}
+
+/**
+ * Subdirectories are opened relative to the directory they were found in,
+ * which saves resolving their whole path again and keeps the walk within
+ * the tree if a directory on the way is swapped for a symlink.
+ */
+static int open_directory(const Directory* directory)
+{
+    const int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+
+    if (directory->parent == NULL) return open(directory->path, flags);
+
+    return openat(directory->parent->fd, directory->name, flags | O_NOFOLLOW);
+}
+
+static void read_directory(Walker* walker, const Directory* directory)
+{
+    Walk* walk = walker->walk;
+    const int fd = open_directory(directory);
+    if (fd < 0) return;
+
+    // Only kept open past this call while its subdirectories are queued
+    DirectoryHandle* handle = DirectoryHandle_new(fd);
+
+    long read_size;
+    while (!is_stopped(walk) &&
+           (read_size = syscall(SYS_getdents64, fd, walker->buffer, DIRECTORY_BUFFER_SIZE)) > 0)
+    {
+        for (long offset = 0; offset < read_size && !is_stopped(walk);)
+        {
+            const DirectoryEntry* entry = (const DirectoryEntry*) (walker->buffer + offset);
+            offset += entry->d_reclen;
+
+            const char* name = entry->d_name;
+            if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+
+            const unsigned char type = entry_type(fd, entry);
+
+            if (type == DT_DIR)
+            {
+                char* path = strdup(join_path(walker, directory->path, name));
+                const Directory subdirectory = {path, path + strlen(path) - strlen(name), handle};
+
+                DirectoryHandle_retain(handle);
+                push_directory(walker, subdirectory);
+            }
+            else if (type == DT_REG && ExtensionSet_contains(&walk->extensions, name))
+            {
+                if (!walk->callback(join_path(walker, directory->path, name), walk->callback_ctx))
+                {
+                    __atomic_store_n(&walk->stopped, true, __ATOMIC_RELAXED);
+                }
+            }
+        }
+    }
+
+    DirectoryHandle_release(handle);
+}
+
+static void* walk_directories(void* arg)
+{
+    Walker* walker = (Walker*) arg;
+    Walk* walk = walker->walk;
+
+    for (;;)
+    {
+        Directory directory;
+
+        if (!take_directory(walker, &directory))
+        {
+            pthread_mutex_lock(&walk->lock);
+
+            if (walk->pending == 0)
+            {
+                pthread_mutex_unlock(&walk->lock);
+                break;
+            }
+
+            // Work may be pushed between the steal and the wait, so don't
+            // wait for long
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += IDLE_WAIT_NS;
+            if (until.tv_nsec >= 1000000000L)
+            {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000L;
+            }
+
+            pthread_cond_timedwait(&walk->work_changed, &walk->lock, &until);
+            pthread_mutex_unlock(&walk->lock);
+            continue;
+        }
+
+        // Once stopped, the queued directories are only drained
+        if (!is_stopped(walk)) read_directory(walker, &directory);
+        DirectoryHandle_release(directory.parent);
+        free(directory.path);
+
+        pthread_mutex_lock(&walk->lock);
+        if (--walk->pending == 0) pthread_cond_broadcast(&walk->work_changed);
+        pthread_mutex_unlock(&walk->lock);
+    }
+
+    return NULL;
+}
+
+int ID3v2_walk(
+    const char* root,
+    const ID3v2_WalkOptions* options,
+    ID3v2_WalkCallback callback,
+    void* callback_ctx
+)
+{
+    const int root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd < 0) return -1;
+    close(root_fd);
+
+    static const char* const default_extensions[] = ID3v2_WALK_DEFAULT_EXTENSIONS;
+    const bool has_extensions = options != NULL && options->extensions != NULL;
+
+    Walk walk;
+    memset(&walk, 0, sizeof(walk));
+    walk.callback = callback;
+    walk.callback_ctx = callback_ctx;
+    walk.threads = options != NULL && options->threads > 0 ? options->threads
+                                                           : sysconf(_SC_NPROCESSORS_ONLN);
+    if (walk.threads < 1) walk.threads = 1;
+
+    ExtensionSet_init(
+        &walk.extensions,
+        has_extensions ? options->extensions : default_extensions,
+        has_extensions ? options->extension_count : ID3v2_WALK_DEFAULT_EXTENSION_COUNT
+    );
+
+    pthread_mutex_init(&walk.lock, NULL);
+    pthread_cond_init(&walk.work_changed, NULL);
+    walk.deques = (WorkDeque*) calloc(walk.threads, sizeof(WorkDeque));
+
+    Walker* walkers = (Walker*) calloc(walk.threads, sizeof(Walker));
+    pthread_t* threads = (pthread_t*) malloc(walk.threads * sizeof(pthread_t));
+
+    for (int i = 0; i < walk.threads; i++)
+    {
+        pthread_mutex_init(&walk.deques[i].lock, NULL);
+        walkers[i].walk = &walk;
+        walkers[i].id = i;
+        walkers[i].buffer = (char*) malloc(DIRECTORY_BUFFER_SIZE);
+    }
+
+    char* root_path = strdup(root);
+    push_directory(&walkers[0], (Directory){root_path, root_path, NULL});
+
+    // The calling thread walks too, so the walk goes on even if no other
+    // thread can be started. Nothing is pushed to the deques of walkers
+    // that didn't start
+    int started = 0;
+    for (int i = 1; i < walk.threads; i++)
+    {
+        if (pthread_create(&threads[started], NULL, walk_directories, &walkers[i]) == 0) started++;
+    }
+
+    walk_directories(&walkers[0]);
+
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (int i = 0; i < walk.threads; i++)
+    {
+        pthread_mutex_destroy(&walk.deques[i].lock);
+        free(walk.deques[i].items);
+        free(walkers[i].buffer);
+        free(walkers[i].path);
+    }
+
+    pthread_cond_destroy(&walk.work_changed);
+    pthread_mutex_destroy(&walk.lock);
+    free(walk.extensions.slots);
+    free(walk.deques);
+    free(walkers);
+    free(threads);
+
+    return walk.stopped ? ID3v2_OPERATION_CANCELLED : 0;
+}
+
+typedef struct _TreeScan
+{
+    ID3v2_ScanCallback callback;
+    void* callback_ctx;
+} TreeScan;
+
+static bool scan_file(const char* path, void* ctx)
+{
+    TreeScan* scan = (TreeScan*) ctx;
+    ID3v2_Tag* tag = ID3v2_read_tag(path);
+    const bool proceed = scan->callback(path, tag, scan->callback_ctx);
+
+    if (tag != NULL) ID3v2_Tag_free(tag);
+    return proceed;
+}
+
+int ID3v2_scan_tree(
+    const char* root,
+    const ID3v2_WalkOptions* options,
+    ID3v2_ScanCallback callback,
+    void* callback_ctx
+)
+{
+    TreeScan scan = {callback, callback_ctx};
+    return ID3v2_walk(root, options, scan_file, &scan);
+}
@@ -0,0 +1,286 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "id3v2lib.h"
+
+#include "canonical_test.h"
+
+#define ORIGINAL_FILE "extra/file.mp3"
+
+/**
+ * Pairs of tags holding the same metadata, built through different edit
+ * histories: other frame orders, encodings, flags and padding.
+ */
+typedef ID3v2_Tag* (*TagBuilder)();
+
+static ID3v2_Tag* read_file_tag()
+{
+    return ID3v2_read_tag(ORIGINAL_FILE);
+}
+
+static ID3v2_Tag* read_file_tag_edited()
+{
+    // Same frames, moved around and with a different amount of padding
+    ID3v2_Tag* tag = ID3v2_read_tag(ORIGINAL_FILE);
+    const ID3v2_TextFrameData* title = ID3v2_Tag_get_title_frame(tag)->data;
+    const int size = title->size;
+    const char encoding = title->encoding;
+    char* title_copy = (char*) malloc(size);
+    memcpy(title_copy, title->text, size);
+
+    ID3v2_Tag_delete_title(tag);
+    ID3v2_Tag_set_text(tag, ID3v2_TITLE_FRAME_ID, title_copy, size, encoding);
+    tag->padding_size += 4096;
+
+    free(title_copy);
+    return tag;
+}
+
+static ID3v2_Tag* v3_latin1()
+{
+    ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+    ID3v2_Tag_set_title(tag, "Twilight of the Thunder God");
+    ID3v2_Tag_set_artist(tag, "Amon Amarth");
+    ID3v2_Tag_set_year(tag, "2008");
+    return tag;
+}
+
+static ID3v2_Tag* v3_latin1_reencoded()
+{
+    ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+    ID3v2_Tag_set_year(tag, "2008");
+    ID3v2_Tag_set_text(
+        tag,
+        ID3v2_ARTIST_FRAME_ID,
+        "\xFF\xFE" "A\0m\0o\0n\0 \0A\0m\0a\0r\0t\0h\0",
+        24,
+        ID3v2_ENCODING_UNICODE
+    );
+    ID3v2_Tag_set_text(
+        tag, ID3v2_TITLE_FRAME_ID, "Twilight of the Thunder God", 27, ID3v2_ENCODING_ISO
+    );
+
+    // Status flags are dropped
+    ID3v2_Tag_get_frame(tag, ID3v2_YEAR_FRAME_ID)->header->flags[0] = 0x40;
+    return tag;
+}
+
+static ID3v2_Tag* v3_unicode()
+{
+    ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+    ID3v2_Tag_set_text(
+        tag, ID3v2_TITLE_FRAME_ID, "Ragnar\xC3\xB6k \xF0\x9F\xA4\x98", 14, ID3v2_ENCODING_UTF8
+    );
+    return tag;
+}
+
+static ID3v2_Tag* v3_unicode_big_endian()
+{
+    ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+    ID3v2_Tag_set_text(
+        tag,
+        ID3v2_TITLE_FRAME_ID,
+        "\0R\0a\0g\0n\0a\0r\0\xF6\0k\0 \xD8\x3E\xDD\x18",
+        22,
+        ID3v2_ENCODING_UTF16BE
+    );
+    return tag;
+}
+
+static ID3v2_Tag* v4_values()
+{
+    ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+    tag->header->major_version = 4;
+
+    const ID3v2_TextValue artists[] = {{"Amon Amarth", 11}, {"Doro", 4}};
+    ID3v2_Tag_set_text_values(tag, ID3v2_ARTIST_FRAME_ID, artists, 2, ID3v2_ENCODING_UTF8);
+    ID3v2_Tag_add_comment_frame(
+        tag,
+        &(ID3v2_CommentFrameInput){"\0\0", "eng", "b", "Second"}
+    );
+    ID3v2_Tag_add_comment_frame(
+        tag,
+        &(ID3v2_CommentFrameInput){"\0\0", "eng", "a", "First"}
+    );
+    return tag;
+}
+
+static ID3v2_Tag* v4_values_reencoded()
+{
+    ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+    tag->header->major_version = 4;
+
+    // Terminated values with an empty one at the end, in UTF-16
+    ID3v2_Tag_add_comment_frame(
+        tag,
+        &(ID3v2_CommentFrameInput){"\0\0", "eng", "a", "First"}
+    );
+    ID3v2_Tag_add_comment_frame(
+        tag,
+        &(ID3v2_CommentFrameInput){"\0\0", "eng", "b", "Second"}
+    );
+
+    const ID3v2_TextValue artists[] = {
+        {"\xFF\xFE" "A\0m\0o\0n\0 \0A\0m\0a\0r\0t\0h\0", 24},
+        {"\xFE\xFF\0D\0o\0r\0o", 10},
+        {"", 0},
+    };
+    ID3v2_Tag_set_text_values(tag, ID3v2_ARTIST_FRAME_ID, artists, 3, ID3v2_ENCODING_UNICODE);
+    return tag;
+}
+
+static ID3v2_Tag* comment_latin1()
+{
+    ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+    ID3v2_Tag_add_comment_frame(
+        tag,
+        &(ID3v2_CommentFrameInput){"\0\0", "swe", "Note", "Ragnar\xF6k"}
+    );
+    ID3v2_Tag_add_apic_frame(
+        tag,
+        &(ID3v2_ApicFrameInput){"\0\0", ID3v2_MIME_TYPE_PNG, "Fr\xE4mre", 3, 4, "\x89PNG"}
+    );
+    return tag;
+}
+
+static ID3v2_Tag* comment_unicode()
+{
+    // Only the encoding of the comment and the picture description differ
+    ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+    ID3v2_Tag_add_comment_frame(
+        tag,
+        &(ID3v2_CommentFrameInput){
+            "\0\0",
+            "swe",
+            "\xFF\xFE" "N\0o\0t\0e\0\0\0",
+            "\xFF\xFE" "R\0a\0g\0n\0a\0r\0\xF6\0k\0\0\0",
+        }
+    );
+    ID3v2_Tag_add_apic_frame(
+        tag,
+        &(ID3v2_ApicFrameInput){
+            "\0\0",
+            ID3v2_MIME_TYPE_PNG,
+            "\xFF\xFE" "F\0r\0\xE4\0m\0r\0e\0\0\0",
+            3,
+            4,
+            "\x89PNG",
+        }
+    );
+    return tag;
+}
+
+static ID3v2_Tag* comment_latin1_v4()
+{
+    ID3v2_Tag* tag = comment_latin1();
+    tag->header->major_version = 4;
+    return tag;
+}
+
+static ID3v2_Tag* comment_unicode_v4()
+{
+    ID3v2_Tag* tag = comment_unicode();
+    tag->header->major_version = 4;
+    return tag;
+}
+
+static const TagBuilder corpus[][2] = {
+    {read_file_tag, read_file_tag_edited},
+    {v3_latin1, v3_latin1_reencoded},
+    {v3_unicode, v3_unicode_big_endian},
+    {v4_values, v4_values_reencoded},
+    {comment_latin1, comment_unicode},
+    {comment_latin1_v4, comment_unicode_v4},
+};
+
+static char* canonical_bytes(TagBuilder builder, int* size)
+{
+    ID3v2_Tag* tag = builder();
+    char* bytes = ID3v2_Tag_to_canonical(tag, size);
+    ID3v2_Tag_free(tag);
+    return bytes;
+}
+
+void canonical_test()
+{
+    const int corpus_size = sizeof(corpus) / sizeof(corpus[0]);
+
+    for (int i = 0; i < corpus_size; i++)
+    {
+        int size = 0;
+        int other_size = 0;
+        char* bytes = canonical_bytes(corpus[i][0], &size);
+        char* other_bytes = canonical_bytes(corpus[i][1], &other_size);
+
+        assert(size % ID3v2_CANONICAL_TAG_ALIGNMENT == 0);
+        assert(size == other_size);
+        assert(memcmp(bytes, other_bytes, size) == 0);
+
+        // Canonicalizing a canonical tag doesn't change it
+        ID3v2_Tag* tag = ID3v2_read_tag_from_buffer(bytes, size);
+        char* again = ID3v2_Tag_to_canonical(tag, &other_size);
+        assert(size == other_size);
+        assert(memcmp(bytes, again, size) == 0);
+
+        ID3v2_Tag_free(tag);
+        free(again);
+        free(other_bytes);
+        free(bytes);
+    }
+
+    // Canonical text uses the narrowest encoding the version allows
+    ID3v2_Tag* tag = v3_latin1_reencoded();
+    ID3v2_Tag_canonicalize(tag);
+    assert(ID3v2_Tag_get_artist_frame(tag)->data->encoding == ID3v2_ENCODING_ISO);
+    assert(strcmp(ID3v2_Tag_get_artist_frame(tag)->data->text, "Amon Amarth") == 0);
+    assert(ID3v2_Tag_get_frame(tag, ID3v2_YEAR_FRAME_ID)->header->flags[0] == 0);
+    ID3v2_Tag_free(tag);
+
+    tag = v4_values_reencoded();
+    ID3v2_Tag_canonicalize(tag);
+    ID3v2_TextFrame* artist = ID3v2_Tag_get_artist_frame(tag);
+    assert(artist->data->encoding == ID3v2_ENCODING_UTF8);
+    assert(artist->data->size == 17);
+    assert(memcmp(artist->data->text, "Amon Amarth\0Doro\0", 17) == 0);
+    assert(strcmp(ID3v2_Tag_get_comment(tag, "eng", "b")->data->comment, "Second") == 0);
+    ID3v2_Tag_free(tag);
+
+    // So do comments and picture descriptions
+    tag = comment_unicode_v4();
+    ID3v2_Tag_canonicalize(tag);
+    ID3v2_CommentFrame* comment = ID3v2_Tag_get_comment_frame(tag);
+    assert(comment->data->encoding == ID3v2_ENCODING_UTF8);
+    assert(strcmp(comment->data->comment, "Ragnar\xC3\xB6k") == 0);
+    assert(comment->header->size == 1 + 3 + 5 + 10);
+    ID3v2_ApicFrame* picture = ID3v2_Tag_get_album_cover_frame(tag);
+    assert(picture->data->encoding == ID3v2_ENCODING_UTF8);
+    assert(strcmp(picture->data->description, "Fr\xC3\xA4mre") == 0);
+    ID3v2_Tag_free(tag);
+
+    // Different metadata gives different bytes
+    int size = 0;
+    int other_size = 0;
+    char* bytes = canonical_bytes(v3_latin1, &size);
+    char* other_bytes = canonical_bytes(v3_unicode, &other_size);
+    assert(size != other_size || memcmp(bytes, other_bytes, size) != 0);
+    free(bytes);
+    free(other_bytes);
+
+    printf("CANONICAL TEST: OK\n");
+}
+
+void canonical_test_main()
+{
+    canonical_test();
+}
@@ -0,0 +1,256 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "id3v2lib.h"
+#include "test_utils.h"
+
+#include "change_log_test.h"
+
+#define ORIGINAL_FILE "extra/file.mp3"
+#define NO_TAG_FILE "extra/no_tag.mp3"
+#define LIBRARY_FILE "extra/library_file.mp3"
+#define REPLICA_ROOT "extra/replica"
+#define REPLICA_FILE "extra/replica/library_file.mp3"
+#define LOG_FILE "extra/changes.log"
+#define LIBRARY_WAV_FILE "extra/library_file.wav"
+#define REPLICA_WAV_FILE "extra/replica/library_file.wav"
+
+#define WAV_AUDIO_LENGTH 1000
+
+static void assert_same_text(ID3v2_Tag* a, ID3v2_Tag* b, const char* frame_id)
+{
+    ID3v2_TextFrame* a_frame = (ID3v2_TextFrame*) ID3v2_Tag_get_frame(a, frame_id);
+    ID3v2_TextFrame* b_frame = (ID3v2_TextFrame*) ID3v2_Tag_get_frame(b, frame_id);
+
+    if (a_frame == NULL || b_frame == NULL)
+    {
+        assert(a_frame == b_frame);
+        return;
+    }
+
+    assert(a_frame->header->size == b_frame->header->size);
+    assert(memcmp(a_frame->data->text, b_frame->data->text, a_frame->data->size) == 0);
+}
+
+void replica_test()
+{
+    mkdir(REPLICA_ROOT, 0755);
+    clone_file(ORIGINAL_FILE, LIBRARY_FILE);
+    clone_file(ORIGINAL_FILE, REPLICA_FILE);
+    remove(LOG_FILE);
+
+    const long replica_size = file_size(REPLICA_FILE);
+
+    ID3v2_ChangeLog* log = ID3v2_ChangeLog_open(LOG_FILE);
+    assert(log != NULL);
+
+    ID3v2_Tag* tag = ID3v2_read_tag(LIBRARY_FILE);
+    ID3v2_Tag_set_title(tag, "Replicated title");
+    ID3v2_Tag_set_comment(tag, "eng", "Replicated comment");
+    ID3v2_Tag_delete_track(tag);
+    assert(ID3v2_ChangeLog_write_tag(log, LIBRARY_FILE, "library_file.mp3", tag) == 0);
+    ID3v2_Tag_free(tag);
+
+    tag = ID3v2_read_tag(LIBRARY_FILE);
+    ID3v2_Tag_set_artist(tag, "Replicated artist");
+    ID3v2_ChangeLog_write_tag(log, LIBRARY_FILE, "library_file.mp3", tag);
+
+    // Nothing changed, no record is appended
+    ID3v2_ChangeLog_write_tag(log, LIBRARY_FILE, "library_file.mp3", tag);
+    ID3v2_Tag_free(tag);
+
+    // Not part of the replica, so the record is skipped
+    clone_file(NO_TAG_FILE, "extra/other_file.mp3");
+    tag = ID3v2_Tag_new_empty();
+    ID3v2_Tag_set_title(tag, "Other");
+    ID3v2_ChangeLog_write_tag(log, "extra/other_file.mp3", "other_file.mp3", tag);
+    ID3v2_Tag_free(tag);
+    remove("extra/other_file.mp3");
+
+    // The write fails, so the edit isn't logged
+    tag = ID3v2_Tag_new_empty();
+    ID3v2_Tag_set_title(tag, "Missing");
+    assert(ID3v2_ChangeLog_write_tag(log, "extra/missing_file.mp3", "library_file.mp3", tag) == -1);
+    ID3v2_Tag_free(tag);
+
+    ID3v2_ChangeLog_close(log);
+
+    assert(ID3v2_ChangeLog_apply(LOG_FILE, REPLICA_ROOT) == 2);
+
+    // Every edit fit in the padding, the replica's audio wasn't rewritten
+    assert(file_size(REPLICA_FILE) == replica_size);
+
+    ID3v2_Tag* library_tag = ID3v2_read_tag(LIBRARY_FILE);
+    ID3v2_Tag* replica_tag = ID3v2_read_tag(REPLICA_FILE);
+
+    assert_same_text(library_tag, replica_tag, ID3v2_TITLE_FRAME_ID);
+    assert_same_text(library_tag, replica_tag, ID3v2_ARTIST_FRAME_ID);
+    assert_same_text(library_tag, replica_tag, ID3v2_ALBUM_FRAME_ID);
+    assert(ID3v2_Tag_get_track_frame(replica_tag) == NULL);
+    assert(
+        ID3v2_Tag_get_comment(replica_tag, "eng", "") != NULL ||
+        ID3v2_Tag_get_comment(replica_tag, "eng", EMPTY_UNICODE_STR) != NULL
+    );
+    assert(ID3v2_Tag_get_album_cover_frame(replica_tag) != NULL);
+
+    ID3v2_Tag_free(library_tag);
+    ID3v2_Tag_free(replica_tag);
+
+    remove(LOG_FILE);
+    remove(LIBRARY_FILE);
+    remove(REPLICA_FILE);
+    rmdir(REPLICA_ROOT);
+
+    printf("CHANGE LOG REPLICA TEST: OK\n");
+}
+
+static void write_wav(const char* file_name)
+{
+    // RIFF header, a 16 bytes fmt chunk and the data chunk
+    const long size = 12 + 8 + 16 + 8 + WAV_AUDIO_LENGTH;
+    char* bytes = (char*) calloc(size, sizeof(char));
+
+    memcpy(bytes, "RIFF", 4);
+    bytes[4] = (size - 8) & 0xFF;
+    bytes[5] = (size - 8) >> 8;
+    memcpy(bytes + 8, "WAVEfmt ", 8);
+    bytes[16] = 16;
+    memcpy(bytes + 36, "data", 4);
+    bytes[40] = WAV_AUDIO_LENGTH & 0xFF;
+    bytes[41] = WAV_AUDIO_LENGTH >> 8;
+
+    for (int i = 0; i < WAV_AUDIO_LENGTH; i++) bytes[44 + i] = (char) (i * 7 + 3);
+
+    FILE* fp = fopen(file_name, "wb");
+    fwrite(bytes, sizeof(char), size, fp);
+    fclose(fp);
+    free(bytes);
+}
+
+void replica_wav_test()
+{
+    mkdir(REPLICA_ROOT, 0755);
+    write_wav(LIBRARY_WAV_FILE);
+    write_wav(REPLICA_WAV_FILE);
+    remove(LOG_FILE);
+
+    // The library file gets a tag chunk the replica doesn't have yet
+    ID3v2_ChangeLog* log = ID3v2_ChangeLog_open(LOG_FILE);
+    ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+    ID3v2_Tag_set_title(tag, "Replicated title");
+    ID3v2_ChangeLog_write_tag(log, LIBRARY_WAV_FILE, "library_file.wav", tag);
+    ID3v2_Tag_free(tag);
+    ID3v2_ChangeLog_close(log);
+
+    assert(ID3v2_ChangeLog_apply(LOG_FILE, REPLICA_ROOT) == 1);
+
+    ID3v2_Tag* library_tag = ID3v2_read_tag(LIBRARY_WAV_FILE);
+    ID3v2_Tag* replica_tag = ID3v2_read_tag(REPLICA_WAV_FILE);
+    assert(replica_tag != NULL);
+    assert_same_text(library_tag, replica_tag, ID3v2_TITLE_FRAME_ID);
+    ID3v2_Tag_free(library_tag);
+    ID3v2_Tag_free(replica_tag);
+
+    remove(LOG_FILE);
+    remove(LIBRARY_WAV_FILE);
+    remove(REPLICA_WAV_FILE);
+    rmdir(REPLICA_ROOT);
+
+    printf("CHANGE LOG REPLICA WAV TEST: OK\n");
+}
+
+void replica_file_id_test()
+{
+    mkdir(REPLICA_ROOT, 0755);
+    clone_file(ORIGINAL_FILE, LIBRARY_FILE);
+    remove(LOG_FILE);
+
+    ID3v2_ChangeLog* log = ID3v2_ChangeLog_open(LOG_FILE);
+    ID3v2_Tag* tag = ID3v2_read_tag(LIBRARY_FILE);
+    ID3v2_Tag_set_title(tag, "Replicated title");
+
+    // Ids are paths relative to the library root
+    assert(ID3v2_ChangeLog_write_tag(log, LIBRARY_FILE, NULL, tag) == -1);
+    assert(ID3v2_ChangeLog_write_tag(log, LIBRARY_FILE, "/library_file.mp3", tag) == -1);
+    assert(ID3v2_ChangeLog_write_tag(log, LIBRARY_FILE, "../library_file.mp3", tag) == -1);
+    assert(ID3v2_ChangeLog_write_tag(log, LIBRARY_FILE, "xx/library_file.mp3", tag) == 0);
+
+    ID3v2_Tag_free(tag);
+    ID3v2_ChangeLog_close(log);
+
+    // A record pointing outside of the replica, it matches the library file's audio
+    const long size = file_size(LOG_FILE);
+    char* bytes = (char*) malloc(size * sizeof(char));
+    FILE* fp = fopen(LOG_FILE, "r+b");
+    assert(fread(bytes, sizeof(char), size, fp) == (size_t) size);
+
+    long offset = 0;
+    while (offset + 3 <= size && memcmp(bytes + offset, "xx/", 3) != 0) offset++;
+    assert(offset + 3 <= size);
+
+    fseek(fp, offset, SEEK_SET);
+    fwrite("../", sizeof(char), 3, fp);
+    fclose(fp);
+    free(bytes);
+
+    assert(ID3v2_ChangeLog_apply(LOG_FILE, REPLICA_ROOT) == 0);
+
+    remove(LOG_FILE);
+    remove(LIBRARY_FILE);
+    rmdir(REPLICA_ROOT);
+
+    printf("CHANGE LOG REPLICA FILE ID TEST: OK\n");
+}
+
+void replica_diverged_test()
+{
+    mkdir(REPLICA_ROOT, 0755);
+    clone_file(ORIGINAL_FILE, LIBRARY_FILE);
+    clone_file(ORIGINAL_FILE, REPLICA_FILE);
+    remove(LOG_FILE);
+
+    // The replica's audio differs from the library's in the middle only
+    FILE* fp = fopen(REPLICA_FILE, "r+b");
+    fseek(fp, file_size(REPLICA_FILE) * 2 / 3, SEEK_SET);
+    const int byte = fgetc(fp);
+    fseek(fp, -1, SEEK_CUR);
+    fputc(byte ^ 0xFF, fp);
+    fclose(fp);
+
+    ID3v2_ChangeLog* log = ID3v2_ChangeLog_open(LOG_FILE);
+    ID3v2_Tag* tag = ID3v2_read_tag(LIBRARY_FILE);
+    ID3v2_Tag_set_title(tag, "Replicated title");
+    assert(ID3v2_ChangeLog_write_tag(log, LIBRARY_FILE, "library_file.mp3", tag) == 0);
+    ID3v2_Tag_free(tag);
+    ID3v2_ChangeLog_close(log);
+
+    assert(ID3v2_ChangeLog_apply(LOG_FILE, REPLICA_ROOT) == 0);
+
+    remove(LOG_FILE);
+    remove(LIBRARY_FILE);
+    remove(REPLICA_FILE);
+    rmdir(REPLICA_ROOT);
+
+    printf("CHANGE LOG REPLICA DIVERGED TEST: OK\n");
+}
+
+void change_log_test_main()
+{
+    replica_test();
+    replica_wav_test();
+    replica_file_id_test();
+    replica_diverged_test();
+}
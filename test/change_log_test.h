@@ -0,0 +1,15 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_change_log_test_h
+#define id3v2lib_change_log_test_h
+
+void change_log_test_main();
+
+#endif
@@ -0,0 +1,246 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "id3v2lib.h"
+#include "test_utils.h"
+
+#include "codepage_test.h"
+
+#define CODEPAGE_FILE "extra/codepage.mp3"
+
+// "Кино" and "ДДТ" in CP1251
+#define KINO_CP1251 "\xca\xe8\xed\xee"
+#define DDT_CP1251 "\xc4\xc4\xd2"
+#define KINO_UTF8 "\xd0\x9a\xd0\xb8\xd0\xbd\xd0\xbe"
+#define DDT_UTF8 "\xd0\x94\xd0\x94\xd0\xa2"
+#define KINO_UTF16 "\xff\xfe\x1a\x04\x38\x04\x3d\x04\x3e\x04"
+
+static void assert_decoded(
+    const char* text,
+    const int size,
+    const int codepage,
+    const char* expected,
+    const int expected_size
+)
+{
+    char* dest = (char*) malloc(ID3v2_CODEPAGE_UTF8_SIZE(size));
+
+    assert(ID3v2_codepage_to_utf8(text, size, codepage, dest) == expected_size);
+    assert(memcmp(dest, expected, expected_size) == 0);
+    assert(dest[expected_size] == '\0');
+
+    free(dest);
+}
+
+void codepage_decode_test()
+{
+    assert_decoded("", 0, ID3v2_CODEPAGE_CP1251, "", 0);
+    assert_decoded("Plain ASCII", 11, ID3v2_CODEPAGE_SHIFT_JIS, "Plain ASCII", 11);
+    assert_decoded("Caf\xe9", 4, ID3v2_CODEPAGE_LATIN1, "Caf\xc3\xa9", 5);
+
+    // Characters before, across and after 16 byte blocks of ASCII
+    assert_decoded(
+        KINO_CP1251 " - Gruppa krovi (1988) " KINO_CP1251 " " DDT_CP1251,
+        4 + 23 + 4 + 1 + 3,
+        ID3v2_CODEPAGE_CP1251,
+        KINO_UTF8 " - Gruppa krovi (1988) " KINO_UTF8 " " DDT_UTF8,
+        8 + 23 + 8 + 1 + 6
+    );
+
+    // Null characters are kept, bytes that aren't characters are replaced
+    assert_decoded(
+        KINO_CP1251 "\0\x98",
+        6,
+        ID3v2_CODEPAGE_CP1251,
+        KINO_UTF8 "\0\xef\xbf\xbd",
+        12
+    );
+
+    assert_decoded(
+        "\x93" "Caf\xe9\x94 \x80",
+        8,
+        ID3v2_CODEPAGE_CP1252,
+        "\xe2\x80\x9c" "Caf\xc3\xa9\xe2\x80\x9d \xe2\x82\xac",
+        15
+    );
+
+    // "ソ" ends with a backslash, "ｱ" takes a single byte, and a lead byte
+    // can't end the text
+    assert_decoded(
+        "\x83\\\xb1\x83",
+        4,
+        ID3v2_CODEPAGE_SHIFT_JIS,
+        "\xe3\x82\xbd\xef\xbd\xb1\xef\xbf\xbd",
+        9
+    );
+
+    // "€周杰伦"
+    assert_decoded(
+        "\x80\xd6\xdc\xbd\xdc\xc2\xd7",
+        7,
+        ID3v2_CODEPAGE_GBK,
+        "\xe2\x82\xac\xe5\x91\xa8\xe6\x9d\xb0\xe4\xbc\xa6",
+        12
+    );
+
+    printf("CODEPAGE DECODE TEST: OK\n");
+}
+
+static int guess(const char* const* texts, const int count)
+{
+    ID3v2_CodepageDetector detector;
+    ID3v2_CodepageDetector_init(&detector);
+
+    for (int i = 0; i < count; i++)
+    {
+        ID3v2_CodepageDetector_add_text(&detector, texts[i], strlen(texts[i]));
+    }
+
+    return ID3v2_CodepageDetector_guess(&detector);
+}
+
+void codepage_detect_test()
+{
+    const char* ascii[] = {"Queen", "A Night at the Opera", "Bohemian Rhapsody"};
+    const char* cp1251[] = {
+        KINO_CP1251,
+        "\xc3\xf0\xf3\xef\xef\xe0 \xea\xf0\xee\xe2\xe8",
+        DDT_CP1251,
+    };
+    const char* cp1252[] = {"Mot\xf6rhead", "Ace of Spades", "Lemmy Kilmister \x96 Bass"};
+    const char* shift_jis[] = {
+        "\x89" "F\x91\xbd\x93" "c\x83q\x83J\x83\x8b",
+        "\x83t\x83@\x81[\x83X\x83g\x81" "E\x83\x89\x83u",
+        "\x8f\x89\x97\xf6",
+    };
+    const char* gbk[] = {
+        "\xd6\xdc\xbd\xdc\xc2\xd7",
+        "\xc6\xdf\xc0\xef\xcf\xe3",
+        "\xc7\xe7\xcc\xec",
+    };
+
+    assert(guess(ascii, 3) == ID3v2_CODEPAGE_LATIN1);
+    assert(guess(cp1251, 3) == ID3v2_CODEPAGE_CP1251);
+    assert(guess(cp1252, 3) == ID3v2_CODEPAGE_CP1252);
+    assert(guess(shift_jis, 3) == ID3v2_CODEPAGE_SHIFT_JIS);
+    assert(guess(gbk, 3) == ID3v2_CODEPAGE_GBK);
+
+    // Tags add their Latin-1 text frames
+    ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+    ID3v2_Tag_set_text(tag, ID3v2_ARTIST_FRAME_ID, cp1251[0], 4, ID3v2_ENCODING_ISO);
+    ID3v2_Tag_set_text(tag, ID3v2_ALBUM_FRAME_ID, cp1251[1], 12, ID3v2_ENCODING_ISO);
+
+    ID3v2_CodepageDetector detector;
+    ID3v2_CodepageDetector_init(&detector);
+    ID3v2_CodepageDetector_add_tag(&detector, tag);
+    assert(detector.text_count == 2);
+    assert(ID3v2_CodepageDetector_guess(&detector) == ID3v2_CODEPAGE_CP1251);
+
+    ID3v2_Tag_free(tag);
+
+    printf("CODEPAGE DETECT TEST: OK\n");
+}
+
+static bool check_decoded_title(const char* file_name, ID3v2_Tag* tag, void* ctx)
+{
+    const ID3v2_TextFrameData* title = ID3v2_Tag_get_title_frame(tag)->data;
+    const int codepage = *(int*) ctx;
+
+    if (codepage == ID3v2_CODEPAGE_LATIN1)
+    {
+        assert(title->encoding == ID3v2_ENCODING_ISO);
+        assert(memcmp(title->text, KINO_CP1251, 4) == 0);
+    }
+    else
+    {
+        assert(title->encoding == ID3v2_ENCODING_UNICODE);
+        assert(memcmp(title->text, KINO_UTF16, 10) == 0);
+    }
+
+    return true;
+}
+
+void codepage_tag_test()
+{
+    // v2.4 tags get UTF-8, values stay apart
+    ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+    tag->header->major_version = 4;
+
+    const ID3v2_TextValue artists[] = {{KINO_CP1251, 4}, {DDT_CP1251, 3}};
+    ID3v2_Tag_set_text_values(tag, ID3v2_ARTIST_FRAME_ID, artists, 2, ID3v2_ENCODING_ISO);
+    ID3v2_Tag_set_text(tag, ID3v2_ALBUM_FRAME_ID, "Caf\xe9", 4, ID3v2_ENCODING_ISO);
+    ID3v2_Tag_set_text(tag, ID3v2_TITLE_FRAME_ID, "Plain", 5, ID3v2_ENCODING_ISO);
+
+    const int tag_size = tag->header->tag_size;
+    ID3v2_Tag_decode_codepage(tag, ID3v2_CODEPAGE_CP1251);
+
+    const ID3v2_TextFrameData* artist = ID3v2_Tag_get_artist_frame(tag)->data;
+    assert(artist->encoding == ID3v2_ENCODING_UTF8);
+    assert(artist->size == 16);
+    assert(memcmp(artist->text, KINO_UTF8 "\0" DDT_UTF8 "\0", 16) == 0);
+    assert(ID3v2_Tag_get_album_frame(tag)->data->encoding == ID3v2_ENCODING_UTF8);
+    assert(ID3v2_Tag_get_title_frame(tag)->data->encoding == ID3v2_ENCODING_ISO);
+    assert(tag->header->tag_size == tag_size + 7 + 1);
+
+    ID3v2_Tag_free(tag);
+
+    // Latin-1 reads the same as CP1252 outside 0x80 to 0x9F
+    tag = ID3v2_Tag_new_empty();
+    ID3v2_Tag_set_text(tag, ID3v2_ALBUM_FRAME_ID, "Caf\xe9", 4, ID3v2_ENCODING_ISO);
+    ID3v2_Tag_decode_codepage(tag, ID3v2_CODEPAGE_CP1252);
+    assert(ID3v2_Tag_get_album_frame(tag)->data->encoding == ID3v2_ENCODING_ISO);
+    ID3v2_Tag_free(tag);
+
+    // Scans decode the tags they hand out
+    clone_file("extra/file.mp3", CODEPAGE_FILE);
+
+    tag = ID3v2_read_tag(CODEPAGE_FILE);
+    assert(tag->header->major_version == 3);
+    ID3v2_Tag_set_text(tag, ID3v2_TITLE_FRAME_ID, KINO_CP1251, 4, ID3v2_ENCODING_ISO);
+    ID3v2_write_tag(CODEPAGE_FILE, tag);
+
+    const char* file_names[] = {CODEPAGE_FILE};
+    const ID3v2_ScanOptions options = {ID3v2_SCAN_ORDER_GIVEN, 0, ID3v2_CODEPAGE_CP1251};
+    int codepage = ID3v2_CODEPAGE_CP1251;
+    assert(ID3v2_scan_files(file_names, 1, &options, check_decoded_title, &codepage) == 0);
+
+    codepage = ID3v2_CODEPAGE_LATIN1;
+    assert(ID3v2_scan_files(file_names, 1, NULL, check_decoded_title, &codepage) == 0);
+
+    // Updates hand tags out as they're stored, so written back tags keep their bytes
+    assert(ID3v2_update_files(file_names, 1, &options, check_decoded_title, &codepage) == 0);
+    assert(ID3v2_scan_files(file_names, 1, NULL, check_decoded_title, &codepage) == 0);
+
+    // v2.3 tags get UTF-16, and are written as such
+    codepage = ID3v2_CODEPAGE_CP1251;
+    ID3v2_Tag_decode_codepage(tag, codepage);
+    ID3v2_write_tag(CODEPAGE_FILE, tag);
+    ID3v2_Tag_free(tag);
+
+    tag = ID3v2_read_tag(CODEPAGE_FILE);
+    check_decoded_title(CODEPAGE_FILE, tag, &codepage);
+    assert(ID3v2_Tag_get_artist_frame(tag) != NULL);
+    ID3v2_Tag_free(tag);
+
+    remove(CODEPAGE_FILE);
+
+    printf("CODEPAGE TAG TEST: OK\n");
+}
+
+void codepage_test_main()
+{
+    codepage_decode_test();
+    codepage_detect_test();
+    codepage_tag_test();
+}
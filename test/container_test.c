@@ -0,0 +1,322 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "id3v2lib.h"
+#include "test_utils.h"
+
+#include "container_test.h"
+
+#define WAV_FILE "extra/file.wav"
+#define AIFF_FILE "extra/file.aiff"
+#define DSF_FILE "extra/file.dsf"
+
+#define AUDIO_LENGTH 1001
+
+static void put_le(char* dest, unsigned long long value, const int size)
+{
+    for (int i = 0; i < size; i++, value >>= 8) dest[i] = value & 0xFF;
+}
+
+static void put_be(char* dest, unsigned long long value, const int size)
+{
+    for (int i = size - 1; i >= 0; i--, value >>= 8) dest[i] = value & 0xFF;
+}
+
+static unsigned long long get_le(const char* bytes, const int size)
+{
+    unsigned long long value = 0;
+    for (int i = size - 1; i >= 0; i--) value = (value << 8) | (unsigned char) bytes[i];
+    return value;
+}
+
+static unsigned long long get_be(const char* bytes, const int size)
+{
+    unsigned long long value = 0;
+    for (int i = 0; i < size; i++) value = (value << 8) | (unsigned char) bytes[i];
+    return value;
+}
+
+static void fill_audio(char* dest)
+{
+    for (int i = 0; i < AUDIO_LENGTH; i++) dest[i] = (char) (i * 7 + 3);
+}
+
+static bool has_audio(const char* bytes)
+{
+    char audio[AUDIO_LENGTH];
+    fill_audio(audio);
+    return memcmp(bytes, audio, AUDIO_LENGTH) == 0;
+}
+
+static void write_file(const char* file_name, const char* bytes, const long size)
+{
+    FILE* fp = fopen(file_name, "wb");
+    fwrite(bytes, sizeof(char), size, fp);
+    fclose(fp);
+}
+
+static void set_title(const char* file_name, const char* title)
+{
+    ID3v2_Tag* tag = ID3v2_read_tag(file_name);
+    if (tag == NULL) tag = ID3v2_Tag_new_empty();
+
+    ID3v2_Tag_set_title(tag, title);
+    ID3v2_write_tag(file_name, tag);
+    ID3v2_Tag_free(tag);
+}
+
+static void set_cover(const char* file_name, const int size)
+{
+    char* picture = (char*) calloc(size, sizeof(char));
+    ID3v2_Tag* tag = ID3v2_read_tag(file_name);
+
+    ID3v2_Tag_set_album_cover(tag, "image/png", size, picture);
+    ID3v2_write_tag(file_name, tag);
+
+    ID3v2_Tag_free(tag);
+    free(picture);
+}
+
+static void assert_title(const char* file_name, const char* title)
+{
+    ID3v2_Tag* tag = ID3v2_read_tag(file_name);
+    assert(tag != NULL);
+
+    ID3v2_TextFrame* frame = ID3v2_Tag_get_title_frame(tag);
+    assert(frame != NULL);
+    assert(strcmp(frame->data->text, title) == 0);
+
+    ID3v2_Tag_free(tag);
+}
+
+/**
+ * Returns the offset of the first chunk with the provided id, or -1.
+ */
+static long find_chunk(const char* bytes, const long size, const char* id, const bool big_endian)
+{
+    long offset = 12;
+
+    while (offset + 8 <= size)
+    {
+        if (memcmp(bytes + offset, id, 4) == 0) return offset;
+
+        const long chunk_size =
+            big_endian ? get_be(bytes + offset + 4, 4) : get_le(bytes + offset + 4, 4);
+        offset += 8 + chunk_size + (chunk_size & 1);
+    }
+
+    return -1;
+}
+
+void wav_test()
+{
+    // RIFF header, a 16 bytes fmt chunk and an odd sized data chunk
+    const long size = 12 + 8 + 16 + 8 + AUDIO_LENGTH + 1;
+    char* bytes = (char*) calloc(size, sizeof(char));
+    memcpy(bytes, "RIFF", 4);
+    put_le(bytes + 4, size - 8, 4);
+    memcpy(bytes + 8, "WAVE", 4);
+    memcpy(bytes + 12, "fmt ", 4);
+    put_le(bytes + 16, 16, 4);
+    memcpy(bytes + 36, "data", 4);
+    put_le(bytes + 40, AUDIO_LENGTH, 4);
+    fill_audio(bytes + 44);
+    write_file(WAV_FILE, bytes, size);
+    free(bytes);
+
+    assert(ID3v2_read_tag(WAV_FILE) == NULL);
+
+    // The first tag is appended as a new chunk
+    set_title(WAV_FILE, "Amon Amarth");
+    assert_title(WAV_FILE, "Amon Amarth");
+
+    long new_size;
+    bytes = read_file(WAV_FILE, &new_size);
+    const long chunk = find_chunk(bytes, new_size, "id3 ", false);
+    assert(chunk == size);
+    assert(get_le(bytes + 4, 4) == new_size - 8);
+    assert(has_audio(bytes + 44));
+    free(bytes);
+
+    // Edits that fit in the padding don't change the file size
+    set_title(WAV_FILE, "Amon Amarth, Ragnarok");
+    assert_title(WAV_FILE, "Amon Amarth, Ragnarok");
+
+    long same_size;
+    bytes = read_file(WAV_FILE, &same_size);
+    assert(same_size == new_size);
+    free(bytes);
+
+    // The chunk is the last one, so it grows where it is
+    set_cover(WAV_FILE, ID3v2_TAG_DEFAULT_PADDING_LENGTH * 2);
+    assert_title(WAV_FILE, "Amon Amarth, Ragnarok");
+
+    bytes = read_file(WAV_FILE, &new_size);
+    assert(new_size > same_size);
+    assert(find_chunk(bytes, new_size, "id3 ", false) == chunk);
+    assert(get_le(bytes + 4, 4) == new_size - 8);
+    assert(has_audio(bytes + 44));
+
+    // Once something follows the tag, growing it leaves the old chunk as filler
+    const long list_size = new_size + 8 + 4;
+    bytes = (char*) realloc(bytes, list_size);
+    memcpy(bytes + new_size, "LIST", 4);
+    put_le(bytes + new_size + 4, 4, 4);
+    memcpy(bytes + new_size + 8, "INFO", 4);
+    put_le(bytes + 4, list_size - 8, 4);
+    write_file(WAV_FILE, bytes, list_size);
+    free(bytes);
+
+    set_cover(WAV_FILE, ID3v2_TAG_DEFAULT_PADDING_LENGTH * 4);
+    assert_title(WAV_FILE, "Amon Amarth, Ragnarok");
+
+    bytes = read_file(WAV_FILE, &new_size);
+    assert(find_chunk(bytes, new_size, "JUNK", false) == chunk);
+    assert(find_chunk(bytes, new_size, "LIST", false) >= 0);
+    assert(find_chunk(bytes, new_size, "id3 ", false) > list_size - 12);
+    assert(get_le(bytes + 4, 4) == new_size - 8);
+    assert(has_audio(bytes + 44));
+    free(bytes);
+
+    // The last chunk is truncated away
+    ID3v2_delete_tag(WAV_FILE);
+    assert(ID3v2_read_tag(WAV_FILE) == NULL);
+
+    bytes = read_file(WAV_FILE, &new_size);
+    assert(new_size == list_size);
+    assert(get_le(bytes + 4, 4) == new_size - 8);
+    free(bytes);
+
+    remove(WAV_FILE);
+
+    printf("CONTAINER WAV TEST: OK\n");
+}
+
+void aiff_test()
+{
+    // FORM header, an 18 bytes COMM chunk and an odd sized SSND chunk
+    const long size = 12 + 8 + 18 + 8 + AUDIO_LENGTH + 1;
+    char* bytes = (char*) calloc(size, sizeof(char));
+    memcpy(bytes, "FORM", 4);
+    put_be(bytes + 4, size - 8, 4);
+    memcpy(bytes + 8, "AIFF", 4);
+    memcpy(bytes + 12, "COMM", 4);
+    put_be(bytes + 16, 18, 4);
+    memcpy(bytes + 38, "SSND", 4);
+    put_be(bytes + 42, AUDIO_LENGTH, 4);
+    fill_audio(bytes + 46);
+    write_file(AIFF_FILE, bytes, size);
+    free(bytes);
+
+    set_title(AIFF_FILE, "Twilight of the Thunder God");
+    assert_title(AIFF_FILE, "Twilight of the Thunder God");
+
+    long new_size;
+    bytes = read_file(AIFF_FILE, &new_size);
+    assert(find_chunk(bytes, new_size, "ID3 ", true) == size);
+    assert(get_be(bytes + 4, 4) == new_size - 8);
+    assert(has_audio(bytes + 46));
+    free(bytes);
+
+    ID3v2_delete_tag(AIFF_FILE);
+    assert(ID3v2_read_tag(AIFF_FILE) == NULL);
+
+    bytes = read_file(AIFF_FILE, &new_size);
+    assert(new_size == size);
+    assert(get_be(bytes + 4, 4) == size - 8);
+    free(bytes);
+
+    remove(AIFF_FILE);
+
+    printf("CONTAINER AIFF TEST: OK\n");
+}
+
+void dsf_test()
+{
+    // DSD chunk without metadata, a 52 bytes fmt chunk and the data chunk
+    const long size = 28 + 52 + 12 + AUDIO_LENGTH;
+    char* bytes = (char*) calloc(size, sizeof(char));
+    memcpy(bytes, "DSD ", 4);
+    put_le(bytes + 4, 28, 8);
+    put_le(bytes + 12, size, 8);
+    memcpy(bytes + 28, "fmt ", 4);
+    put_le(bytes + 32, 52, 8);
+    memcpy(bytes + 80, "data", 4);
+    put_le(bytes + 84, 12 + AUDIO_LENGTH, 8);
+    fill_audio(bytes + 92);
+    write_file(DSF_FILE, bytes, size);
+    free(bytes);
+
+    // The tag goes after the audio and the header points to it
+    set_title(DSF_FILE, "Jomsviking");
+    assert_title(DSF_FILE, "Jomsviking");
+
+    long new_size;
+    bytes = read_file(DSF_FILE, &new_size);
+    assert(get_le(bytes + 12, 8) == new_size);
+    assert(get_le(bytes + 20, 8) == size);
+    assert(has_audio(bytes + 92));
+    free(bytes);
+
+    set_cover(DSF_FILE, ID3v2_TAG_DEFAULT_PADDING_LENGTH * 2);
+    assert_title(DSF_FILE, "Jomsviking");
+
+    bytes = read_file(DSF_FILE, &new_size);
+    assert(get_le(bytes + 12, 8) == new_size);
+    assert(get_le(bytes + 20, 8) == size);
+    free(bytes);
+
+    // Writes that fail are reported, here the file isn't allowed to grow
+    struct rlimit limit;
+    getrlimit(RLIMIT_FSIZE, &limit);
+    const rlim_t file_size_limit = limit.rlim_cur;
+    void (*previous_handler)(int) = signal(SIGXFSZ, SIG_IGN);
+    limit.rlim_cur = new_size;
+    setrlimit(RLIMIT_FSIZE, &limit);
+
+    ID3v2_Tag* tag = ID3v2_read_tag(DSF_FILE);
+    char* picture = (char*) calloc(ID3v2_TAG_DEFAULT_PADDING_LENGTH * 4, sizeof(char));
+    ID3v2_Tag_set_album_cover(tag, "image/png", ID3v2_TAG_DEFAULT_PADDING_LENGTH * 4, picture);
+    assert(ID3v2_write_tag_with_progress(DSF_FILE, tag, NULL, NULL) == -1);
+    ID3v2_Tag_free(tag);
+    free(picture);
+
+    limit.rlim_cur = file_size_limit;
+    setrlimit(RLIMIT_FSIZE, &limit);
+    signal(SIGXFSZ, previous_handler);
+
+    ID3v2_delete_tag(DSF_FILE);
+    assert(ID3v2_read_tag(DSF_FILE) == NULL);
+
+    bytes = read_file(DSF_FILE, &new_size);
+    assert(new_size == size);
+    assert(get_le(bytes + 12, 8) == size);
+    assert(get_le(bytes + 20, 8) == 0);
+    free(bytes);
+
+    remove(DSF_FILE);
+
+    printf("CONTAINER DSF TEST: OK\n");
+}
+
+void container_test_main()
+{
+    wav_test();
+    aiff_test();
+    dsf_test();
+}
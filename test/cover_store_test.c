@@ -0,0 +1,228 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "id3v2lib.h"
+#include "test_utils.h"
+
+#include "cover_store_test.h"
+
+#define FILES_DIRECTORY "extra/covers"
+#define STORE_DIRECTORY "extra/cover_store"
+
+#define PNG_COVER_HASH "d61d4a11e28630f4c13decf13e49844c3589668ba4162634d5ec83e2395f9534"
+
+// Just enough of a 300x200 JPEG for its size to be read
+static const char jpeg_cover[] = {
+    '\xFF', '\xD8', '\xFF', '\xE0', '\x00', '\x10', 'J',    'F',    'I',    'F',    '\x00',
+    '\x01', '\x01', '\x00', '\x00', '\x01', '\x00', '\x01', '\x00', '\x00', '\xFF', '\xC0',
+    '\x00', '\x0B', '\x08', '\x00', '\xC8', '\x01', '\x2C', '\x01', '\x01', '\x11', '\x00',
+    '\xFF', '\xD9',
+};
+
+static void set_jpeg_cover(const char* file_name)
+{
+    ID3v2_Tag* tag = ID3v2_read_tag(file_name);
+    if (tag == NULL) tag = ID3v2_Tag_new_empty();
+
+    ID3v2_Tag_set_album_cover(tag, ID3v2_MIME_TYPE_JPG, sizeof(jpeg_cover), jpeg_cover);
+    ID3v2_write_tag(file_name, tag);
+    ID3v2_Tag_free(tag);
+}
+
+static int remove_entry(const char* path, const struct stat* st, int type, struct FTW* ftw)
+{
+    return remove(path);
+}
+
+static void remove_tree(const char* directory)
+{
+    nftw(directory, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+typedef struct _Covers
+{
+    int count;
+    ID3v2_Cover covers[8];
+} Covers;
+
+static bool collect_cover(const ID3v2_Cover* cover, void* ctx)
+{
+    Covers* covers = (Covers*) ctx;
+    assert(covers->count < 8);
+    covers->covers[covers->count++] = *cover;
+
+    return true;
+}
+
+static bool stop_at_first_cover(const ID3v2_Cover* cover, void* ctx)
+{
+    return false;
+}
+
+void cover_store_test()
+{
+    remove_tree(FILES_DIRECTORY);
+    remove_tree(STORE_DIRECTORY);
+    mkdir(FILES_DIRECTORY, 0755);
+
+    const char* const file_names[] = {
+        FILES_DIRECTORY "/a.mp3",
+        FILES_DIRECTORY "/b.mp3",
+        FILES_DIRECTORY "/c.mp3",
+        FILES_DIRECTORY "/missing.mp3",
+    };
+
+    // a and b hold the same picture, c another one
+    clone_file("extra/file.mp3", file_names[0]);
+    clone_file("extra/file.mp3", file_names[1]);
+    clone_file("extra/no_tag.mp3", file_names[2]);
+    set_jpeg_cover(file_names[2]);
+
+    ID3v2_CoverStore* store = ID3v2_CoverStore_open(STORE_DIRECTORY);
+    assert(store != NULL);
+
+    ID3v2_CoverStats stats;
+    assert(ID3v2_CoverStore_extract(store, file_names, 4, 2, &stats) == 0);
+    assert(stats.unchanged_files == 0);
+    assert(stats.failed == 1);
+    assert(stats.pictures == 3);
+    assert(stats.stored_pictures == 2);
+
+    Covers covers = {0};
+    assert(ID3v2_CoverStore_for_each(store, collect_cover, &covers) == 0);
+    assert(covers.count == 3);
+
+    const ID3v2_Cover* png = &covers.covers[0];
+    assert(strcmp(png->file_name, file_names[0]) == 0);
+    assert(png->picture_type == ID3v2_PIC_TYPE_FRONT_COVER);
+    assert(strcmp(png->hash, PNG_COVER_HASH) == 0);
+    assert(strcmp(png->mime_type, ID3v2_MIME_TYPE_PNG) == 0);
+    assert(png->width == 1425 && png->height == 1425);
+    assert(strcmp(covers.covers[1].hash, PNG_COVER_HASH) == 0);
+
+    const ID3v2_Cover* jpeg = &covers.covers[2];
+    assert(strcmp(jpeg->file_name, file_names[2]) == 0);
+    assert(strcmp(jpeg->mime_type, ID3v2_MIME_TYPE_JPG) == 0);
+    assert(jpeg->size == sizeof(jpeg_cover));
+    assert(jpeg->width == 300 && jpeg->height == 200);
+
+    // Stored once, as found in the file
+    long expected_size, stored_size;
+    char* expected = read_file("extra/album_cover.png", &expected_size);
+    char* stored = read_file(STORE_DIRECTORY "/d6/" PNG_COVER_HASH, &stored_size);
+    assert(png->size == expected_size && stored_size == expected_size);
+    assert(memcmp(stored, expected, expected_size) == 0);
+    free(expected);
+    free(stored);
+
+    char jpeg_file_name[256];
+    snprintf(
+        jpeg_file_name, sizeof(jpeg_file_name), "%s/%.2s/%s", STORE_DIRECTORY, jpeg->hash,
+        jpeg->hash
+    );
+    stored = read_file(jpeg_file_name, &stored_size);
+    assert(stored_size == sizeof(jpeg_cover) && memcmp(stored, jpeg_cover, stored_size) == 0);
+    free(stored);
+
+    char jpeg_hash[ID3v2_COVER_HASH_LENGTH + 1];
+    memcpy(jpeg_hash, jpeg->hash, sizeof(jpeg_hash));
+    ID3v2_CoverStore_close(store);
+
+    // Reopened, unchanged files are skipped
+    store = ID3v2_CoverStore_open(STORE_DIRECTORY);
+    assert(ID3v2_CoverStore_extract(store, file_names, 3, 0, &stats) == 0);
+    assert(stats.unchanged_files == 3);
+    assert(stats.pictures == 0 && stats.stored_pictures == 0 && stats.failed == 0);
+
+    // b now holds the picture of c, which the store already has
+    set_jpeg_cover(file_names[1]);
+    assert(ID3v2_CoverStore_extract(store, file_names + 1, 1, 0, &stats) == 0);
+    assert(stats.unchanged_files == 0);
+    assert(stats.pictures == 1 && stats.stored_pictures == 0);
+
+    covers.count = 0;
+    ID3v2_CoverStore_for_each(store, collect_cover, &covers);
+    assert(covers.count == 3);
+    assert(strcmp(covers.covers[1].file_name, file_names[1]) == 0);
+    assert(strcmp(covers.covers[1].hash, jpeg_hash) == 0);
+
+    // Files that can't be read any more leave the mapping
+    remove(file_names[0]);
+    assert(ID3v2_CoverStore_extract(store, file_names, 1, 0, &stats) == 0);
+    assert(stats.failed == 1);
+
+    covers.count = 0;
+    ID3v2_CoverStore_for_each(store, collect_cover, &covers);
+    assert(covers.count == 2);
+    assert(strcmp(covers.covers[0].file_name, file_names[1]) == 0);
+    assert(
+        ID3v2_CoverStore_for_each(store, stop_at_first_cover, NULL) == ID3v2_OPERATION_CANCELLED
+    );
+
+    ID3v2_CoverStore_close(store);
+
+    remove_tree(FILES_DIRECTORY);
+    remove_tree(STORE_DIRECTORY);
+
+    printf("COVER STORE TEST: OK\n");
+}
+
+void cover_store_retry_test()
+{
+    remove_tree(FILES_DIRECTORY);
+    remove_tree(STORE_DIRECTORY);
+    mkdir(FILES_DIRECTORY, 0755);
+    mkdir(STORE_DIRECTORY, 0755);
+
+    const char* const file_names[] = {FILES_DIRECTORY "/a.mp3"};
+    clone_file("extra/file.mp3", file_names[0]);
+
+    // A file in the way of its subdirectory keeps the picture from being stored
+    FILE* blocker = fopen(STORE_DIRECTORY "/d6", "wb");
+    fclose(blocker);
+
+    ID3v2_CoverStore* store = ID3v2_CoverStore_open(STORE_DIRECTORY);
+    ID3v2_CoverStats stats;
+    assert(ID3v2_CoverStore_extract(store, file_names, 1, 0, &stats) == 0);
+    assert(stats.pictures == 1 && stats.stored_pictures == 0 && stats.failed == 1);
+    ID3v2_CoverStore_close(store);
+
+    // The file is extracted again, unchanged, once the picture can be stored
+    remove(STORE_DIRECTORY "/d6");
+
+    store = ID3v2_CoverStore_open(STORE_DIRECTORY);
+    assert(ID3v2_CoverStore_extract(store, file_names, 1, 0, &stats) == 0);
+    assert(stats.unchanged_files == 0);
+    assert(stats.pictures == 1 && stats.stored_pictures == 1 && stats.failed == 0);
+
+    assert(ID3v2_CoverStore_extract(store, file_names, 1, 0, &stats) == 0);
+    assert(stats.unchanged_files == 1);
+    ID3v2_CoverStore_close(store);
+
+    remove_tree(FILES_DIRECTORY);
+    remove_tree(STORE_DIRECTORY);
+
+    printf("COVER STORE RETRY TEST: OK\n");
+}
+
+void cover_store_test_main()
+{
+    cover_store_test();
+    cover_store_retry_test();
+}
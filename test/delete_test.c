@@ -9,6 +9,7 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "id3v2lib.h"
 #include "test_utils.h"
@@ -18,7 +19,7 @@
 #define ORIGINAL_FILE "extra/file.mp3"
 #define EDITED_FILE "extra/file_edited.mp3"
 
-void delete_test_main()
+void delete_test()
 {
     // Clone the file to not having to modify the original
     clone_file(ORIGINAL_FILE, EDITED_FILE);
@@ -76,3 +77,97 @@ void delete_test_main()
 
     printf("DELETE TEST: OK\n");
 }
+
+static int frames_size(ID3v2_Tag* tag)
+{
+    int size = 0;
+
+    for (ID3v2_FrameList* head = tag->frames; head != NULL && head->frame != NULL;
+         head = head->next)
+    {
+        size += head->frame->header->size + ID3v2_FRAME_HEADER_LENGTH;
+    }
+
+    return size;
+}
+
+static bool is_german_comment(ID3v2_Frame* frame, void* ctx)
+{
+    return memcmp(frame->header->id, ID3v2_COMMENT_FRAME_ID, 4) == 0 &&
+           memcmp(((ID3v2_CommentFrame*) frame)->data->language, "deu", 3) == 0;
+}
+
+static bool is_not_front_cover(ID3v2_Frame* frame, void* ctx)
+{
+    return memcmp(frame->header->id, ID3v2_ALBUM_COVER_FRAME_ID, 4) == 0 &&
+           ((ID3v2_ApicFrame*) frame)->data->picture_type != ID3v2_PIC_TYPE_FRONT_COVER;
+}
+
+void delete_if_test()
+{
+    clone_file(ORIGINAL_FILE, EDITED_FILE);
+
+    ID3v2_Tag* tag = ID3v2_read_tag(EDITED_FILE);
+    const int padding_size = tag->header->tag_size - frames_size(tag);
+
+    ID3v2_Tag_set_comment_frame(
+        tag,
+        &(ID3v2_CommentFrameInput){
+            .flags = "\0\0",
+            .language = "deu",
+            .short_description = "",
+            .comment = "Kommentar",
+        }
+    );
+    ID3v2_Tag_set_picture(tag, ID3v2_PIC_TYPE_BACK_COVER, ID3v2_MIME_TYPE_PNG, 3, "abc");
+    ID3v2_Tag_set_picture(tag, ID3v2_PIC_TYPE_ARTIST, ID3v2_MIME_TYPE_PNG, 3, "abc");
+
+    assert(ID3v2_Tag_delete_frames_if(tag, is_german_comment, NULL) == 1);
+    assert(ID3v2_Tag_get_comment(tag, "deu", "") == NULL);
+    assert(ID3v2_Tag_get_comment_frame(tag) != NULL);
+
+    assert(ID3v2_Tag_delete_frames_if(tag, is_not_front_cover, NULL) == 2);
+    assert(ID3v2_Tag_get_picture(tag, ID3v2_PIC_TYPE_FRONT_COVER) != NULL);
+    assert(ID3v2_Tag_get_picture(tag, ID3v2_PIC_TYPE_ARTIST) == NULL);
+
+    const char* const people[] = {ID3v2_ARTIST_FRAME_ID, ID3v2_ALBUM_ARTIST_FRAME_ID};
+    assert(ID3v2_Tag_delete_frames_in(tag, people, 2) == 2);
+    assert(ID3v2_Tag_delete_frames_in(tag, people, 2) == 0);
+    assert(ID3v2_Tag_get_artist_frame(tag) == NULL);
+    assert(ID3v2_Tag_get_title_frame(tag) != NULL);
+
+    // Deleting a frame that isn't there is a no-op
+    ID3v2_Tag_delete_frame(tag, "PRIV");
+    ID3v2_Tag_delete_comment_frame(tag, 5);
+
+    assert(tag->header->tag_size == frames_size(tag) + padding_size);
+
+    // Keep the title only, which isn't the last frame of the tag
+    const char* const kept[] = {ID3v2_TITLE_FRAME_ID};
+    assert(ID3v2_Tag_delete_frames_not_in(tag, kept, 1) > 0);
+    assert(ID3v2_Tag_get_title_frame(tag) != NULL);
+    assert(tag->frames->next == NULL);
+    assert(tag->header->tag_size == frames_size(tag) + padding_size);
+
+    ID3v2_write_tag(EDITED_FILE, tag);
+    ID3v2_Tag_free(tag);
+
+    tag = ID3v2_read_tag(EDITED_FILE);
+    assert(ID3v2_Tag_get_title_frame(tag) != NULL);
+    assert(ID3v2_Tag_get_album_frame(tag) == NULL);
+    assert(tag->header->tag_size == frames_size(tag) + tag->padding_size);
+
+    assert(ID3v2_Tag_delete_frames_not_in(tag, NULL, 0) == 1);
+    assert(tag->frames->frame == NULL);
+    ID3v2_Tag_free(tag);
+
+    remove(EDITED_FILE);
+
+    printf("DELETE IF TEST: OK\n");
+}
+
+void delete_test_main()
+{
+    delete_test();
+    delete_if_test();
+}
@@ -10,6 +10,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "assertion_utils.h"
 #include "id3v2lib.h"
@@ -177,8 +178,170 @@ void get_test_empty()
     printf("GET TEST EMPTY: OK\n");
 }
 
+void get_test_numeric()
+{
+    ID3v2_Tag* tag = ID3v2_read_tag("./extra/file.mp3");
+    int number, total, year, date, bpm;
+    long length;
+
+    assert(ID3v2_Tag_get_track(tag, &number, &total));
+    assert(number == 1 && total == 0);
+    assert(ID3v2_Tag_get_disc(tag, &number, &total));
+    assert(number == 1 && total == 0);
+    assert(ID3v2_Tag_get_year(tag, &year) && year == 2019);
+    assert(ID3v2_Tag_get_date(tag, &date) && date == ID3v2_DATE(2019, 0, 0));
+    assert(!ID3v2_Tag_get_bpm(tag, &bpm));
+    assert(!ID3v2_Tag_get_length(tag, &length));
+
+    // Parsed straight from utf-16 text
+    char* track = ID3v2_to_unicode("3/12");
+    ID3v2_Tag_set_track(tag, track);
+    free(track);
+    assert(ID3v2_Tag_get_track(tag, &number, &total));
+    assert(number == 3 && total == 12);
+
+    // The second call is answered from the numbers cached in the frame
+    ID3v2_TextFrame* track_frame = ID3v2_Tag_get_track_frame(tag);
+    assert(track_frame->data->number_count == 2);
+    assert(ID3v2_Tag_get_track(tag, &number, &total) && number == 3);
+
+    ID3v2_Tag_set_disc_value(tag, 2, 3);
+    assert(ID3v2_Tag_get_disc(tag, &number, &total));
+    assert(number == 2 && total == 3);
+
+    ID3v2_Tag_set_date_value(tag, ID3v2_DATE(2021, 5, 17));
+    assert(ID3v2_Tag_get_date(tag, &date) && date == ID3v2_DATE(2021, 5, 17));
+    assert(ID3v2_DATE_MONTH(date) == 5 && ID3v2_DATE_DAY(date) == 17);
+
+    ID3v2_Tag_set_text_frame(
+        tag,
+        &(ID3v2_TextFrameInput){
+            .id = ID3v2_RECORDING_TIME_FRAME_ID,
+            .flags = "\0\0",
+            .text = "1999-12-31T23:59",
+        }
+    );
+    assert(ID3v2_Tag_get_date(tag, &date) && date == ID3v2_DATE(1999, 12, 31));
+    assert(ID3v2_Tag_get_year(tag, &year) && year == 1999);
+
+    ID3v2_Tag_set_bpm(tag, 128);
+    assert(ID3v2_Tag_get_bpm(tag, &bpm) && bpm == 128);
+
+    ID3v2_Tag_set_length(tag, 215340);
+    assert(ID3v2_Tag_get_length(tag, &length) && length == 215340);
+
+    ID3v2_Tag_set_bpm(tag, 0);
+    ID3v2_Tag_set_text_frame(
+        tag,
+        &(ID3v2_TextFrameInput){ .id = ID3v2_BPM_FRAME_ID, .flags = "\0\0", .text = "fast" }
+    );
+    assert(!ID3v2_Tag_get_bpm(tag, &bpm));
+
+    ID3v2_Tag_free(tag);
+
+    tag = ID3v2_Tag_new_empty();
+    tag->header->major_version = 4;
+    ID3v2_Tag_set_date_value(tag, ID3v2_DATE(2004, 7, 0));
+    assert(ID3v2_Tag_get_frame(tag, ID3v2_YEAR_FRAME_ID) == NULL);
+    assert(ID3v2_Tag_get_date(tag, &date) && date == ID3v2_DATE(2004, 7, 0));
+
+    ID3v2_Tag_set_year_value(tag, 2005);
+    assert(ID3v2_Tag_get_frame(tag, ID3v2_YEAR_FRAME_ID) == NULL);
+    assert(ID3v2_Tag_get_date(tag, &date) && date == ID3v2_DATE(2005, 7, 0));
+    ID3v2_Tag_free(tag);
+
+    // A partial date on a v2.3 tag without TDAT
+    tag = ID3v2_Tag_new_empty();
+    ID3v2_Tag_set_date_value(tag, ID3v2_DATE(2004, 0, 0));
+    assert(ID3v2_Tag_get_frame(tag, ID3v2_DATE_FRAME_ID) == NULL);
+    assert(ID3v2_Tag_get_year(tag, &year) && year == 2004);
+    ID3v2_Tag_free(tag);
+
+    printf("GET TEST NUMERIC: OK\n");
+}
+
+static void set_genre(ID3v2_Tag* tag, const char* genre)
+{
+    ID3v2_Tag_set_text_frame(
+        tag,
+        &(ID3v2_TextFrameInput){ .id = ID3v2_GENRE_FRAME_ID, .flags = "\0\0", .text = genre }
+    );
+}
+
+void get_test_genres()
+{
+    for (int id = 0; id < ID3v2_GENRE_COUNT; id++)
+    {
+        assert(ID3v2_genre_id(ID3v2_genre_name(id)) == id);
+    }
+
+    assert(ID3v2_genre_id("rock") == 17);
+    assert(ID3v2_genre_id("DRUM & BASS") == 127);
+    assert(ID3v2_genre_id("Remix") == ID3v2_GENRE_REMIX);
+    assert(ID3v2_genre_id("Rocks") == ID3v2_GENRE_UNKNOWN);
+    assert(ID3v2_genre_id("") == ID3v2_GENRE_UNKNOWN);
+    assert(ID3v2_genre_name(ID3v2_GENRE_COUNT) == NULL);
+
+    char* hip_hop = ID3v2_to_unicode("Hip-Hop");
+    assert(ID3v2_genre_id(hip_hop) == 7);
+    free(hip_hop);
+
+    ID3v2_Genre genres[4];
+
+    // Free text that isn't in the table
+    ID3v2_Tag* tag = ID3v2_read_tag("./extra/file.mp3");
+    assert(ID3v2_Tag_get_genres(tag, genres, 4) == 1);
+    assert(genres[0].id == ID3v2_GENRE_UNKNOWN && genres[0].name == NULL);
+    assert(genres[0].encoding == ID3v2_ENCODING_UNICODE);
+    assert(genres[0].text_size == strlen("Melodic Death Metal") * 2);
+
+    set_genre(tag, "(17)Rock");
+    assert(ID3v2_Tag_get_genres(tag, genres, 4) == 1);
+    assert(genres[0].id == 17 && strcmp(genres[0].name, "Rock") == 0);
+
+    set_genre(tag, "(4)(RX)Eurodisco");
+    assert(ID3v2_Tag_get_genres(tag, genres, 4) == 3);
+    assert(genres[0].id == 4 && genres[1].id == ID3v2_GENRE_REMIX);
+    assert(genres[2].id == ID3v2_GENRE_UNKNOWN);
+    assert(genres[2].text_size == 9 && memcmp(genres[2].text, "Eurodisco", 9) == 0);
+
+    // Only as many genres as requested
+    assert(ID3v2_Tag_get_genres(tag, genres, 2) == 2);
+
+    set_genre(tag, "((Weird)");
+    assert(ID3v2_Tag_get_genres(tag, genres, 4) == 1);
+    assert(genres[0].text_size == 7 && memcmp(genres[0].text, "(Weird)", 7) == 0);
+
+    char* techno = ID3v2_to_unicode("Techno");
+    set_genre(tag, techno);
+    free(techno);
+    assert(ID3v2_Tag_get_genres(tag, genres, 4) == 1 && genres[0].id == 18);
+
+    ID3v2_Tag_free(tag);
+
+    // v2.4 null separated values
+    const char v24_tag[] = "ID3\x04\x00\x00\x00\x00\x00\x1B"
+                           "TCON\x00\x00\x00\x11\x00\x00"
+                           "\x00"
+                           "17\0Eurodisco\0CR\0";
+    tag = ID3v2_read_tag_from_buffer(v24_tag, sizeof(v24_tag) - 1);
+    assert(ID3v2_Tag_get_genres(tag, genres, 4) == 3);
+    assert(genres[0].id == 17);
+    assert(genres[1].id == ID3v2_GENRE_UNKNOWN && genres[1].text_size == 9);
+    assert(genres[2].id == ID3v2_GENRE_COVER);
+    ID3v2_Tag_free(tag);
+
+    tag = ID3v2_Tag_new_empty();
+    assert(ID3v2_Tag_get_genres(tag, genres, 4) == 0);
+    ID3v2_Tag_free(tag);
+
+    printf("GET TEST GENRES: OK\n");
+}
+
 void get_test_main()
 {
     get_test_existing();
     get_test_empty();
+    get_test_numeric();
+    get_test_genres();
 }
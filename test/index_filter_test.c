@@ -0,0 +1,242 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "id3v2lib.h"
+#include "index_test_utils.h"
+
+#include "index_filter_test.h"
+
+#define INDEX_DIRECTORY "extra/filter_index"
+#define ROW_COUNT 5000
+
+static bool has_substring(const char* text, const char* lowercase_needle)
+{
+    char lowercase_text[64];
+    int i = 0;
+
+    for (; text[i] != '\0'; i++)
+    {
+        lowercase_text[i] = text[i] >= 'A' && text[i] <= 'Z' ? text[i] + 32 : text[i];
+    }
+
+    lowercase_text[i] = '\0';
+    return strstr(lowercase_text, lowercase_needle) != NULL;
+}
+
+static bool beatles_in_the_sixties(const ID3v2_IndexRow* row)
+{
+    return has_substring(row->strings[ID3v2_INDEX_ARTIST], "beatles") &&
+           row->numbers[ID3v2_INDEX_YEAR] >= 1965 && row->numbers[ID3v2_INDEX_YEAR] <= 1970 &&
+           row->numbers[ID3v2_INDEX_HAS_COVER] != 0;
+}
+
+static bool recent_or_first(const ID3v2_IndexRow* row)
+{
+    return row->numbers[ID3v2_INDEX_YEAR] >= 2000 || row->numbers[ID3v2_INDEX_TRACK] == 1;
+}
+
+static bool early_tracks_not_rock(const ID3v2_IndexRow* row)
+{
+    return strcmp(row->strings[ID3v2_INDEX_GENRE], "Rock") != 0 &&
+           row->numbers[ID3v2_INDEX_TRACK] < 5;
+}
+
+static bool abba(const ID3v2_IndexRow* row)
+{
+    return strcmp(row->strings[ID3v2_INDEX_ARTIST], "ABBA") == 0;
+}
+
+static bool not_abba(const ID3v2_IndexRow* row)
+{
+    return !abba(row);
+}
+
+static bool first_paths(const ID3v2_IndexRow* row)
+{
+    return strcmp(row->strings[ID3v2_INDEX_PATH], "001000.mp3") < 0;
+}
+
+static bool unknown_title(const ID3v2_IndexRow* row)
+{
+    return has_substring(row->strings[ID3v2_INDEX_TITLE], "zzz");
+}
+
+static bool any_row(const ID3v2_IndexRow* row)
+{
+    return true;
+}
+
+static bool house_after_1990(const ID3v2_IndexRow* row)
+{
+    return has_substring(row->strings[ID3v2_INDEX_ARTIST], "house") &&
+           row->numbers[ID3v2_INDEX_YEAR] > 1990;
+}
+
+static bool no_genre_or_late_tracks(const ID3v2_IndexRow* row)
+{
+    return (row->strings[ID3v2_INDEX_GENRE][0] == '\0' || row->numbers[ID3v2_INDEX_TRACK] > 18) &&
+           !(row->numbers[ID3v2_INDEX_YEAR] <= 1999 && row->numbers[ID3v2_INDEX_HAS_COVER]);
+}
+
+typedef struct _FilterCase
+{
+    const char* expression;
+    bool (*predicate)(const ID3v2_IndexRow* row);
+    int matches;
+    int selected;
+} FilterCase;
+
+static bool count_matches(const ID3v2_IndexRow* row, void* ctx)
+{
+    FilterCase* filter_case = (FilterCase*) ctx;
+    if (filter_case->predicate(row)) filter_case->matches++;
+
+    return true;
+}
+
+static bool check_selected(const ID3v2_IndexRow* row, void* ctx)
+{
+    FilterCase* filter_case = (FilterCase*) ctx;
+    assert(filter_case->predicate(row));
+    filter_case->selected++;
+
+    return true;
+}
+
+void index_filter_test()
+{
+    delete_index(INDEX_DIRECTORY);
+
+    ID3v2_LibraryIndex* index = ID3v2_LibraryIndex_open(INDEX_DIRECTORY);
+
+    // Three segments, the later ones replacing and deleting rows of the first
+    ID3v2_IndexBatch* batch = ID3v2_IndexBatch_new();
+    for (int i = 0; i < 3000; i++) put_generated_row(batch, i, 1);
+    assert(ID3v2_LibraryIndex_commit(index, batch) == 0);
+    ID3v2_IndexBatch_free(batch);
+
+    batch = ID3v2_IndexBatch_new();
+    for (int i = 2000; i < ROW_COUNT; i++) put_generated_row(batch, i, 2);
+    assert(ID3v2_LibraryIndex_commit(index, batch) == 0);
+    ID3v2_IndexBatch_free(batch);
+
+    batch = ID3v2_IndexBatch_new();
+    char path[16];
+
+    for (int i = 0; i < ROW_COUNT; i += 7)
+    {
+        generated_row_path(path, sizeof(path), i);
+        ID3v2_IndexBatch_delete(batch, path);
+    }
+
+    assert(ID3v2_LibraryIndex_commit(index, batch) == 0);
+    ID3v2_IndexBatch_free(batch);
+
+    FilterCase cases[] = {
+        {"artist contains \"beatles\" and year between 1965 and 1970 and has_cover",
+         beatles_in_the_sixties},
+        {"year >= 2000 or track = 1", recent_or_first},
+        {"not (genre = \"Rock\") and track < 5", early_tracks_not_rock},
+        {"artist = \"ABBA\"", abba},
+        {"artist != 'ABBA'", not_abba},
+        {"path < \"001000.mp3\"", first_paths},
+        {"title contains \"zzz\"", unknown_title},
+        {"", any_row},
+        {"ARTIST Contains 'HOUSE' AND Year > 1990", house_after_1990},
+        {"(genre = \"\" or track > 18) and not (year <= 1999 and has_cover)",
+         no_genre_or_late_tracks},
+    };
+
+    ID3v2_IndexSnapshot* snapshot = ID3v2_LibraryIndex_acquire(index);
+
+    for (int i = 0; i < (int) (sizeof(cases) / sizeof(cases[0])); i++)
+    {
+        int error_offset = 0;
+        ID3v2_IndexFilter* filter = ID3v2_IndexFilter_compile(cases[i].expression, &error_offset);
+        assert(filter != NULL);
+
+        ID3v2_IndexSnapshot_for_each(snapshot, count_matches, &cases[i]);
+        ID3v2_IndexSelection* selection = ID3v2_IndexFilter_select(filter, snapshot);
+
+        assert(ID3v2_IndexSelection_get_count(selection) == cases[i].matches);
+        assert(ID3v2_IndexSelection_for_each(selection, check_selected, &cases[i]) == 0);
+        assert(cases[i].selected == cases[i].matches);
+
+        ID3v2_IndexSelection_free(selection);
+        ID3v2_IndexFilter_free(filter);
+    }
+
+    assert(cases[0].matches > 0 && cases[7].matches == ID3v2_IndexSnapshot_get_row_count(snapshot));
+
+    // Selections keep their snapshot pinned
+    ID3v2_IndexFilter* filter = ID3v2_IndexFilter_compile("artist = \"ABBA\"", NULL);
+    ID3v2_IndexSelection* selection = ID3v2_IndexFilter_select(filter, snapshot);
+    ID3v2_IndexSnapshot_release(snapshot);
+    ID3v2_LibraryIndex_close(index);
+
+    FilterCase abba_case = {"", abba};
+    assert(ID3v2_IndexSelection_for_each(selection, check_selected, &abba_case) == 0);
+    assert(abba_case.selected == cases[3].matches);
+
+    ID3v2_IndexSelection_free(selection);
+    ID3v2_IndexFilter_free(filter);
+    delete_index(INDEX_DIRECTORY);
+
+    printf("INDEX FILTER TEST: OK\n");
+}
+
+void index_filter_errors_test()
+{
+    int error_offset = -1;
+
+    assert(ID3v2_IndexFilter_compile("year between 1960 and", &error_offset) == NULL);
+    assert(error_offset == 21);
+
+    assert(ID3v2_IndexFilter_compile("artist contains 5", &error_offset) == NULL);
+    assert(error_offset == 16);
+
+    assert(ID3v2_IndexFilter_compile("title > 3", &error_offset) == NULL);
+    assert(error_offset == 8);
+
+    assert(ID3v2_IndexFilter_compile("year = \"1999\"", &error_offset) == NULL);
+    assert(error_offset == 7);
+
+    assert(ID3v2_IndexFilter_compile("composer = \"Bach\"", &error_offset) == NULL);
+    assert(error_offset == 0);
+
+    assert(ID3v2_IndexFilter_compile("(year = 1999", &error_offset) == NULL);
+    assert(error_offset == 12);
+
+    assert(ID3v2_IndexFilter_compile("artist = \"unterminated", &error_offset) == NULL);
+    assert(error_offset == 9);
+
+    assert(ID3v2_IndexFilter_compile("has_cover has_cover", &error_offset) == NULL);
+    assert(error_offset == 10);
+
+    assert(ID3v2_IndexFilter_compile("year = 1999 and", NULL) == NULL);
+
+    ID3v2_IndexFilter* filter = ID3v2_IndexFilter_compile("title = \"say \\\"hi\\\"\"", NULL);
+    assert(filter != NULL);
+    ID3v2_IndexFilter_free(filter);
+
+    printf("INDEX FILTER ERRORS TEST: OK\n");
+}
+
+void index_filter_test_main()
+{
+    index_filter_test();
+    index_filter_errors_test();
+}
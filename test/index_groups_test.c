@@ -0,0 +1,224 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "id3v2lib.h"
+#include "index_test_utils.h"
+
+#include "index_groups_test.h"
+
+#define INDEX_DIRECTORY "extra/groups_index"
+// Enough rows to be counted by several threads
+#define ROW_COUNT 70000
+
+typedef struct _ExpectedGroups
+{
+    bool covers_only;
+    int artists[INDEX_ARTIST_COUNT];
+    int genres[INDEX_GENRE_COUNT];
+    // Of 1950 to 2029
+    int decades[8];
+    int years[80];
+} ExpectedGroups;
+
+static int find_text(const char* const* texts, const int count, const char* text)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (strcmp(texts[i], text) == 0) return i;
+    }
+
+    return -1;
+}
+
+static bool count_row(const ID3v2_IndexRow* row, void* ctx)
+{
+    ExpectedGroups* expected = (ExpectedGroups*) ctx;
+    if (expected->covers_only && !row->numbers[ID3v2_INDEX_HAS_COVER]) return true;
+
+    const char* artist = row->strings[ID3v2_INDEX_ARTIST];
+    const char* genre = row->strings[ID3v2_INDEX_GENRE];
+
+    expected->artists[find_text(index_artists, INDEX_ARTIST_COUNT, artist)]++;
+    expected->genres[find_text(index_genres, INDEX_GENRE_COUNT, genre)]++;
+    expected->decades[(row->numbers[ID3v2_INDEX_YEAR] - 1950) / 10]++;
+    expected->years[row->numbers[ID3v2_INDEX_YEAR] - 1950]++;
+
+    return true;
+}
+
+static void assert_text_groups(
+    const ID3v2_IndexGroups* groups,
+    const char* const* texts,
+    const int* counts,
+    const int count
+)
+{
+    int found = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (counts[i] == 0) continue;
+
+        const ID3v2_IndexGroup* group = ID3v2_IndexGroups_get(groups, found++);
+        assert(group != NULL);
+        assert(strcmp(group->text, texts[i]) == 0);
+        assert(group->count == counts[i]);
+    }
+
+    assert(ID3v2_IndexGroups_get_count(groups) == found);
+    assert(ID3v2_IndexGroups_get(groups, found) == NULL);
+}
+
+static void assert_number_groups(
+    const ID3v2_IndexGroups* groups,
+    const int first,
+    const int width,
+    const int* counts,
+    const int count
+)
+{
+    int found = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (counts[i] == 0) continue;
+
+        const ID3v2_IndexGroup* group = ID3v2_IndexGroups_get(groups, found++);
+        assert(group->text == NULL);
+        assert(group->number == first + i * width);
+        assert(group->count == counts[i]);
+    }
+
+    assert(ID3v2_IndexGroups_get_count(groups) == found);
+}
+
+static void assert_groups(ID3v2_IndexSnapshot* snapshot, const ID3v2_IndexSelection* selection)
+{
+    ExpectedGroups expected = {selection != NULL};
+    ID3v2_IndexSnapshot_for_each(snapshot, count_row, &expected);
+
+    ID3v2_IndexGroups* groups[4];
+    const int columns[4] = {
+        ID3v2_INDEX_ARTIST,
+        ID3v2_INDEX_GENRE,
+        ID3v2_INDEX_YEAR,
+        ID3v2_INDEX_YEAR,
+    };
+    const int widths[4] = {10, 1, 10, 0};
+
+    for (int i = 0; i < 4; i++)
+    {
+        groups[i] = selection != NULL
+                        ? ID3v2_IndexSelection_group_by(selection, columns[i], widths[i])
+                        : ID3v2_IndexSnapshot_group_by(snapshot, columns[i], widths[i]);
+    }
+
+    assert_text_groups(groups[0], index_artists, expected.artists, INDEX_ARTIST_COUNT);
+    assert_text_groups(groups[1], index_genres, expected.genres, INDEX_GENRE_COUNT);
+    assert_number_groups(groups[2], 1950, 10, expected.decades, 8);
+    assert_number_groups(groups[3], 1950, 1, expected.years, 80);
+
+    // Top artists, against a sort of the expected counts
+    ID3v2_IndexGroup top[INDEX_ARTIST_COUNT + 1];
+    assert(ID3v2_IndexGroups_top(groups[0], 3, top) == 3);
+    assert(ID3v2_IndexGroups_top(groups[0], 100, top) == ID3v2_IndexGroups_get_count(groups[0]));
+
+    for (int i = 0; i < 3; i++)
+    {
+        int better = 0;
+        int artist = find_text(index_artists, INDEX_ARTIST_COUNT, top[i].text);
+
+        for (int j = 0; j < INDEX_ARTIST_COUNT; j++)
+        {
+            if (expected.artists[j] > expected.artists[artist] ||
+                (expected.artists[j] == expected.artists[artist] && j < artist))
+            {
+                better++;
+            }
+        }
+
+        assert(better == i);
+        assert(top[i].count == expected.artists[artist]);
+    }
+
+    assert(ID3v2_IndexGroups_top(groups[0], 0, top) == 0);
+
+    for (int i = 0; i < 4; i++) ID3v2_IndexGroups_free(groups[i]);
+}
+
+void index_groups_test()
+{
+    delete_index(INDEX_DIRECTORY);
+
+    ID3v2_LibraryIndex* index = ID3v2_LibraryIndex_open(INDEX_DIRECTORY);
+
+    ID3v2_IndexBatch* batch = ID3v2_IndexBatch_new();
+    for (int i = 0; i < ROW_COUNT; i++) put_generated_row(batch, i, 1);
+    assert(ID3v2_LibraryIndex_commit(index, batch) == 0);
+    ID3v2_IndexBatch_free(batch);
+
+    // Replaced rows, counted from the newer segment only
+    batch = ID3v2_IndexBatch_new();
+    for (int i = 20000; i < 30000; i++) put_generated_row(batch, i, 2);
+    assert(ID3v2_LibraryIndex_commit(index, batch) == 0);
+    ID3v2_IndexBatch_free(batch);
+
+    batch = ID3v2_IndexBatch_new();
+    char path[16];
+
+    for (int i = 0; i < ROW_COUNT; i += 11)
+    {
+        generated_row_path(path, sizeof(path), i);
+        ID3v2_IndexBatch_delete(batch, path);
+    }
+
+    assert(ID3v2_LibraryIndex_commit(index, batch) == 0);
+    ID3v2_IndexBatch_free(batch);
+
+    ID3v2_IndexSnapshot* snapshot = ID3v2_LibraryIndex_acquire(index);
+    assert_groups(snapshot, NULL);
+
+    ID3v2_IndexFilter* filter = ID3v2_IndexFilter_compile("has_cover", NULL);
+    ID3v2_IndexSelection* selection = ID3v2_IndexFilter_select(filter, snapshot);
+    assert_groups(snapshot, selection);
+
+    // Every path is a group of its own
+    ID3v2_IndexGroups* paths = ID3v2_IndexSelection_group_by(selection, ID3v2_INDEX_PATH, 1);
+    assert(ID3v2_IndexGroups_get_count(paths) == ID3v2_IndexSelection_get_count(selection));
+    ID3v2_IndexGroups_free(paths);
+
+    assert(ID3v2_IndexSnapshot_group_by(snapshot, ID3v2_INDEX_COLUMN_COUNT, 1) == NULL);
+
+    // Groups keep their snapshot pinned
+    ID3v2_IndexGroups* genres_groups = ID3v2_IndexSnapshot_group_by(snapshot, ID3v2_INDEX_GENRE, 1);
+    ID3v2_IndexSelection_free(selection);
+    ID3v2_IndexFilter_free(filter);
+    ID3v2_IndexSnapshot_release(snapshot);
+    ID3v2_LibraryIndex_close(index);
+
+    assert(ID3v2_IndexGroups_get_count(genres_groups) == INDEX_GENRE_COUNT);
+    assert(strcmp(ID3v2_IndexGroups_get(genres_groups, 4)->text, "Rock") == 0);
+    ID3v2_IndexGroups_free(genres_groups);
+
+    delete_index(INDEX_DIRECTORY);
+
+    printf("INDEX GROUPS TEST: OK\n");
+}
+
+void index_groups_test_main()
+{
+    index_groups_test();
+}
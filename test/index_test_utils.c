@@ -0,0 +1,88 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "id3v2lib.h"
+
+#include "index_test_utils.h"
+
+const char* const index_artists[INDEX_ARTIST_COUNT] = {
+    "ABBA",
+    "Aphex Twin",
+    "Beach House",
+    "Björk",
+    "Boards of Canada",
+    "The Beatles",
+    "beatles tribute band",
+};
+
+const char* const index_genres[INDEX_GENRE_COUNT] = {"", "Electronic", "Jazz", "Pop", "Rock"};
+
+void delete_index(const char* directory)
+{
+    DIR* dir = opendir(directory);
+    if (dir == NULL) return;
+
+    struct dirent* entry;
+    char path[512];
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (entry->d_name[0] == '.') continue;
+
+        snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+        remove(path);
+    }
+
+    closedir(dir);
+    rmdir(directory);
+}
+
+void put_index_row(ID3v2_IndexBatch* batch, const char* path, const char* title, const int year)
+{
+    ID3v2_IndexRow row = {{0}};
+    row.strings[ID3v2_INDEX_PATH] = path;
+    row.strings[ID3v2_INDEX_TITLE] = title;
+    row.strings[ID3v2_INDEX_ARTIST] = "Artist";
+    row.numbers[ID3v2_INDEX_YEAR] = year;
+
+    ID3v2_IndexBatch_put(batch, &row);
+}
+
+void generated_row_path(char* path, const int size, const int i)
+{
+    snprintf(path, size, "%06d.mp3", i);
+}
+
+void put_generated_row(ID3v2_IndexBatch* batch, const int i, const int version)
+{
+    char path[16];
+    char title[32];
+    generated_row_path(path, sizeof(path), i);
+    snprintf(title, sizeof(title), "Song %d", i * version);
+
+    // Skewed, so every artist has a different number of rows
+    const int artist = (i % 29 * (i % 29) + version) % 29 % INDEX_ARTIST_COUNT;
+
+    ID3v2_IndexRow row = {{0}};
+    row.strings[ID3v2_INDEX_PATH] = path;
+    row.strings[ID3v2_INDEX_TITLE] = title;
+    row.strings[ID3v2_INDEX_ARTIST] = index_artists[artist];
+    row.strings[ID3v2_INDEX_GENRE] = index_genres[(i / 3 + version) % INDEX_GENRE_COUNT];
+    row.numbers[ID3v2_INDEX_YEAR] = 1950 + (i * version) % 75;
+    row.numbers[ID3v2_INDEX_TRACK] = i % 20 + 1;
+    row.numbers[ID3v2_INDEX_HAS_COVER] = i % 3 == 0;
+
+    ID3v2_IndexBatch_put(batch, &row);
+}
@@ -0,0 +1,32 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_index_test_utils_h
+#define id3v2lib_index_test_utils_h
+
+#include "id3v2lib.h"
+
+#define INDEX_ARTIST_COUNT 7
+#define INDEX_GENRE_COUNT 5
+
+// Sorted, as groups hand them out
+extern const char* const index_artists[INDEX_ARTIST_COUNT];
+extern const char* const index_genres[INDEX_GENRE_COUNT];
+
+void delete_index(const char* directory);
+void put_index_row(ID3v2_IndexBatch* batch, const char* path, const char* title, const int year);
+
+/**
+ * Puts row i of a generated library. Later versions of a row keep its path
+ * and change everything else.
+ */
+void put_generated_row(ID3v2_IndexBatch* batch, const int i, const int version);
+void generated_row_path(char* path, const int size, const int i);
+
+#endif
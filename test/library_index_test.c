@@ -0,0 +1,402 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "id3v2lib.h"
+#include "index_test_utils.h"
+
+#include "library_index_test.h"
+
+#define INDEX_DIRECTORY "extra/index"
+#define READER_COUNT 4
+#define UPDATE_COUNT 200
+
+static int count_segment_files()
+{
+    DIR* dir = opendir(INDEX_DIRECTORY);
+    struct dirent* entry;
+    int count = 0;
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (strstr(entry->d_name, ".seg") != NULL) count++;
+    }
+
+    closedir(dir);
+    return count;
+}
+
+/**
+ * Overwrites size bytes at offset of the only segment file with value.
+ */
+static void corrupt_segment(const long offset, const char value, const int size)
+{
+    DIR* dir = opendir(INDEX_DIRECTORY);
+    struct dirent* entry;
+    char path[512] = "";
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (strstr(entry->d_name, ".seg") != NULL)
+        {
+            snprintf(path, sizeof(path), "%s/%s", INDEX_DIRECTORY, entry->d_name);
+        }
+    }
+
+    closedir(dir);
+
+    FILE* fp = fopen(path, "r+b");
+    assert(fp != NULL);
+    fseek(fp, offset, SEEK_SET);
+    for (int i = 0; i < size; i++) fputc(value, fp);
+    fclose(fp);
+}
+
+static bool count_rows(const ID3v2_IndexRow* row, void* ctx)
+{
+    (*(int*) ctx)++;
+    return true;
+}
+
+void library_index_test()
+{
+    delete_index(INDEX_DIRECTORY);
+
+    ID3v2_LibraryIndex* index = ID3v2_LibraryIndex_open(INDEX_DIRECTORY);
+    assert(index != NULL);
+
+    ID3v2_IndexSnapshot* empty = ID3v2_LibraryIndex_acquire(index);
+    assert(ID3v2_IndexSnapshot_get_generation(empty) == 0);
+    assert(ID3v2_IndexSnapshot_get_row_count(empty) == 0);
+
+    ID3v2_Tag* tag = ID3v2_read_tag("extra/file.mp3");
+    ID3v2_IndexBatch* batch = ID3v2_IndexBatch_new();
+    put_index_row(batch, "a.mp3", "A", 1999);
+    put_index_row(batch, "c.mp3", "C", 2001);
+    put_index_row(batch, "b.mp3", "First B", 2000);
+    put_index_row(batch, "b.mp3", "B", 2000);
+    ID3v2_IndexBatch_put_tag(batch, "extra/file.mp3", tag);
+    assert(ID3v2_LibraryIndex_commit(index, batch) == 0);
+    ID3v2_IndexBatch_free(batch);
+    ID3v2_Tag_free(tag);
+
+    ID3v2_IndexSnapshot* first = ID3v2_LibraryIndex_acquire(index);
+    ID3v2_IndexRow row;
+    assert(ID3v2_IndexSnapshot_get_generation(first) == 1);
+    assert(ID3v2_IndexSnapshot_get_row_count(first) == 4);
+    assert(ID3v2_IndexSnapshot_get_row_count(empty) == 0);
+
+    // The last put of a path wins
+    assert(ID3v2_IndexSnapshot_find(first, "b.mp3", &row));
+    assert(strcmp(row.strings[ID3v2_INDEX_TITLE], "B") == 0);
+    assert(strcmp(row.strings[ID3v2_INDEX_ARTIST], "Artist") == 0);
+    assert(strcmp(row.strings[ID3v2_INDEX_ALBUM], "") == 0);
+    assert(row.numbers[ID3v2_INDEX_YEAR] == 2000);
+
+    // Tags are stored as UTF-8
+    assert(ID3v2_IndexSnapshot_find(first, "extra/file.mp3", &row));
+    assert(strcmp(row.strings[ID3v2_INDEX_TITLE], "Rivers") == 0);
+    assert(row.numbers[ID3v2_INDEX_HAS_COVER] == 1);
+
+    // Pinned generations don't see later commits
+    batch = ID3v2_IndexBatch_new();
+    put_index_row(batch, "b.mp3", "New B", 2010);
+    ID3v2_IndexBatch_delete(batch, "c.mp3");
+    ID3v2_IndexBatch_delete(batch, "missing.mp3");
+    assert(ID3v2_LibraryIndex_commit(index, batch) == 0);
+    ID3v2_IndexBatch_free(batch);
+
+    ID3v2_IndexSnapshot* second = ID3v2_LibraryIndex_acquire(index);
+    assert(ID3v2_IndexSnapshot_get_generation(second) == 2);
+    assert(ID3v2_IndexSnapshot_get_segment_count(second) == 2);
+    assert(ID3v2_IndexSnapshot_get_row_count(second) == 3);
+    assert(!ID3v2_IndexSnapshot_find(second, "c.mp3", &row));
+    assert(!ID3v2_IndexSnapshot_find(second, "missing.mp3", &row));
+    assert(ID3v2_IndexSnapshot_find(second, "b.mp3", &row));
+    assert(strcmp(row.strings[ID3v2_INDEX_TITLE], "New B") == 0);
+
+    assert(ID3v2_IndexSnapshot_get_row_count(first) == 4);
+    assert(ID3v2_IndexSnapshot_find(first, "c.mp3", &row));
+    assert(ID3v2_IndexSnapshot_find(first, "b.mp3", &row));
+    assert(strcmp(row.strings[ID3v2_INDEX_TITLE], "B") == 0);
+
+    int count = 0;
+    assert(ID3v2_IndexSnapshot_for_each(second, count_rows, &count) == 0);
+    assert(count == 3);
+
+    // Another process only loads what changed
+    ID3v2_LibraryIndex* other = ID3v2_LibraryIndex_open(INDEX_DIRECTORY);
+    ID3v2_IndexSnapshot* other_snapshot = ID3v2_LibraryIndex_acquire(other);
+    assert(ID3v2_IndexSnapshot_get_generation(other_snapshot) == 2);
+    assert(ID3v2_IndexSnapshot_get_row_count(other_snapshot) == 3);
+    ID3v2_IndexSnapshot_release(other_snapshot);
+
+    batch = ID3v2_IndexBatch_new();
+    put_index_row(batch, "d.mp3", "D", 2020);
+    assert(ID3v2_LibraryIndex_commit(index, batch) == 0);
+    ID3v2_IndexBatch_free(batch);
+
+    assert(ID3v2_LibraryIndex_refresh(other) == 0);
+    other_snapshot = ID3v2_LibraryIndex_acquire(other);
+    assert(ID3v2_IndexSnapshot_get_generation(other_snapshot) == 3);
+    assert(ID3v2_IndexSnapshot_get_row_count(other_snapshot) == 4);
+    assert(ID3v2_IndexSnapshot_find(other_snapshot, "d.mp3", &row));
+    ID3v2_IndexSnapshot_release(other_snapshot);
+
+    // Compaction leaves a single segment and pinned generations alone
+    assert(count_segment_files() == 3);
+    assert(ID3v2_LibraryIndex_compact(index) == 0);
+    assert(count_segment_files() == 1);
+
+    ID3v2_IndexSnapshot* compacted = ID3v2_LibraryIndex_acquire(index);
+    assert(ID3v2_IndexSnapshot_get_generation(compacted) == 4);
+    assert(ID3v2_IndexSnapshot_get_segment_count(compacted) == 1);
+    assert(ID3v2_IndexSnapshot_get_row_count(compacted) == 4);
+    assert(ID3v2_IndexSnapshot_find(compacted, "b.mp3", &row));
+    assert(strcmp(row.strings[ID3v2_INDEX_TITLE], "New B") == 0);
+    assert(ID3v2_IndexSnapshot_find(first, "c.mp3", &row));
+    assert(strcmp(row.strings[ID3v2_INDEX_TITLE], "C") == 0);
+
+    assert(ID3v2_LibraryIndex_refresh(other) == 0);
+    other_snapshot = ID3v2_LibraryIndex_acquire(other);
+    assert(ID3v2_IndexSnapshot_get_segment_count(other_snapshot) == 1);
+    assert(ID3v2_IndexSnapshot_get_row_count(other_snapshot) == 4);
+    ID3v2_IndexSnapshot_release(other_snapshot);
+    ID3v2_LibraryIndex_close(other);
+
+    // Nothing left to compact
+    assert(ID3v2_LibraryIndex_compact(index) == 0);
+    assert(count_segment_files() == 1);
+
+    ID3v2_LibraryIndex_close(index);
+
+    // Snapshots outlive the index
+    assert(ID3v2_IndexSnapshot_find(compacted, "d.mp3", &row));
+    ID3v2_IndexSnapshot_release(empty);
+    ID3v2_IndexSnapshot_release(first);
+    ID3v2_IndexSnapshot_release(second);
+    ID3v2_IndexSnapshot_release(compacted);
+
+    index = ID3v2_LibraryIndex_open(INDEX_DIRECTORY);
+    ID3v2_IndexSnapshot* reopened = ID3v2_LibraryIndex_acquire(index);
+    assert(ID3v2_IndexSnapshot_get_generation(reopened) == 4);
+    assert(ID3v2_IndexSnapshot_get_row_count(reopened) == 4);
+    ID3v2_IndexSnapshot_release(reopened);
+    ID3v2_LibraryIndex_close(index);
+
+    delete_index(INDEX_DIRECTORY);
+
+    printf("LIBRARY INDEX TEST: OK\n");
+}
+
+typedef struct _IndexUpdates
+{
+    ID3v2_LibraryIndex* index;
+    bool done;
+} IndexUpdates;
+
+static void* update_index(void* arg)
+{
+    IndexUpdates* updates = (IndexUpdates*) arg;
+    char title[16];
+
+    for (int i = 1; i <= UPDATE_COUNT; i++)
+    {
+        snprintf(title, sizeof(title), "%d", i);
+
+        ID3v2_IndexBatch* batch = ID3v2_IndexBatch_new();
+        put_index_row(batch, "first.mp3", title, i);
+        put_index_row(batch, "second.mp3", title, i);
+        assert(ID3v2_LibraryIndex_commit(updates->index, batch) == 0);
+        ID3v2_IndexBatch_free(batch);
+    }
+
+    __atomic_store_n(&updates->done, true, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void* compact_index(void* arg)
+{
+    IndexUpdates* updates = (IndexUpdates*) arg;
+
+    while (!__atomic_load_n(&updates->done, __ATOMIC_ACQUIRE))
+    {
+        assert(ID3v2_LibraryIndex_compact(updates->index) == 0);
+    }
+
+    return NULL;
+}
+
+static void* read_index(void* arg)
+{
+    IndexUpdates* updates = (IndexUpdates*) arg;
+    unsigned long long generation = 0;
+    ID3v2_IndexRow first;
+    ID3v2_IndexRow second;
+
+    while (!__atomic_load_n(&updates->done, __ATOMIC_ACQUIRE))
+    {
+        ID3v2_IndexSnapshot* snapshot = ID3v2_LibraryIndex_acquire(updates->index);
+
+        // Both rows change in the same commit
+        assert(ID3v2_IndexSnapshot_get_generation(snapshot) >= generation);
+        assert(ID3v2_IndexSnapshot_get_row_count(snapshot) == 2);
+        assert(ID3v2_IndexSnapshot_find(snapshot, "first.mp3", &first));
+        assert(ID3v2_IndexSnapshot_find(snapshot, "second.mp3", &second));
+        assert(strcmp(first.strings[ID3v2_INDEX_TITLE], second.strings[ID3v2_INDEX_TITLE]) == 0);
+        assert(first.numbers[ID3v2_INDEX_YEAR] == second.numbers[ID3v2_INDEX_YEAR]);
+
+        generation = ID3v2_IndexSnapshot_get_generation(snapshot);
+        ID3v2_IndexSnapshot_release(snapshot);
+    }
+
+    return NULL;
+}
+
+void library_index_concurrency_test()
+{
+    delete_index(INDEX_DIRECTORY);
+
+    IndexUpdates updates = {ID3v2_LibraryIndex_open(INDEX_DIRECTORY), false};
+
+    ID3v2_IndexBatch* batch = ID3v2_IndexBatch_new();
+    put_index_row(batch, "first.mp3", "0", 0);
+    put_index_row(batch, "second.mp3", "0", 0);
+    assert(ID3v2_LibraryIndex_commit(updates.index, batch) == 0);
+    ID3v2_IndexBatch_free(batch);
+
+    pthread_t updater;
+    pthread_t compactor;
+    pthread_t readers[READER_COUNT];
+
+    for (int i = 0; i < READER_COUNT; i++)
+    {
+        pthread_create(&readers[i], NULL, read_index, &updates);
+    }
+
+    pthread_create(&compactor, NULL, compact_index, &updates);
+    pthread_create(&updater, NULL, update_index, &updates);
+
+    pthread_join(updater, NULL);
+    pthread_join(compactor, NULL);
+
+    for (int i = 0; i < READER_COUNT; i++)
+    {
+        pthread_join(readers[i], NULL);
+    }
+
+    ID3v2_IndexSnapshot* snapshot = ID3v2_LibraryIndex_acquire(updates.index);
+    ID3v2_IndexRow row;
+    assert(ID3v2_IndexSnapshot_find(snapshot, "second.mp3", &row));
+    assert(row.numbers[ID3v2_INDEX_YEAR] == UPDATE_COUNT);
+    ID3v2_IndexSnapshot_release(snapshot);
+
+    ID3v2_LibraryIndex_close(updates.index);
+    delete_index(INDEX_DIRECTORY);
+
+    printf("LIBRARY INDEX CONCURRENCY TEST: OK\n");
+}
+
+static void* acquire_index(void* arg)
+{
+    IndexUpdates* updates = (IndexUpdates*) arg;
+
+    while (!__atomic_load_n(&updates->done, __ATOMIC_ACQUIRE))
+    {
+        ID3v2_IndexSnapshot* snapshot = ID3v2_LibraryIndex_acquire(updates->index);
+        assert(ID3v2_IndexSnapshot_get_row_count(snapshot) == 1);
+        ID3v2_IndexSnapshot_release(snapshot);
+    }
+
+    return NULL;
+}
+
+void library_index_publish_test()
+{
+    delete_index(INDEX_DIRECTORY);
+
+    IndexUpdates updates = {ID3v2_LibraryIndex_open(INDEX_DIRECTORY), false};
+    pthread_t readers[READER_COUNT * 2];
+    char title[16];
+
+    ID3v2_IndexBatch* batch = ID3v2_IndexBatch_new();
+    put_index_row(batch, "only.mp3", "0", 0);
+    assert(ID3v2_LibraryIndex_commit(updates.index, batch) == 0);
+    ID3v2_IndexBatch_free(batch);
+
+    for (int i = 0; i < READER_COUNT * 2; i++)
+    {
+        pthread_create(&readers[i], NULL, acquire_index, &updates);
+    }
+
+    // Generations are published back to back while readers pin them
+    for (int i = 1; i <= UPDATE_COUNT; i++)
+    {
+        snprintf(title, sizeof(title), "%d", i);
+
+        batch = ID3v2_IndexBatch_new();
+        put_index_row(batch, "only.mp3", title, i);
+        assert(ID3v2_LibraryIndex_commit(updates.index, batch) == 0);
+        ID3v2_IndexBatch_free(batch);
+    }
+
+    __atomic_store_n(&updates.done, true, __ATOMIC_RELEASE);
+
+    for (int i = 0; i < READER_COUNT * 2; i++)
+    {
+        pthread_join(readers[i], NULL);
+    }
+
+    ID3v2_IndexSnapshot* snapshot = ID3v2_LibraryIndex_acquire(updates.index);
+    assert(ID3v2_IndexSnapshot_get_generation(snapshot) == UPDATE_COUNT + 1);
+    ID3v2_IndexSnapshot_release(snapshot);
+
+    ID3v2_LibraryIndex_close(updates.index);
+    delete_index(INDEX_DIRECTORY);
+
+    printf("LIBRARY INDEX PUBLISH TEST: OK\n");
+}
+
+void library_index_corrupt_test()
+{
+    delete_index(INDEX_DIRECTORY);
+
+    ID3v2_LibraryIndex* index = ID3v2_LibraryIndex_open(INDEX_DIRECTORY);
+    ID3v2_IndexBatch* batch = ID3v2_IndexBatch_new();
+    put_index_row(batch, "a.mp3", "A", 1999);
+    assert(ID3v2_LibraryIndex_commit(index, batch) == 0);
+    ID3v2_IndexBatch_free(batch);
+    ID3v2_LibraryIndex_close(index);
+
+    // The title code of the only row, past the header, the paths (count,
+    // offset and code), the count of titles and the offset of the only one
+    corrupt_segment(16 + 3 * 4 + 4 + 4, '\xFF', 4);
+    assert(ID3v2_LibraryIndex_open(INDEX_DIRECTORY) == NULL);
+
+    delete_index(INDEX_DIRECTORY);
+
+    printf("LIBRARY INDEX CORRUPT TEST: OK\n");
+}
+
+void library_index_test_main()
+{
+    library_index_test();
+    library_index_concurrency_test();
+    library_index_publish_test();
+    library_index_corrupt_test();
+}
@@ -9,10 +9,28 @@
 
 #include <stdio.h>
 
+#include "canonical_test.h"
+#include "change_log_test.h"
+#include "codepage_test.h"
 #include "compat_test.h"
+#include "container_test.h"
+#include "cover_store_test.h"
 #include "delete_test.h"
 #include "get_test.h"
+#include "index_filter_test.h"
+#include "index_groups_test.h"
+#include "library_index_test.h"
+#include "parse_test.h"
+#include "play_count_test.h"
+#include "prepend_test.h"
+#include "progress_test.h"
+#include "scan_test.h"
 #include "set_test.h"
+#include "snapshot_test.h"
+#include "tag_cache_test.h"
+#include "tag_view_test.h"
+#include "throttle_test.h"
+#include "walker_test.h"
 
 int main()
 {
@@ -20,4 +38,22 @@ int main()
     set_test_main();
     delete_test_main();
     compat_test_main();
+    play_count_test_main();
+    change_log_test_main();
+    snapshot_test_main();
+    container_test_main();
+    prepend_test_main();
+    tag_cache_test_main();
+    throttle_test_main();
+    progress_test_main();
+    canonical_test_main();
+    scan_test_main();
+    walker_test_main();
+    parse_test_main();
+    tag_view_test_main();
+    library_index_test_main();
+    index_filter_test_main();
+    index_groups_test_main();
+    cover_store_test_main();
+    codepage_test_main();
 }
@@ -0,0 +1,204 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "id3v2lib.h"
+#include "test_utils.h"
+
+#include "parse_test.h"
+
+#define COMMENT_COUNT 300
+#define PICTURE_COUNT 6
+#define PICTURE_SIZE (512 * 1024)
+#define PADDED_FILE "extra/padded.mp3"
+#define LARGE_PADDING_SIZE (8 * 1024 * 1024)
+
+static char* tag_bytes(ID3v2_Tag* tag, int* size)
+{
+    struct iovec iov[ID3v2_PREPEND_IOV_COUNT];
+    int iovcnt = 0;
+
+    assert(ID3v2_Tag_prepend(tag, NULL, 0, iov, &iovcnt) == 0);
+    *size = iov[0].iov_len;
+    return (char*) iov[0].iov_base;
+}
+
+void large_tag_test()
+{
+    // Big enough to be decoded by several threads
+    ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+    char* picture = (char*) malloc(PICTURE_SIZE);
+    char description[32];
+
+    for (int i = 0; i < COMMENT_COUNT; i++)
+    {
+        sprintf(description, "Chapter %d", i);
+        ID3v2_Tag_add_comment_frame(
+            tag,
+            &(ID3v2_CommentFrameInput){"\0\0", "eng", description, description}
+        );
+
+        if (i % (COMMENT_COUNT / PICTURE_COUNT) == 0)
+        {
+            memset(picture, i, PICTURE_SIZE);
+            ID3v2_Tag_add_apic_frame(
+                tag,
+                &(ID3v2_ApicFrameInput){
+                    "\0\0", "image/png", description, 0x08, PICTURE_SIZE, picture
+                }
+            );
+        }
+    }
+
+    ID3v2_Tag_set_title(tag, "Chapters");
+
+    int size = 0;
+    char* bytes = tag_bytes(tag, &size);
+    assert(size > PICTURE_COUNT * PICTURE_SIZE);
+
+    // Frames come back in the same order, with the same contents
+    ID3v2_Tag* parsed = ID3v2_read_tag_from_buffer(bytes, size);
+    int parsed_size = 0;
+    char* parsed_bytes = tag_bytes(parsed, &parsed_size);
+
+    assert(parsed_size == size);
+    assert(memcmp(parsed_bytes, bytes, size) == 0);
+    assert(strcmp(ID3v2_Tag_get_title_frame(parsed)->data->text, "Chapters") == 0);
+    ID3v2_CommentFrame* comment = ID3v2_Tag_get_comment(parsed, "eng", "Chapter 299");
+    assert(strcmp(comment->data->comment, "Chapter 299") == 0);
+    assert(ID3v2_Tag_get_apic_frames(parsed)->start != NULL);
+
+    free(parsed_bytes);
+    free(bytes);
+    free(picture);
+    ID3v2_Tag_free(parsed);
+    ID3v2_Tag_free(tag);
+
+    printf("LARGE TAG TEST: OK\n");
+}
+
+void unsynchronisation_test()
+{
+    // v2.4 frame, unsynchronised and with a data length indicator
+    const char v4_tag[] = "ID3\x04\x00\x00\x00\x00\x00\x13"
+                          "TIT2\x00\x00\x00\x09\x00\x03"
+                          "\x00\x00\x00\x04"
+                          "\x00" "A\xFF\x00" "B";
+
+    ID3v2_Tag* tag = ID3v2_read_tag_from_buffer(v4_tag, sizeof(v4_tag) - 1);
+    ID3v2_TextFrame* title = ID3v2_Tag_get_title_frame(tag);
+
+    assert(strcmp(title->data->text, "A\xFF" "B") == 0);
+    assert(title->header->flags[1] == 0);
+    ID3v2_Tag_free(tag);
+
+    // v2.3 tag, unsynchronised as a whole
+    const char v3_tag[] = "ID3\x03\x00\x80\x00\x00\x00\x0F"
+                          "TIT2\x00\x00\x00\x04\x00\x00"
+                          "\x00" "A\xFF\x00" "B";
+
+    tag = ID3v2_read_tag_from_buffer(v3_tag, sizeof(v3_tag) - 1);
+    title = ID3v2_Tag_get_title_frame(tag);
+
+    assert(strcmp(title->data->text, "A\xFF" "B") == 0);
+    assert((tag->header->flags & 0x80) == 0);
+    assert(tag->padding_size == 0);
+    ID3v2_Tag_free(tag);
+
+    printf("UNSYNCHRONISATION TEST: OK\n");
+}
+
+void compression_test()
+{
+    // v2.4 frame, compressed and with the data length indicator it requires
+    const char v4_tag[] = "ID3\x04\x00\x00\x00\x00\x00\x27"
+                          "TIT2\x00\x00\x00\x1D\x00\x09"
+                          "\x00\x00\x00\x11"
+                          "\x78\xDA\x63\x70\xCE\xCF\x2D\x28\x4A\x2D\x2E\x4E\x4D"
+                          "\x51\x28\xC9\x2C\xC9\x49\x05\x00\x35\xC5\x06\x58";
+
+    ID3v2_Tag* tag = ID3v2_read_tag_from_buffer(v4_tag, sizeof(v4_tag) - 1);
+    ID3v2_TextFrame* title = ID3v2_Tag_get_title_frame(tag);
+
+#ifdef ID3V2_WITH_ZLIB
+    assert(strcmp(title->data->text, "Compressed title") == 0);
+    assert(title->header->flags[1] == 0);
+#else
+    // Without zlib the frame is kept as it was found
+    assert(strcmp(title->data->text, "Compressed title") != 0);
+    assert(title->header->flags[1] == 0x09);
+#endif
+
+    ID3v2_Tag_free(tag);
+
+    // A body that doesn't inflate to its data length is kept as it was found
+    char corrupt_tag[sizeof(v4_tag)];
+    memcpy(corrupt_tag, v4_tag, sizeof(v4_tag));
+    corrupt_tag[23] = 0x12;
+
+    tag = ID3v2_read_tag_from_buffer(corrupt_tag, sizeof(corrupt_tag) - 1);
+    title = ID3v2_Tag_get_title_frame(tag);
+    assert(strcmp(title->data->text, "Compressed title") != 0);
+    assert(title->header->flags[1] == 0x09);
+    ID3v2_Tag_free(tag);
+
+    printf("COMPRESSION TEST: OK\n");
+}
+
+void padding_test()
+{
+    clone_file("extra/no_tag.mp3", PADDED_FILE);
+    const long audio_size = file_size(PADDED_FILE);
+
+    // Padding is written as zeros, however big it is
+    ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+    ID3v2_Tag_set_title(tag, "Padded");
+    ID3v2_Tag_set_artist(tag, "Amon Amarth");
+    ID3v2_Tag_set_album(tag, "Twilight of the Thunder God");
+    tag->padding_size = LARGE_PADDING_SIZE;
+    ID3v2_write_tag(PADDED_FILE, tag);
+    ID3v2_Tag_free(tag);
+
+    tag = ID3v2_read_tag(PADDED_FILE);
+    assert(tag->padding_size == LARGE_PADDING_SIZE);
+    assert(file_size(PADDED_FILE) == audio_size + 10 + tag->header->tag_size);
+    assert(strcmp(ID3v2_Tag_get_album_frame(tag)->data->text, "Twilight of the Thunder God") == 0);
+
+    // Smaller tags written in place leave no trace of the frames they replace
+    const int tag_size = tag->header->tag_size;
+    ID3v2_Tag_delete_artist(tag);
+    ID3v2_Tag_delete_album(tag);
+    ID3v2_write_tag(PADDED_FILE, tag);
+    ID3v2_Tag_free(tag);
+
+    tag = ID3v2_read_tag(PADDED_FILE);
+    assert(tag->header->tag_size == tag_size);
+    assert(tag->padding_size > LARGE_PADDING_SIZE);
+    assert(ID3v2_Tag_get_artist_frame(tag) == NULL);
+    assert(ID3v2_Tag_get_album_frame(tag) == NULL);
+    assert(strcmp(ID3v2_Tag_get_title_frame(tag)->data->text, "Padded") == 0);
+    assert(file_size(PADDED_FILE) == audio_size + 10 + tag_size);
+    ID3v2_Tag_free(tag);
+
+    remove(PADDED_FILE);
+
+    printf("PADDING TEST: OK\n");
+}
+
+void parse_test_main()
+{
+    large_tag_test();
+    unsynchronisation_test();
+    compression_test();
+    padding_test();
+}
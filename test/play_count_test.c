@@ -0,0 +1,171 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "id3v2lib.h"
+#include "test_utils.h"
+
+#include "play_count_test.h"
+
+#define ORIGINAL_FILE "extra/file.mp3"
+#define NO_TAG_FILE "extra/no_tag.mp3"
+#define EDITED_FILE "extra/file_edited.mp3"
+
+#define EMAIL "user@example.com"
+
+void in_place_test()
+{
+    clone_file(ORIGINAL_FILE, EDITED_FILE);
+    const long original_size = file_size(EDITED_FILE);
+
+    assert(ID3v2_increment_play_count(EDITED_FILE, NULL) == 0);
+    assert(ID3v2_increment_play_count(EDITED_FILE, NULL) == 0);
+    assert(ID3v2_set_rating(EDITED_FILE, EMAIL, 196) == 0);
+    assert(ID3v2_increment_play_count(EDITED_FILE, EMAIL) == 0);
+
+    // Everything fit in the padding, the audio wasn't moved
+    assert(file_size(EDITED_FILE) == original_size);
+
+    ID3v2_Tag* tag = ID3v2_read_tag(EDITED_FILE);
+    assert(ID3v2_Tag_get_play_counter_frame(tag)->data->counter == 2);
+    assert(ID3v2_Tag_get_popm_frame(tag, EMAIL)->data->rating == 196);
+    assert(ID3v2_Tag_get_popm_frame(tag, EMAIL)->data->counter == 1);
+    assert(ID3v2_Tag_get_popm_frame(tag, "other@example.com") == NULL);
+
+    // Force the counter to overflow its 4 bytes
+    ID3v2_Tag_set_play_count(tag, 0xFFFFFFFF);
+    ID3v2_write_tag(EDITED_FILE, tag);
+    ID3v2_Tag_free(tag);
+
+    const long written_size = file_size(EDITED_FILE);
+    assert(ID3v2_increment_play_count(EDITED_FILE, NULL) == 0);
+    assert(file_size(EDITED_FILE) == written_size);
+
+    tag = ID3v2_read_tag(EDITED_FILE);
+    assert(ID3v2_Tag_get_play_counter_frame(tag)->data->counter == 0x100000000ULL);
+    assert(ID3v2_Tag_get_play_counter_frame(tag)->header->size == 5);
+    assert(ID3v2_Tag_get_popm_frame(tag, EMAIL)->data->rating == 196);
+    assert(ID3v2_Tag_get_album_cover_frame(tag) != NULL);
+    ID3v2_Tag_free(tag);
+
+    remove(EDITED_FILE);
+
+    printf("PLAY COUNT IN PLACE TEST: OK\n");
+}
+
+void no_tag_test()
+{
+    clone_file(NO_TAG_FILE, EDITED_FILE);
+
+    assert(ID3v2_increment_play_count(EDITED_FILE, NULL) == 0);
+
+    ID3v2_Tag* tag = ID3v2_read_tag(EDITED_FILE);
+    assert(tag != NULL);
+    assert(ID3v2_Tag_get_play_counter_frame(tag)->data->counter == 1);
+    ID3v2_Tag_free(tag);
+
+    remove(EDITED_FILE);
+
+    printf("PLAY COUNT NO TAG TEST: OK\n");
+}
+
+void concurrent_test()
+{
+    const int processes = 4;
+    const int increments = 25;
+
+    clone_file(ORIGINAL_FILE, EDITED_FILE);
+
+    for (int i = 0; i < processes; i++)
+    {
+        if (fork() == 0)
+        {
+            for (int j = 0; j < increments; j++)
+            {
+                ID3v2_increment_play_count(EDITED_FILE, j % 2 == 0 ? NULL : EMAIL);
+            }
+
+            _exit(0);
+        }
+    }
+
+    for (int i = 0; i < processes; i++)
+    {
+        wait(NULL);
+    }
+
+    ID3v2_Tag* tag = ID3v2_read_tag(EDITED_FILE);
+    assert(ID3v2_Tag_get_play_counter_frame(tag)->data->counter == processes * 13);
+    assert(ID3v2_Tag_get_popm_frame(tag, EMAIL)->data->counter == processes * 12);
+    ID3v2_Tag_free(tag);
+
+    remove(EDITED_FILE);
+
+    printf("PLAY COUNT CONCURRENT TEST: OK\n");
+}
+
+void concurrent_rewrite_test()
+{
+    const int rounds = 8;
+    const int processes = 8;
+    const int increments = 20;
+
+    // The first update of a file without a tag renames a new file over it,
+    // while the other processes wait for the lock of the old one
+    for (int round = 0; round < rounds; round++)
+    {
+        clone_file(NO_TAG_FILE, EDITED_FILE);
+
+        for (int i = 0; i < processes; i++)
+        {
+            if (fork() == 0)
+            {
+                // Some open the file before it's renamed, some after
+                usleep(i * 1000);
+
+                for (int j = 0; j < increments; j++)
+                {
+                    if (ID3v2_increment_play_count(EDITED_FILE, NULL) != 0) _exit(1);
+                }
+
+                _exit(0);
+            }
+        }
+
+        for (int i = 0; i < processes; i++)
+        {
+            int status = 0;
+            wait(&status);
+            assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        }
+
+        ID3v2_Tag* tag = ID3v2_read_tag(EDITED_FILE);
+        assert(ID3v2_Tag_get_play_counter_frame(tag)->data->counter == processes * increments);
+        ID3v2_Tag_free(tag);
+    }
+
+    remove(EDITED_FILE);
+
+    printf("PLAY COUNT CONCURRENT REWRITE TEST: OK\n");
+}
+
+void play_count_test_main()
+{
+    in_place_test();
+    no_tag_test();
+    concurrent_test();
+    concurrent_rewrite_test();
+}
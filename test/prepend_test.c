@@ -0,0 +1,78 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "id3v2lib.h"
+#include "test_utils.h"
+
+#include "prepend_test.h"
+
+#define TAG_FILE "extra/file.mp3"
+#define AUDIO_FILE "extra/no_tag.mp3"
+#define OUTPUT_FILE "extra/prepended.mp3"
+
+void prepend_test()
+{
+    long audio_size = 0;
+    char* audio = read_file(AUDIO_FILE, &audio_size);
+    ID3v2_Tag* tag = ID3v2_read_tag(TAG_FILE);
+
+    struct iovec iov[ID3v2_PREPEND_IOV_COUNT];
+    int iovcnt = 0;
+
+    assert(ID3v2_Tag_prepend(tag, audio, audio_size, iov, &iovcnt) == 0);
+    assert(iovcnt == ID3v2_PREPEND_IOV_COUNT);
+
+    // The audio is referenced, not copied
+    assert(iov[2].iov_base == audio);
+    assert(iov[2].iov_len == audio_size);
+    assert(iov[0].iov_len + iov[1].iov_len == tag->header->tag_size + ID3v2_TAG_HEADER_LENGTH);
+
+    void* tag_buffer = iov[0].iov_base;
+    const long output_size = iov[0].iov_len + iov[1].iov_len + iov[2].iov_len;
+
+    const int fd = open(OUTPUT_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    assert(ID3v2_writev(fd, iov, iovcnt) == 0);
+    close(fd);
+    free(tag_buffer);
+
+    long size = 0;
+    char* output = read_file(OUTPUT_FILE, &size);
+    assert(size == output_size);
+    assert(memcmp(output + size - audio_size, audio, audio_size) == 0);
+    free(output);
+
+    ID3v2_Tag* prepended = ID3v2_read_tag(OUTPUT_FILE);
+    assert(prepended != NULL);
+    assert(prepended->padding_size == ID3v2_TAG_DEFAULT_PADDING_LENGTH);
+    assert(
+        strcmp(
+            ID3v2_Tag_get_title_frame(prepended)->data->text,
+            ID3v2_Tag_get_title_frame(tag)->data->text
+        ) == 0
+    );
+
+    ID3v2_Tag_free(prepended);
+    ID3v2_Tag_free(tag);
+    free(audio);
+    remove(OUTPUT_FILE);
+
+    printf("PREPEND TEST: OK\n");
+}
+
+void prepend_test_main()
+{
+    prepend_test();
+}
@@ -0,0 +1,307 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <dirent.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+
+#include "id3v2lib.h"
+#include "test_utils.h"
+
+#include "progress_test.h"
+
+#define ORIGINAL_FILE "extra/file.mp3"
+#define PROGRESS_FILE "extra/progress.mp3"
+
+typedef struct _Progress
+{
+    int calls;
+    int cancel_after;
+    unsigned long long bytes_moved;
+    unsigned long long total_bytes;
+} Progress;
+
+static bool on_progress(
+    const unsigned long long bytes_moved,
+    const unsigned long long total_bytes,
+    void* ctx
+)
+{
+    Progress* progress = (Progress*) ctx;
+
+    assert(bytes_moved > progress->bytes_moved);
+    assert(bytes_moved <= total_bytes);
+
+    progress->calls++;
+    progress->bytes_moved = bytes_moved;
+    progress->total_bytes = total_bytes;
+
+    return progress->calls != progress->cancel_after;
+}
+
+static bool same_files(const char* a, const char* b)
+{
+    FILE* a_fp = fopen(a, "rb");
+    FILE* b_fp = fopen(b, "rb");
+    int a_c = 0;
+    int b_c = 0;
+
+    do
+    {
+        a_c = getc(a_fp);
+        b_c = getc(b_fp);
+    } while (a_c == b_c && a_c != EOF);
+
+    fclose(a_fp);
+    fclose(b_fp);
+
+    return a_c == b_c;
+}
+
+static bool has_temp_files()
+{
+    DIR* dir = opendir("extra");
+    struct dirent* entry = NULL;
+    bool found = false;
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (strstr(entry->d_name, ".id3v2-") != NULL) found = true;
+    }
+
+    closedir(dir);
+
+    return found;
+}
+
+void progress_test()
+{
+    clone_file(ORIGINAL_FILE, PROGRESS_FILE);
+    ID3v2_Tag* tag = ID3v2_read_tag(PROGRESS_FILE);
+
+    // Nothing is moved when the tag fits where it is
+    Progress progress = {0};
+    ID3v2_Tag_set_title(tag, "Progress");
+    assert(ID3v2_write_tag_with_progress(PROGRESS_FILE, tag, on_progress, &progress) == 0);
+    assert(progress.calls == 0);
+
+    // A bigger tag has to move the audio, cancelling leaves the file as it was
+    const int picture_size = 2 * tag->header->tag_size;
+    char* picture = (char*) calloc(picture_size, sizeof(char));
+    ID3v2_Tag_set_album_cover(tag, "image/png", picture_size, picture);
+    free(picture);
+
+    clone_file(PROGRESS_FILE, "extra/progress_original.mp3");
+
+    progress = (Progress){0, 2, 0, 0};
+    assert(
+        ID3v2_write_tag_with_progress(PROGRESS_FILE, tag, on_progress, &progress) ==
+        ID3v2_OPERATION_CANCELLED
+    );
+    assert(progress.calls == 2);
+    assert(progress.bytes_moved < progress.total_bytes);
+    assert(same_files(PROGRESS_FILE, "extra/progress_original.mp3"));
+    assert(!has_temp_files());
+
+    // So do writes that fail, here no file can grow past the original one
+    struct rlimit limit;
+    getrlimit(RLIMIT_FSIZE, &limit);
+    const rlim_t file_size_limit = limit.rlim_cur;
+    void (*previous_handler)(int) = signal(SIGXFSZ, SIG_IGN);
+    limit.rlim_cur = progress.total_bytes;
+    setrlimit(RLIMIT_FSIZE, &limit);
+
+    assert(ID3v2_write_tag_with_progress(PROGRESS_FILE, tag, NULL, NULL) == -1);
+
+    limit.rlim_cur = file_size_limit;
+    setrlimit(RLIMIT_FSIZE, &limit);
+    signal(SIGXFSZ, previous_handler);
+
+    assert(same_files(PROGRESS_FILE, "extra/progress_original.mp3"));
+    assert(!has_temp_files());
+
+    progress = (Progress){0};
+    assert(ID3v2_write_tag_with_progress(PROGRESS_FILE, tag, on_progress, &progress) == 0);
+    assert(progress.calls > 1);
+    assert(progress.bytes_moved == progress.total_bytes);
+    assert(!has_temp_files());
+
+    ID3v2_Tag* written_tag = ID3v2_read_tag(PROGRESS_FILE);
+    assert(ID3v2_Tag_get_album_cover_frame(written_tag)->data->picture_size == picture_size);
+    ID3v2_Tag_free(written_tag);
+
+    // The same goes for deletes
+    const unsigned long long audio_size = progress.total_bytes;
+    clone_file(PROGRESS_FILE, "extra/progress_original.mp3");
+
+    progress = (Progress){0, 1, 0, 0};
+    assert(
+        ID3v2_delete_tag_with_progress(PROGRESS_FILE, on_progress, &progress) ==
+        ID3v2_OPERATION_CANCELLED
+    );
+    assert(same_files(PROGRESS_FILE, "extra/progress_original.mp3"));
+
+    progress = (Progress){0};
+    assert(ID3v2_delete_tag_with_progress(PROGRESS_FILE, on_progress, &progress) == 0);
+    assert(progress.total_bytes == audio_size);
+    assert(progress.bytes_moved == audio_size);
+    assert(ID3v2_read_tag(PROGRESS_FILE) == NULL);
+    assert(!has_temp_files());
+
+    ID3v2_Tag_free(tag);
+    remove(PROGRESS_FILE);
+    remove("extra/progress_original.mp3");
+
+    printf("PROGRESS TEST: OK\n");
+}
+
+void tmpfile_fallback_test()
+{
+    // No temp file name fits next to a file whose name is this long
+    char file_name[6 + 251 + 1] = "extra/";
+    memset(file_name + 6, 'p', 247);
+    strcpy(file_name + 6 + 247, ".mp3");
+
+    clone_file(ORIGINAL_FILE, file_name);
+    clone_file(ORIGINAL_FILE, "extra/progress_original.mp3");
+
+    ID3v2_Tag* tag = ID3v2_read_tag(file_name);
+    const int picture_size = 2 * tag->header->tag_size;
+    char* picture = (char*) calloc(picture_size, sizeof(char));
+    ID3v2_Tag_set_album_cover(tag, "image/png", picture_size, picture);
+    free(picture);
+
+    // The original is left alone until the whole new file could be written
+    struct rlimit limit;
+    getrlimit(RLIMIT_FSIZE, &limit);
+    const rlim_t file_size_limit = limit.rlim_cur;
+    void (*previous_handler)(int) = signal(SIGXFSZ, SIG_IGN);
+    limit.rlim_cur = picture_size;
+    setrlimit(RLIMIT_FSIZE, &limit);
+
+    assert(ID3v2_write_tag_with_progress(file_name, tag, NULL, NULL) == -1);
+
+    limit.rlim_cur = file_size_limit;
+    setrlimit(RLIMIT_FSIZE, &limit);
+    signal(SIGXFSZ, previous_handler);
+
+    assert(same_files(file_name, "extra/progress_original.mp3"));
+
+    Progress progress = {0};
+    assert(ID3v2_write_tag_with_progress(file_name, tag, on_progress, &progress) == 0);
+    assert(progress.bytes_moved == progress.total_bytes);
+
+    ID3v2_Tag* written_tag = ID3v2_read_tag(file_name);
+    assert(ID3v2_Tag_get_album_cover_frame(written_tag)->data->picture_size == picture_size);
+    ID3v2_Tag_free(written_tag);
+
+    // Deletes cut the file to its new size
+    assert(ID3v2_delete_tag_with_progress(file_name, NULL, NULL) == 0);
+    assert(ID3v2_read_tag(file_name) == NULL);
+
+    ID3v2_delete_tag("extra/progress_original.mp3");
+    assert(same_files(file_name, "extra/progress_original.mp3"));
+
+    ID3v2_Tag_free(tag);
+    remove(file_name);
+    remove("extra/progress_original.mp3");
+
+    printf("PROGRESS TMPFILE FALLBACK TEST: OK\n");
+}
+
+static ID3v2_Tag* tag_with_big_cover(const char* file_name)
+{
+    ID3v2_Tag* tag = ID3v2_read_tag(file_name);
+    const int picture_size = 2 * tag->header->tag_size;
+    char* picture = (char*) calloc(picture_size, sizeof(char));
+    ID3v2_Tag_set_album_cover(tag, "image/png", picture_size, picture);
+    free(picture);
+
+    return tag;
+}
+
+static void assert_has_big_cover(const char* file_name)
+{
+    ID3v2_Tag* tag = ID3v2_read_tag(file_name);
+    assert(ID3v2_Tag_get_album_cover_frame(tag)->data->picture_size > tag->header->tag_size / 2);
+    ID3v2_Tag_free(tag);
+}
+
+void links_test()
+{
+    struct stat before, after;
+
+    // Symbolic links stay links to the rewritten file
+    clone_file(ORIGINAL_FILE, PROGRESS_FILE);
+    remove("extra/progress_link.mp3");
+    assert(symlink("progress.mp3", "extra/progress_link.mp3") == 0);
+
+    ID3v2_Tag* tag = tag_with_big_cover("extra/progress_link.mp3");
+    assert(ID3v2_write_tag_with_progress("extra/progress_link.mp3", tag, NULL, NULL) == 0);
+    ID3v2_Tag_free(tag);
+
+    assert(lstat("extra/progress_link.mp3", &after) == 0 && S_ISLNK(after.st_mode));
+    assert_has_big_cover(PROGRESS_FILE);
+    assert(!has_temp_files());
+    remove("extra/progress_link.mp3");
+
+    // Hard links keep sharing the same file
+    clone_file(ORIGINAL_FILE, PROGRESS_FILE);
+    remove("extra/progress_link.mp3");
+    assert(link(PROGRESS_FILE, "extra/progress_link.mp3") == 0);
+    stat(PROGRESS_FILE, &before);
+
+    tag = tag_with_big_cover(PROGRESS_FILE);
+    assert(ID3v2_write_tag_with_progress(PROGRESS_FILE, tag, NULL, NULL) == 0);
+    ID3v2_Tag_free(tag);
+
+    stat("extra/progress_link.mp3", &after);
+    assert(after.st_ino == before.st_ino && after.st_nlink == 2);
+    assert_has_big_cover("extra/progress_link.mp3");
+    remove("extra/progress_link.mp3");
+
+    // Owner, mode and extended attributes are carried over
+    clone_file(ORIGINAL_FILE, PROGRESS_FILE);
+    chmod(PROGRESS_FILE, 0640);
+    const bool owned = getuid() == 0 && chown(PROGRESS_FILE, 1234, 5678) == 0;
+    const bool has_xattr = setxattr(PROGRESS_FILE, "user.id3v2lib", "kept", 4, 0) == 0;
+
+    tag = tag_with_big_cover(PROGRESS_FILE);
+    assert(ID3v2_write_tag_with_progress(PROGRESS_FILE, tag, NULL, NULL) == 0);
+    ID3v2_Tag_free(tag);
+
+    stat(PROGRESS_FILE, &after);
+    assert((after.st_mode & 07777) == 0640);
+    if (owned) assert(after.st_uid == 1234 && after.st_gid == 5678);
+
+    char value[4];
+    if (has_xattr) assert(getxattr(PROGRESS_FILE, "user.id3v2lib", value, 4) == 4);
+    assert_has_big_cover(PROGRESS_FILE);
+    assert(!has_temp_files());
+
+    remove(PROGRESS_FILE);
+
+    printf("PROGRESS LINKS TEST: OK\n");
+}
+
+void progress_test_main()
+{
+    progress_test();
+    tmpfile_fallback_test();
+    links_test();
+}
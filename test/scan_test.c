@@ -0,0 +1,213 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "id3v2lib.h"
+#include "test_utils.h"
+
+#include "scan_test.h"
+
+#define SCANNED_FILE_COUNT 8
+#define FILE_COUNT (SCANNED_FILE_COUNT + 1)
+#define MISSING_FILE "extra/missing.mp3"
+
+// Best effort class, lowest level, as ioprio_get reports it
+#define THROTTLED_PRIORITY ((ID3v2_IO_CLASS_BEST_EFFORT << 13) | 7)
+
+typedef struct _Visits
+{
+    const char* const* file_names;
+    int order[FILE_COUNT];
+    int count;
+    int stop_after;
+} Visits;
+
+static int file_index(const char* const* file_names, const char* file_name)
+{
+    for (int i = 0; i < FILE_COUNT; i++)
+    {
+        if (file_names[i] == file_name) return i;
+    }
+
+    return -1;
+}
+
+static bool record_visit(const char* file_name, ID3v2_Tag* tag, void* ctx)
+{
+    Visits* visits = (Visits*) ctx;
+    const int index = file_index(visits->file_names, file_name);
+    assert(index != -1);
+
+    // Every file was tagged with its own name, except the missing one
+    if (strcmp(file_name, MISSING_FILE) == 0)
+    {
+        assert(tag == NULL);
+    }
+    else
+    {
+        assert(strcmp(ID3v2_Tag_get_title_frame(tag)->data->text, file_name) == 0);
+    }
+
+    visits->order[visits->count++] = index;
+    return visits->count != visits->stop_after;
+}
+
+static bool retitle_even_files(const char* file_name, ID3v2_Tag* tag, void* ctx)
+{
+    const int index = file_index((const char* const*) ctx, file_name);
+    if (index % 2 != 0 || strcmp(file_name, MISSING_FILE) == 0) return false;
+
+    ID3v2_Tag_set_title(tag, "Updated");
+    return true;
+}
+
+static int io_priority()
+{
+    return syscall(SYS_ioprio_get, 1, 0);
+}
+
+static bool check_io_priority(const char* file_name, ID3v2_Tag* tag, void* ctx)
+{
+    assert(io_priority() == THROTTLED_PRIORITY);
+    return true;
+}
+
+static void assert_visited_once(const Visits* visits)
+{
+    bool visited[FILE_COUNT] = {false};
+
+    assert(visits->count == FILE_COUNT);
+    for (int i = 0; i < visits->count; i++)
+    {
+        assert(!visited[visits->order[i]]);
+        visited[visits->order[i]] = true;
+    }
+}
+
+void scan_test()
+{
+    char names[SCANNED_FILE_COUNT][32];
+    const char* file_names[FILE_COUNT];
+
+    for (int i = 0; i < SCANNED_FILE_COUNT; i++)
+    {
+        sprintf(names[i], "extra/scanned_%02d.mp3", i);
+        clone_file("extra/empty.mp3", names[i]);
+
+        ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+        ID3v2_Tag_set_title(tag, names[i]);
+        ID3v2_write_tag(names[i], tag);
+        ID3v2_Tag_free(tag);
+
+        file_names[i] = names[i];
+    }
+
+    file_names[SCANNED_FILE_COUNT] = MISSING_FILE;
+
+    // Without options the files are visited as given
+    Visits visits = {file_names, {0}, 0, 0};
+    assert(ID3v2_scan_files(file_names, FILE_COUNT, NULL, record_visit, &visits) == 0);
+    assert(visits.count == FILE_COUNT);
+    for (int i = 0; i < FILE_COUNT; i++) assert(visits.order[i] == i);
+
+    // A window of a single file can't reorder anything
+    ID3v2_ScanOptions options = {ID3v2_SCAN_ORDER_PHYSICAL, 1};
+    visits = (Visits){file_names, {0}, 0, 0};
+    assert(ID3v2_scan_files(file_names, FILE_COUNT, &options, record_visit, &visits) == 0);
+    for (int i = 0; i < FILE_COUNT; i++) assert(visits.order[i] == i);
+
+    // Any other window visits every file exactly once
+    options.window = 3;
+    visits = (Visits){file_names, {0}, 0, 0};
+    assert(ID3v2_scan_files(file_names, FILE_COUNT, &options, record_visit, &visits) == 0);
+    assert_visited_once(&visits);
+
+    options.window = 0;
+    visits = (Visits){file_names, {0}, 0, 0};
+    assert(ID3v2_scan_files(file_names, FILE_COUNT, &options, record_visit, &visits) == 0);
+    assert_visited_once(&visits);
+
+    // Files that can't be located go last
+    assert(visits.order[FILE_COUNT - 1] == SCANNED_FILE_COUNT);
+
+    // The callback can stop the scan
+    visits = (Visits){file_names, {0}, 0, 3};
+    assert(
+        ID3v2_scan_files(file_names, FILE_COUNT, &options, record_visit, &visits) ==
+        ID3v2_OPERATION_CANCELLED
+    );
+    assert(visits.count == 3);
+
+    // Scans run with the I/O class of the installed throttle, and give the
+    // previous one back
+    const int previous_priority = io_priority();
+    ID3v2_Throttle* throttle = ID3v2_Throttle_new(ID3v2_IO_CLASS_BEST_EFFORT, 7, 0, 0);
+    ID3v2_Throttle_install(throttle);
+    assert(ID3v2_scan_files(file_names, FILE_COUNT, NULL, check_io_priority, NULL) == 0);
+    assert(io_priority() == previous_priority);
+
+    ID3v2_Throttle_install(NULL);
+    ID3v2_Throttle_free(throttle);
+
+    printf("SCAN TEST: OK\n");
+}
+
+void update_files_test()
+{
+    const char* file_names[FILE_COUNT];
+    char names[SCANNED_FILE_COUNT][32];
+
+    for (int i = 0; i < SCANNED_FILE_COUNT; i++)
+    {
+        sprintf(names[i], "extra/scanned_%02d.mp3", i);
+        file_names[i] = names[i];
+    }
+
+    file_names[SCANNED_FILE_COUNT] = MISSING_FILE;
+
+    const ID3v2_ScanOptions options = {ID3v2_SCAN_ORDER_PHYSICAL, 0};
+    assert(
+        ID3v2_update_files(
+            file_names,
+            FILE_COUNT,
+            &options,
+            retitle_even_files,
+            (void*) file_names
+        ) == 0
+    );
+
+    for (int i = 0; i < SCANNED_FILE_COUNT; i++)
+    {
+        ID3v2_Tag* tag = ID3v2_read_tag(names[i]);
+        const char* title = ID3v2_Tag_get_title_frame(tag)->data->text;
+        assert(strcmp(title, i % 2 == 0 ? "Updated" : names[i]) == 0);
+        ID3v2_Tag_free(tag);
+
+        remove(names[i]);
+    }
+
+    // Files that weren't asked to be written are left alone
+    FILE* missing = fopen(MISSING_FILE, "rb");
+    assert(missing == NULL);
+
+    printf("UPDATE FILES TEST: OK\n");
+}
+
+void scan_test_main()
+{
+    scan_test();
+    update_files_test();
+}
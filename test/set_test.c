@@ -10,6 +10,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "assertion_utils.h"
 #include "id3v2lib.h"
@@ -250,8 +251,211 @@ void new_tag_test()
 {
 }
 
+void keyed_comment_test()
+{
+    ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+
+    char* norm_desc = ID3v2_to_unicode("iTunNORM");
+    char* norm = ID3v2_to_unicode("00000A2B 00000C1D");
+    char* comment = ID3v2_to_unicode("Comment");
+    char* edited_comment = ID3v2_to_unicode("Edited comment");
+
+    ID3v2_Tag_add_comment_frame(
+        tag,
+        &(ID3v2_CommentFrameInput){
+            .flags = "\0\0",
+            .language = "eng",
+            .short_description = norm_desc,
+            .comment = norm,
+        }
+    );
+    ID3v2_Tag_set_comment(tag, "eng", comment);
+    ID3v2_Tag_set_comment(tag, "spa", comment);
+
+    // The empty description matches regardless of its encoding
+    assert(ID3v2_Tag_get_comment(tag, "eng", "") != NULL);
+    assert(ID3v2_Tag_get_comment(tag, "eng", EMPTY_UNICODE_STR) != NULL);
+    assert(ID3v2_Tag_get_comment(tag, "eng", NULL) != NULL);
+    assert(ID3v2_Tag_get_comment(tag, "eng", "iTunNORM") != NULL);
+    assert(ID3v2_Tag_get_comment(tag, "fra", "") == NULL);
+    assert(ID3v2_Tag_get_comment(tag, "eng", "iTunSMPB") == NULL);
+
+    // Setting a comment only replaces the frame with the same key
+    ID3v2_Tag_set_comment(tag, "eng", edited_comment);
+
+    assert_comment_frame(
+        ID3v2_Tag_get_comment_frame(tag),
+        &(ID3v2_CommentFrameInput){
+            .flags = "\0\0",
+            .language = "eng",
+            .short_description = norm_desc,
+            .comment = norm,
+        }
+    );
+    assert_comment_frame(
+        ID3v2_Tag_get_comment(tag, "eng", ""),
+        &(ID3v2_CommentFrameInput){
+            .flags = "\0\0",
+            .language = "eng",
+            .short_description = EMPTY_UNICODE_STR,
+            .comment = edited_comment,
+        }
+    );
+    assert_comment_frame(
+        ID3v2_Tag_get_comment(tag, "spa", ""),
+        &(ID3v2_CommentFrameInput){
+            .flags = "\0\0",
+            .language = "spa",
+            .short_description = EMPTY_UNICODE_STR,
+            .comment = comment,
+        }
+    );
+
+    ID3v2_Tag_delete_comment_frame(tag, 0);
+    assert(ID3v2_Tag_get_comment(tag, "eng", norm_desc) == NULL);
+    assert(ID3v2_Tag_get_comment(tag, "eng", "") != NULL);
+
+    free(norm_desc);
+    free(norm);
+    free(comment);
+    free(edited_comment);
+
+    ID3v2_Tag_free(tag);
+
+    printf("KEYED COMMENT TEST: OK\n");
+}
+
+void picture_type_test()
+{
+    ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+
+    ID3v2_Tag_set_picture(tag, ID3v2_PIC_TYPE_BACK_COVER, ID3v2_MIME_TYPE_JPG, 4, "back");
+    ID3v2_Tag_set_picture(tag, ID3v2_PIC_TYPE_ARTIST, ID3v2_MIME_TYPE_JPG, 6, "artist");
+
+    // Without a front cover, any picture is used as the album cover
+    assert(ID3v2_Tag_get_picture(tag, ID3v2_PIC_TYPE_FRONT_COVER) == NULL);
+    assert(ID3v2_Tag_get_album_cover_frame(tag) == ID3v2_Tag_get_picture(tag, 0x04));
+
+    ID3v2_Tag_set_album_cover(tag, ID3v2_MIME_TYPE_PNG, 5, "front");
+    ID3v2_Tag_set_picture(tag, ID3v2_PIC_TYPE_BACK_COVER, ID3v2_MIME_TYPE_PNG, 8, "new back");
+
+    assert_apic_frame(
+        ID3v2_Tag_get_album_cover_frame(tag),
+        &(ID3v2_ApicFrameInput){
+            .flags = "\0\0",
+            .mime_type = ID3v2_MIME_TYPE_PNG,
+            .description = EMPTY_UNICODE_STR,
+            .picture_type = ID3v2_PIC_TYPE_FRONT_COVER,
+            .data = "front",
+            .picture_size = 5,
+        }
+    );
+
+    // The back cover was replaced in place, the other pictures are untouched
+    ID3v2_FrameList* apics = ID3v2_Tag_get_apic_frames(tag);
+    assert((ID3v2_ApicFrame*) apics->frame == ID3v2_Tag_get_picture(tag, 0x04));
+    assert((ID3v2_ApicFrame*) apics->next->frame == ID3v2_Tag_get_picture(tag, 0x08));
+    assert(apics->next->next->next == NULL);
+    assert_apic_frame(
+        (ID3v2_ApicFrame*) apics->frame,
+        &(ID3v2_ApicFrameInput){
+            .flags = "\0\0",
+            .mime_type = ID3v2_MIME_TYPE_PNG,
+            .description = EMPTY_UNICODE_STR,
+            .picture_type = ID3v2_PIC_TYPE_BACK_COVER,
+            .data = "new back",
+            .picture_size = 8,
+        }
+    );
+    ID3v2_FrameList_unlink(apics);
+
+    ID3v2_Tag_delete_apic_frame(tag, 0);
+    assert(ID3v2_Tag_get_picture(tag, ID3v2_PIC_TYPE_BACK_COVER) == NULL);
+    assert(ID3v2_Tag_get_picture(tag, ID3v2_PIC_TYPE_ARTIST) != NULL);
+
+    ID3v2_Tag_free(tag);
+
+    printf("PICTURE TYPE TEST: OK\n");
+}
+
+void text_values_test()
+{
+    // Neither view is NUL terminated, only their first bytes are used
+    const char* title = "Ragnar\xC3\xB6k rising";
+    const char* emoji = "\xF0\x9F\xA4\x98!";
+
+    // v2.3 tags don't know about UTF-8, it's stored as UTF-16
+    ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+    ID3v2_Tag_set_text(tag, ID3v2_TITLE_FRAME_ID, title, 9, ID3v2_ENCODING_UTF8);
+    ID3v2_Tag_set_text(tag, ID3v2_ALBUM_FRAME_ID, emoji, 4, ID3v2_ENCODING_UTF8);
+
+    ID3v2_TextFrame* frame = ID3v2_Tag_get_title_frame(tag);
+    assert(frame->data->encoding == ID3v2_ENCODING_UNICODE);
+    assert(frame->data->size == 20);
+    assert(memcmp(frame->data->text, "\xFF\xFER\0a\0g\0n\0a\0r\0\xF6\0k\0\0\0", 20) == 0);
+    assert(frame->header->size == 21);
+
+    // Code points outside the BMP take a surrogate pair
+    frame = ID3v2_Tag_get_album_frame(tag);
+    assert(frame->data->size == 8);
+    assert(memcmp(frame->data->text, "\xFF\xFE\x3E\xD8\x18\xDD\0\0", 8) == 0);
+
+    // Several values are joined with a slash, behind a single BOM
+    const ID3v2_TextValue names[] = {{"Amon", 4}, {"Doro", 4}};
+    ID3v2_Tag_set_text_values(tag, ID3v2_ARTIST_FRAME_ID, names, 2, ID3v2_ENCODING_ISO);
+    frame = ID3v2_Tag_get_artist_frame(tag);
+    assert(frame->data->size == 10);
+    assert(memcmp(frame->data->text, "Amon/Doro\0", 10) == 0);
+
+    ID3v2_Tag_set_text_values(tag, ID3v2_ARTIST_FRAME_ID, names, 2, ID3v2_ENCODING_UTF8);
+    frame = ID3v2_Tag_get_artist_frame(tag);
+    assert(frame->data->size == 22);
+    assert(memcmp(frame->data->text, "\xFF\xFE" "A\0m\0o\0n\0/\0D\0o\0r\0o\0\0\0", 22) == 0);
+    assert(frame->header->size == 23);
+
+    // Encodings that don't exist are ignored
+    ID3v2_Tag_set_text(tag, ID3v2_COMPOSER_FRAME_ID, "Doro", 4, 4);
+    assert(ID3v2_Tag_get_composer_frame(tag) == NULL);
+
+    ID3v2_Tag_free(tag);
+
+    // v2.4 tags store UTF-8 as is and every value NUL terminated
+    tag = ID3v2_Tag_new_empty();
+    tag->header->major_version = 4;
+
+    const ID3v2_TextValue artists[] = {
+        {"Amon Amarth", 11},
+        {title, 9},
+    };
+    ID3v2_Tag_set_text_values(tag, ID3v2_ARTIST_FRAME_ID, artists, 2, ID3v2_ENCODING_UTF8);
+    ID3v2_Tag_set_text(tag, ID3v2_TITLE_FRAME_ID, "\0O\0k", 4, ID3v2_ENCODING_UTF16BE);
+
+    clone_file("extra/no_tag.mp3", EDITED_FILE);
+    ID3v2_write_tag(EDITED_FILE, tag);
+    ID3v2_Tag_free(tag);
+
+    tag = ID3v2_read_tag(EDITED_FILE);
+    frame = ID3v2_Tag_get_artist_frame(tag);
+    assert(frame->data->encoding == ID3v2_ENCODING_UTF8);
+    assert(frame->data->size == 22);
+    assert(memcmp(frame->data->text, "Amon Amarth\0Ragnar\xC3\xB6k\0", 22) == 0);
+
+    frame = ID3v2_Tag_get_title_frame(tag);
+    assert(frame->data->encoding == ID3v2_ENCODING_UTF16BE);
+    assert(frame->data->size == 6);
+    assert(memcmp(frame->data->text, "\0O\0k\0\0", 6) == 0);
+
+    ID3v2_Tag_free(tag);
+    remove(EDITED_FILE);
+
+    printf("TEXT VALUES TEST: OK\n");
+}
+
 void set_test_main()
 {
     edit_test();
     new_tag_test();
+    keyed_comment_test();
+    picture_type_test();
+    text_values_test();
 }
@@ -0,0 +1,138 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "id3v2lib.h"
+#include "test_utils.h"
+
+#include "snapshot_test.h"
+
+#define ORIGINAL_FILE "extra/file.mp3"
+#define SNAPSHOT_FILE "extra/file.snapshot"
+
+void snapshot_test()
+{
+    ID3v2_Tag* tag = ID3v2_read_tag(ORIGINAL_FILE);
+    int size = 0;
+    char* snapshot = ID3v2_Snapshot_new(tag, &size);
+
+    // Store it and read it back through a mapping, like a cache would
+    FILE* fp = fopen(SNAPSHOT_FILE, "wb");
+    fwrite(snapshot, sizeof(char), size, fp);
+    fclose(fp);
+    free(snapshot);
+
+    const int fd = open(SNAPSHOT_FILE, O_RDONLY);
+    const char* mapped = (const char*) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    assert(mapped != MAP_FAILED);
+
+    assert(ID3v2_Snapshot_is_valid(mapped, size));
+    assert(!ID3v2_Snapshot_is_valid(mapped, size - 1));
+    assert(ID3v2_Snapshot_get_major_version(mapped) == tag->header->major_version);
+
+    int frame_count = 0;
+    ID3v2_FrameList* head = tag->frames;
+
+    for (; head != NULL && head->frame != NULL; head = head->next, frame_count++)
+    {
+        ID3v2_FrameRef frame;
+        assert(ID3v2_Snapshot_get_frame(mapped, frame_count, &frame));
+        assert(memcmp(frame.id, head->frame->header->id, 4) == 0);
+        assert(frame.size == head->frame->header->size);
+    }
+
+    assert(ID3v2_Snapshot_get_frame_count(mapped) == frame_count);
+
+    ID3v2_FrameRef frame;
+    assert(!ID3v2_Snapshot_get_frame(mapped, frame_count, &frame));
+
+    // Text frames hold their encoding followed by the text
+    assert(ID3v2_Snapshot_find_frame(mapped, ID3v2_YEAR_FRAME_ID, 0, &frame) >= 0);
+    assert(frame.data[0] == ID3v2_ENCODING_ISO);
+    assert(memcmp(frame.data + 1, "2019", 4) == 0);
+
+    // Or decoded into the frames tags are made of
+    const int title_index = ID3v2_Snapshot_find_frame(mapped, ID3v2_TITLE_FRAME_ID, 0, &frame);
+    ID3v2_TextFrame* title = (ID3v2_TextFrame*) ID3v2_Snapshot_decode_frame(mapped, title_index);
+    ID3v2_TextFrame* expected_title = ID3v2_Tag_get_title_frame(tag);
+    assert(title != NULL);
+    assert(title->data->encoding == expected_title->data->encoding);
+    assert(title->data->size == expected_title->data->size);
+    assert(memcmp(title->data->text, expected_title->data->text, title->data->size) == 0);
+    ID3v2_Frame_free((ID3v2_Frame*) title);
+    assert(ID3v2_Snapshot_decode_frame(mapped, frame_count) == NULL);
+
+    ID3v2_ApicFrame* cover = ID3v2_Tag_get_album_cover_frame(tag);
+    const int index = ID3v2_Snapshot_find_frame(mapped, ID3v2_ALBUM_COVER_FRAME_ID, 0, &frame);
+    assert(index >= 0);
+    assert(
+        memcmp(
+            frame.data + frame.size - cover->data->picture_size,
+            cover->data->data,
+            cover->data->picture_size
+        ) == 0
+    );
+    assert(ID3v2_Snapshot_find_frame(mapped, ID3v2_ALBUM_COVER_FRAME_ID, index + 1, &frame) < 0);
+    assert(ID3v2_Snapshot_find_frame(mapped, "PRIV", 0, &frame) < 0);
+
+    munmap((void*) mapped, size);
+    remove(SNAPSHOT_FILE);
+
+    // An empty tag is a snapshot without frames
+    ID3v2_Tag* empty_tag = ID3v2_Tag_new_empty();
+    snapshot = ID3v2_Snapshot_new(empty_tag, &size);
+    assert(size == ID3v2_SNAPSHOT_HEADER_LENGTH);
+    assert(ID3v2_Snapshot_is_valid(snapshot, size));
+    assert(ID3v2_Snapshot_get_frame_count(snapshot) == 0);
+    free(snapshot);
+
+    ID3v2_Tag_free(empty_tag);
+    ID3v2_Tag_free(tag);
+
+    printf("SNAPSHOT TEST: OK\n");
+}
+
+void snapshot_in_place_test()
+{
+    // v2.4 frames keep their UTF-8 text, read without decoding the frame
+    ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+    tag->header->major_version = 4;
+    ID3v2_Tag_set_text(tag, ID3v2_TITLE_FRAME_ID, "Ragnar\xC3\xB6k", 9, ID3v2_ENCODING_UTF8);
+
+    int size = 0;
+    char* snapshot = ID3v2_Snapshot_new(tag, &size);
+    assert(ID3v2_Snapshot_get_major_version(snapshot) == 4);
+
+    ID3v2_FrameRef frame;
+    ID3v2_TextRef title;
+    assert(ID3v2_Snapshot_find_frame(snapshot, ID3v2_TITLE_FRAME_ID, 0, &frame) == 0);
+    assert(ID3v2_FrameRef_get_text(&frame, &title));
+    assert(title.encoding == ID3v2_ENCODING_UTF8);
+    assert(title.size == 9);
+    assert(memcmp(title.text, "Ragnar\xC3\xB6k", 9) == 0);
+
+    free(snapshot);
+    ID3v2_Tag_free(tag);
+
+    printf("SNAPSHOT IN PLACE TEST: OK\n");
+}
+
+void snapshot_test_main()
+{
+    snapshot_test();
+    snapshot_in_place_test();
+}
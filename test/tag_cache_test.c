@@ -0,0 +1,192 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "id3v2lib.h"
+#include "test_utils.h"
+
+#include "tag_cache_test.h"
+
+#define ORIGINAL_FILE "extra/file.mp3"
+#define CACHED_FILE "extra/cached.mp3"
+#define SMALL_FILE_COUNT (ID3v2_TAG_CACHE_SHARDS + 1)
+#define CACHE_BYTES (ID3v2_TAG_CACHE_SHARDS * 8 * 1024 * 1024)
+
+void tag_cache_test()
+{
+    ID3v2_TagCacheStats stats;
+    ID3v2_TagCache* cache = ID3v2_TagCache_new(CACHE_BYTES, ID3v2_TAG_CACHE_KEEP_PICTURES, 0);
+    ID3v2_TagCache_install(cache);
+
+    clone_file(ORIGINAL_FILE, CACHED_FILE);
+
+    ID3v2_Tag* tag = ID3v2_read_tag(CACHED_FILE);
+    ID3v2_Tag* cached_tag = ID3v2_read_tag(CACHED_FILE);
+
+    ID3v2_TagCache_get_stats(cache, &stats);
+    assert(stats.misses == 1);
+    assert(stats.hits == 1);
+    assert(stats.entries == 1);
+    assert(stats.bytes > 0);
+
+    // Hits are new copies, identical to what was read from disk
+    assert(cached_tag != tag);
+    assert(cached_tag->padding_size == tag->padding_size);
+    assert(cached_tag->header->tag_size == tag->header->tag_size);
+    assert(
+        strcmp(
+            ID3v2_Tag_get_title_frame(cached_tag)->data->text,
+            ID3v2_Tag_get_title_frame(tag)->data->text
+        ) == 0
+    );
+    assert(
+        ID3v2_Tag_get_album_cover_frame(cached_tag)->data->picture_size ==
+        ID3v2_Tag_get_album_cover_frame(tag)->data->picture_size
+    );
+
+    // Writing the file drops it from the cache
+    ID3v2_Tag_set_title(cached_tag, "Cached");
+    ID3v2_write_tag(CACHED_FILE, cached_tag);
+    ID3v2_Tag_free(cached_tag);
+
+    cached_tag = ID3v2_read_tag(CACHED_FILE);
+    assert(strcmp(ID3v2_Tag_get_title_frame(cached_tag)->data->text, "Cached") == 0);
+    ID3v2_Tag_free(cached_tag);
+
+    ID3v2_TagCache_get_stats(cache, &stats);
+    assert(stats.misses == 2);
+    assert(stats.hits == 1);
+
+    ID3v2_TagCache_install(NULL);
+    ID3v2_TagCache_free(cache);
+
+    printf("TAG CACHE TEST: OK\n");
+
+    // Tags are evicted once a shard goes over its share of the budget. With
+    // a tag per shard, some of these small files have to share one.
+    char small_files[SMALL_FILE_COUNT][32];
+    unsigned long long small_tag_bytes = 0;
+
+    for (int i = 0; i < SMALL_FILE_COUNT; i++)
+    {
+        sprintf(small_files[i], "extra/cached_%02d.mp3", i);
+        clone_file("extra/empty.mp3", small_files[i]);
+
+        ID3v2_Tag* small_tag = ID3v2_Tag_new_empty();
+        ID3v2_Tag_set_title(small_tag, small_files[i]);
+        ID3v2_write_tag(small_files[i], small_tag);
+        ID3v2_Tag_free(small_tag);
+    }
+
+    cache = ID3v2_TagCache_new(CACHE_BYTES, ID3v2_TAG_CACHE_KEEP_PICTURES, 0);
+    ID3v2_TagCache_install(cache);
+    ID3v2_Tag_free(ID3v2_read_tag(small_files[0]));
+    ID3v2_TagCache_get_stats(cache, &stats);
+    small_tag_bytes = stats.bytes;
+    ID3v2_TagCache_install(NULL);
+    ID3v2_TagCache_free(cache);
+
+    cache = ID3v2_TagCache_new(
+        ID3v2_TAG_CACHE_SHARDS * (small_tag_bytes + small_tag_bytes / 2),
+        ID3v2_TAG_CACHE_KEEP_PICTURES,
+        0
+    );
+    ID3v2_TagCache_install(cache);
+
+    for (int i = 0; i < SMALL_FILE_COUNT; i++)
+    {
+        ID3v2_Tag_free(ID3v2_read_tag(small_files[i]));
+    }
+
+    ID3v2_TagCache_get_stats(cache, &stats);
+    assert(stats.misses == SMALL_FILE_COUNT);
+    assert(stats.evictions > 0);
+    assert(stats.entries == SMALL_FILE_COUNT - stats.evictions);
+    assert(stats.bytes == stats.entries * small_tag_bytes);
+
+    // The last file read is always cached
+    cached_tag = ID3v2_read_tag(small_files[SMALL_FILE_COUNT - 1]);
+    assert(
+        strcmp(
+            ID3v2_Tag_get_title_frame(cached_tag)->data->text,
+            small_files[SMALL_FILE_COUNT - 1]
+        ) == 0
+    );
+    ID3v2_Tag_free(cached_tag);
+
+    ID3v2_TagCache_get_stats(cache, &stats);
+    assert(stats.hits == 1);
+
+    ID3v2_TagCache_install(NULL);
+    ID3v2_TagCache_free(cache);
+
+    for (int i = 0; i < SMALL_FILE_COUNT; i++) remove(small_files[i]);
+
+    printf("TAG CACHE EVICTION TEST: OK\n");
+
+    // Large pictures can be kept out of the cache
+    cache = ID3v2_TagCache_new(CACHE_BYTES, ID3v2_TAG_CACHE_SKIP_PICTURES, 1024);
+    ID3v2_TagCache_install(cache);
+
+    ID3v2_Tag_free(ID3v2_read_tag(CACHED_FILE));
+    ID3v2_TagCache_get_stats(cache, &stats);
+    assert(stats.entries == 0);
+
+    ID3v2_TagCache_install(NULL);
+    ID3v2_TagCache_free(cache);
+
+    cache = ID3v2_TagCache_new(CACHE_BYTES, ID3v2_TAG_CACHE_DROP_PICTURES, 1024);
+    ID3v2_TagCache_install(cache);
+
+    // Or cached without them, leaving the tag that was read alone
+    cached_tag = ID3v2_read_tag(CACHED_FILE);
+    assert(ID3v2_Tag_get_album_cover_frame(cached_tag) != NULL);
+    assert(!cached_tag->partial);
+    ID3v2_Tag_free(cached_tag);
+
+    cached_tag = ID3v2_read_tag(CACHED_FILE);
+    assert(ID3v2_Tag_get_album_cover_frame(cached_tag) == NULL);
+    assert(ID3v2_Tag_get_title_frame(cached_tag) != NULL);
+    assert(cached_tag->partial);
+
+    ID3v2_TagCache_get_stats(cache, &stats);
+    assert(stats.entries == 1);
+    assert(stats.bytes < 1024 * 1024);
+
+    // Tags missing their pictures are never written back
+    assert(ID3v2_write_tag_with_progress(CACHED_FILE, cached_tag, NULL, NULL) == -1);
+    ID3v2_Tag_free(cached_tag);
+
+    // Nor do read-modify-write calls lose them
+    ID3v2_Tag_free(ID3v2_read_tag(CACHED_FILE));
+    assert(ID3v2_increment_play_count(CACHED_FILE, NULL) == 0);
+    ID3v2_Tag_free(ID3v2_read_tag(CACHED_FILE));
+    assert(ID3v2_set_rating(CACHED_FILE, "someone@example.com", 200) == 0);
+
+    ID3v2_TagCache_install(NULL);
+    ID3v2_TagCache_free(cache);
+
+    cached_tag = ID3v2_read_tag(CACHED_FILE);
+    assert(ID3v2_Tag_get_album_cover_frame(cached_tag) != NULL);
+    assert(ID3v2_Tag_get_play_counter_frame(cached_tag) != NULL);
+    ID3v2_Tag_free(cached_tag);
+
+    printf("TAG CACHE PICTURES TEST: OK\n");
+
+    ID3v2_Tag_free(tag);
+    remove(CACHED_FILE);
+}
+
+void tag_cache_test_main()
+{
+    tag_cache_test();
+}
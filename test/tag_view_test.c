@@ -0,0 +1,151 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "id3v2lib.h"
+#include "test_utils.h"
+
+#include "tag_view_test.h"
+
+void tag_view_test()
+{
+    long size = 0;
+    char* file = read_file("extra/file.mp3", &size);
+    ID3v2_Tag* tag = ID3v2_read_tag("extra/file.mp3");
+
+    ID3v2_TagView view;
+    assert(ID3v2_TagView_init(&view, file, size));
+    assert(view.major_version == 3);
+
+    // Same frames as the parsed tag, in the same order
+    ID3v2_FrameRef frame;
+    ID3v2_FrameList* frames = tag->frames;
+    int count = 0;
+
+    while (ID3v2_TagView_next(&view, &frame))
+    {
+        assert(memcmp(frame.id, frames->frame->header->id, ID3v2_FRAME_HEADER_ID_LENGTH) == 0);
+        frames = frames->next;
+        count++;
+    }
+
+    assert(count > 0 && frames == NULL);
+
+    // Text keeps its encoding, UTF-16 keeps its BOM
+    ID3v2_TextRef text;
+    assert(ID3v2_TagView_find_frame(&view, ID3v2_TITLE_FRAME_ID, &frame));
+    assert(ID3v2_FrameRef_get_text(&frame, &text));
+    assert(text.encoding == ID3v2_ENCODING_UNICODE);
+    assert(text.size == 14);
+    assert(memcmp(text.text, "\xFF\xFE" "R\0i\0v\0e\0r\0s\0", 14) == 0);
+
+    ID3v2_CommentRef comment;
+    assert(ID3v2_TagView_find_frame(&view, ID3v2_COMMENT_FRAME_ID, &frame));
+    assert(ID3v2_FrameRef_get_comment(&frame, &comment));
+    assert(memcmp(comment.language, "eng", 3) == 0);
+    assert(comment.short_description.size == 2);
+    assert(comment.comment.size == 2 + 2 * strlen("This is a comment"));
+    assert(memcmp(comment.comment.text + 2, "T\0h\0i\0s\0", 8) == 0);
+
+    ID3v2_PictureRef picture;
+    ID3v2_ApicFrame* cover = ID3v2_Tag_get_album_cover_frame(tag);
+    assert(ID3v2_TagView_find_frame(&view, ID3v2_ALBUM_COVER_FRAME_ID, &frame));
+    assert(ID3v2_FrameRef_get_picture(&frame, &picture));
+    assert(strcmp(picture.mime_type, ID3v2_MIME_TYPE_PNG) == 0);
+    assert(picture.picture_type == 0x03);
+    assert(picture.size == cover->data->picture_size);
+    assert(memcmp(picture.data, cover->data->data, picture.size) == 0);
+
+    assert(!ID3v2_TagView_find_frame(&view, "TXXX", &frame));
+
+    ID3v2_Tag_free(tag);
+    free(file);
+
+    // Only v2.3 and v2.4 tags are read
+    long no_tag_size = 0;
+    char* no_tag = read_file("extra/no_tag.mp3", &no_tag_size);
+    assert(!ID3v2_TagView_init(&view, no_tag, no_tag_size));
+    free(no_tag);
+
+    printf("TAG VIEW TEST: OK\n");
+}
+
+void tag_view_frames_test()
+{
+    // v2.4 tag with a TXXX frame and a text frame with a data length
+    // indicator, followed by padding
+    const char buffer[] = "ID3\x04\x00\x00\x00\x00\x00\x35"
+                          "TXXX\x00\x00\x00\x0A\x00\x00"
+                          "\x03" "MOOD\0" "Calm"
+                          "TPE1\x00\x00\x00\x09\x00\x01"
+                          "\x00\x00\x00\x05"
+                          "\x03" "Doro"
+                          "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00";
+
+    ID3v2_TagView view;
+    ID3v2_FrameRef frame;
+    assert(ID3v2_TagView_init(&view, buffer, sizeof(buffer) - 1));
+
+    ID3v2_UserTextRef user_text;
+    assert(ID3v2_TagView_next(&view, &frame));
+    assert(ID3v2_FrameRef_get_user_text(&frame, &user_text));
+    assert(user_text.description.encoding == ID3v2_ENCODING_UTF8);
+    assert(user_text.description.size == 4);
+    assert(memcmp(user_text.description.text, "MOOD", 4) == 0);
+    assert(user_text.value.size == 4);
+    assert(memcmp(user_text.value.text, "Calm", 4) == 0);
+
+    ID3v2_TextRef text;
+    assert(ID3v2_TagView_next(&view, &frame));
+    assert(frame.size == 5);
+    assert(ID3v2_FrameRef_get_text(&frame, &text));
+    assert(text.size == 4);
+    assert(memcmp(text.text, "Doro", 4) == 0);
+
+    assert(!ID3v2_TagView_next(&view, &frame));
+
+    ID3v2_TagView_rewind(&view);
+    assert(ID3v2_TagView_next(&view, &frame));
+    assert(memcmp(frame.id, "TXXX", 4) == 0);
+
+    // Frames that don't fit in the buffer aren't handed out
+    assert(ID3v2_TagView_init(&view, buffer, 30));
+    assert(ID3v2_TagView_next(&view, &frame));
+    assert(!ID3v2_TagView_next(&view, &frame));
+
+    // Unsynchronised frames can't be read in place
+    char unsynchronised[sizeof(buffer)];
+    memcpy(unsynchronised, buffer, sizeof(buffer));
+    unsynchronised[19] = 0x02;
+    assert(ID3v2_TagView_init(&view, unsynchronised, sizeof(buffer) - 1));
+    assert(ID3v2_TagView_next(&view, &frame));
+    assert(!ID3v2_FrameRef_get_user_text(&frame, &user_text));
+
+    // So aren't the frames of a tag unsynchronised as a whole, flagged or not
+    memcpy(unsynchronised, buffer, sizeof(buffer));
+    unsynchronised[5] = (char) 0x80;
+    assert(ID3v2_TagView_init(&view, unsynchronised, sizeof(buffer) - 1));
+    assert(view.unsynchronised);
+    assert(ID3v2_TagView_next(&view, &frame));
+    assert(!ID3v2_FrameRef_get_user_text(&frame, &user_text));
+    assert(ID3v2_TagView_next(&view, &frame));
+    assert(!ID3v2_FrameRef_get_text(&frame, &text));
+
+    printf("TAG VIEW FRAMES TEST: OK\n");
+}
+
+void tag_view_test_main()
+{
+    tag_view_test();
+    tag_view_frames_test();
+}
@@ -7,6 +7,7 @@
  * file that was distributed with this source code.
  */
 
+#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -167,3 +168,31 @@ void clone_file(const char* src, const char* dest)
     fclose(src_fp);
     fclose(dest_fp);
 }
+
+char* read_file(const char* file_name, long* size)
+{
+    FILE* fp = fopen(file_name, "rb");
+    assert(fp != NULL);
+
+    fseek(fp, 0, SEEK_END);
+    *size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    char* bytes = (char*) malloc(*size);
+    assert(fread(bytes, sizeof(char), *size, fp) == (size_t) *size);
+    fclose(fp);
+
+    return bytes;
+}
+
+long file_size(const char* file_name)
+{
+    FILE* fp = fopen(file_name, "rb");
+    assert(fp != NULL);
+
+    fseek(fp, 0, SEEK_END);
+    const long size = ftell(fp);
+    fclose(fp);
+
+    return size;
+}
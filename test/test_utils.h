@@ -31,5 +31,7 @@ uint16_t* char_to_utf16(const char* string, int size);
 void println_utf16(uint16_t* string, int size);
 char* to_unicode(char* string);
 void clone_file(const char* src, const char* dest);
+char* read_file(const char* file_name, long* size);
+long file_size(const char* file_name);
 
 #endif
@@ -0,0 +1,83 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "id3v2lib.h"
+#include "test_utils.h"
+
+#include "throttle_test.h"
+
+#define ORIGINAL_FILE "extra/file.mp3"
+#define THROTTLED_FILE "extra/throttled.mp3"
+#define BYTES_PER_SECOND (16 * 1024 * 1024)
+
+static unsigned long long now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void throttle_test()
+{
+    ID3v2_ThrottleStats stats;
+    ID3v2_Throttle* throttle = ID3v2_Throttle_new(ID3v2_IO_CLASS_IDLE, 7, BYTES_PER_SECOND, 1);
+    ID3v2_Throttle_install(throttle);
+
+    clone_file(ORIGINAL_FILE, THROTTLED_FILE);
+    ID3v2_Tag* tag = ID3v2_read_tag(THROTTLED_FILE);
+
+    // Writes that fit in the existing tag don't move anything
+    ID3v2_Tag_set_title(tag, "Throttled");
+    ID3v2_write_tag(THROTTLED_FILE, tag);
+
+    ID3v2_Throttle_get_stats(throttle, &stats);
+    assert(stats.rewrites == 0);
+    assert(stats.bytes_moved == 0);
+
+    // The audio is copied once, into the file that replaces the original
+    const unsigned long long start = now_ns();
+    ID3v2_delete_tag(THROTTLED_FILE);
+    const unsigned long long elapsed_ns = now_ns() - start;
+    const long audio_size = file_size(THROTTLED_FILE);
+
+    ID3v2_Throttle_get_stats(throttle, &stats);
+    assert(stats.rewrites == 1);
+    assert(stats.bytes_moved == audio_size);
+
+    // Everything past the initial burst has to wait for the bucket
+    const unsigned long long expected_ns =
+        (stats.bytes_moved - BYTES_PER_SECOND / 10) * 1000000000ULL / BYTES_PER_SECOND;
+    assert(elapsed_ns >= expected_ns * 9 / 10);
+    assert(stats.throttled_ns > 0);
+
+    ID3v2_write_tag(THROTTLED_FILE, tag);
+    assert(ID3v2_read_tag_header(THROTTLED_FILE) != NULL);
+
+    ID3v2_Throttle_get_stats(throttle, &stats);
+    assert(stats.rewrites == 2);
+    assert(stats.bytes_moved == 2 * audio_size);
+    assert(stats.rewrite_wait_ns == 0);
+
+    ID3v2_Throttle_install(NULL);
+    ID3v2_Throttle_free(throttle);
+    ID3v2_Tag_free(tag);
+    remove(THROTTLED_FILE);
+
+    printf("THROTTLE TEST: OK\n");
+}
+
+void throttle_test_main()
+{
+    throttle_test();
+}
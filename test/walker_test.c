@@ -0,0 +1,206 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "id3v2lib.h"
+#include "test_utils.h"
+
+#include "walker_test.h"
+
+#define WALK_ROOT "extra/walk"
+#define MOVED_ARTIST "extra/walk_artist"
+#define MAX_FOUND 64
+
+static const char* const directories[] = {
+    WALK_ROOT,
+    WALK_ROOT "/Artist",
+    WALK_ROOT "/Artist/Album",
+    WALK_ROOT "/Artist/Album/CD1",
+    WALK_ROOT "/Artist/Album/CD2",
+    WALK_ROOT "/Empty",
+};
+
+static const char* const audio_files[] = {
+    WALK_ROOT "/root.mp3",
+    WALK_ROOT "/Artist/Album/CD1/01.mp3",
+    WALK_ROOT "/Artist/Album/CD1/02.MP3",
+    WALK_ROOT "/Artist/Album/CD2/01.wav",
+    WALK_ROOT "/Artist/Album/CD2/02.aiff",
+};
+
+static const char* const other_files[] = {
+    WALK_ROOT "/Artist/Album/cover.jpg",
+    WALK_ROOT "/Artist/Album/notes.txt",
+    WALK_ROOT "/Artist/mp3",
+    WALK_ROOT "/Artist/.mp3.part",
+};
+
+#define COUNT(array) ((int) (sizeof(array) / sizeof(array[0])))
+
+typedef struct _Found
+{
+    pthread_mutex_t lock;
+    char* paths[MAX_FOUND];
+    int count;
+    int stop_after;
+    int tags;
+} Found;
+
+static bool record_path(const char* path, void* ctx)
+{
+    Found* found = (Found*) ctx;
+
+    pthread_mutex_lock(&found->lock);
+    found->paths[found->count++] = strdup(path);
+    const bool proceed = found->count != found->stop_after;
+    pthread_mutex_unlock(&found->lock);
+
+    return proceed;
+}
+
+static bool record_tag(const char* path, ID3v2_Tag* tag, void* ctx)
+{
+    Found* found = (Found*) ctx;
+
+    if (tag != NULL)
+    {
+        assert(strcmp(ID3v2_Tag_get_title_frame(tag)->data->text, path) == 0);
+
+        pthread_mutex_lock(&found->lock);
+        found->tags++;
+        pthread_mutex_unlock(&found->lock);
+    }
+
+    return record_path(path, ctx);
+}
+
+static bool swap_artist_for_symlink(const char* path, void* ctx)
+{
+    if (strcmp(path, WALK_ROOT "/root.mp3") == 0)
+    {
+        assert(rename(WALK_ROOT "/Artist", MOVED_ARTIST) == 0);
+        assert(symlink("../walk_artist", WALK_ROOT "/Artist") == 0);
+    }
+
+    return record_path(path, ctx);
+}
+
+static bool was_found(Found* found, const char* path)
+{
+    for (int i = 0; i < found->count; i++)
+    {
+        if (strcmp(found->paths[i], path) == 0) return true;
+    }
+
+    return false;
+}
+
+static void reset(Found* found, const int stop_after)
+{
+    for (int i = 0; i < found->count; i++) free(found->paths[i]);
+    found->count = 0;
+    found->tags = 0;
+    found->stop_after = stop_after;
+}
+
+static void create_tree()
+{
+    for (int i = 0; i < COUNT(directories); i++) mkdir(directories[i], 0755);
+
+    for (int i = 0; i < COUNT(audio_files); i++)
+    {
+        clone_file("extra/empty.mp3", audio_files[i]);
+
+        ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+        ID3v2_Tag_set_title(tag, audio_files[i]);
+        ID3v2_write_tag(audio_files[i], tag);
+        ID3v2_Tag_free(tag);
+    }
+
+    for (int i = 0; i < COUNT(other_files); i++) clone_file("extra/empty.mp3", other_files[i]);
+}
+
+static void delete_tree()
+{
+    for (int i = 0; i < COUNT(audio_files); i++) remove(audio_files[i]);
+    for (int i = 0; i < COUNT(other_files); i++) remove(other_files[i]);
+    for (int i = COUNT(directories) - 1; i >= 0; i--) rmdir(directories[i]);
+}
+
+void walker_test()
+{
+    Found found = {PTHREAD_MUTEX_INITIALIZER, {NULL}, 0, 0, 0};
+    create_tree();
+
+    // Only audio files are reported, whatever the case of their extension
+    for (int threads = 1; threads <= 4; threads *= 2)
+    {
+        const ID3v2_WalkOptions options = {threads, NULL, 0};
+        reset(&found, 0);
+
+        assert(ID3v2_walk(WALK_ROOT, &options, record_path, &found) == 0);
+        assert(found.count == COUNT(audio_files));
+        for (int i = 0; i < COUNT(audio_files); i++) assert(was_found(&found, audio_files[i]));
+    }
+
+    // Any extension can be asked for
+    const char* const extensions[] = {"txt", "JPG"};
+    const ID3v2_WalkOptions options = {2, extensions, COUNT(extensions)};
+    reset(&found, 0);
+
+    assert(ID3v2_walk(WALK_ROOT "/", &options, record_path, &found) == 0);
+    assert(found.count == 2);
+    assert(was_found(&found, WALK_ROOT "/Artist/Album/cover.jpg"));
+    assert(was_found(&found, WALK_ROOT "/Artist/Album/notes.txt"));
+
+    // The callback can stop the walk
+    reset(&found, 2);
+    assert(ID3v2_walk(WALK_ROOT, NULL, record_path, &found) == ID3v2_OPERATION_CANCELLED);
+    assert(found.count == 2);
+
+    reset(&found, 0);
+    assert(ID3v2_walk(WALK_ROOT "/missing", NULL, record_path, &found) == -1);
+    assert(found.count == 0);
+
+    // Directories queued before being swapped for a symlink aren't followed
+    const ID3v2_WalkOptions single_thread = {1, NULL, 0};
+    reset(&found, 0);
+    assert(ID3v2_walk(WALK_ROOT, &single_thread, swap_artist_for_symlink, &found) == 0);
+    assert(found.count == 1);
+
+    remove(WALK_ROOT "/Artist");
+    rename(MOVED_ARTIST, WALK_ROOT "/Artist");
+
+    printf("WALKER TEST: OK\n");
+
+    // Tags are read on the walking threads
+    reset(&found, 0);
+    assert(ID3v2_scan_tree(WALK_ROOT, NULL, record_tag, &found) == 0);
+    assert(found.count == COUNT(audio_files));
+    assert(found.tags == COUNT(audio_files));
+
+    reset(&found, 0);
+    delete_tree();
+
+    printf("SCAN TREE TEST: OK\n");
+}
+
+void walker_test_main()
+{
+    walker_test();
+}
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+#
+# This file is part of id3v2lib library
+#
+# Copyright (c) Lars Ruiz
+#
+# For the full copyright and license information, please view the LICENSE
+# file that was distributed with this source code.
+#
+# Writes src/modules/codepage_tables.c from the codecs of Python's standard
+# library: python3 tools/codepage_tables.py > src/modules/codepage_tables.c
+
+HEADER = """/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+// Generated by tools/codepage_tables.py, don't edit
+
+#include "codepage.private.h"
+"""
+
+SHIFT_JIS_LEADS = list(range(0x81, 0xA0)) + list(range(0xE0, 0xFD))
+GBK_LEADS = list(range(0x81, 0xFF))
+
+
+def decode(codec, data):
+    try:
+        text = data.decode(codec)
+    except UnicodeDecodeError:
+        return 0
+
+    if len(text) != 1: return 0
+
+    code_point = ord(text)
+
+    # Controls and private use characters don't come out of text
+    if code_point < 0xA0 or 0xE000 <= code_point < 0xF900: return 0
+
+    return code_point
+
+
+def high_half(codec, extra={}):
+    return [extra.get(byte, decode(codec, bytes([byte]))) for byte in range(0x80, 0x100)]
+
+
+def double_bytes(codec, leads, first_trail, last_trail):
+    return [
+        decode(codec, bytes([lead, trail]))
+        for lead in leads
+        for trail in range(first_trail, last_trail + 1)
+    ]
+
+
+def print_table(name, size, values):
+    print()
+    print("const unsigned short %s[%s] = {" % (name, size))
+
+    for i in range(0, len(values), 12):
+        print("    " + " ".join("0x%04X," % value for value in values[i:i + 12]))
+
+    print("};")
+
+
+print(HEADER, end="")
+
+print_table("cp1251_table", "128", high_half("cp1251"))
+print_table("cp1252_table", "128", high_half("cp1252"))
+
+# Lead bytes are left at 0, single byte half-width katakana aren't
+print_table(
+    "shift_jis_table",
+    "128",
+    [0 if 0x80 + i in SHIFT_JIS_LEADS else value for i, value in enumerate(high_half("cp932"))],
+)
+
+# Windows maps the lone 0x80 to the euro sign
+print_table("gbk_table", "128", [0x20AC] + [0] * 127)
+
+print_table(
+    "shift_jis_double_table",
+    "SHIFT_JIS_LEAD_COUNT * SHIFT_JIS_TRAIL_COUNT",
+    double_bytes("cp932", SHIFT_JIS_LEADS, 0x40, 0xFC),
+)
+print_table(
+    "gbk_double_table",
+    "GBK_LEAD_COUNT * GBK_TRAIL_COUNT",
+    double_bytes("gbk", GBK_LEADS, 0x40, 0xFE),
+)
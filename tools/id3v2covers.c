@@ -0,0 +1,156 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "id3v2lib.h"
+
+/**
+ * Extracts the pictures of audio files into a content addressed store and
+ * prints the mapping of the store, a line per picture:
+ *
+ *   file  picture type  hash  mime type  size  widthxheight
+ *
+ * separated by tabs. Directories are walked for the files the library can
+ * read. Files that didn't change since the last run are skipped.
+ */
+
+typedef struct _FileList
+{
+    pthread_mutex_t lock;
+    int count;
+    int capacity;
+    char** file_names;
+} FileList;
+
+static void FileList_add(FileList* list, const char* file_name)
+{
+    pthread_mutex_lock(&list->lock);
+
+    if (list->count == list->capacity)
+    {
+        list->capacity = list->capacity == 0 ? 256 : list->capacity * 2;
+        list->file_names = (char**) realloc(list->file_names, list->capacity * sizeof(char*));
+    }
+
+    list->file_names[list->count++] = strdup(file_name);
+
+    pthread_mutex_unlock(&list->lock);
+}
+
+static bool add_found_file(const char* path, void* ctx)
+{
+    FileList_add((FileList*) ctx, path);
+    return true;
+}
+
+static bool print_cover(const ID3v2_Cover* cover, void* ctx)
+{
+    printf(
+        "%s\t%d\t%s\t%s\t%ld\t%dx%d\n",
+        cover->file_name,
+        cover->picture_type,
+        cover->hash,
+        cover->mime_type,
+        cover->size,
+        cover->width,
+        cover->height
+    );
+
+    return true;
+}
+
+static void print_usage(const char* program)
+{
+    fprintf(stderr, "usage: %s [-j threads] store path...\n", program);
+}
+
+int main(int argc, char* argv[])
+{
+    int threads = 0;
+    int option;
+
+    while ((option = getopt(argc, argv, "j:")) != -1)
+    {
+        if (option != 'j')
+        {
+            print_usage(argv[0]);
+            return 2;
+        }
+
+        threads = atoi(optarg);
+    }
+
+    if (argc - optind < 2)
+    {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    ID3v2_CoverStore* store = ID3v2_CoverStore_open(argv[optind]);
+
+    if (store == NULL)
+    {
+        fprintf(stderr, "%s: can't open the store %s\n", argv[0], argv[optind]);
+        return 1;
+    }
+
+    FileList files = {PTHREAD_MUTEX_INITIALIZER};
+    ID3v2_WalkOptions walk_options = {threads, NULL, 0};
+
+    for (int i = optind + 1; i < argc; i++)
+    {
+        struct stat st;
+
+        if (stat(argv[i], &st) == 0 && S_ISDIR(st.st_mode))
+        {
+            ID3v2_walk(argv[i], &walk_options, add_found_file, &files);
+        }
+        else
+        {
+            FileList_add(&files, argv[i]);
+        }
+    }
+
+    ID3v2_CoverStats stats;
+    const int result = ID3v2_CoverStore_extract(
+        store,
+        (const char* const*) files.file_names,
+        files.count,
+        threads,
+        &stats
+    );
+
+    ID3v2_CoverStore_for_each(store, print_cover, NULL);
+
+    fprintf(
+        stderr,
+        "%d files, %d unchanged, %d pictures, %d stored, %d failed\n",
+        files.count,
+        stats.unchanged_files,
+        stats.pictures,
+        stats.stored_pictures,
+        stats.failed
+    );
+
+    if (result != 0) fprintf(stderr, "%s: can't save the mapping of the store\n", argv[0]);
+
+    for (int i = 0; i < files.count; i++) free(files.file_names[i]);
+    free(files.file_names);
+    ID3v2_CoverStore_close(store);
+
+    return result == 0 && stats.failed == 0 ? 0 : 1;
+}